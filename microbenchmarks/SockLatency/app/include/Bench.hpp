@@ -0,0 +1,136 @@
+#pragma once
+
+// Measurement and output of the compute benchmarks (operators, memory), shared by both targets.
+//
+//   parseList/parseNames   comma-separated flag values
+//   measure_repetitions    times warmup + measured repetitions of a run, with process cpu time and perf counters
+//   output_bench_results   one CSV row of a run: the config columns of the target, the latency summary of the
+//                          repetitions, throughput, cpu_util and the perf counters, every line prefixed as a whole
+//
+// The config type of a target provides csv_header() and to_csv(), like the ExperimentConfig of the client.
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Logger.hpp"
+#include "PerfCounters.hpp"
+#include "Recorder.hpp"
+#include "Utilities.hpp"
+
+inline std::vector<double> parseList(const std::string &str) {
+    std::vector<double> values;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty()) values.push_back(std::stod(item));
+    return values;
+}
+
+inline std::vector<std::string> parseNames(const std::string &str) {
+    std::vector<std::string> names;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty()) names.push_back(item);
+    return names;
+}
+
+struct BenchResult {
+    LatencySummary summary;  // per repetition [us], divided by per_rep
+    double cpu_util;         // process cpu time per wall time of all repetitions, 1 = one busy core
+    LoopCounters counters;
+    uint64_t checksum;       // of the last repetition
+};
+
+// Times warmup + measured repetitions of run(), which returns the result checksum of a repetition. The checksum
+// has to be equal for all repetitions of label. Each repetition is recorded divided by per_rep [us], e.g. the loads
+// of a pointer chase.
+template <typename Run>
+BenchResult measure_repetitions(const std::string &label, const size_t warmup_repetitions, const size_t repetitions,
+                                const double per_rep, const bool perf_counters, const bool output_outliers, Run run)
+{
+    const size_t total = warmup_repetitions + repetitions;
+    VectorRecorder recorder(WarmupPolicy{ warmup_repetitions, 0 }, total, 3);
+    const PerfMeter perf(perf_counters, true);
+    const double cpu_start = cpu_clock_sec(CLOCK_PROCESS_CPUTIME_ID);
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t checksum = 0;
+    for (size_t rep = 0; rep < total; rep++) {
+        const auto t0 = std::chrono::steady_clock::now();
+        const uint64_t result = run();
+        recorder.record(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / per_rep);
+        if (rep > 0 && result != checksum) {
+            error("Result of " + label + " differs between repetitions: " + std::to_string(result) + " != " + std::to_string(checksum));
+            throw std::runtime_error("Inconsistent benchmark result");
+        }
+        checksum = result;
+    }
+    const double elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double cpu_util = (cpu_clock_sec(CLOCK_PROCESS_CPUTIME_ID) - cpu_start) / elapsed_sec;
+    return BenchResult{ recorder.summary(output_outliers), cpu_util, perf.read(), checksum };
+}
+
+// throughput: work per second at the median repetition, with work in the unit of the target (rows, bytes, loads)
+template <typename Config>
+void output_bench_results(const Config& config, const BenchResult& result, const double work, const bool printHeader,
+                          const std::string &outfile, const std::string &line_prefix)
+{
+    const LatencySummary &results = result.summary;
+    const double throughput = results.median > 0 ? work / results.median * 1e6 : 0;
+
+    // lines are prefixed as a whole, e.g. the enclave console interleaves kernel messages
+    std::ostringstream out;
+    if (printHeader) csv::write_csv(out, config.csv_header(), "act_sample_count", "act_warmup_rounds",
+        "min",
+        "max",
+        "p99",
+        "p999",
+        "avg",
+        "median",
+        "q25",
+        "q75",
+        "lower_bound",
+        "upper_bound",
+        "num_outliers_lo",
+        "num_outliers_hi",
+        "outliers_lo",
+        "outliers_hi",
+        "throughput",
+        "cpu_util",
+        LoopCounters::csv_header());
+    csv::write_csv(out, config.to_csv(), results.num_measurements, results.num_warmup_rounds,
+        results.min,
+        results.max,
+        results.p99,
+        results.p999,
+        results.avg,
+        results.median,
+        results.q25,
+        results.q75,
+        results.lower_bound,
+        results.upper_bound,
+        results.num_outliers_lo,
+        results.num_outliers_hi,
+        results.outliers_lo,
+        results.outliers_hi,
+        throughput,
+        result.cpu_util,
+        result.counters.to_csv());
+
+    std::unique_ptr<std::ofstream> file;
+    if (outfile.size()) file = std::make_unique<std::ofstream>(outfile, std::ios_base::app);
+    std::ostream &os = file ? *file : std::cout;
+    std::istringstream lines(out.str());
+    std::string line;
+    while (std::getline(lines, line))
+        os << line_prefix << line << "\n";
+    os.flush();
+}
@@ -4,28 +4,99 @@
 #include <iostream>
 #include <cstring>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include <linux/vm_sockets.h>
 #include <unistd.h>
 #include <memory>
 #include <vector>
+#include <atomic>
 
 // local includes
 #include "Logger.hpp"
 #include "myTypes.h"
+#include "Transport.hpp"
+#include "Recorder.hpp"
+#include "Timer.hpp"
+#include "Framing.hpp"
+#include "Sealing.hpp"
+#include "Compression.hpp"
+#include "Columnar.hpp"
+#include "Trace.hpp"
+#include "PerfCounters.hpp"
+#include "ShmChannel.hpp"
 
 
+// request schedule of the open-loop load generator
+enum ArrivalProcess {
+    CLOSED,    // closed loop: next request after the previous response
+    CONSTANT,  // open loop: fixed inter-arrival time 1/rate
+    POISSON    // open loop: exponentially distributed inter-arrival times with mean 1/rate
+};
+
+inline std::string to_string(const ArrivalProcess arrival)
+{
+    switch (arrival)
+    {
+    case CLOSED:
+        return "closed";
+    case CONSTANT:
+        return "constant";
+    case POISSON:
+        return "poisson";
+    default:
+        return "unknown";
+    }
+}
+
+inline std::ostream& operator<<(std::ostream& os, const ArrivalProcess& arrival) {
+    os << to_string(arrival);
+    return os;
+}
+
+// message size that varies between the steps of a sweep
+enum SweepVary {
+    REQ,   // request size, fixed response size
+    RSP,   // response size, fixed request size
+    BOTH   // request and response size
+};
+
+inline std::string to_string(const SweepVary vary)
+{
+    switch (vary)
+    {
+    case REQ:
+        return "req";
+    case RSP:
+        return "rsp";
+    case BOTH:
+        return "both";
+    default:
+        return "unknown";
+    }
+}
+
 struct ClientConfig {
     size_t buf_size;
     size_t msg_size;
 };
 
+// per-thread counters of the bandwidth workloads
+struct StreamCounters {
+    uint64_t bytes = 0;      // on the wire
+    uint64_t raw_bytes = 0;  // compressed streams: before compression or after decompression, otherwise bytes
+    uint64_t msgs = 0;       // complete messages (send: msg_size, receive: rsp_size), compressed streams: chunks
+    double elapsed_sec = 0;
+    double cpu_sec = 0;  // thread cpu time
+};
+
 struct ExperimentConfig;
 
 class Client
 {
 protected:
     int sock = 0;
+    std::unique_ptr<ShmChannel> shm;  // data channel of the shm protocol, sock is its control connection
     Client(const SocketProtocol protocol, const size_t buf_size);
     void connectToServer();
     virtual struct sockaddr *getSockAddr(socklen_t *len) const = 0;
@@ -33,12 +104,65 @@ protected:
 
 private:
     std::unique_ptr<char[]> buf;
+    IoStats io_stats;  // partial reads and sends of the last measurement
     void handshake(const ExperimentConfig &config);
+    void awaitHello();
+    void reconfigure(const ExperimentConfig &config);  // sweep: update the server config over the open connection
+    void prepare(const ExperimentConfig &config);
+    template <typename Recorder>
+    void runClosedLoop(const ExperimentConfig &config);
+    template <typename Recorder>
+    void runOpenLoop(const ExperimentConfig &config);
+    template <typename Recorder>
+    void runPipelined(const ExperimentConfig &config);
+    template <typename Recorder>
+    void runDecomposed(const ExperimentConfig &config);
+    template <typename Recorder>
+    void runSweep(const ExperimentConfig &config);
+    template <typename Recorder>
+    void runReplay(const ExperimentConfig &config);
+    template <typename Recorder>
+    void runSealed(const ExperimentConfig &config);
+    template <typename Recorder>
+    void measureConnection(const ExperimentConfig &config, Recorder &recorder);
+    template <typename Recorder>
+    static void measureConcurrent(const ExperimentConfig &config, std::vector<std::unique_ptr<Client>> &clients);
+    template <typename Recorder>
+    static void measureMultiplexed(const ExperimentConfig &config, const std::vector<Client*> &clients, const std::vector<Recorder*> &recorders);
 
-    std::vector<double> measureRTT(const size_t num_samples, const size_t msg_size);
-    std::vector<double> measureRTT(const size_t num_max_samples, const size_t msg_size, const double timeout_sec);
-    std::vector<double> measureRTTLarge(const size_t num_max_samples, const size_t msg_size, const size_t rsp_exp_size,const double timeout_sec);
+    template <typename Transport, typename Recorder>
+    void measure(Transport &transport, Recorder &recorder, const ExperimentConfig &config, std::string &msg);
+    template <typename Transport, typename Recorder, typename Timer>
+    void measure(Transport &transport, Recorder &recorder, const Timer &timer, const ExperimentConfig &config, std::string &msg);
+    template <typename Transport, typename Recorder, typename Timer>
+    void measureRTT(Transport &transport, Recorder &recorder, const Timer &timer, const size_t num_samples, std::string &msg);
+    template <typename Transport, typename Recorder, typename Timer>
+    void measureRTT(Transport &transport, Recorder &recorder, const Timer &timer, const size_t num_max_samples, std::string &msg, const double timeout_sec);
+    template <typename Transport, typename Recorder, typename Timer>
+    void measureRTTLarge(Transport &transport, Recorder &recorder, const Timer &timer, const size_t num_max_samples, std::string &msg, const size_t rsp_exp_size, const double timeout_sec);
+    template <typename Transport, typename Recorder, typename Timer>
+    void measureFramed(Transport &transport, Recorder &recorder, const Timer &timer, const ExperimentConfig &config, std::string &msg);
     // std::vector<double> measureRTT(double timeout_sec);
+    bool streamSend(const std::atomic<bool> &stop, const std::string &msg, StreamCounters &counters);
+    bool streamRecv(const std::atomic<bool> &stop, const size_t rsp_size, StreamCounters &counters);
+    bool streamSendCompressed(const std::atomic<bool> &stop, const ExperimentConfig &config, const size_t stream, StreamCounters &counters);
+    bool streamRecvCompressed(const std::atomic<bool> &stop, const ExperimentConfig &config, StreamCounters &counters);
+    template <typename Recorder>
+    void measurePipelined(Recorder &recorder, const ExperimentConfig &config, std::string &msg, double &achieved_rate);
+    template <typename Transport>
+    int64_t syncClock(Transport &transport, const ExperimentConfig &config, std::string &msg);
+    template <typename Transport, typename Recorder>
+    void measureDecomposed(Transport &transport, std::vector<Recorder> &recorders, const ExperimentConfig &config, std::string &msg, const int64_t offset_ns);
+    template <typename Transport, typename Recorder>
+    double measureReplay(Transport &transport, std::vector<Recorder> &recorders, const std::vector<size_t> &class_of, const ExperimentConfig &config, std::string &msg);
+    template <typename Transport, typename Recorder, typename Timer>
+    double measureReplay(Transport &transport, std::vector<Recorder> &recorders, const std::vector<size_t> &class_of, const Timer &timer, const ExperimentConfig &config, std::string &msg);
+    template <typename Transport, typename Recorder>
+    void measureSealed(Transport &transport, std::vector<Recorder> &recorders, RecordCipher &cipher, const ExperimentConfig &config, std::string &sealed, char *record);
+    template <typename Transport, typename Recorder, typename Timer>
+    void measureSealed(Transport &transport, std::vector<Recorder> &recorders, RecordCipher &cipher, const Timer &timer, const ExperimentConfig &config, std::string &sealed, char *record);
+    template <typename Recorder>
+    void measureOpenLoop(Recorder &recorder, const ExperimentConfig &config, std::string &msg, double &achieved_rate);
 
 public:
     const SocketProtocol protocol;
@@ -52,6 +176,12 @@ public:
     Client() = delete;
 
     void run(const ExperimentConfig &config);
+    // config.connections connections driven by config.threads (pinned) threads, per-connection and aggregated results
+    static void runConcurrent(const ExperimentConfig &config, const std::string& adr, const int port);
+    // bandwidth workloads: config.connections parallel streams for the configured duration
+    static void runBandwidth(const ExperimentConfig &config, const std::string& adr, const int port);
+    // scan workload: per batch size, columnar batches streamed over a fresh connection, filtered and aggregated by the server
+    static void runScan(const ExperimentConfig &config, const std::string& adr, const int port);
 };
 
 class InetClient : public Client {
@@ -71,3 +201,21 @@ public:
 private:
     struct sockaddr_vm serv_addr;
 };
+
+// unix stream or seqpacket socket, the local IPC baseline of the same host
+class UnixClient : public Client {
+public:
+    UnixClient(const SocketProtocol protocol, const std::string& path, const size_t buf_size);
+    struct sockaddr *getSockAddr(socklen_t *len) const override { *len = addrlen; return (struct sockaddr*)&serv_addr; }
+    int checkBufferSizes(const ExperimentConfig& conf) const override;
+private:
+    struct sockaddr_un serv_addr;
+    socklen_t addrlen;
+};
+
+// shared-memory rings, connected and handed over to the server via a unix control socket at the path
+class ShmClient : public UnixClient {
+public:
+    ShmClient(const std::string& path, const size_t buf_size, const size_t ring_size, const bool hugepages);
+    int checkBufferSizes(const ExperimentConfig& conf) const override;
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+// Columnar batches of the scan workload: the host streams fixed-size batches of a key, a group and a value column
+// into the enclave, the enclave evaluates
+//
+//   SELECT group, COUNT(*), SUM(value) FROM batches WHERE key < threshold GROUP BY group
+//
+// over all batches of the stream and returns only the aggregates.
+//
+// A batch is a 64-byte BatchHeader followed by its uint32 columns, each padded to 64 bytes. The header holds the
+// byte offset of every column, so a received batch is decoded in place: the columns of a BatchView point into
+// the receive buffer. A batch with 0 rows ends the stream. Sealed streams carry every batch as a single AES-GCM
+// record (Sealing.hpp) that the enclave opens in place before it decodes the batch.
+//
+// The server receives into a BatchRing of scan_buffers buffers (2: double, 3: triple buffering) on a receiving
+// thread, while the calling thread opens, filters (select_lt, Operators.hpp) and aggregates the previous batches.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Operators.hpp"
+#include "myTypes.h"
+
+constexpr uint32_t BATCH_MAGIC = 0xc01b47c4;
+constexpr size_t BATCH_ALIGN = 64;
+constexpr size_t BATCH_COLUMNS = 3;
+constexpr size_t COL_KEY = 0;    // filter column, uniform uint32
+constexpr size_t COL_GROUP = 1;  // group of the row, uniform in [0, scan_groups)
+constexpr size_t COL_VALUE = 2;  // aggregated column, uniform in [0, 2^16)
+constexpr size_t MAX_BATCH_ROWS = 1 << 24;
+constexpr size_t SCAN_POOL_BYTES = 64 << 20;  // client: generated batches sent round robin
+
+struct BatchHeader {
+    uint32_t magic;      // BATCH_MAGIC (never starts with CONFIG_UPDATE_MARKER)
+    uint32_t rows;       // 0: end of the stream
+    uint64_t seq;        // batch number of the stream
+    uint32_t columns;    // BATCH_COLUMNS
+    uint32_t reserved;
+    uint64_t offset[BATCH_COLUMNS];  // byte offset of each column from the start of the batch
+    uint64_t pad[2];
+};
+static_assert(sizeof(BatchHeader) == BATCH_ALIGN, "BatchHeader must fill the first cache line of a batch");
+
+// result of a scan stream, sent by the server after the end of the stream, followed by groups AggEntry
+struct ScanSummary {
+    uint64_t batches;
+    uint64_t rows;
+    uint64_t selected;
+    uint64_t elapsed_ns;        // start of the stream to the last batch aggregated
+    uint64_t recv_ns;           // receiving thread reading batches
+    uint64_t compute_ns;        // calling thread opening, filtering and aggregating batches
+    uint64_t crypto_ns;         // sealed: opening the records, part of compute_ns
+    uint64_t recv_stall_ns;     // receiving thread waiting for a free buffer (compute bound)
+    uint64_t compute_stall_ns;  // calling thread waiting for a received batch (receive bound)
+    uint32_t groups;            // AggEntry following the summary
+    uint32_t simd;              // SimdLevel of the filter on the server
+};
+
+inline size_t batch_column_bytes(const size_t rows)
+{
+    return (rows * sizeof(uint32_t) + BATCH_ALIGN - 1) / BATCH_ALIGN * BATCH_ALIGN;
+}
+
+// bytes of a batch of rows rows
+inline size_t batch_bytes(const size_t rows)
+{
+    return sizeof(BatchHeader) + BATCH_COLUMNS * batch_column_bytes(rows);
+}
+
+// threshold of the filter key < threshold that selects a fraction of the uniform keys
+inline uint32_t scan_threshold(const double selectivity)
+{
+    const double bound = selectivity * 4294967296.0;
+    return bound >= std::numeric_limits<uint32_t>::max() ? std::numeric_limits<uint32_t>::max() : static_cast<uint32_t>(std::max(bound, 0.0));
+}
+
+// a generated batch, deterministic for the seed
+inline std::string make_batch(const size_t rows, const uint32_t groups, const uint64_t seed)
+{
+    std::string batch(batch_bytes(rows), '\0');
+    BatchHeader hdr = {};
+    hdr.magic = BATCH_MAGIC;
+    hdr.rows = static_cast<uint32_t>(rows);
+    hdr.columns = BATCH_COLUMNS;
+    for (size_t c = 0; c < BATCH_COLUMNS; c++)
+        hdr.offset[c] = sizeof(BatchHeader) + c * batch_column_bytes(rows);
+    std::memcpy(batch.data(), &hdr, sizeof(hdr));
+
+    uint64_t state = seed;
+    for (size_t i = 0; i < rows; i++) {
+        const uint64_t r = splitmix64(state);
+        const uint32_t row[BATCH_COLUMNS] = { static_cast<uint32_t>(r), static_cast<uint32_t>((r >> 32) % groups),
+                                              static_cast<uint32_t>(splitmix64(state) & 0xffff) };
+        for (size_t c = 0; c < BATCH_COLUMNS; c++)
+            std::memcpy(batch.data() + hdr.offset[c] + i * sizeof(uint32_t), &row[c], sizeof(uint32_t));
+    }
+    return batch;
+}
+
+inline void put_batch_seq(char *batch, const uint64_t seq)
+{
+    std::memcpy(batch + offsetof(BatchHeader, seq), &seq, sizeof(seq));
+}
+
+// a batch decoded in place
+struct BatchView {
+    uint32_t rows;
+    uint64_t seq;
+    const uint32_t *col[BATCH_COLUMNS];
+};
+
+// decodes the len bytes of batch (4-byte aligned) into view, false if the header does not describe a valid
+// batch of at most max_rows rows within len bytes
+inline bool decode_batch(const char *batch, const size_t len, const size_t max_rows, BatchView &view)
+{
+    if (len < sizeof(BatchHeader)) return false;
+    BatchHeader hdr;
+    std::memcpy(&hdr, batch, sizeof(hdr));
+    if (hdr.magic != BATCH_MAGIC || hdr.columns != BATCH_COLUMNS || hdr.rows > max_rows) return false;
+    view.rows = hdr.rows;
+    view.seq = hdr.seq;
+    for (size_t c = 0; c < BATCH_COLUMNS; c++) {
+        if (hdr.rows == 0) {
+            view.col[c] = nullptr;
+            continue;
+        }
+        if (hdr.offset[c] < sizeof(BatchHeader) || hdr.offset[c] % sizeof(uint32_t) != 0 || hdr.offset[c] > len
+            || len - hdr.offset[c] < hdr.rows * sizeof(uint32_t))
+            return false;
+        view.col[c] = reinterpret_cast<const uint32_t*>(batch + hdr.offset[c]);
+    }
+    return true;
+}
+
+// filters key < threshold into the selection vector sel (batch.rows entries) and adds COUNT(*), SUM(value) of the
+// selected rows to their groups, returns the selected rows
+inline size_t scan_aggregate(const SimdLevel level, const BatchView &batch, const uint32_t threshold, uint32_t *sel, AggTable &table)
+{
+    const size_t n = select_lt(level, batch.col[COL_KEY], 0, batch.rows, threshold, sel);
+    const uint32_t *group = batch.col[COL_GROUP];
+    const uint32_t *value = batch.col[COL_VALUE];
+    for (size_t i = 0; i < n; i++)
+        table.add(group[sel[i]], 1, value[sel[i]]);
+    return n;
+}
+
+// checksum of a query result, the same for the groups and for the rows they aggregate: SUM(value + group)
+inline uint64_t scan_checksum(const AggEntry &e) { return e.sum + static_cast<uint64_t>(e.count) * e.key; }
+
+// Buffers between the receiving thread (acquire, publish) and the computing thread (take, release),
+// handed over in order. close() wakes up both sides, take() drains the published buffers first.
+class BatchRing
+{
+private:
+    std::vector<std::unique_ptr<char[]>> buffers;
+    std::vector<size_t> lens;
+    size_t head = 0;    // next buffer to take
+    size_t tail = 0;    // next buffer to acquire
+    size_t filled = 0;  // published buffers not yet released
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+public:
+    const size_t capacity;
+
+    BatchRing(const size_t count, const size_t capacity) : lens(std::max<size_t>(count, 1)), capacity(capacity)
+    {
+        for (size_t i = 0; i < lens.size(); i++)
+            buffers.push_back(std::make_unique<char[]>(capacity));
+    }
+
+    // receiving side: the next free buffer, nullptr once closed
+    char *acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return closed || filled < buffers.size(); });
+        return closed ? nullptr : buffers[tail].get();
+    }
+
+    // receiving side: the acquired buffer holds len bytes
+    void publish(const size_t len)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            lens[tail] = len;
+            tail = (tail + 1) % buffers.size();
+            filled++;
+        }
+        cv.notify_all();
+    }
+
+    // computing side: the oldest published buffer, nullptr once closed and drained
+    char *take(size_t &len)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return closed || filled > 0; });
+        if (filled == 0) return nullptr;
+        len = lens[head];
+        return buffers[head].get();
+    }
+
+    // computing side: the taken buffer can be reused
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            head = (head + 1) % buffers.size();
+            filled--;
+        }
+        cv.notify_all();
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        cv.notify_all();
+    }
+};
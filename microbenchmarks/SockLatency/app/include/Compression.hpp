@@ -0,0 +1,406 @@
+#pragma once
+
+// Chunked on-the-fly compression of the bulk streams of the bandwidth workloads (opt-in via the handshake config).
+//
+// A sender cuts its stream into chunks of compression_chunk raw bytes. A worker thread compresses the next
+// chunks into a ring of compression_depth frames while the sending thread writes the finished ones, i.e. the
+// compression of chunk i+1 overlaps with the transmission of chunk i (depth 2: double buffering).
+// A frame is a ChunkHeader and comp_len bytes. Chunks that do not shrink are sent as they are (comp_len == raw_len),
+// like the stored blocks of the codecs' own frame formats. The receiver decompresses every frame on its receiving
+// thread and checks its raw length.
+//
+// lz4 and zstd are optional: CMake defines HAVE_LZ4/HAVE_ZSTD and links the libraries when it finds them.
+// Both are used through their block APIs with a context per sender/receiver, set up once per stream.
+//
+// The sent data is synthetic, every 4 KiB block starts with random bytes and ends with compressibility % zeros
+// (fio's buffer_compress_percentage). The chunks are generated once per stream and compressed round robin.
+
+#ifndef HAVE_LZ4
+#define HAVE_LZ4 0
+#endif
+#ifndef HAVE_ZSTD
+#define HAVE_ZSTD 0
+#endif
+
+#if HAVE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Logger.hpp"
+#include "Utilities.hpp"
+#include "myTypes.h"
+
+constexpr uint32_t CHUNK_MAGIC = 0xc4c4c0de;
+constexpr size_t COMPRESSIBLE_BLOCK = 4096;
+constexpr size_t MAX_COMPRESSION_CHUNK = 64 << 20;
+constexpr size_t COMPRESSION_SOURCE_CHUNKS = 8;  // distinct raw chunks per stream
+
+struct ChunkHeader {
+    uint32_t magic;     // CHUNK_MAGIC (never starts with CONFIG_UPDATE_MARKER)
+    uint32_t raw_len;   // bytes of the chunk
+    uint32_t comp_len;  // bytes following the header, raw_len: stored uncompressed
+    uint32_t reserved;
+};
+static_assert(sizeof(ChunkHeader) == 16, "ChunkHeader must not be padded");
+
+inline bool compression_supported(const CompressionCodec codec)
+{
+    switch (codec)
+    {
+    case UNCOMPRESSED:
+        return true;
+    case LZ4:
+        return HAVE_LZ4;
+    case ZSTD:
+        return HAVE_ZSTD;
+    default:
+        return false;
+    }
+}
+
+// synthetic data of a stream: compressibility % zeros at the end of every 4 KiB block, random bytes before
+inline std::string compressible_chunk(const size_t len, const uint32_t compressibility, const uint64_t seed)
+{
+    std::string chunk(len, '\0');
+    std::mt19937_64 rng(seed);
+    const size_t random_len = COMPRESSIBLE_BLOCK - COMPRESSIBLE_BLOCK * std::min<uint32_t>(compressibility, 100) / 100;
+    for (size_t block = 0; block < len; block += COMPRESSIBLE_BLOCK) {
+        const size_t end = std::min(len, block + random_len);
+        for (size_t i = block; i < end; i += sizeof(uint64_t)) {
+            const uint64_t r = rng();
+            std::memcpy(chunk.data() + i, &r, std::min(sizeof(r), end - i));
+        }
+    }
+    return chunk;
+}
+
+inline std::vector<std::string> compressible_chunks(const ServerDynamicConfig &config, const uint64_t seed)
+{
+    std::vector<std::string> chunks;
+    for (size_t i = 0; i < COMPRESSION_SOURCE_CHUNKS; i++)
+        chunks.push_back(compressible_chunk(config.compression_chunk, config.compressibility, seed + i));
+    return chunks;
+}
+
+// compression context of one direction of a stream
+class ChunkCodec
+{
+private:
+    const CompressionCodec codec;
+    const int level;
+#if HAVE_LZ4
+    std::unique_ptr<char[]> lz4_state;
+#endif
+#if HAVE_ZSTD
+    ZSTD_CCtx *cctx = nullptr;
+    ZSTD_DCtx *dctx = nullptr;
+#endif
+
+    size_t bound(const size_t len) const
+    {
+        switch (codec)
+        {
+#if HAVE_LZ4
+        case LZ4:
+            return LZ4_compressBound(static_cast<int>(len));
+#endif
+#if HAVE_ZSTD
+        case ZSTD:
+            return ZSTD_compressBound(len);
+#endif
+        default:
+            return len;
+        }
+    }
+
+    // compressed size, 0 if the chunk does not shrink
+    size_t compress([[maybe_unused]] const char *src, [[maybe_unused]] const size_t len, [[maybe_unused]] char *dst,
+                    [[maybe_unused]] const size_t cap)
+    {
+        switch (codec)
+        {
+#if HAVE_LZ4
+        case LZ4: {
+            const int n = level >= LZ4HC_CLEVEL_MIN
+                ? LZ4_compress_HC_extStateHC(lz4_state.get(), src, dst, static_cast<int>(len), static_cast<int>(cap), level)
+                : LZ4_compress_fast_extState(lz4_state.get(), src, dst, static_cast<int>(len), static_cast<int>(cap), std::max(1, 1 - level));
+            return n > 0 ? static_cast<size_t>(n) : 0;
+        }
+#endif
+#if HAVE_ZSTD
+        case ZSTD: {
+            const size_t n = ZSTD_compressCCtx(cctx, dst, cap, src, len, level);
+            if (ZSTD_isError(n)) {
+                error("zstd compression failed: " + std::string(ZSTD_getErrorName(n)));
+                throw std::runtime_error("Compression failed");
+            }
+            return n;
+        }
+#endif
+        default:
+            return 0;
+        }
+    }
+
+public:
+    ChunkCodec(const CompressionCodec codec, const int level) : codec(codec), level(level)
+    {
+        if (codec == CompressionCodec::UNCOMPRESSED || !compression_supported(codec)) {
+            error("Compression codec " + to_string(codec) + " is not supported by this build");
+            throw std::invalid_argument("Unsupported compression codec");
+        }
+#if HAVE_LZ4
+        if (codec == CompressionCodec::LZ4)
+            lz4_state = std::make_unique<char[]>(level >= LZ4HC_CLEVEL_MIN ? LZ4_sizeofStateHC() : LZ4_sizeofState());
+#endif
+#if HAVE_ZSTD
+        if (codec == CompressionCodec::ZSTD) {
+            cctx = ZSTD_createCCtx();
+            dctx = ZSTD_createDCtx();
+            if (cctx == nullptr || dctx == nullptr) {
+                ZSTD_freeCCtx(cctx);
+                ZSTD_freeDCtx(dctx);
+                error("Setting up the zstd contexts failed");
+                throw std::runtime_error("Compression setup failed");
+            }
+        }
+#endif
+    }
+
+    ~ChunkCodec()
+    {
+#if HAVE_ZSTD
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+#endif
+    }
+
+    ChunkCodec(const ChunkCodec &) = delete;
+    ChunkCodec &operator=(const ChunkCodec &) = delete;
+
+    // bytes of the largest frame of a chunk of len raw bytes
+    size_t frame_bound(const size_t len) const
+    {
+        return sizeof(ChunkHeader) + std::max(len, bound(len));
+    }
+
+    // writes the frame of a chunk to frame (frame_bound(len) bytes), returns its size
+    size_t encode(const char *raw, const size_t len, char *frame)
+    {
+        char *payload = frame + sizeof(ChunkHeader);
+        size_t comp_len = compress(raw, len, payload, frame_bound(len) - sizeof(ChunkHeader));
+        if (comp_len == 0 || comp_len >= len) {
+            std::memcpy(payload, raw, len);
+            comp_len = len;
+        }
+        const ChunkHeader hdr = { CHUNK_MAGIC, static_cast<uint32_t>(len), static_cast<uint32_t>(comp_len), 0 };
+        std::memcpy(frame, &hdr, sizeof(hdr));
+        return sizeof(hdr) + comp_len;
+    }
+
+    // decompresses comp_len bytes into raw_len bytes of dst, false if the payload is corrupt
+    bool decode(const char *src, const size_t comp_len, char *dst, const size_t raw_len)
+    {
+        if (comp_len == raw_len) {
+            std::memcpy(dst, src, raw_len);
+            return true;
+        }
+        switch (codec)
+        {
+#if HAVE_LZ4
+        case LZ4:
+            return LZ4_decompress_safe(src, dst, static_cast<int>(comp_len), static_cast<int>(raw_len)) == static_cast<int>(raw_len);
+#endif
+#if HAVE_ZSTD
+        case ZSTD:
+            return ZSTD_decompressDCtx(dctx, dst, raw_len, src, comp_len) == raw_len;
+#endif
+        default:
+            return false;
+        }
+    }
+};
+
+// Sender side: a worker thread compresses the chunks of source round robin into a ring of depth frames,
+// next() hands out the oldest finished frame to the sending thread, release() returns its slot to the worker.
+class CompressPipeline
+{
+private:
+    ChunkCodec codec;
+    const std::vector<std::string> &source;
+    const size_t depth;
+    std::vector<std::unique_ptr<char[]>> frames;
+    std::vector<size_t> frame_len;
+    std::vector<size_t> raw_len;
+    size_t head = 0;    // next frame to send
+    size_t tail = 0;    // next frame to compress
+    size_t filled = 0;  // finished frames not yet released
+    bool stopped = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+    double cpu_sec = 0;  // worker cpu time
+    std::thread worker;
+
+    void compressLoop()
+    {
+        const double cpu_start = cpu_clock_sec();
+        for (size_t chunk = 0;; chunk++) {
+            size_t slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return stopped || filled < depth; });
+                if (stopped) break;
+                slot = tail;
+            }
+            const std::string &raw = source[chunk % source.size()];
+            const size_t len = codec.encode(raw.data(), raw.size(), frames[slot].get());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                frame_len[slot] = len;
+                raw_len[slot] = raw.size();
+                tail = (tail + 1) % depth;
+                filled++;
+            }
+            cv.notify_all();
+        }
+        cpu_sec = cpu_clock_sec() - cpu_start;
+    }
+
+public:
+    CompressPipeline(const ServerDynamicConfig &config, const std::vector<std::string> &source) :
+        codec(config.compression, config.compression_level), source(source), depth(std::max<uint32_t>(config.compression_depth, 1)),
+        frame_len(depth), raw_len(depth)
+    {
+        if (source.empty())
+            throw std::invalid_argument("No data to compress");
+        size_t max_len = 0;
+        for (const std::string &chunk : source)
+            max_len = std::max(max_len, chunk.size());
+        for (size_t i = 0; i < depth; i++)
+            frames.push_back(std::make_unique<char[]>(codec.frame_bound(max_len)));
+        worker = std::thread(&CompressPipeline::compressLoop, this);
+    }
+
+    ~CompressPipeline() { stop(); }
+
+    CompressPipeline(const CompressPipeline &) = delete;
+    CompressPipeline &operator=(const CompressPipeline &) = delete;
+
+    // the oldest finished frame and the raw bytes it carries, nullptr once stopped
+    const char *next(size_t &len, size_t &raw)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return stopped || filled > 0; });
+        if (stopped) return nullptr;
+        len = frame_len[head];
+        raw = raw_len[head];
+        return frames[head].get();
+    }
+
+    // the frame of next() is sent
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            head = (head + 1) % depth;
+            filled--;
+        }
+        cv.notify_all();
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        cv.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // cpu time of the compression worker, valid after stop()
+    double workerCpuSec() const { return cpu_sec; }
+};
+
+// Receiver side: reads the frames of a stream and decompresses them on the calling thread
+class ChunkReader
+{
+private:
+    ChunkCodec codec;
+    const size_t max_raw_len;
+    std::unique_ptr<char[]> frame;
+    std::unique_ptr<char[]> raw;
+    std::string err;
+
+public:
+    uint64_t raw_bytes = 0;   // decompressed bytes
+    uint64_t wire_bytes = 0;  // received bytes, headers included
+
+    ChunkReader(const ServerDynamicConfig &config) :
+        codec(config.compression, config.compression_level), max_raw_len(config.compression_chunk),
+        frame(std::make_unique<char[]>(codec.frame_bound(max_raw_len))), raw(std::make_unique<char[]>(max_raw_len)) {}
+
+    // reads and decompresses the next frame, false at the end of the stream or on an error (see error()).
+    // The peer may close or reset the connection anywhere, the stream ends with the last complete frame.
+    bool next(const int fd)
+    {
+        ChunkHeader hdr;
+        const int64_t n = readall(fd, reinterpret_cast<char*>(&hdr), sizeof(hdr));
+        if (n != (int64_t) sizeof(hdr)) {
+            if (n < 0 && errno != ECONNRESET)
+                err = "Read failed. Error: " + std::string(strerror(errno));
+            return false;
+        }
+        if (hdr.magic != CHUNK_MAGIC || hdr.raw_len == 0 || hdr.raw_len > max_raw_len || hdr.comp_len > codec.frame_bound(hdr.raw_len) - sizeof(ChunkHeader)) {
+            err = "Invalid chunk header: raw_len " + std::to_string(hdr.raw_len) + ", comp_len " + std::to_string(hdr.comp_len);
+            return false;
+        }
+        const int64_t m = readall(fd, frame.get(), hdr.comp_len);
+        if (m != (int64_t) hdr.comp_len) {
+            if (m < 0 && errno != ECONNRESET)
+                err = "Read failed. Error: " + std::string(strerror(errno));
+            return false;
+        }
+        if (!codec.decode(frame.get(), hdr.comp_len, raw.get(), hdr.raw_len)) {
+            err = "Decompressing a chunk of " + std::to_string(hdr.comp_len) + " bytes failed";
+            return false;
+        }
+        raw_bytes += hdr.raw_len;
+        wire_bytes += sizeof(hdr) + hdr.comp_len;
+        return true;
+    }
+
+    // reason of the last failed next(), empty at the end of the stream
+    const std::string &error() const { return err; }
+};
+
+// writes a frame completely, false if the connection is closed or fails
+inline bool send_frame(const int fd, const char *frame, const size_t len)
+{
+    size_t sent = 0;
+    while (sent < len) {
+        const ssize_t n = ::send(fd, frame + sent, len - sent, MSG_NOSIGNAL);
+        if (n <= 0) [[unlikely]] return false;
+        sent += n;
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+// Framed wire protocol (opt-in via the handshake config, the raw protocol sends bare payloads).
+//
+// Every request and response is a frame: a FrameHeader followed by the payload. Sizes in the header are
+// total frame sizes including the header, so a frame of msg_size bytes puts msg_size bytes on the wire
+// like a raw message. A request carries the response size it asks for, i.e. a single connection can mix
+// message sizes. Responses echo the sequence number of their request.
+//
+// FrameReader parses frames incrementally in the receive buffer: headers are decoded where they were read,
+// payloads are consumed without being copied or buffered, so frames may be larger than the buffer.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+constexpr uint16_t FRAME_MAGIC = 0x5e7f;
+
+struct FrameHeader {
+    uint16_t magic;     // FRAME_MAGIC, detects a desynchronized stream (and never starts with CONFIG_UPDATE_MARKER)
+    uint16_t flags;     // reserved
+    uint32_t seq;       // sequence number of the request, echoed by the response
+    uint32_t size;      // total size of this frame [B]
+    uint32_t rsp_size;  // requests: total size of the requested response frame [B], responses: 0
+};
+static_assert(sizeof(FrameHeader) == 16, "FrameHeader must not be padded");
+
+inline FrameHeader make_frame_header(const uint32_t seq, const uint32_t size, const uint32_t rsp_size = 0)
+{
+    return FrameHeader{ FRAME_MAGIC, 0, seq, size, rsp_size };
+}
+
+// writes a header into the head of a frame buffer (no alignment requirements)
+inline void put_frame_header(char *frame, const FrameHeader &hdr)
+{
+    std::memcpy(frame, &hdr, sizeof(hdr));
+}
+
+inline FrameHeader get_frame_header(const char *frame)
+{
+    FrameHeader hdr;
+    std::memcpy(&hdr, frame, sizeof(hdr));
+    return hdr;
+}
+
+class FrameReader
+{
+private:
+    char *buf = nullptr;
+    size_t cap = 0;
+    size_t fill = 0;       // bytes in buf not consumed yet (less than a header between calls)
+    size_t skip = 0;       // payload bytes of the current frame still to come
+    FrameHeader current{};
+    std::string err;
+
+public:
+    FrameReader() = default;
+
+    // buf must hold at least one header
+    FrameReader(char *buf, const size_t cap) : buf(buf), cap(cap) {}
+
+    // where the next read has to go
+    char *readPtr() const { return buf + fill; }
+    size_t readLen() const { return cap - fill; }
+
+    // at a frame boundary, i.e. the next read starts at the head of the buffer with a new frame
+    bool idle() const { return fill == 0 && skip == 0; }
+
+    // Consumes n bytes that were read to readPtr() and calls on_frame(header) for each frame completed by them.
+    // Returns false on a malformed frame, see error().
+    template <typename Fn>
+    bool consume(const size_t n, Fn on_frame)
+    {
+        fill += n;
+        size_t off = 0;
+        while (true)
+        {
+            if (skip > 0) {
+                const size_t len = std::min(skip, fill - off);
+                skip -= len;
+                off += len;
+                if (skip > 0) break;
+                on_frame(current);
+                continue;
+            }
+
+            if (fill - off < sizeof(FrameHeader)) break;
+            current = get_frame_header(buf + off);
+            if (current.magic != FRAME_MAGIC || current.size < sizeof(FrameHeader)) {
+                err = "malformed frame header (seq " + std::to_string(current.seq) + ", size " + std::to_string(current.size) + ")";
+                return false;
+            }
+            off += sizeof(FrameHeader);
+            skip = current.size - sizeof(FrameHeader);
+            if (skip == 0) on_frame(current);
+        }
+
+        // keep a partial header at the start of the buffer
+        if (off < fill) std::memmove(buf, buf + off, fill - off);
+        fill -= off;
+        return true;
+    }
+
+    const std::string &error() const { return err; }
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+// Constant-memory latency histogram with HDR (high dynamic range) bucketing:
+// values are grouped in power-of-two buckets, each split into linear sub-buckets,
+// such that every recorded value is kept with the requested number of significant decimal digits.
+// Histograms with equal precision and range can be merged by adding their counts.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+class Histogram
+{
+private:
+    int significant_digits;
+    uint64_t highest_trackable;
+    int sub_bucket_half_count_magnitude;
+    int64_t sub_bucket_count;
+    int64_t sub_bucket_half_count;
+    int64_t sub_bucket_mask;
+    int bucket_count;
+    std::vector<uint64_t> counts;
+
+    uint64_t total_count = 0;
+    uint64_t min_value = std::numeric_limits<uint64_t>::max();
+    uint64_t max_value = 0;
+    double sum = 0;  // exact mean, bucket medians would add the bucketing error
+
+    inline int bucketIndex(const uint64_t value) const {
+        const int pow2ceiling = 64 - __builtin_clzll(value | sub_bucket_mask);
+        return pow2ceiling - (sub_bucket_half_count_magnitude + 1);
+    }
+
+    inline size_t countsIndex(const uint64_t value) const {
+        const int bi = bucketIndex(value);
+        const int64_t sbi = value >> bi;
+        return ((size_t)(bi + 1) << sub_bucket_half_count_magnitude) + (sbi - sub_bucket_half_count);
+    }
+
+    inline uint64_t valueFromIndex(const size_t index) const {
+        int bi = (int)(index >> sub_bucket_half_count_magnitude) - 1;
+        int64_t sbi = (index & (sub_bucket_half_count - 1)) + sub_bucket_half_count;
+        if (bi < 0) {
+            sbi -= sub_bucket_half_count;
+            bi = 0;
+        }
+        return (uint64_t) sbi << bi;
+    }
+
+    inline uint64_t sizeOfEquivalentRange(const uint64_t value) const {
+        const int bi = bucketIndex(value);
+        const int64_t sbi = value >> bi;
+        return (uint64_t) 1 << (sbi >= sub_bucket_count ? bi + 1 : bi);
+    }
+
+public:
+    // highest_trackable: larger values are clamped; significant_digits: 1..5
+    Histogram(const uint64_t highest_trackable, const int significant_digits = 3) :
+        significant_digits(significant_digits), highest_trackable(highest_trackable)
+    {
+        if (significant_digits < 1 || significant_digits > 5)
+            throw std::invalid_argument("Histogram significant digits must be in [1, 5]");
+        if (highest_trackable < 2)
+            throw std::invalid_argument("Histogram highest trackable value must be >= 2");
+
+        const int64_t largest_single_unit_value = 2 * (int64_t) std::pow(10, significant_digits);
+        const int sub_bucket_count_magnitude = (int) std::ceil(std::log2((double) largest_single_unit_value));
+        sub_bucket_half_count_magnitude = std::max(sub_bucket_count_magnitude, 1) - 1;
+        sub_bucket_count = (int64_t) 1 << (sub_bucket_half_count_magnitude + 1);
+        sub_bucket_half_count = sub_bucket_count / 2;
+        sub_bucket_mask = sub_bucket_count - 1;
+
+        // number of power-of-two buckets needed to cover highest_trackable
+        uint64_t smallest_untrackable = sub_bucket_count;
+        bucket_count = 1;
+        while (smallest_untrackable <= highest_trackable) {
+            if (smallest_untrackable > std::numeric_limits<uint64_t>::max() / 2) {
+                bucket_count++;
+                break;
+            }
+            smallest_untrackable <<= 1;
+            bucket_count++;
+        }
+        counts.assign((size_t)(bucket_count + 1) * sub_bucket_half_count, 0);
+    }
+
+    inline void record(uint64_t value, const uint64_t count = 1) {
+        value = std::min(value, highest_trackable);
+        counts[countsIndex(value)] += count;
+        total_count += count;
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+        sum += (double) value * count;
+    }
+
+    void merge(const Histogram &other) {
+        if (other.significant_digits != significant_digits || other.highest_trackable != highest_trackable)
+            throw std::invalid_argument("Cannot merge histograms with different precision or range");
+        for (size_t i = 0; i < counts.size(); i++)
+            counts[i] += other.counts[i];
+        total_count += other.total_count;
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+        sum += other.sum;
+    }
+
+    void reset() {
+        std::fill(counts.begin(), counts.end(), 0);
+        total_count = 0;
+        min_value = std::numeric_limits<uint64_t>::max();
+        max_value = 0;
+        sum = 0;
+    }
+
+    uint64_t count() const { return total_count; }
+    uint64_t min() const { return total_count ? min_value : 0; }
+    uint64_t max() const { return max_value; }
+    double mean() const { return total_count ? sum / total_count : 0; }
+    int digits() const { return significant_digits; }
+    uint64_t highest() const { return highest_trackable; }
+
+    uint64_t lowestEquivalentValue(const uint64_t value) const { return valueFromIndex(countsIndex(value)); }
+    uint64_t highestEquivalentValue(const uint64_t value) const { return lowestEquivalentValue(value) + sizeOfEquivalentRange(value) - 1; }
+
+    // value of the sample at 0-based rank in sorted order (same indexing as sorted[rank] on the raw samples)
+    uint64_t valueAtRank(const uint64_t rank) const {
+        if (total_count == 0) return 0;
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            cumulative += counts[i];
+            if (cumulative > rank)
+                return std::clamp(highestEquivalentValue(valueFromIndex(i)), min(), max());
+        }
+        return max();
+    }
+
+    // number of samples strictly below/above the given value (at bucket resolution)
+    uint64_t countBelow(const uint64_t value) const {
+        uint64_t n = 0;
+        for (size_t i = 0; i < counts.size() && highestEquivalentValue(valueFromIndex(i)) < value; i++)
+            n += counts[i];
+        return n;
+    }
+
+    uint64_t countAbove(const uint64_t value) const {
+        uint64_t n = 0;
+        for (size_t i = counts.size(); i-- > 0 && lowestEquivalentValue(valueFromIndex(i)) > value;)
+            n += counts[i];
+        return n;
+    }
+
+    // visit all non-empty buckets in ascending order: fn(lowest_equivalent_value, count)
+    template <typename Fn>
+    void forEachBucket(Fn fn) const {
+        for (size_t i = 0; i < counts.size(); i++)
+            if (counts[i]) fn(valueFromIndex(i), counts[i]);
+    }
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+// Minimal io_uring ring wrapper on top of the raw syscalls (no liburing dependency).
+// Only the pieces needed by the UringTransport are implemented.
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "Logger.hpp"
+#include "Utilities.hpp"
+
+// IORING_FEAT_FAST_POLL ships with the same uapi header generation (5.7) as IORING_OP_SEND/RECV
+#if defined(IORING_FEAT_FAST_POLL) && defined(__NR_io_uring_setup)
+#define HAVE_IO_URING 1
+#else
+#define HAVE_IO_URING 0
+#endif
+
+#if HAVE_IO_URING
+
+class IoUring
+{
+private:
+    int ring_fd = -1;
+    unsigned setup_flags = 0;
+
+    // submission queue
+    void *sq_ptr = nullptr;
+    size_t sq_size = 0;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_flags, *sq_array;
+    struct io_uring_sqe *sqes = nullptr;
+    size_t sqes_size = 0;
+    unsigned sqe_tail = 0;  // local tail, published on submit
+
+    // completion queue
+    void *cq_ptr = nullptr;
+    size_t cq_size = 0;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    static int sys_setup(unsigned entries, struct io_uring_params *p) {
+        return (int) syscall(__NR_io_uring_setup, entries, p);
+    }
+    static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+    }
+    static int sys_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+        return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+    }
+
+public:
+    IoUring(const unsigned entries, const bool sqpoll = false, const unsigned sq_thread_idle_ms = 1000)
+    {
+        struct io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        if (sqpoll) {
+            p.flags |= IORING_SETUP_SQPOLL;
+            p.sq_thread_idle = sq_thread_idle_ms;
+        }
+
+        if ((ring_fd = sys_setup(entries, &p)) < 0) {
+            error("io_uring_setup failed with ERROR: " + std::string(strerror(errno)));
+            throw std::runtime_error("io_uring_setup failed");
+        }
+        setup_flags = p.flags;
+
+        sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+        sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        void *sqes_ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes_ptr == MAP_FAILED) {
+            error("io_uring mmap failed with ERROR: " + std::string(strerror(errno)));
+            close(ring_fd);
+            throw std::runtime_error("io_uring mmap failed");
+        }
+        sqes = static_cast<struct io_uring_sqe*>(sqes_ptr);
+
+        char *sq = static_cast<char*>(sq_ptr);
+        sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_flags = reinterpret_cast<unsigned*>(sq + p.sq_off.flags);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        sqe_tail = *sq_tail;
+
+        char *cq = static_cast<char*>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+    }
+
+    ~IoUring()
+    {
+        if (sqes) munmap(sqes, sqes_size);
+        if (cq_ptr) munmap(cq_ptr, cq_size);
+        if (sq_ptr) munmap(sq_ptr, sq_size);
+        if (ring_fd >= 0) close(ring_fd);
+    }
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    bool sqpoll() const { return setup_flags & IORING_SETUP_SQPOLL; }
+
+    int registerFiles(const int *fds, const unsigned n) {
+        return sys_register(ring_fd, IORING_REGISTER_FILES, fds, n);
+    }
+
+    int registerBuffers(const struct iovec *iovs, const unsigned n) {
+        return sys_register(ring_fd, IORING_REGISTER_BUFFERS, iovs, n);
+    }
+
+    // returns a zeroed sqe; the caller must not request more entries than the ring holds between submits
+    inline struct io_uring_sqe *getSqe() {
+        struct io_uring_sqe *sqe = &sqes[sqe_tail & *sq_mask];
+        sq_array[sqe_tail & *sq_mask] = sqe_tail & *sq_mask;
+        sqe_tail++;
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // publish all prepared sqes and wait for at least wait_nr completions
+    inline int submitAndWait(const unsigned to_submit, const unsigned wait_nr) {
+        __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+        if (sqpoll()) {
+            // the kernel thread picks up the sqes, we only enter to wake it up
+            if (__atomic_load_n(sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)
+                sys_enter(ring_fd, to_submit, 0, IORING_ENTER_SQ_WAKEUP);
+            // and spin on the completion queue instead of sleeping in the kernel
+            while (wait_nr && *cq_head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+                cpu_relax();
+            return to_submit;
+        }
+
+        int rc;
+        do {
+            rc = sys_enter(ring_fd, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        } while (rc < 0 && errno == EINTR);
+        return rc;
+    }
+
+    // nullptr if the completion queue is empty
+    inline struct io_uring_cqe *peekCqe() {
+        const unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+            return nullptr;
+        return &cqes[head & *cq_mask];
+    }
+
+    inline void cqeSeen() {
+        __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+    }
+
+    inline struct io_uring_cqe *waitCqe() {
+        struct io_uring_cqe *cqe;
+        while ((cqe = peekCqe()) == nullptr) {
+            if (submitAndWait(0, 1) < 0 && errno != EAGAIN && errno != EBUSY)
+                return nullptr;
+        }
+        return cqe;
+    }
+};
+
+#endif  // HAVE_IO_URING
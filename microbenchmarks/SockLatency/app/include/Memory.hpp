@@ -0,0 +1,314 @@
+#pragma once
+
+// Kernels of the memory microbenchmark (src/Memory.cpp): bandwidth and latency of the memory that backs the process,
+// i.e. in the enclave the memory the nitro-enclaves-allocator carved out for it.
+//
+//   MappedRegion  anonymous mapping on 4 KiB pages (THP disabled) or 2 MiB pages (hugetlb, otherwise THP via madvise),
+//                 with the share actually backed by huge pages (smaps)
+//   stream        STREAM copy/scale/add/triad over arrays of doubles, plain loops, AVX2 or AVX-512, optionally with
+//                 non-temporal stores (SIMD kernels)
+//   build_ring    random cyclic pointer ring (Sattolo), one node per cache line (latency) or per page (TLB pressure)
+//   chase         dependent loads along a ring
+
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "Logger.hpp"
+#include "Parallel.hpp"
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+constexpr size_t SMALL_PAGE_SIZE = 4ul << 10;
+constexpr size_t HUGE_PAGE_SIZE = 2ul << 20;
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+enum class PageSize {
+    PAGE_4K,
+    PAGE_2M
+};
+
+inline std::string to_string(const PageSize page)
+{
+    switch (page)
+    {
+    case PageSize::PAGE_4K:
+        return "4k";
+    case PageSize::PAGE_2M:
+        return "2m";
+    default:
+        return "unknown";
+    }
+}
+
+inline PageSize page_size_from_string(const std::string &str)
+{
+    if (str == "4k") {
+        return PageSize::PAGE_4K;
+    } else if (str == "2m") {
+        return PageSize::PAGE_2M;
+    } else {
+        throw std::runtime_error("Invalid page size");
+    }
+}
+
+class MappedRegion
+{
+private:
+    char *base = nullptr;
+    size_t map_len = 0;
+
+    // AnonHugePages of the mapping at addr [B], 0 if not found
+    static size_t anonHugeBytes(const void *addr)
+    {
+        std::ostringstream start;
+        start << std::hex << reinterpret_cast<uintptr_t>(addr) << "-";
+        std::ifstream smaps("/proc/self/smaps");
+        std::string line;
+        bool found = false;
+        while (std::getline(smaps, line)) {
+            if (!found) {
+                found = line.rfind(start.str(), 0) == 0;
+            } else if (line.rfind("AnonHugePages:", 0) == 0) {
+                return std::stoull(line.substr(14)) * 1024;
+            }
+        }
+        return 0;
+    }
+
+public:
+    const PageSize page;
+    std::string backing;  // 4k, 2m (hugetlb) or 2m-thp (transparent huge pages, best effort)
+
+    // len bytes, rounded up to the page size; hugetlb requires reserved huge pages, otherwise THP is requested
+    MappedRegion(const size_t len, const PageSize page) : page(page)
+    {
+        const size_t align = page == PageSize::PAGE_2M ? HUGE_PAGE_SIZE : SMALL_PAGE_SIZE;
+        map_len = (len + align - 1) / align * align;
+
+        if (page == PageSize::PAGE_2M) {
+            void *p = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+            if (p != MAP_FAILED) {
+                base = static_cast<char*>(p);
+                backing = "2m";
+                return;
+            }
+            static bool warned = false;
+            if (!warned) error("WARNING: no reserved huge pages (" + std::string(strerror(errno)) + "), falling back to transparent huge pages");
+            warned = true;
+
+            // over-allocate to align the mapping to the huge page size, the rest is unmapped again
+            p = mmap(nullptr, map_len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                error("Mapping " + std::to_string(map_len) + " bytes failed with ERROR: " + std::string(strerror(errno)));
+                throw std::runtime_error("mmap failed");
+            }
+            const uintptr_t raw = reinterpret_cast<uintptr_t>(p);
+            const uintptr_t aligned = (raw + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+            if (aligned > raw) munmap(p, aligned - raw);
+            if (aligned + map_len < raw + map_len + HUGE_PAGE_SIZE)
+                munmap(reinterpret_cast<void*>(aligned + map_len), raw + HUGE_PAGE_SIZE - aligned);
+            base = reinterpret_cast<char*>(aligned);
+            if (madvise(base, map_len, MADV_HUGEPAGE) != 0)
+                error("WARNING: madvise(MADV_HUGEPAGE) failed with ERROR: " + std::string(strerror(errno)));
+            backing = "2m-thp";
+            return;
+        }
+
+        void *p = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            error("Mapping " + std::to_string(map_len) + " bytes failed with ERROR: " + std::string(strerror(errno)));
+            throw std::runtime_error("mmap failed");
+        }
+        base = static_cast<char*>(p);
+        madvise(base, map_len, MADV_NOHUGEPAGE);  // THP enabled=always would back the region with huge pages
+        backing = "4k";
+    }
+
+    ~MappedRegion() { if (base) munmap(base, map_len); }
+
+    MappedRegion(const MappedRegion &) = delete;
+    MappedRegion &operator=(const MappedRegion &) = delete;
+
+    char *data() const { return base; }
+    size_t size() const { return map_len; }
+
+    // share of the region on huge pages [%], after the first touch
+    double hugePct() const
+    {
+        if (backing == "2m") return 100;
+        if (backing == "4k") return 0;
+        return std::min(100.0, 100.0 * anonHugeBytes(base) / map_len);
+    }
+};
+
+// STREAM
+
+enum class StreamKernel {
+    COPY,   // c = a
+    SCALE,  // b = s * c
+    ADD,    // c = a + b
+    TRIAD   // a = b + s * c
+};
+
+inline std::string to_string(const StreamKernel kernel)
+{
+    switch (kernel)
+    {
+    case StreamKernel::COPY:
+        return "copy";
+    case StreamKernel::SCALE:
+        return "scale";
+    case StreamKernel::ADD:
+        return "add";
+    case StreamKernel::TRIAD:
+        return "triad";
+    default:
+        return "unknown";
+    }
+}
+
+constexpr double STREAM_SCALAR = 3.0;
+
+// arrays read and written per element, counted like STREAM (no write-allocate traffic)
+inline size_t stream_arrays(const StreamKernel kernel)
+{
+    return kernel == StreamKernel::COPY || kernel == StreamKernel::SCALE ? 2 : 3;
+}
+
+template <StreamKernel K>
+inline void stream_scalar(double *a, double *b, double *c, const size_t begin, const size_t end)
+{
+    for (size_t i = begin; i < end; i++) {
+        if constexpr (K == StreamKernel::COPY) c[i] = a[i];
+        else if constexpr (K == StreamKernel::SCALE) b[i] = STREAM_SCALAR * c[i];
+        else if constexpr (K == StreamKernel::ADD) c[i] = a[i] + b[i];
+        else a[i] = b[i] + STREAM_SCALAR * c[i];
+    }
+}
+
+#if HAVE_X86_SIMD
+// begin has to be 32-byte aligned
+template <StreamKernel K, bool NT>
+__attribute__((target("avx2")))
+void stream_avx2(double *a, double *b, double *c, const size_t begin, const size_t end)
+{
+    const __m256d s = _mm256_set1_pd(STREAM_SCALAR);
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m256d r;
+        double *dst;
+        if constexpr (K == StreamKernel::COPY) { r = _mm256_load_pd(a + i); dst = c; }
+        else if constexpr (K == StreamKernel::SCALE) { r = _mm256_mul_pd(s, _mm256_load_pd(c + i)); dst = b; }
+        else if constexpr (K == StreamKernel::ADD) { r = _mm256_add_pd(_mm256_load_pd(a + i), _mm256_load_pd(b + i)); dst = c; }
+        else { r = _mm256_add_pd(_mm256_load_pd(b + i), _mm256_mul_pd(s, _mm256_load_pd(c + i))); dst = a; }
+        if constexpr (NT) _mm256_stream_pd(dst + i, r);
+        else _mm256_store_pd(dst + i, r);
+    }
+    if constexpr (NT) _mm_sfence();
+    stream_scalar<K>(a, b, c, i, end);
+}
+
+// begin has to be 64-byte aligned
+template <StreamKernel K, bool NT>
+__attribute__((target("avx512f")))
+void stream_avx512(double *a, double *b, double *c, const size_t begin, const size_t end)
+{
+    const __m512d s = _mm512_set1_pd(STREAM_SCALAR);
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m512d r;
+        double *dst;
+        if constexpr (K == StreamKernel::COPY) { r = _mm512_load_pd(a + i); dst = c; }
+        else if constexpr (K == StreamKernel::SCALE) { r = _mm512_mul_pd(s, _mm512_load_pd(c + i)); dst = b; }
+        else if constexpr (K == StreamKernel::ADD) { r = _mm512_add_pd(_mm512_load_pd(a + i), _mm512_load_pd(b + i)); dst = c; }
+        else { r = _mm512_add_pd(_mm512_load_pd(b + i), _mm512_mul_pd(s, _mm512_load_pd(c + i))); dst = a; }
+        if constexpr (NT) _mm512_stream_pd(dst + i, r);
+        else _mm512_store_pd(dst + i, r);
+    }
+    if constexpr (NT) _mm_sfence();
+    stream_scalar<K>(a, b, c, i, end);
+}
+#endif
+
+template <StreamKernel K>
+inline void stream(const SimdLevel level, const bool nt, double *a, double *b, double *c, const size_t begin, const size_t end)
+{
+    switch (level)
+    {
+    #if HAVE_X86_SIMD
+    case SimdLevel::AVX512:
+        return nt ? stream_avx512<K, true>(a, b, c, begin, end) : stream_avx512<K, false>(a, b, c, begin, end);
+    case SimdLevel::AVX2:
+        return nt ? stream_avx2<K, true>(a, b, c, begin, end) : stream_avx2<K, false>(a, b, c, begin, end);
+    #endif
+    default:
+        return stream_scalar<K>(a, b, c, begin, end);
+    }
+}
+
+// elements [begin, end) of the arrays, begin a multiple of 8 (cache line)
+inline void stream(const StreamKernel kernel, const SimdLevel level, const bool nt, double *a, double *b, double *c, const size_t begin, const size_t end)
+{
+    switch (kernel)
+    {
+    case StreamKernel::COPY:
+        return stream<StreamKernel::COPY>(level, nt, a, b, c, begin, end);
+    case StreamKernel::SCALE:
+        return stream<StreamKernel::SCALE>(level, nt, a, b, c, begin, end);
+    case StreamKernel::ADD:
+        return stream<StreamKernel::ADD>(level, nt, a, b, c, begin, end);
+    case StreamKernel::TRIAD:
+        return stream<StreamKernel::TRIAD>(level, nt, a, b, c, begin, end);
+    }
+}
+
+// POINTER CHASING
+
+// Node i of a ring with nodes stride bytes apart. Nodes of page-strided rings move through the cache lines of their
+// page, otherwise all of them would compete for the same cache sets.
+inline uint64_t *ring_node(char *base, const size_t i, const size_t stride)
+{
+    const size_t offset = stride > CACHE_LINE_SIZE ? i * CACHE_LINE_SIZE % stride : 0;
+    return reinterpret_cast<uint64_t*>(base + i * stride + offset);
+}
+
+// Links nodes (stride bytes apart from base) into a single random cycle: Sattolo's shuffle of the successor indexes,
+// which are then replaced by the node addresses. Random order defeats the prefetchers.
+inline void build_ring(char *base, const size_t nodes, const size_t stride, const uint64_t seed)
+{
+    for (size_t i = 0; i < nodes; i++)
+        *ring_node(base, i, stride) = i;
+    uint64_t state = seed;
+    for (size_t i = nodes - 1; i > 0; i--)
+        std::swap(*ring_node(base, i, stride), *ring_node(base, splitmix64(state) % i, stride));
+    for (size_t i = 0; i < nodes; i++) {
+        uint64_t *node = ring_node(base, i, stride);
+        *node = reinterpret_cast<uint64_t>(ring_node(base, *node, stride));
+    }
+}
+
+// loads dependent loads along the ring from start (rounded up to a multiple of 8), returns the last node
+inline const void *chase(const void *start, const size_t loads)
+{
+    const void *p = start;
+    for (size_t i = 0; i < loads; i += 8) {
+        p = *static_cast<const void* const*>(p);
+        p = *static_cast<const void* const*>(p);
+        p = *static_cast<const void* const*>(p);
+        p = *static_cast<const void* const*>(p);
+        p = *static_cast<const void* const*>(p);
+        p = *static_cast<const void* const*>(p);
+        p = *static_cast<const void* const*>(p);
+        p = *static_cast<const void* const*>(p);
+    }
+    return p;
+}
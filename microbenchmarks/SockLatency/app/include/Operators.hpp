@@ -0,0 +1,301 @@
+#pragma once
+
+// Database operator kernels of the operator microbenchmark (src/Operators.cpp), the query processing counterpart
+// of the communication benchmarks: the same binary runs on the host and inside the enclave image.
+//
+//   select_lt     selection scan col < bound into a selection vector, scalar (branch-free), AVX2 or AVX-512
+//   AggTable      grouped COUNT/SUM, thread-local linear probing tables merged by hash partition
+//   radix_partition  parallel one-pass radix partitioning (histograms, prefix sums, scatter)
+//   radix_join    radix-partitioned hash join, a bucket-chained table per partition pair
+//   radix_sort    parallel sort: radix partitioning by the top key bits, then the partitions are sorted in parallel
+//
+// Threads are spawned per operator run and pinned like the client threads (thread i on cpus[i % n]).
+// Work is handed out in morsels via an atomic counter, so threads that finish early take over the rest.
+// Generated columns are deterministic for a seed, independent of the thread count.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Parallel.hpp"
+
+// DATA GENERATION
+
+// fills col[i] = gen(rng) in parallel, the generator of a morsel is seeded with the seed and the morsel index
+template <typename T, typename Gen>
+void generate(std::vector<T> &col, const size_t n, const uint64_t seed, const size_t threads, const std::vector<int> &cpus, Gen gen)
+{
+    col.resize(n);
+    Morsels morsels(n);
+    run_parallel(threads, cpus, [&](size_t) {
+        size_t begin, end;
+        while (morsels.take(begin, end)) {
+            uint64_t state = seed ^ (begin / MORSEL_ROWS) * 0xff51afd7ed558ccdULL;
+            for (size_t i = begin; i < end; i++)
+                col[i] = gen(state, i);
+        }
+    });
+}
+
+// unique 32-bit keys of a build side: a bijection of the row number (odd multiplier), i.e. dense input, sparse keys
+inline uint32_t scatter_key(const uint32_t i) { return i * 0x9e3779b1u; }
+
+// SELECTION SCAN
+
+// positions i in [begin, end) with col[i] < bound, written to out, returns their number
+inline size_t select_lt_scalar(const uint32_t *col, const size_t begin, const size_t end, const uint32_t bound, uint32_t *out)
+{
+    size_t k = 0;
+    for (size_t i = begin; i < end; i++) {
+        out[k] = static_cast<uint32_t>(i);
+        k += col[i] < bound;
+    }
+    return k;
+}
+
+#if HAVE_X86_SIMD
+// AVX2 has no compress: the comparison mask selects a permutation that moves the selected positions to the front
+struct alignas(32) CompressLut {
+    uint32_t perm[256][8];
+
+    CompressLut() {
+        for (unsigned mask = 0; mask < 256; mask++) {
+            unsigned k = 0;
+            for (unsigned lane = 0; lane < 8; lane++)
+                if (mask & (1u << lane)) perm[mask][k++] = lane;
+            for (; k < 8; k++) perm[mask][k] = 0;
+        }
+    }
+};
+
+__attribute__((target("avx2")))
+inline size_t select_lt_avx2(const uint32_t *col, const size_t begin, const size_t end, const uint32_t bound, uint32_t *out)
+{
+    static const CompressLut lut;
+    const __m256i bias = _mm256_set1_epi32(INT32_MIN);  // unsigned comparison via signed compare of biased values
+    const __m256i limit = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(bound)), bias);
+    const __m256i step = _mm256_set1_epi32(8);
+    __m256i pos = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(begin)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    size_t k = 0;
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        const __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(col + i)), bias);
+        const unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, v)));
+        const __m256i perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(lut.perm[mask]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), _mm256_permutevar8x32_epi32(pos, perm));
+        k += __builtin_popcount(mask);
+        pos = _mm256_add_epi32(pos, step);
+    }
+    return k + select_lt_scalar(col, i, end, bound, out + k);
+}
+
+__attribute__((target("avx512f")))
+inline size_t select_lt_avx512(const uint32_t *col, const size_t begin, const size_t end, const uint32_t bound, uint32_t *out)
+{
+    const __m512i limit = _mm512_set1_epi32(static_cast<int>(bound));
+    const __m512i step = _mm512_set1_epi32(16);
+    __m512i pos = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(begin)),
+                                   _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+    size_t k = 0;
+    size_t i = begin;
+    for (; i + 16 <= end; i += 16) {
+        const __m512i v = _mm512_loadu_si512(col + i);
+        const __mmask16 mask = _mm512_cmplt_epu32_mask(v, limit);
+        _mm512_mask_compressstoreu_epi32(out + k, mask, pos);
+        k += __builtin_popcount(mask);
+        pos = _mm512_add_epi32(pos, step);
+    }
+    return k + select_lt_scalar(col, i, end, bound, out + k);
+}
+#endif
+
+// out has to hold end - begin positions (the scalar and AVX2 kernels write behind the selected ones)
+inline size_t select_lt(const SimdLevel level, const uint32_t *col, const size_t begin, const size_t end, const uint32_t bound, uint32_t *out)
+{
+    switch (level)
+    {
+    #if HAVE_X86_SIMD
+    case SimdLevel::AVX512:
+        return select_lt_avx512(col, begin, end, bound, out);
+    case SimdLevel::AVX2:
+        return select_lt_avx2(col, begin, end, bound, out);
+    #endif
+    default:
+        return select_lt_scalar(col, begin, end, bound, out);
+    }
+}
+
+// GROUPED AGGREGATION
+
+inline uint64_t hash32(const uint32_t key) { return key * 0x9e3779b97f4a7c15ULL; }
+
+struct AggEntry {
+    uint32_t key;
+    uint32_t count;
+    uint64_t sum;
+};
+
+// linear probing table of COUNT(*), SUM(value) per key, sized for a known number of groups
+class AggTable
+{
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    std::vector<AggEntry> slots;
+    uint64_t mask;
+    unsigned shift;
+
+public:
+    explicit AggTable(const size_t groups) {
+        size_t cap = 16;
+        while (cap < 2 * groups) cap *= 2;
+        slots.assign(cap, AggEntry{ EMPTY, 0, 0 });
+        mask = cap - 1;
+        shift = 64 - __builtin_ctzll(cap);
+    }
+
+    inline void add(const uint32_t key, const uint32_t count, const uint64_t sum) {
+        uint64_t slot = hash32(key) >> shift;
+        while (slots[slot].key != key && slots[slot].key != EMPTY)
+            slot = (slot + 1) & mask;
+        slots[slot].key = key;
+        slots[slot].count += count;
+        slots[slot].sum += sum;
+    }
+
+    void clear() { std::fill(slots.begin(), slots.end(), AggEntry{ EMPTY, 0, 0 }); }
+
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const AggEntry &e : slots)
+            if (e.key != EMPTY) fn(e);
+    }
+};
+
+// merge partition of a key: the top bits of its hash (the slot order of the tables)
+inline size_t agg_partition(const uint32_t key, const size_t partitions) { return (hash32(key) >> 32) * partitions >> 32; }
+
+// RADIX PARTITIONING
+
+// Partitions n items of in into out by part(item) in [0, 2^bits). Every thread histograms and scatters a contiguous
+// chunk, the prefix sums over (partition, thread) keep the partitions contiguous. bounds[p] is the start of partition p.
+template <typename T, typename Part>
+void radix_partition(const T *in, T *out, const size_t n, const unsigned bits, Part part, const size_t threads, const std::vector<int> &cpus,
+                     std::vector<size_t> &bounds)
+{
+    const size_t fanout = size_t(1) << bits;
+    std::vector<std::vector<size_t>> hist(threads, std::vector<size_t>(fanout, 0));
+    auto chunk = [&](const size_t t, size_t &begin, size_t &end) {
+        begin = n * t / threads;
+        end = n * (t + 1) / threads;
+    };
+
+    run_parallel(threads, cpus, [&](const size_t t) {
+        size_t begin, end;
+        chunk(t, begin, end);
+        std::vector<size_t> &h = hist[t];
+        for (size_t i = begin; i < end; i++)
+            h[part(in[i])]++;
+    });
+
+    bounds.assign(fanout + 1, 0);
+    size_t offset = 0;
+    for (size_t p = 0; p < fanout; p++) {
+        bounds[p] = offset;
+        for (size_t t = 0; t < threads; t++) {
+            const size_t count = hist[t][p];
+            hist[t][p] = offset;  // write cursor
+            offset += count;
+        }
+    }
+    bounds[fanout] = offset;
+
+    run_parallel(threads, cpus, [&](const size_t t) {
+        size_t begin, end;
+        chunk(t, begin, end);
+        std::vector<size_t> &cursor = hist[t];
+        for (size_t i = begin; i < end; i++)
+            out[cursor[part(in[i])]++] = in[i];
+    });
+}
+
+// HASH JOIN
+
+struct JoinTuple {
+    uint32_t key;
+    uint32_t payload;
+};
+
+struct JoinResult {
+    uint64_t matches = 0;
+    uint64_t checksum = 0;  // sum of the payloads of both sides of all matches
+};
+
+// Radix join of build r and probe s on key: both sides are partitioned by the low radix_bits of the key (into r_part/s_part),
+// then the threads join partition pairs with a bucket-chained table over the remaining key bits.
+inline JoinResult radix_join(const std::vector<JoinTuple> &r, const std::vector<JoinTuple> &s, std::vector<JoinTuple> &r_part, std::vector<JoinTuple> &s_part,
+                             const unsigned radix_bits, const size_t threads, const std::vector<int> &cpus)
+{
+    const uint32_t radix_mask = (1u << radix_bits) - 1;
+    auto part = [radix_mask](const JoinTuple &tuple) { return tuple.key & radix_mask; };
+    std::vector<size_t> r_bounds, s_bounds;
+    radix_partition(r.data(), r_part.data(), r.size(), radix_bits, part, threads, cpus, r_bounds);
+    radix_partition(s.data(), s_part.data(), s.size(), radix_bits, part, threads, cpus, s_bounds);
+
+    const size_t fanout = size_t(1) << radix_bits;
+    std::atomic<uint64_t> matches{0}, checksum{0};
+    Morsels partitions(fanout, 1);
+    run_parallel(threads, cpus, [&](size_t) {
+        std::vector<uint32_t> head, next;  // 1-based tuple indexes, 0: end of chain
+        uint64_t local_matches = 0, local_checksum = 0;
+        size_t p, p_end;
+        while (partitions.take(p, p_end)) {
+            const JoinTuple *build = r_part.data() + r_bounds[p];
+            const size_t build_n = r_bounds[p + 1] - r_bounds[p];
+            size_t buckets = 1;
+            while (buckets < build_n) buckets *= 2;
+            head.assign(buckets, 0);
+            next.resize(build_n);
+            for (size_t i = 0; i < build_n; i++) {
+                const uint32_t bucket = (build[i].key >> radix_bits) & (buckets - 1);
+                next[i] = head[bucket];
+                head[bucket] = static_cast<uint32_t>(i + 1);
+            }
+
+            for (size_t j = s_bounds[p]; j < s_bounds[p + 1]; j++) {
+                const JoinTuple &probe = s_part[j];
+                for (uint32_t i = head[(probe.key >> radix_bits) & (buckets - 1)]; i != 0; i = next[i - 1]) {
+                    if (build[i - 1].key == probe.key) {
+                        local_matches++;
+                        local_checksum += build[i - 1].payload + probe.payload;
+                    }
+                }
+            }
+        }
+        matches += local_matches;
+        checksum += local_checksum;
+    });
+    return JoinResult{ matches.load(), checksum.load() };
+}
+
+// SORT
+
+// sorts keys into out: partitioned by the top radix_bits, then the partitions are sorted by the threads (morsels of one partition)
+inline void radix_sort(const std::vector<uint64_t> &keys, std::vector<uint64_t> &out, const unsigned radix_bits, const size_t threads, const std::vector<int> &cpus)
+{
+    const unsigned shift = 64 - radix_bits;
+    std::vector<size_t> bounds;
+    radix_partition(keys.data(), out.data(), keys.size(), radix_bits, [shift](const uint64_t key) { return key >> shift; }, threads, cpus, bounds);
+
+    Morsels partitions(bounds.size() - 1, 1);
+    run_parallel(threads, cpus, [&](size_t) {
+        size_t p, p_end;
+        while (partitions.take(p, p_end))
+            std::sort(out.begin() + bounds[p], out.begin() + bounds[p + 1]);
+    });
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+// Threading and SIMD helpers of the compute benchmarks (operators, memory), which run the same binary on the host
+// and inside the enclave.
+//
+//   SimdLevel     kernel variant, resolved at runtime against the cpu (x86: __builtin_cpu_supports, otherwise scalar)
+//   run_parallel  fn(t) on threads pinned like the client threads (thread i on cpus[i % n]), spawned per run
+//   Morsels       [begin, end) ranges handed out via an atomic counter, so threads that finish early take over the rest
+//   splitmix64    generator of the deterministic inputs
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#else
+#define HAVE_X86_SIMD 0
+#endif
+
+#include "Logger.hpp"
+#include "Utilities.hpp"
+
+constexpr size_t MORSEL_ROWS = 1 << 16;
+
+enum class SimdLevel {
+    AUTO,    // widest supported
+    SCALAR,
+    AVX2,
+    AVX512
+};
+
+inline std::string to_string(const SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AUTO:
+        return "auto";
+    case SimdLevel::SCALAR:
+        return "scalar";
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::AVX512:
+        return "avx512";
+    default:
+        return "unknown";
+    }
+}
+
+inline SimdLevel simd_level_from_string(const std::string &str)
+{
+    if (str == "auto") {
+        return SimdLevel::AUTO;
+    } else if (str == "scalar") {
+        return SimdLevel::SCALAR;
+    } else if (str == "avx2") {
+        return SimdLevel::AVX2;
+    } else if (str == "avx512") {
+        return SimdLevel::AVX512;
+    } else {
+        throw std::runtime_error("Invalid simd level");
+    }
+}
+
+inline bool simd_supported(const SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::SCALAR:
+        return true;
+    #if HAVE_X86_SIMD
+    case SimdLevel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case SimdLevel::AVX512:
+        return __builtin_cpu_supports("avx512f");
+    #endif
+    default:
+        return false;
+    }
+}
+
+// auto: the widest level of the cpu, otherwise the requested level if supported
+inline SimdLevel resolve_simd(const SimdLevel level)
+{
+    if (level == SimdLevel::AUTO) {
+        for (const SimdLevel l : { SimdLevel::AVX512, SimdLevel::AVX2 })
+            if (simd_supported(l)) return l;
+        return SimdLevel::SCALAR;
+    }
+    if (!simd_supported(level))
+        throw std::invalid_argument("SIMD level " + to_string(level) + " is not supported by this cpu");
+    return level;
+}
+
+// runs fn(t) for t in [0, threads) on pinned threads, the calling thread runs t = 0
+template <typename Fn>
+void run_parallel(const size_t threads, const std::vector<int> &cpus, Fn fn)
+{
+    auto pinned = [&](const size_t t) {
+        if (!cpus.empty() && pin_to_cpu(cpus[t % cpus.size()]) != 0)
+            error("Failed to pin thread " + std::to_string(t) + " to cpu " + std::to_string(cpus[t % cpus.size()]));
+        fn(t);
+    };
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++)
+        workers.emplace_back(pinned, t);
+    pinned(0);
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+// hands out [begin, end) ranges of n items to the threads of a run
+class Morsels
+{
+private:
+    std::atomic<size_t> next{0};
+    const size_t n;
+    const size_t size;
+
+public:
+    Morsels(const size_t n, const size_t size = MORSEL_ROWS) : n(n), size(size) {}
+
+    bool take(size_t &begin, size_t &end) {
+        begin = next.fetch_add(size, std::memory_order_relaxed);
+        if (begin >= n) return false;
+        end = std::min(n, begin + size);
+        return true;
+    }
+};
+
+inline uint64_t splitmix64(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+// Hardware and OS counters of a measurement loop, to attribute tail latency to scheduling vs. copying.
+//
+// PerfMeter counts from its construction, like a stopwatch: cycles, instructions and cache misses via
+// perf_event_open, page faults and (in)voluntary context switches via getrusage. Counters are only read at
+// construction and in read(), i.e. nothing is added to the loop itself. A disabled meter opens nothing.
+// perf_event_open is often unavailable (containers with the default seccomp profile, VMs and enclaves
+// without a virtual PMU): the hardware counters are then reported as not measured, the OS counters still work.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Logger.hpp"
+
+// reads and sends that transferred less than the rest of a message, i.e. needed a further syscall (or SQE)
+struct IoStats {
+    uint64_t partial_reads = 0;
+    uint64_t partial_writes = 0;
+
+    IoStats &operator+=(const IoStats &other) {
+        partial_reads += other.partial_reads;
+        partial_writes += other.partial_writes;
+        return *this;
+    }
+};
+
+// counters of one measurement, -1: not measured
+struct LoopCounters {
+    int64_t cycles = -1;
+    int64_t instructions = -1;
+    int64_t cache_misses = -1;
+    int64_t page_faults = -1;
+    int64_t ctx_switches_vol = -1;
+    int64_t ctx_switches_invol = -1;
+    int64_t partial_reads = -1;
+    int64_t partial_writes = -1;
+
+    void setIo(const IoStats &io) {
+        partial_reads = io.partial_reads;
+        partial_writes = io.partial_writes;
+    }
+
+    // e.g. aggregate the counters of several threads, not measured by any of them stays -1
+    LoopCounters &operator+=(const LoopCounters &other) {
+        auto add = [](int64_t &a, const int64_t b) { if (b >= 0) a = (a >= 0 ? a : 0) + b; };
+        add(cycles, other.cycles);
+        add(instructions, other.instructions);
+        add(cache_misses, other.cache_misses);
+        add(page_faults, other.page_faults);
+        add(ctx_switches_vol, other.ctx_switches_vol);
+        add(ctx_switches_invol, other.ctx_switches_invol);
+        add(partial_reads, other.partial_reads);
+        add(partial_writes, other.partial_writes);
+        return *this;
+    }
+
+    static std::string csv_header() {
+        return "cycles,instructions,cache_misses,page_faults,ctx_switches_vol,ctx_switches_invol,partial_reads,partial_writes";
+    }
+
+    // not measured counters are empty
+    std::string to_csv() const {
+        auto field = [](const int64_t v) { return v >= 0 ? std::to_string(v) : std::string(); };
+        return field(cycles) + "," + field(instructions) + "," + field(cache_misses) + "," + field(page_faults) + ","
+            + field(ctx_switches_vol) + "," + field(ctx_switches_invol) + "," + field(partial_reads) + "," + field(partial_writes);
+    }
+
+    // key=value pairs of the measured counters, for logs
+    std::string to_kv() const {
+        std::string kv;
+        auto field = [&kv](const char *key, const int64_t v) { if (v >= 0) kv += (kv.empty() ? "" : " ") + std::string(key) + "=" + std::to_string(v); };
+        field("cycles", cycles);
+        field("instructions", instructions);
+        field("cache_misses", cache_misses);
+        field("page_faults", page_faults);
+        field("ctx_switches_vol", ctx_switches_vol);
+        field("ctx_switches_invol", ctx_switches_invol);
+        field("partial_reads", partial_reads);
+        field("partial_writes", partial_writes);
+        return kv;
+    }
+};
+
+class PerfMeter
+{
+private:
+    static constexpr uint64_t HW_EVENTS[3] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES };
+
+    const bool enabled;
+    const int rusage_who;
+    int fds[3] = { -1, -1, -1 };
+    int64_t hw_start[3] = { 0, 0, 0 };
+    struct rusage ru_start;
+
+    static int openEvent(const uint64_t config, const bool process, const bool exclude_kernel) {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = process;  // threads spawned after the construction, e.g. the open-loop sender
+        attr.exclude_kernel = exclude_kernel;
+        attr.exclude_hv = 1;
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    }
+
+    // scaled to the full time enabled if the PMU was multiplexed
+    static int64_t readEvent(const int fd) {
+        uint64_t values[3];  // value, time enabled, time running
+        if (::read(fd, values, sizeof(values)) != sizeof(values)) return -1;
+        if (values[2] == 0) return 0;
+        return values[2] < values[1] ? static_cast<int64_t>(values[0] * (static_cast<double>(values[1]) / values[2])) : values[0];
+    }
+
+public:
+    // process: count all threads of the process (rusage) incl. threads spawned later (perf), otherwise the calling thread
+    explicit PerfMeter(const bool enabled, const bool process = false) :
+        enabled(enabled), rusage_who(process ? RUSAGE_SELF : RUSAGE_THREAD)
+    {
+        if (!enabled) return;
+
+        for (int i = 0; i < 3; i++) {
+            fds[i] = openEvent(HW_EVENTS[i], process, false);
+            if (fds[i] < 0 && (errno == EACCES || errno == EPERM))
+                fds[i] = openEvent(HW_EVENTS[i], process, true);  // perf_event_paranoid 2: user space only
+            if (fds[i] < 0) {
+                static bool warned = false;
+                if (!warned) error("WARNING: hardware counters not available (perf_event_open: " + std::string(strerror(errno)) + ")");
+                warned = true;
+                continue;
+            }
+            hw_start[i] = readEvent(fds[i]);
+        }
+        getrusage(rusage_who, &ru_start);
+    }
+
+    ~PerfMeter() {
+        for (const int fd : fds)
+            if (fd >= 0) close(fd);
+    }
+
+    PerfMeter(const PerfMeter &) = delete;
+    PerfMeter &operator=(const PerfMeter &) = delete;
+
+    // counters since the construction, the partial io counts are set by the caller
+    LoopCounters read() const {
+        LoopCounters c;
+        if (!enabled) return c;
+
+        int64_t *hw[3] = { &c.cycles, &c.instructions, &c.cache_misses };
+        for (int i = 0; i < 3; i++) {
+            if (fds[i] < 0) continue;
+            const int64_t v = readEvent(fds[i]);
+            if (v >= 0) *hw[i] = v - hw_start[i];
+        }
+
+        struct rusage ru;
+        getrusage(rusage_who, &ru);
+        c.page_faults = (ru.ru_minflt + ru.ru_majflt) - (ru_start.ru_minflt + ru_start.ru_majflt);
+        c.ctx_switches_vol = ru.ru_nvcsw - ru_start.ru_nvcsw;
+        c.ctx_switches_invol = ru.ru_nivcsw - ru_start.ru_nivcsw;
+        return c;
+    }
+};
@@ -0,0 +1,269 @@
+// Proxy.hpp
+#pragma once
+
+#include <sys/socket.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// local includes
+#include "myTypes.h"
+
+// forward: one upstream connection per client (1:1),
+// mux/demux: the two ends of a tunnel that carries all client connections as framed streams over a small pool of connections
+enum ProxyMode {
+    FORWARD,
+    MUX,    // client side: accepts clients, coalesces their data into the tunnel connections
+    DEMUX   // server side: accepts the tunnel connection, one upstream connection per stream
+};
+
+std::string to_string(const ProxyMode mode);
+
+struct ProxyConfig {
+    ProxyMode mode;
+    SocketProtocol listen_protocol;
+    std::string listen_address;
+    int listen_port;
+    SocketProtocol connect_protocol;
+    std::string connect_address;
+    int connect_port;
+    unsigned num_workers;  // listener shards (SO_REUSEPORT), one epoll thread each
+    int so_rcvbuf;         // 0: system default
+    int so_sndbuf;         // 0: system default
+    bool no_delay;         // TCP_NODELAY on inet sockets
+    bool splice;           // zero-copy forwarding via splice() through a pipe, falls back to copying
+    size_t pipe_size;      // 0: system default
+    size_t buf_size;       // copy buffer per direction if splice is not possible
+    uint32_t coalesce_bytes;  // tunnel: send once this many bytes are staged (0: at the end of each event batch)
+    uint32_t coalesce_us;     // tunnel: send staged bytes at the latest after this time (0: at the end of each event batch)
+    size_t tunnel_buf_size; // tunnel: unsent bytes per tunnel connection before reading the streams pauses
+    unsigned tunnel_connections;  // mux: pooled tunnel connections, streams are spread across them
+    uint32_t stream_window;   // tunnel: flow control window per stream and direction
+
+    std::string to_string() const;
+};
+
+// one forwarding direction of a proxied connection (src -> dst)
+struct ProxyFlow {
+    int pipe_fds[2] = {-1, -1};     // splice mode: src -> pipe -> dst
+    std::unique_ptr<char[]> buf;    // copy mode: src -> buf -> dst
+    size_t buf_off = 0;
+    size_t pending = 0;             // bytes received from src and not yet forwarded to dst
+    size_t capacity = 0;            // pipe or buffer size
+    bool use_splice = false;
+    bool eof = false;               // src closed its write side
+    bool shut = false;              // eof forwarded to dst
+};
+
+struct ProxySession;
+
+// epoll user data: one per socket of a session
+struct ProxyEndpoint {
+    ProxySession *session;
+    int side;  // 0: downstream (accepted), 1: upstream (connected)
+};
+
+struct ProxySession {
+    int fd[2] = {-1, -1};
+    ProxyFlow flow[2];              // flow[i] forwards fd[i] -> fd[1 - i]
+    ProxyEndpoint ep[2];
+    uint32_t interest[2] = {0, 0};  // registered epoll events per fd
+    bool connecting = true;         // upstream connect still in progress
+    bool closed = false;            // sockets closed, memory released after the current event batch
+
+    ProxySession() : ep{{this, 0}, {this, 1}} {}
+};
+
+class ProxyWorker
+{
+private:
+    const ProxyConfig &config;
+    const unsigned id;
+    const int listen_fd;  // owned by the Proxy, possibly shared with other workers
+    int epoll_fd = -1;
+    std::unordered_map<ProxySession*, std::unique_ptr<ProxySession>> sessions;
+    std::vector<ProxySession*> closed_sessions;
+    struct sockaddr_storage connect_addr;
+    socklen_t connect_addrlen;
+
+    void acceptConnections();
+    void closeSession(ProxySession &s);
+    bool onEvent(ProxySession &s, const int side, const uint32_t events);
+    bool fill(ProxySession &s, const int side);
+    bool drain(ProxySession &s, const int side);
+    bool updateInterest(ProxySession &s);
+
+public:
+    ProxyWorker(const ProxyConfig &config, const unsigned id, const int listen_fd);
+    ~ProxyWorker();
+
+    ProxyWorker(const ProxyWorker &) = delete;
+    ProxyWorker(ProxyWorker &&) = delete;
+
+    void run();
+};
+
+// TUNNEL
+
+// frame on a tunnel connection: header, then len payload bytes (host byte order, both ends run on one host)
+enum TunnelFrameType : uint16_t {
+    HELLO,  // stream 0, mux to demux: TunnelHello, the coalescing and flow control policy of the connection
+    OPEN,   // mux to demux: new client, demux connects upstream
+    DATA,   // payload of the stream
+    CLOSE,  // the sender's side of the stream reached eof (half-close)
+    RESET,  // the stream failed, the receiver drops it
+    CREDIT  // uint32_t: bytes of the stream written to its socket by the sender of the frame, the peer may send as many more
+};
+
+struct TunnelFrame {
+    uint32_t stream;
+    uint16_t type;
+    uint16_t len;
+};
+static_assert(sizeof(TunnelFrame) == 8);
+
+constexpr size_t TUNNEL_MAX_PAYLOAD = UINT16_MAX;
+
+struct TunnelHello {
+    uint32_t coalesce_bytes;
+    uint32_t coalesce_us;
+    uint32_t stream_window;  // initial credit of every stream in both directions
+};
+
+// byte queue: [off, len) pending, appends at len, rewinds when empty and compacts or grows on demand
+struct TunnelBuffer {
+    std::unique_ptr<char[]> data;
+    size_t capacity = 0;
+    size_t off = 0;
+    size_t len = 0;
+
+    size_t size() const { return len - off; }
+    char *begin() const { return data.get() + off; }
+    char *reserve(const size_t n);  // room for n more bytes at the end
+    void commit(const size_t n) { len += n; }
+    void consume(const size_t n) { off += n; if (off == len) off = len = 0; }
+};
+
+// client connection carried by the tunnel.
+// Credit based flow control: a stream sends at most stream_window bytes the peer has not yet written to its socket,
+// so a slow stream holds up neither the tunnel connection nor the other streams.
+struct TunnelStream {
+    const uint32_t id;
+    const size_t tunnel;      // index of the carrying tunnel connection
+    const int fd;
+    TunnelBuffer out;         // received from the tunnel, not yet written to fd, at most stream_window bytes
+    uint32_t credit;          // bytes that may still be read from fd and sent, reading pauses at 0
+    uint32_t written = 0;     // bytes written to fd and not yet returned to the peer as credit
+    uint32_t interest = 0;    // registered epoll events
+    bool connecting = false;  // demux: upstream connect in progress
+    bool blocked = false;     // reading paused until the tunnel connection drained
+    bool eof_in = false;      // fd reached eof, CLOSE sent
+    bool eof_out = false;     // CLOSE received, shutdown(fd) once out is written
+    bool shut = false;        // eof forwarded to fd
+    bool closed = false;      // fd closed, memory released after the current event batch
+
+    TunnelStream(const uint32_t id, const size_t tunnel, const int fd, const uint32_t credit) :
+        id(id), tunnel(tunnel), fd(fd), credit(credit) {}
+    // stream ids are assigned per mux, i.e. unique per tunnel connection only
+    static uint64_t key(const size_t tunnel, const uint32_t id) { return (static_cast<uint64_t>(tunnel) << 32) | id; }
+    uint64_t key() const { return key(tunnel, id); }
+};
+
+// tunnel connection between mux and demux
+struct TunnelConn {
+    const int fd;
+    TunnelBuffer out;           // frames to send
+    size_t staged = 0;          // bytes at the end of out held back for coalescing, the rest may be sent
+    uint64_t deadline_ns = 0;   // staged bytes are released at the latest then, 0: nothing staged
+    TunnelBuffer in;            // received, not yet handled
+    TunnelHello policy = {};    // coalescing of the direction towards the peer, flow control of both directions
+    std::vector<uint32_t> blocked;  // streams paused because out is full
+    size_t open_streams = 0;
+    uint32_t interest = 0;
+    bool want_out = false;      // send buffer was full, wait for EPOLLOUT
+    bool dirty = false;         // released bytes, sent at the end of the event batch
+    bool closed = false;
+    uint64_t frames = 0, bytes = 0, sends = 0;  // sent since the tunnel was idle last
+
+    explicit TunnelConn(const int fd) : fd(fd) {}
+};
+
+// single-threaded epoll loop of either tunnel end
+class TunnelWorker
+{
+private:
+    const ProxyConfig &config;
+    const int listen_fd;  // mux: clients, demux: tunnel connections
+    int epoll_fd = -1;
+    int timer_fd = -1;    // earliest coalescing deadline
+    uint64_t timer_ns = 0;  // armed deadline, 0: disarmed
+    std::vector<std::unique_ptr<TunnelConn>> tunnels;  // closed ones are released after the event batch, slots reused
+    std::unordered_map<uint64_t, std::unique_ptr<TunnelStream>> streams;  // by TunnelStream::key()
+    std::vector<TunnelStream*> closed_streams;
+    std::vector<size_t> dirty;   // tunnels to send from at the end of the event batch
+    uint32_t next_stream = 1;
+    struct sockaddr_storage connect_addr;
+    socklen_t connect_addrlen;
+
+    void acceptClients();
+    void acceptTunnels();
+    bool connectTunnels();
+    size_t addTunnel(const int fd);
+    void onTunnel(const size_t t, const uint32_t events);
+    void onStream(TunnelStream &s, const uint32_t events);
+    void onTimer();
+    bool readTunnel(const size_t t);
+    bool handleFrame(const size_t t, const TunnelFrame &hdr, const char *payload);
+    void openUpstream(const size_t t, const uint32_t id);
+    void readStream(TunnelStream &s);
+    bool writeStream(TunnelStream &s, const char *data, size_t len);
+    bool creditStream(TunnelStream &s, const size_t n);
+    void closeStream(TunnelStream &s, const bool reset);
+    void closeTunnel(const size_t t);
+    void pushFrame(const size_t t, const uint32_t stream, const TunnelFrameType type, const char *payload = nullptr, const uint16_t len = 0);
+    void stage(const size_t t, const size_t n);
+    void release(const size_t t);
+    bool flush(const size_t t);
+    void armTimer();
+    void endBatch();
+    bool updateStream(TunnelStream &s);
+    bool updateTunnel(const size_t t);
+    bool setInterest(const int fd, const uint64_t tag, uint32_t &interest, const uint32_t events, const bool add = false);
+
+public:
+    TunnelWorker(const ProxyConfig &config, const int listen_fd);
+    ~TunnelWorker();
+
+    TunnelWorker(const TunnelWorker &) = delete;
+    TunnelWorker(TunnelWorker &&) = delete;
+
+    void run();
+};
+
+class Proxy
+{
+private:
+    const ProxyConfig config;
+    std::vector<int> listen_fds;
+    std::vector<std::unique_ptr<ProxyWorker>> workers;
+    std::unique_ptr<TunnelWorker> tunnel;  // mux and demux mode
+    std::vector<std::thread> threads;
+
+    int createListener(const bool reuseport) const;
+
+public:
+    explicit Proxy(const ProxyConfig &config);
+    ~Proxy();
+
+    Proxy(const Proxy &) = delete;
+    Proxy(Proxy &&) = delete;
+    Proxy() = delete;
+
+    void run();
+};
+
+// fills addr for inet (dotted address), vsock (numeric cid) or unix (socket path) endpoints
+socklen_t make_sockaddr(const SocketProtocol protocol, const std::string &adr, const int port, struct sockaddr_storage &addr);
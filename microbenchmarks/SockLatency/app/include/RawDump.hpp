@@ -0,0 +1,201 @@
+#pragma once
+
+// Binary dump of the raw latency samples for offline analysis (see plot/raw_samples.py).
+//
+// The file is a sequence of page-aligned segments, one per recorder (connection, rate step, sweep size, ...),
+// appended by every run. A segment is a RawSegmentHeader (incl. the CSV config of its result row) followed by
+// the samples. Segments are preallocated and memory-mapped when they are opened, i.e. recording a sample is a
+// plain store into the mapping: no allocation, no syscall and no page fault in the measurement loop.
+// The file is trimmed to the written samples when the last segment is closed (e.g. after a timeout).
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Logger.hpp"
+#include "Utilities.hpp"
+
+constexpr char RAW_DUMP_MAGIC[8] = { 'S', 'L', 'R', 'A', 'W', '0', '0', '1' };
+constexpr size_t RAW_PAGE_SIZE = 4096;  // segment alignment of the file format, segments are mapped from the enclosing
+                                        // system page (e.g. 64 KiB on arm64), see RawDumpFile::segment
+
+struct RawSample {
+    uint64_t ts_ns;     // CLOCK_MONOTONIC when the sample was recorded, i.e. at completion of the request
+    uint64_t rtt_ns;    // recorded latency
+    uint32_t req_size;  // request size [B]
+    uint32_t rsp_size;  // response size [B]
+};
+static_assert(sizeof(RawSample) == 24, "RawSample must not be padded");
+
+struct RawSegmentHeader {
+    char magic[8];              // RAW_DUMP_MAGIC
+    uint32_t header_size;       // offset of the first sample
+    uint32_t sample_size;       // sizeof(RawSample)
+    uint64_t capacity;          // preallocated samples
+    uint64_t count;             // written samples, set when the segment is closed (0 if the client crashed)
+    uint64_t dropped;           // samples beyond the capacity, not written
+    uint64_t segment_size;      // offset of the next segment
+    int64_t realtime_offset_ns; // CLOCK_REALTIME - CLOCK_MONOTONIC at open, ts_ns + offset is a unix timestamp
+    uint32_t conn;              // connection of the samples
+    uint32_t config_len;
+    char config[RAW_PAGE_SIZE - 64];  // CSV header line, '\n', CSV config row
+};
+static_assert(sizeof(RawSegmentHeader) == RAW_PAGE_SIZE, "RawSegmentHeader must fill a page");
+
+inline uint64_t raw_page_align(const uint64_t n) { return (n + RAW_PAGE_SIZE - 1) / RAW_PAGE_SIZE * RAW_PAGE_SIZE; }
+
+class RawDumpFile;
+
+// writes the samples of one segment, owned by the measurement and attached to its recorder
+class RawSampleWriter
+{
+private:
+    friend class RawDumpFile;
+    RawDumpFile &file;
+    const uint64_t offset;  // of the segment in the file
+    void *const map;       // from the system page that encloses the segment
+    const size_t map_len;
+    RawSegmentHeader *hdr;
+    RawSample *samples;
+    const size_t capacity;
+    size_t n = 0;
+    size_t dropped = 0;
+    const uint32_t req_size;
+    const uint32_t rsp_size;
+
+    RawSampleWriter(RawDumpFile &file, const uint64_t offset, void *map, const size_t map_len, RawSegmentHeader *hdr,
+                    const size_t capacity, const uint32_t req_size, const uint32_t rsp_size) :
+        file(file), offset(offset), map(map), map_len(map_len), hdr(hdr),
+        samples(reinterpret_cast<RawSample*>(reinterpret_cast<char*>(hdr) + sizeof(RawSegmentHeader))),
+        capacity(capacity), req_size(req_size), rsp_size(rsp_size) {}
+
+public:
+    RawSampleWriter(const RawSampleWriter &) = delete;
+    RawSampleWriter &operator=(const RawSampleWriter &) = delete;
+    ~RawSampleWriter();
+
+    // sample with the sizes of the segment
+    inline void append(const double rtt_us) { append(rtt_us, req_size, rsp_size); }
+
+    inline void append(const double rtt_us, const uint32_t req, const uint32_t rsp) {
+        if (n == capacity) [[unlikely]] { dropped++; return; }
+        samples[n++] = RawSample{ monotonic_ns(), static_cast<uint64_t>(rtt_us > 0 ? std::llround(rtt_us * 1000) : 0), req, rsp };
+    }
+
+    size_t count() const { return n; }
+};
+
+class RawDumpFile
+{
+private:
+    int fd = -1;
+    uint64_t end;  // offset of the next segment
+    std::mutex mtx;
+
+    static int64_t realtime_offset_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<int64_t>(ts.tv_sec * 1000000000ULL + ts.tv_nsec) - static_cast<int64_t>(monotonic_ns());
+    }
+
+public:
+    // segments are appended to an existing file
+    explicit RawDumpFile(const std::string &path)
+    {
+        fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            error("Cannot open raw sample file " + path + ": " + std::string(strerror(errno)));
+            throw std::runtime_error("Cannot open raw sample file");
+        }
+        end = raw_page_align(st.st_size);
+    }
+
+    ~RawDumpFile() { if (fd >= 0) close(fd); }
+
+    RawDumpFile(const RawDumpFile &) = delete;
+    RawDumpFile &operator=(const RawDumpFile &) = delete;
+
+    // Preallocates and maps a segment for capacity samples. The pages are touched upfront, so that neither
+    // the first write to a page nor the dirty tracking of the shared mapping faults during the measurement.
+    std::unique_ptr<RawSampleWriter> segment(const std::string &config, const uint32_t conn, const size_t capacity, const uint32_t req_size, const uint32_t rsp_size)
+    {
+        if (config.size() > sizeof(RawSegmentHeader::config)) {
+            error("Config of " + std::to_string(config.size()) + " bytes does not fit into a raw sample segment header");
+            throw std::invalid_argument("Config too large for raw sample segment");
+        }
+
+        const uint64_t segment_size = sizeof(RawSegmentHeader) + raw_page_align(capacity * sizeof(RawSample));
+        uint64_t offset;
+        {
+            const std::lock_guard<std::mutex> lock(mtx);
+            offset = end;
+            end += segment_size;
+            const int err = posix_fallocate(fd, offset, segment_size);
+            if (err != 0) {
+                error("Cannot allocate raw sample segment of " + std::to_string(segment_size) + " bytes: " + std::string(strerror(err)));
+                throw std::runtime_error("Cannot allocate raw sample segment");
+            }
+        }
+
+        // the mmap offset must be a multiple of the system page size, which may be larger than RAW_PAGE_SIZE
+        const uint64_t page_size = std::max<uint64_t>(RAW_PAGE_SIZE, sysconf(_SC_PAGESIZE));
+        const uint64_t lead = offset % page_size;
+        void *map = mmap(nullptr, lead + segment_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset - lead);
+        if (map == MAP_FAILED) {
+            error("Cannot map raw sample segment: " + std::string(strerror(errno)));
+            throw std::runtime_error("Cannot map raw sample segment");
+        }
+
+        // only the own segment is written, the leading part may belong to a segment of another recorder
+        RawSegmentHeader *hdr = reinterpret_cast<RawSegmentHeader*>(static_cast<char*>(map) + lead);
+        std::memset(hdr, 0, segment_size);
+        std::memcpy(hdr->magic, RAW_DUMP_MAGIC, sizeof(hdr->magic));
+        hdr->header_size = sizeof(RawSegmentHeader);
+        hdr->sample_size = sizeof(RawSample);
+        hdr->capacity = capacity;
+        hdr->segment_size = segment_size;
+        hdr->realtime_offset_ns = realtime_offset_ns();
+        hdr->conn = conn;
+        hdr->config_len = config.size();
+        std::memcpy(hdr->config, config.data(), config.size());
+
+        return std::unique_ptr<RawSampleWriter>(new RawSampleWriter(*this, offset, map, lead + segment_size, hdr, capacity, req_size, rsp_size));
+    }
+
+    // publishes the sample count and unmaps the segment, the unused capacity of the last segment is cut off
+    void release(RawSampleWriter &writer)
+    {
+        RawSegmentHeader *hdr = writer.hdr;
+        hdr->count = writer.n;
+        hdr->dropped = writer.dropped;
+        const uint64_t segment_size = hdr->segment_size;
+        const uint64_t used = sizeof(RawSegmentHeader) + writer.n * sizeof(RawSample);
+
+        const std::lock_guard<std::mutex> lock(mtx);
+        if (writer.offset + segment_size == end) {
+            hdr->segment_size = raw_page_align(used);
+            end = writer.offset + hdr->segment_size;
+            munmap(writer.map, writer.map_len);
+            if (ftruncate(fd, writer.offset + used) != 0)
+                error("WARNING: cannot trim raw sample file: " + std::string(strerror(errno)));
+        } else {
+            munmap(writer.map, writer.map_len);
+        }
+        if (writer.dropped > 0)
+            error("WARNING: dropped " + std::to_string(writer.dropped) + " raw samples beyond the preallocated " + std::to_string(writer.capacity));
+    }
+};
+
+inline RawSampleWriter::~RawSampleWriter() { file.release(*this); }
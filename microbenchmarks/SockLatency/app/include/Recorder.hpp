@@ -0,0 +1,294 @@
+#pragma once
+
+// Latency sample recorders used by the client measurement loops.
+//
+// Both recorders expose the same (non-virtual) interface, the loops are templated on the recorder type:
+//   record(rtt_us)           add one sample [µs]
+//   record(rtt_us, req, rsp) add one sample of a request with individual sizes (replay)
+//   dumpTo(writer)           additionally write every sample incl. warmup to a raw sample dump (RawDump.hpp)
+//   count()                  number of recorded samples including warmup
+//   summary(output_outliers) statistics of the CSV output (excluding warmup)
+//   histogram()              HDR histogram of the samples (excluding warmup), e.g. for export
+//
+// VectorRecorder keeps every sample and sorts them once at the end (exact, O(n) memory).
+// HdrRecorder keeps a constant-size HDR histogram (configurable precision, mergeable across threads and runs).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Histogram.hpp"
+#include "RawDump.hpp"
+
+// samples are recorded in ns, larger values are clamped
+constexpr uint64_t HDR_HIGHEST_TRACKABLE_NS = 3600ULL * 1000 * 1000 * 1000;  // 1 hour
+
+enum RecorderType {
+    VECTOR,
+    HDR
+};
+
+inline std::string to_string(const RecorderType recorder)
+{
+    switch (recorder)
+    {
+    case VECTOR:
+        return "vector";
+    case HDR:
+        return "hdr";
+    default:
+        return "unknown";
+    }
+}
+
+inline std::ostream& operator<<(std::ostream& os, const RecorderType& recorder) {
+    os << to_string(recorder);
+    return os;
+}
+
+// number of leading samples considered as warmup
+struct WarmupPolicy {
+    size_t num_warmup_rounds;   // used if > 0 and smaller than the number of samples
+    double perc_warmup_rounds;  // otherwise, percentage of the number of samples
+
+    size_t of(const size_t num_samples) const {
+        if (num_warmup_rounds > 0 && num_warmup_rounds < num_samples)
+            return num_warmup_rounds;
+        else
+            return static_cast<size_t>(num_samples * perc_warmup_rounds / 100.0);
+    }
+};
+
+// all values in µs
+struct LatencySummary {
+    uint64_t num_measurements;
+    uint64_t num_warmup_rounds;
+    double min;
+    double max;
+    double p99;
+    double p999;
+    double avg;
+    double median;
+    double q25;
+    double q75;
+    double lower_bound;  // boxplot whiskers (1.5 IQR), clamped to min/max
+    double upper_bound;
+    uint64_t num_outliers_lo;
+    uint64_t num_outliers_hi;
+    std::string outliers_lo;  // "|"-separated, only if requested
+    std::string outliers_hi;
+};
+
+class VectorRecorder
+{
+private:
+    std::vector<double> samples;
+    const WarmupPolicy warmup;
+    const int hdr_digits;  // precision of the exported histogram
+    size_t merged_warmup = 0;  // warmup samples dropped by merged recorders
+    RawSampleWriter *raw = nullptr;
+
+public:
+    // warmup is applied on the actual number of samples (e.g. after a timeout)
+    VectorRecorder(const WarmupPolicy &warmup, const size_t expected_samples, const int hdr_digits) :
+        warmup(warmup), hdr_digits(hdr_digits)
+    {
+        samples.reserve(expected_samples);
+    }
+
+    inline void record(const double rtt_us) {
+        if (raw) raw->append(rtt_us);
+        samples.push_back(rtt_us);
+    }
+
+    inline void record(const double rtt_us, const uint32_t req_size, const uint32_t rsp_size) {
+        if (raw) raw->append(rtt_us, req_size, rsp_size);
+        samples.push_back(rtt_us);
+    }
+
+    void dumpTo(RawSampleWriter *writer) { raw = writer; }
+
+    size_t count() const { return samples.size() + merged_warmup; }
+
+    // e.g. aggregate per-thread recorders into one without warmup, warmup is dropped by each of them
+    void merge(const VectorRecorder &other) {
+        const size_t other_warmup = other.warmup.of(other.samples.size());
+        samples.insert(samples.end(), other.samples.begin() + other_warmup, other.samples.end());
+        merged_warmup += other.merged_warmup + other_warmup;
+    }
+
+    LatencySummary summary(const bool output_outliers) const
+    {
+        LatencySummary s;
+        const size_t num_warmup_rounds = warmup.of(samples.size());
+        s.num_warmup_rounds = merged_warmup + num_warmup_rounds;
+
+        // copy and sort results
+        std::vector<double> sorted_results(samples.begin() + num_warmup_rounds, samples.end());
+        std::sort(sorted_results.begin(), sorted_results.end());
+        if (sorted_results.empty())
+            throw std::runtime_error("No samples recorded after warmup");
+
+        // simple statistics
+        const uint64_t num_measurements = sorted_results.size();
+        s.num_measurements = num_measurements;
+        s.min = sorted_results[0];
+        s.max = sorted_results.back();
+        s.p99 = sorted_results[num_measurements * 0.99];
+        s.p999 = sorted_results[num_measurements * 0.999];
+        s.avg = std::accumulate(sorted_results.begin(), sorted_results.end(), 0.0) / num_measurements;
+        s.median = sorted_results[num_measurements * 0.5];
+        s.q25 = sorted_results[num_measurements * 0.25];
+        s.q75 = sorted_results[num_measurements * 0.75];
+
+        // advanced - boxplot outlier calculation
+        const double iqr = s.q75 - s.q25;
+        s.lower_bound = s.q25 - 1.5 * iqr;
+        s.upper_bound = s.q75 + 1.5 * iqr;
+        s.num_outliers_lo = 0;
+        s.num_outliers_hi = 0;
+        std::stringstream outliers_lo;
+        std::stringstream outliers_hi;
+        if (s.lower_bound < s.min)
+        {
+            // no outliers
+            s.lower_bound = s.min;
+        }
+        else
+        {
+            // outliers exist
+            auto it_end = sorted_results.begin() + (num_measurements * 0.25);  // outliers are below q25
+            for (auto it = sorted_results.begin(); it != it_end ; it++)
+                if (*it < s.lower_bound)
+                {
+                    s.num_outliers_lo++;
+                    if (output_outliers) outliers_lo << *it << "|";
+                }
+                else
+                    break;
+        }
+        if (s.upper_bound > s.max)
+        {
+            // no outliers
+            s.upper_bound = s.max;
+        }
+        else
+        {
+            // outliers exist
+            auto it_end = sorted_results.rbegin() + (num_measurements * 0.25) + 1;  // outliers are above q75, +1 because I'm too lazy to think about one-off errors here...
+            for (auto it = sorted_results.rbegin(); it != it_end; it++)
+                if (*it > s.upper_bound)
+                {
+                    s.num_outliers_hi++;
+                    if (output_outliers) outliers_hi << *it << "|";
+                }
+                else
+                    break;
+        }
+
+        s.outliers_lo = outliers_lo.str();
+        s.outliers_hi = outliers_hi.str();
+        if (!s.outliers_lo.empty()) s.outliers_lo.pop_back();  // remove trailing "|"
+        if (!s.outliers_hi.empty()) s.outliers_hi.pop_back();
+        return s;
+    }
+
+    Histogram histogram() const
+    {
+        Histogram hist(HDR_HIGHEST_TRACKABLE_NS, hdr_digits);
+        for (size_t i = warmup.of(samples.size()); i < samples.size(); i++)
+            hist.record(samples[i] > 0 ? std::llround(samples[i] * 1000) : 0);
+        return hist;
+    }
+};
+
+class HdrRecorder
+{
+private:
+    Histogram hist;
+    const size_t skip;  // warmup samples still to be dropped
+    size_t seen = 0;
+    RawSampleWriter *raw = nullptr;
+
+public:
+    // warmup is fixed upfront on the expected number of samples, since samples are not kept
+    HdrRecorder(const WarmupPolicy &warmup, const size_t expected_samples, const int hdr_digits) :
+        hist(HDR_HIGHEST_TRACKABLE_NS, hdr_digits), skip(warmup.of(expected_samples)) {}
+
+    inline void record(const double rtt_us) {
+        if (raw) raw->append(rtt_us);
+        if (seen++ < skip) [[unlikely]] return;
+        hist.record(rtt_us > 0 ? std::llround(rtt_us * 1000) : 0);
+    }
+
+    inline void record(const double rtt_us, const uint32_t req_size, const uint32_t rsp_size) {
+        if (raw) raw->append(rtt_us, req_size, rsp_size);
+        if (seen++ < skip) [[unlikely]] return;
+        hist.record(rtt_us > 0 ? std::llround(rtt_us * 1000) : 0);
+    }
+
+    void dumpTo(RawSampleWriter *writer) { raw = writer; }
+
+    size_t count() const { return seen; }
+
+    // e.g. aggregate per-thread recorders, warmup is dropped by each of them
+    void merge(const HdrRecorder &other) {
+        hist.merge(other.hist);
+        seen += other.seen;
+    }
+
+    LatencySummary summary(const bool output_outliers) const
+    {
+        if (hist.count() == 0)
+            throw std::runtime_error("No samples recorded after warmup");
+
+        auto us = [](const uint64_t ns) { return ns / 1000.0; };
+        const uint64_t num_measurements = hist.count();
+
+        LatencySummary s;
+        s.num_measurements = num_measurements;
+        s.num_warmup_rounds = seen - num_measurements;
+        s.min = us(hist.min());
+        s.max = us(hist.max());
+        s.p99 = us(hist.valueAtRank(num_measurements * 0.99));
+        s.p999 = us(hist.valueAtRank(num_measurements * 0.999));
+        s.avg = hist.mean() / 1000.0;
+        s.median = us(hist.valueAtRank(num_measurements * 0.5));
+        s.q25 = us(hist.valueAtRank(num_measurements * 0.25));
+        s.q75 = us(hist.valueAtRank(num_measurements * 0.75));
+
+        // boxplot outliers at bucket resolution
+        const double iqr = s.q75 - s.q25;
+        s.lower_bound = std::max(s.q25 - 1.5 * iqr, s.min);
+        s.upper_bound = std::min(s.q75 + 1.5 * iqr, s.max);
+        s.num_outliers_lo = hist.countBelow(std::llround(s.lower_bound * 1000));
+        s.num_outliers_hi = hist.countAbove(std::llround(s.upper_bound * 1000));
+
+        if (output_outliers)
+        {
+            // one entry per sample (bucket value), as with the raw samples
+            std::stringstream outliers_lo;
+            std::stringstream outliers_hi;
+            const uint64_t lo = std::llround(s.lower_bound * 1000);
+            const uint64_t hi = std::llround(s.upper_bound * 1000);
+            hist.forEachBucket([&](const uint64_t value, const uint64_t count) {
+                if (hist.highestEquivalentValue(value) < lo)
+                    for (uint64_t i = 0; i < count; i++) outliers_lo << us(value) << "|";
+                else if (value > hi)
+                    for (uint64_t i = 0; i < count; i++) outliers_hi << us(value) << "|";
+            });
+            s.outliers_lo = outliers_lo.str();
+            s.outliers_hi = outliers_hi.str();
+            if (!s.outliers_lo.empty()) s.outliers_lo.pop_back();  // remove trailing "|"
+            if (!s.outliers_hi.empty()) s.outliers_hi.pop_back();
+        }
+        return s;
+    }
+
+    const Histogram &histogram() const { return hist; }
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+// AES-GCM record layer (opt-in via the handshake config), the payload protection of a TLS-style channel
+// into the enclave through the untrusted host proxy.
+//
+// A message of req_size/rsp_size plaintext bytes travels as one or more records: a SealHeader, the ciphertext
+// (as long as the plaintext) and a 16-byte tag. The header up to crypto_ns is authenticated as additional data.
+// Every direction numbers its records from 0, the nonce is the direction and the record number, i.e. it is never
+// reused under a session key, and a receiver accepts only the next record number (no replays or reordering).
+// crypto_ns is filled in after sealing and not authenticated: the server reports its crypto time of the roundtrip.
+//
+// OpenSSL's EVP interface picks the fastest GCM implementation of the cpu (AES-NI + PCLMULQDQ, VAES + VPCLMULQDQ
+// with AVX-512). The key schedule is set up once per direction, a record only sets its nonce.
+// With seal_record_size, a large message is split into records that are sealed back to back in one batch and
+// sent with a single write. The receiver opens each record as soon as it has arrived, i.e. while the rest of
+// the message is still in flight.
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "Logger.hpp"
+#include "myTypes.h"
+
+constexpr uint16_t SEAL_MAGIC = 0x5ea1;
+constexpr uint16_t SEAL_LAST = 1;  // flags: last record of a message
+constexpr size_t SEAL_NONCE_LEN = 12;
+constexpr size_t SEAL_TAG_LEN = 16;
+
+struct SealHeader {
+    uint16_t magic;      // SEAL_MAGIC (never starts with CONFIG_UPDATE_MARKER)
+    uint16_t flags;      // SEAL_LAST
+    uint32_t len;        // plaintext bytes of this record
+    uint64_t seq;        // record number of the direction
+    uint32_t crypto_ns;  // responses: server time spent opening the request and sealing the response [ns]
+    uint32_t reserved;
+};
+static_assert(sizeof(SealHeader) == 24, "SealHeader must not be padded");
+
+// authenticated part of the header
+constexpr size_t SEAL_AAD_LEN = offsetof(SealHeader, crypto_ns);
+
+// bytes per record on top of its plaintext
+constexpr size_t SEAL_OVERHEAD = sizeof(SealHeader) + SEAL_TAG_LEN;
+
+// records of a message of len plaintext bytes
+inline size_t seal_records(const size_t len, const size_t record_size)
+{
+    return record_size == 0 || len <= record_size ? 1 : (len + record_size - 1) / record_size;
+}
+
+// wire size of a message of len plaintext bytes
+inline size_t sealed_size(const size_t len, const size_t record_size)
+{
+    return len + seal_records(len, record_size) * SEAL_OVERHEAD;
+}
+
+inline size_t seal_key_len(const SealCipher seal)
+{
+    return seal == SealCipher::AES_128_GCM ? 16 : 32;
+}
+
+// draws a fresh session key into the config, e.g. for every config update of a sweep (record numbers restart)
+inline void seal_session_key(ServerDynamicConfig &config)
+{
+    if (RAND_bytes(config.seal_key, sizeof(config.seal_key)) != 1) {
+        error("Generating the session key failed");
+        throw std::runtime_error("RAND_bytes failed");
+    }
+}
+
+inline SealHeader get_seal_header(const char *record)
+{
+    SealHeader hdr;
+    std::memcpy(&hdr, record, sizeof(hdr));
+    return hdr;
+}
+
+// responses: report the server crypto time in the (already sealed) first record
+inline void put_seal_crypto_ns(char *record, const uint32_t crypto_ns)
+{
+    std::memcpy(record + offsetof(SealHeader, crypto_ns), &crypto_ns, sizeof(crypto_ns));
+}
+
+class RecordCipher
+{
+private:
+    EVP_CIPHER_CTX *enc = nullptr;
+    EVP_CIPHER_CTX *dec = nullptr;
+    const uint32_t send_dir;   // nonce prefix of the sent records
+    const uint32_t recv_dir;   // nonce prefix of the received records
+    uint64_t send_seq = 0;
+    uint64_t recv_seq = 0;
+
+    static EVP_CIPHER_CTX *init(const SealCipher seal, const uint8_t *key, const int encrypt)
+    {
+        const EVP_CIPHER *cipher = seal == SealCipher::AES_128_GCM ? EVP_aes_128_gcm() : EVP_aes_256_gcm();
+        EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+        if (ctx == nullptr
+            || EVP_CipherInit_ex(ctx, cipher, nullptr, nullptr, nullptr, encrypt) != 1
+            || EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, SEAL_NONCE_LEN, nullptr) != 1
+            || EVP_CipherInit_ex(ctx, nullptr, nullptr, key, nullptr, encrypt) != 1) {
+            EVP_CIPHER_CTX_free(ctx);
+            error("Setting up the " + to_string(seal) + " cipher failed");
+            throw std::runtime_error("Cipher setup failed");
+        }
+        return ctx;
+    }
+
+    static void nonce(uint8_t *iv, const uint32_t dir, const uint64_t seq)
+    {
+        std::memcpy(iv, &dir, sizeof(dir));
+        std::memcpy(iv + sizeof(dir), &seq, sizeof(seq));
+    }
+
+public:
+    const size_t record_size;  // plaintext bytes per record, 0: one record per message
+
+    // server: receives the client direction (0) and sends the server direction (1)
+    RecordCipher(const ServerDynamicConfig &config, const bool server) :
+        send_dir(server ? 1 : 0), recv_dir(server ? 0 : 1), record_size(config.seal_record_size)
+    {
+        if (config.seal == SealCipher::PLAINTEXT)
+            throw std::invalid_argument("No cipher configured");
+        enc = init(config.seal, config.seal_key, 1);
+        try {
+            dec = init(config.seal, config.seal_key, 0);
+        } catch (...) {
+            EVP_CIPHER_CTX_free(enc);
+            throw;
+        }
+    }
+
+    ~RecordCipher()
+    {
+        EVP_CIPHER_CTX_free(enc);
+        EVP_CIPHER_CTX_free(dec);
+    }
+
+    RecordCipher(const RecordCipher &) = delete;
+    RecordCipher &operator=(const RecordCipher &) = delete;
+
+    // largest record of a message of len plaintext bytes
+    size_t maxRecord(const size_t len) const { return record_size == 0 ? len : std::min(len, record_size); }
+
+    // Seals len > 0 plaintext bytes as a batch of records into dst, which has to hold sealed_size(len) bytes.
+    // Returns the wire size of the message.
+    size_t seal(const char *src, const size_t len, char *dst)
+    {
+        char *out = dst;
+        size_t off = 0;
+        while (off < len)
+        {
+            const size_t n = record_size == 0 ? len : std::min(record_size, len - off);
+            const SealHeader hdr = { SEAL_MAGIC, static_cast<uint16_t>(off + n == len ? SEAL_LAST : 0), static_cast<uint32_t>(n), send_seq, 0, 0 };
+            uint8_t iv[SEAL_NONCE_LEN];
+            nonce(iv, send_dir, send_seq++);
+
+            uint8_t *body = reinterpret_cast<uint8_t*>(out + sizeof(hdr));
+            int outl;
+            if (EVP_EncryptInit_ex(enc, nullptr, nullptr, nullptr, iv) != 1
+                || EVP_EncryptUpdate(enc, nullptr, &outl, reinterpret_cast<const uint8_t*>(&hdr), SEAL_AAD_LEN) != 1
+                || EVP_EncryptUpdate(enc, body, &outl, reinterpret_cast<const uint8_t*>(src + off), static_cast<int>(n)) != 1
+                || EVP_EncryptFinal_ex(enc, body + n, &outl) != 1
+                || EVP_CIPHER_CTX_ctrl(enc, EVP_CTRL_GCM_GET_TAG, SEAL_TAG_LEN, body + n) != 1) [[unlikely]] {
+                error("Sealing record " + std::to_string(hdr.seq) + " failed");
+                throw std::runtime_error("Sealing failed");
+            }
+            std::memcpy(out, &hdr, sizeof(hdr));
+            out += sizeof(hdr) + n + SEAL_TAG_LEN;
+            off += n;
+        }
+        return out - dst;
+    }
+
+    // a received header announces the next record number and at most max_len plaintext bytes
+    bool check(const SealHeader &hdr, const size_t max_len) const
+    {
+        return hdr.magic == SEAL_MAGIC && hdr.seq == recv_seq && hdr.len > 0 && hdr.len <= max_len;
+    }
+
+    // Decrypts the body of a checked record (hdr.len ciphertext bytes and the tag) in place.
+    // Returns false if the record was not authentic.
+    bool open(const SealHeader &hdr, char *body)
+    {
+        uint8_t iv[SEAL_NONCE_LEN];
+        nonce(iv, recv_dir, recv_seq++);
+
+        uint8_t *data = reinterpret_cast<uint8_t*>(body);
+        int outl;
+        return EVP_DecryptInit_ex(dec, nullptr, nullptr, nullptr, iv) == 1
+            && EVP_CIPHER_CTX_ctrl(dec, EVP_CTRL_GCM_SET_TAG, SEAL_TAG_LEN, data + hdr.len) == 1
+            && EVP_DecryptUpdate(dec, nullptr, &outl, reinterpret_cast<const uint8_t*>(&hdr), SEAL_AAD_LEN) == 1
+            && EVP_DecryptUpdate(dec, data, &outl, data, static_cast<int>(hdr.len)) == 1
+            && EVP_DecryptFinal_ex(dec, data + hdr.len, &outl) == 1;
+    }
+};
@@ -3,46 +3,108 @@
 #include <iostream>
 #include <cstring>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <linux/vm_sockets.h>
 #include <unistd.h>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <deque>
 
 // local includes
 #include "myTypes.h"
 #include "Utilities.hpp"
+#include "Transport.hpp"
+#include "Framing.hpp"
+#include "Sealing.hpp"
+#include "Compression.hpp"
+#include "Columnar.hpp"
+#include "PerfCounters.hpp"
+#include "ShmChannel.hpp"
+
+enum ServerMode {
+    SERIAL,  // one connection at a time, blocking accept/handshake/handleClient
+    EPOLL    // event-driven reactor multiplexing many connections
+};
+
+// per-connection state of the epoll reactor
+struct Connection {
+    enum class State { HANDSHAKE, ECHO };
+
+    const int fd;
+    State state = State::HANDSHAKE;
+    ServerDynamicConfig config;
+    ServerDynamicConfig pending_config;  // handshake: config being received, independent of buf_size
+    std::unique_ptr<char[]> buf;
+    size_t buf_size;
+    size_t rcvd = 0;         // bytes received of the current message (handshake or request)
+    std::string rsp;
+    size_t rsp_pending = 0;  // response bytes owed to the client but not yet sent
+    size_t rsp_offset = 0;   // offset into rsp where the next send continues
+    std::deque<uint64_t> rcvd_ns;  // timestamps mode: receive time of the requests owed a response
+    FrameReader reader;             // framed protocol: parser over buf
+    std::deque<FrameHeader> frames; // framed protocol: requests owed a response
+    bool want_write = false; // EPOLLOUT currently registered
+
+    Connection(const int fd, const size_t buf_size) : fd(fd), config(), buf(std::make_unique<char[]>(buf_size)), buf_size(buf_size) {}
+};
 
 class Server
 {
 protected:
     int server_fd, client_con_fd;
+    std::unique_ptr<ShmChannel> shm;  // data channel of the shm protocol, client_con_fd is its control connection
     Server(const SocketProtocol protocol, const size_t buf_size);
-    void startServer();
+    void startServer(const int backlog = 3);
     void acceptConnection();
+    virtual bool attachChannel() { return true; }  // set up the data channel of an accepted connection, if any
     virtual struct sockaddr *getSockAddrServer(socklen_t *len) const = 0;
     virtual struct sockaddr *getSockAddrClient(socklen_t *len) const = 0;
 
 private:
     ServerDynamicConfig config;
     std::unique_ptr<char[]> buf;
+    IoBackend io = IoBackend::BLOCKING;
+    RecvOptions recv_opts;
 
     void applyConfig(ServerDynamicConfig &cfg);
-    void handshake();
+    bool handshake();  // false if the client did not complete it
     void handleClient();
+    template <typename Transport>
+    bool serveClient(Transport &transport, std::string &rsp);
+    template <typename Transport>
+    bool reconfigure(Transport &transport, const size_t n);  // sweep: config update, its first n bytes are in buf
+    void streamClient(const std::string &rsp);
+    void streamCompressed();
+    void scanClient();
+
+    // epoll reactor
+    int epoll_fd = -1;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::unique_ptr<PerfMeter> busy_perf;  // --perf_counters: reactor thread while connections are open
+    void runEpoll();
+    void acceptConnections();
+    void closeConnection(Connection &con);
+    bool onReadable(Connection &con);
+    bool onWritable(Connection &con);
+    bool updateInterest(Connection &con, const bool want_write);
 
 public:
     const SocketProtocol protocol;
 
     static std::unique_ptr<Server> make(const SocketProtocol protocol, const std::string &adr, const int port, const size_t buf_size);
-    ~Server();
+    virtual ~Server();
 
     Server(const Server &) = delete;
     Server(Server &&) = delete;
     Server() = delete;
 
-    void run();
+    void run(const ServerMode mode = ServerMode::SERIAL);
     size_t getBufSize() const { return config.buf_size; }
+    void setIoBackend(const IoBackend backend) { io = backend; }
+    void setRecvOptions(const RecvOptions &opts) { recv_opts = opts; }
 };
 
 class InetServer : public Server
@@ -63,4 +125,26 @@ public:
     struct sockaddr *getSockAddrClient(socklen_t *len) const override { *len = sizeof(sockaddr_vm); return (struct sockaddr *)&client_addr; }
 private:
     struct sockaddr_vm address, client_addr;
+};
+
+// unix stream or seqpacket socket, the path is replaced by the server
+class UnixServer : public Server
+{
+public:
+    UnixServer(const SocketProtocol protocol, const std::string &path, const size_t buf_size);
+    ~UnixServer() override;
+    struct sockaddr *getSockAddrServer(socklen_t *len) const override { *len = addrlen; return (struct sockaddr *)&address; }
+    struct sockaddr *getSockAddrClient(socklen_t *len) const override { *len = sizeof(sockaddr_un); return (struct sockaddr *)&client_addr; }
+private:
+    struct sockaddr_un address, client_addr;
+    socklen_t addrlen;
+};
+
+// shared-memory rings of the client, received over the unix control socket at the path
+class ShmServer : public UnixServer
+{
+public:
+    ShmServer(const std::string &path, const size_t buf_size) : UnixServer(SocketProtocol::SHM, path, buf_size) {}
+protected:
+    bool attachChannel() override;
 };
\ No newline at end of file
@@ -0,0 +1,332 @@
+#pragma once
+
+// Shared-memory data channel of the shm protocol, the lower bound of cross-process request/response on one host.
+//
+// A pair of single-producer/single-consumer byte rings in one memfd: ring 0 carries the requests (client to
+// server), ring 1 the responses. The client creates the memfd and passes it over the unix control socket
+// (SCM_RIGHTS), which also carries the handshake and tells the end of the session. Head and tail count the
+// bytes since the start and live on cache lines of their own, so producer and consumer only share the data.
+// A message larger than the free space is written in chunks, i.e. any message size works with any ring size.
+//
+// ShmTransport exposes the interface of the transports in Transport.hpp. Reads wait according to the
+// RecvStrategy: spin on the head index, block on a futex (blocking) or spin for poll_us, then block (hybrid).
+// A producer only issues a futex wake if the consumer announced that it is about to sleep.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Logger.hpp"
+#include "Utilities.hpp"
+#include "Transport.hpp"
+#include "PerfCounters.hpp"
+
+constexpr size_t SHM_CACHE_LINE = 64;
+constexpr size_t SHM_HEADER_SIZE = 4096;          // per ring, the data follows page aligned
+constexpr size_t SHM_HUGE_PAGE_SIZE = 2ul << 20;  // MFD_HUGETLB default huge page size
+constexpr size_t SHM_MIN_RING_SIZE = 4096;
+constexpr long SHM_LIVENESS_CHECK_NS = 100'000'000;  // blocked readers and writers check the peer every 100 ms
+
+struct ShmRingHeader {
+    uint64_t capacity;  // power of two, set by the creator
+    alignas(SHM_CACHE_LINE) std::atomic<uint64_t> head;  // bytes produced, written by the producer only
+    alignas(SHM_CACHE_LINE) std::atomic<uint64_t> tail;  // bytes consumed, written by the consumer only
+    alignas(SHM_CACHE_LINE) std::atomic<uint32_t> data_seq;  // futex word of a sleeping consumer
+    std::atomic<uint32_t> consumer_waiting;
+    alignas(SHM_CACHE_LINE) std::atomic<uint32_t> space_seq;  // futex word of a sleeping producer
+    std::atomic<uint32_t> producer_waiting;
+    alignas(SHM_CACHE_LINE) std::atomic<uint32_t> closed;  // set by either side when it closes the channel
+};
+static_assert(sizeof(ShmRingHeader) <= SHM_HEADER_SIZE);
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free);
+
+// process-shared futex (no FUTEX_PRIVATE_FLAG), the word lives in the shared mapping
+inline void futex_wait(std::atomic<uint32_t> &word, const uint32_t expected, const struct timespec *timeout) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t> &word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+class ShmChannel
+{
+private:
+    const int fd;
+    char *base;
+    const size_t map_size;
+    size_t stride = 0;  // header and data of a ring
+
+    ShmChannel(const int fd, const size_t map_size) : fd(fd), base(nullptr), map_size(map_size)
+    {
+        void *p = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+        if (p == MAP_FAILED) {
+            error("Mapping shared memory channel failed with ERROR: " + std::string(strerror(errno)));
+            close(fd);
+            throw std::runtime_error("Mapping shared memory channel failed");
+        }
+        base = static_cast<char*>(p);
+    }
+
+    static size_t ringStride(const size_t capacity) { return SHM_HEADER_SIZE + capacity; }
+
+public:
+    // client: new channel with two rings of at least ring_size bytes, hugepages requires reserved huge pages
+    static std::unique_ptr<ShmChannel> create(const size_t ring_size, const bool hugepages)
+    {
+        size_t capacity = SHM_MIN_RING_SIZE;
+        while (capacity < ring_size) capacity <<= 1;
+        size_t map_size = 2 * ringStride(capacity);
+        if (hugepages) map_size = (map_size + SHM_HUGE_PAGE_SIZE - 1) / SHM_HUGE_PAGE_SIZE * SHM_HUGE_PAGE_SIZE;
+
+        const int fd = memfd_create("socklatency-shm", MFD_CLOEXEC | (hugepages ? MFD_HUGETLB : 0));
+        if (fd < 0) {
+            error("memfd_create failed with ERROR: " + std::string(strerror(errno)));
+            throw std::runtime_error("memfd_create failed");
+        }
+        if (ftruncate(fd, map_size) < 0) {
+            error("Sizing shared memory channel failed with ERROR: " + std::string(strerror(errno)) + (hugepages ? " (huge pages reserved?)" : ""));
+            close(fd);
+            throw std::runtime_error("Sizing shared memory channel failed");
+        }
+
+        std::unique_ptr<ShmChannel> channel(new ShmChannel(fd, map_size));
+        channel->stride = ringStride(capacity);
+        for (int r = 0; r < 2; r++)
+            channel->header(r).capacity = capacity;  // the rest is zero-filled by ftruncate
+        logger("Shared memory channel: 2 rings of " + std::to_string(capacity) + " bytes" + (hugepages ? " on huge pages" : ""));
+        return channel;
+    }
+
+    // server: map the channel received from the client, takes ownership of fd
+    static std::unique_ptr<ShmChannel> attach(const int fd)
+    {
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t) st.st_size < 2 * ringStride(SHM_MIN_RING_SIZE)) {
+            error("Invalid shared memory channel");
+            close(fd);
+            throw std::runtime_error("Invalid shared memory channel");
+        }
+        std::unique_ptr<ShmChannel> channel(new ShmChannel(fd, st.st_size));
+        const uint64_t capacity = reinterpret_cast<const ShmRingHeader*>(channel->base)->capacity;
+        channel->stride = ringStride(capacity);
+        if (capacity < SHM_MIN_RING_SIZE || (capacity & (capacity - 1)) != 0 || 2 * channel->stride > channel->map_size
+            || channel->header(1).capacity != capacity) {
+            error("Invalid shared memory channel: ring capacity " + std::to_string(capacity));
+            channel->stride = 0;  // the destructor only touches the first header
+            throw std::runtime_error("Invalid shared memory channel");
+        }
+        return channel;
+    }
+
+    ~ShmChannel()
+    {
+        // a peer blocked on the channel must not wait for its liveness check
+        for (int r = 0; r < 2; r++) {
+            ShmRingHeader &hdr = header(r);
+            hdr.closed.store(1, std::memory_order_seq_cst);
+            futex_wake(hdr.data_seq);
+            futex_wake(hdr.space_seq);
+        }
+        munmap(base, map_size);
+        close(fd);
+    }
+
+    ShmChannel(const ShmChannel &) = delete;
+    ShmChannel &operator=(const ShmChannel &) = delete;
+
+    int getFd() const { return fd; }
+    ShmRingHeader &header(const int ring) const { return *reinterpret_cast<ShmRingHeader*>(base + ring * stride); }
+    char *data(const int ring) const { return base + ring * stride + SHM_HEADER_SIZE; }
+};
+
+// pass the channel to the peer over the connected unix control socket
+inline bool send_fd(const int sock, const int fd)
+{
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    alignas(struct cmsghdr) char ctrl[CMSG_SPACE(sizeof(int))] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+// the descriptor passed with send_fd, -1 on error
+inline int recv_fd(const int sock)
+{
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    alignas(struct cmsghdr) char ctrl[CMSG_SPACE(sizeof(int))] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1) return -1;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int))) return -1;
+    int fd;
+    std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+// one side of a ShmChannel: the client sends on ring 0 and receives on ring 1, the server vice versa
+class ShmTransport
+{
+private:
+    const RecvOptions recv_opts;
+    ShmRingHeader &tx_hdr, &rx_hdr;
+    char *const tx;
+    char *const rx;
+    const uint64_t capacity;
+    const int ctrl_fd;  // control socket, tells a peer that exited without closing the channel
+
+    // the peer closed the channel or the control socket
+    bool peerGone() const {
+        if (tx_hdr.closed.load(std::memory_order_acquire) || rx_hdr.closed.load(std::memory_order_acquire)) return true;
+        char c;
+        const ssize_t n = ::recv(ctrl_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+    }
+
+    // wait until ready() holds according to the receive strategy, false if the peer is gone meanwhile
+    template <typename Ready>
+    bool await(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &waiting, const Ready &ready) const {
+        if (ready()) [[likely]] return true;
+
+        if (recv_opts.strategy != RecvStrategy::BLOCKING) {
+            const bool hybrid = recv_opts.strategy == RecvStrategy::HYBRID;
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(recv_opts.poll_us);
+            for (uint64_t i = 1;; i++) {
+                cpu_relax();
+                if (ready()) return true;
+                if ((i & 0xffff) == 0 && peerGone()) return false;
+                if (hybrid && (i & 0x3f) == 0 && std::chrono::steady_clock::now() >= deadline) break;
+            }
+        }
+
+        // announce the sleep before the last check, the producer checks the announcement after publishing
+        const struct timespec timeout = { 0, SHM_LIVENESS_CHECK_NS };
+        while (true) {
+            const uint32_t s = seq.load(std::memory_order_acquire);
+            waiting.store(1, std::memory_order_seq_cst);
+            if (ready()) break;
+            if (peerGone()) {
+                waiting.store(0, std::memory_order_relaxed);
+                return false;
+            }
+            futex_wait(seq, s, &timeout);
+        }
+        waiting.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    static inline void notify(std::atomic<uint32_t> &seq, const std::atomic<uint32_t> &waiting) {
+        if (waiting.load(std::memory_order_seq_cst)) [[unlikely]] {
+            seq.fetch_add(1, std::memory_order_release);
+            futex_wake(seq);
+        }
+    }
+
+    inline int64_t sendall(const char *buf, const size_t len) {
+        const uint64_t head = tx_hdr.head.load(std::memory_order_relaxed);
+        size_t total = 0;
+        while (total < len) {
+            uint64_t tail = tx_hdr.tail.load(std::memory_order_acquire);
+            if (head + total - tail == capacity) {
+                if (!await(tx_hdr.space_seq, tx_hdr.producer_waiting, [&]() { return head + total - tx_hdr.tail.load(std::memory_order_acquire) < capacity; })) [[unlikely]] {
+                    errno = EPIPE;
+                    return -1;
+                }
+                tail = tx_hdr.tail.load(std::memory_order_acquire);
+            }
+            const size_t n = std::min<size_t>(len - total, capacity - (head + total - tail));
+            const size_t off = (head + total) & (capacity - 1);
+            const size_t first = std::min<size_t>(n, capacity - off);
+            std::memcpy(tx + off, buf + total, first);
+            std::memcpy(tx, buf + total + first, n - first);
+            total += n;
+            tx_hdr.head.store(head + total, std::memory_order_seq_cst);
+            notify(tx_hdr.data_seq, tx_hdr.consumer_waiting);
+            if (total < len) stats.partial_writes++;
+        }
+        return total;
+    }
+
+public:
+    IoStats stats;
+
+    ShmTransport(ShmChannel &channel, const bool server, const int ctrl_fd, const RecvOptions &recv_opts = {}) :
+        recv_opts(recv_opts), tx_hdr(channel.header(server ? 1 : 0)), rx_hdr(channel.header(server ? 0 : 1)),
+        tx(channel.data(server ? 1 : 0)), rx(channel.data(server ? 0 : 1)), capacity(tx_hdr.capacity), ctrl_fd(ctrl_fd)
+    {
+        if (recv_opts.strategy == RecvStrategy::BUSY_POLL)
+            throw std::invalid_argument("The shm protocol supports the blocking (futex), spin and hybrid receive strategies");
+    }
+
+    inline int64_t read(char *buf, const size_t len) {
+        const uint64_t tail = rx_hdr.tail.load(std::memory_order_relaxed);
+        if (!await(rx_hdr.data_seq, rx_hdr.consumer_waiting, [&]() { return rx_hdr.head.load(std::memory_order_acquire) != tail; })) [[unlikely]]
+            return 0;
+        const size_t n = std::min<size_t>(len, rx_hdr.head.load(std::memory_order_acquire) - tail);
+        const size_t off = tail & (capacity - 1);
+        const size_t first = std::min<size_t>(n, capacity - off);
+        std::memcpy(buf, rx + off, first);
+        std::memcpy(buf + first, rx, n - first);
+        rx_hdr.tail.store(tail + n, std::memory_order_seq_cst);
+        notify(rx_hdr.space_seq, rx_hdr.producer_waiting);
+        return n;
+    }
+
+    inline int64_t readall(char *buf, const size_t len) {
+        size_t total = 0;
+        while (total < len) {
+            const int64_t n = read(buf + total, len - total);
+            if (n <= 0) [[unlikely]] { return n; }
+            total += n;
+            if (total < len) stats.partial_reads++;
+        }
+        return total;
+    }
+
+    inline int64_t roundtrip(const char *req, const size_t req_len, char *rsp, const size_t rsp_len) {
+        if (sendall(req, req_len) != (int64_t) req_len) [[unlikely]] {
+            error("Send failed. Error: " + std::string(strerror(errno)));
+            throw std::runtime_error("Send failed");
+        }
+        return read(rsp, rsp_len);
+    }
+
+    inline int64_t roundtripAll(const char *req, const size_t req_len, char *rsp, const size_t rsp_len) {
+        if (sendall(req, req_len) != (int64_t) req_len) [[unlikely]] {
+            error("Send failed. Error: " + std::string(strerror(errno)));
+            throw std::runtime_error("Send failed");
+        }
+        return readall(rsp, rsp_len);
+    }
+
+    inline int64_t write(const char *buf, const size_t len) {
+        return sendall(buf, len);
+    }
+};
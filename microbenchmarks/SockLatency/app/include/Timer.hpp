@@ -0,0 +1,209 @@
+#pragma once
+
+// Timers of the closed-loop measurement loops.
+//
+// Both timers expose the same (non-virtual) interface, the loops are templated on the timer type:
+//   start()      timestamp before the measured operation [ticks]
+//   stop()       timestamp after the measured operation [ticks]
+//   toUs(ticks)  duration of a tick difference [µs]
+//
+// TscTimer reads the time stamp counter directly (no vDSO call), fenced such that the measured operation
+// can neither start before start() nor complete after stop(). Its frequency is calibrated at runtime
+// against CLOCK_MONOTONIC_RAW, which requires an invariant TSC (constant rate, not stopped in idle states).
+// ClockTimer uses std::chrono::steady_clock and is the fallback where the TSC is unavailable or unreliable,
+// e.g. in virtualized environments that hide the invariant TSC flag.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define HAVE_TSC_TIMER 1
+#else
+#define HAVE_TSC_TIMER 0
+#endif
+
+#include "Logger.hpp"
+
+enum class TimerSource {
+    AUTO,   // tsc if invariant and stable, otherwise clock
+    TSC,
+    CLOCK
+};
+
+inline std::string to_string(const TimerSource source)
+{
+    switch (source)
+    {
+    case TimerSource::AUTO:
+        return "auto";
+    case TimerSource::TSC:
+        return "tsc";
+    case TimerSource::CLOCK:
+        return "clock";
+    default:
+        return "unknown";
+    }
+}
+
+inline std::ostream& operator<<(std::ostream& os, const TimerSource& source) {
+    os << to_string(source);
+    return os;
+}
+
+inline TimerSource timer_source_from_string(const std::string &str)
+{
+    if (str == "auto") {
+        return TimerSource::AUTO;
+    } else if (str == "tsc") {
+        return TimerSource::TSC;
+    } else if (str == "clock") {
+        return TimerSource::CLOCK;
+    } else {
+        throw std::runtime_error("Invalid timer source");
+    }
+}
+
+class ClockTimer
+{
+public:
+    inline uint64_t start() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    inline uint64_t stop() const { return start(); }
+    inline double toUs(const uint64_t ticks) const { return ticks / 1000.0; }
+};
+
+#if HAVE_TSC_TIMER
+
+class TscTimer
+{
+private:
+    const double ticks_per_us;
+
+public:
+    explicit TscTimer(const double ticks_per_us) : ticks_per_us(ticks_per_us) {}
+
+    // lfence before: earlier instructions are complete, lfence after: later instructions do not start early
+    inline uint64_t start() const {
+        _mm_lfence();
+        const uint64_t tsc = __rdtsc();
+        _mm_lfence();
+        return tsc;
+    }
+
+    // rdtscp waits for earlier instructions, lfence after: later instructions do not start early
+    inline uint64_t stop() const {
+        unsigned int aux;
+        const uint64_t tsc = __rdtscp(&aux);
+        _mm_lfence();
+        return tsc;
+    }
+
+    inline double toUs(const uint64_t ticks) const { return ticks / ticks_per_us; }
+};
+
+// CPUID.80000007H:EDX[8] invariant TSC, CPUID.80000001H:EDX[27] rdtscp
+inline bool tsc_invariant()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007)
+        return false;
+    if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) == 0 || !(edx & (1u << 27)))
+        return false;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0 || !(edx & (1u << 8)))
+        return false;
+    return true;
+}
+
+#endif  // HAVE_TSC_TIMER
+
+// result of the startup calibration, carried in the experiment config
+struct TimerCalibration {
+    TimerSource source;   // resolved: TSC or CLOCK
+    double ticks_per_us;  // tsc frequency [MHz], unused for CLOCK
+    double overhead_ns;   // median duration of an empty start()/stop() pair
+};
+
+// median duration of back-to-back start()/stop() pairs, i.e. the share of every sample caused by the timer itself
+template <typename Timer>
+double timer_overhead_ns(const Timer &timer, const size_t rounds = 100000)
+{
+    std::vector<double> samples(rounds);
+    for (size_t i = 0; i < rounds; i++) {
+        const uint64_t start = timer.start();
+        const uint64_t stop = timer.stop();
+        samples[i] = timer.toUs(stop - start) * 1000;
+    }
+    std::nth_element(samples.begin(), samples.begin() + rounds / 2, samples.end());
+    return samples[rounds / 2];
+}
+
+inline uint64_t monotonic_raw_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Resolves AUTO and calibrates the tsc frequency over a few busy-waiting intervals. The tsc is considered
+// unreliable if it is not invariant or the intervals disagree by more than max_spread (relative).
+inline TimerCalibration calibrate_timer(const TimerSource requested, const double interval_ms = 20, const int intervals = 5, const double max_spread = 1e-3)
+{
+    TimerCalibration cal = { TimerSource::CLOCK, 1000.0, 0 };
+
+    #if HAVE_TSC_TIMER
+    if (requested != TimerSource::CLOCK)
+    {
+        std::string reason;
+        if (!tsc_invariant()) {
+            reason = "no invariant tsc";
+        } else {
+            const TscTimer raw(1.0);
+            std::vector<double> freqs;
+            for (int i = 0; i < intervals; i++) {
+                const uint64_t ns_start = monotonic_raw_ns();
+                const uint64_t tsc_start = raw.start();
+                uint64_t ns_end;
+                while ((ns_end = monotonic_raw_ns()) - ns_start < interval_ms * 1e6);
+                const uint64_t tsc_end = raw.stop();
+                freqs.push_back((tsc_end - tsc_start) * 1000.0 / (ns_end - ns_start));
+            }
+            std::sort(freqs.begin(), freqs.end());
+            const double median = freqs[freqs.size() / 2];
+            const double spread = (freqs.back() - freqs.front()) / median;
+            if (spread > max_spread)
+                reason = "tsc frequency unstable (spread " + std::to_string(spread) + ")";
+            else
+                cal = { TimerSource::TSC, median, 0 };
+        }
+
+        if (cal.source != TimerSource::TSC) {
+            if (requested == TimerSource::TSC) {
+                error("TSC timer not usable: " + reason);
+                throw std::runtime_error("TSC timer not usable");
+            }
+            error("WARNING: falling back to the clock timer, " + reason);
+        }
+    }
+    #else
+    if (requested == TimerSource::TSC)
+        throw std::runtime_error("TSC timer not available on this architecture");
+    #endif
+
+    #if HAVE_TSC_TIMER
+    if (cal.source == TimerSource::TSC)
+        cal.overhead_ns = timer_overhead_ns(TscTimer(cal.ticks_per_us));
+    else
+    #endif
+        cal.overhead_ns = timer_overhead_ns(ClockTimer());
+    return cal;
+}
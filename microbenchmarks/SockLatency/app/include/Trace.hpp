@@ -0,0 +1,120 @@
+#pragma once
+
+// Replayed workloads: a sequence of requests with individual request and response sizes and the
+// inter-arrival gap before each request, either read from a trace file or drawn from a size mix.
+//
+// Trace file: CSV lines req_size,rsp_size,gap_us. Lines that do not start with a digit (header, comments) are skipped.
+// Size mix:   comma-separated req_size:rsp_size:weight classes, e.g. "64:64:90,64:65536:10" for 90% point lookups
+//             and 10% scans, with exponentially distributed gaps of a given mean.
+//
+// Sizes are frame sizes of the framed protocol, i.e. at least sizeof(FrameHeader).
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Logger.hpp"
+#include "Framing.hpp"
+
+struct TraceEntry {
+    uint32_t req_size;  // request frame size [B]
+    uint32_t rsp_size;  // requested response frame size [B]
+    double gap_us;      // inter-arrival gap before this request [µs]
+};
+
+// upper bound of the power-of-two size class of size
+inline uint32_t size_class(const uint32_t size)
+{
+    uint32_t bound = 1;
+    while (bound < size && bound < (1u << 31)) bound <<= 1;
+    return bound;
+}
+
+// sizes below a frame header are raised to it, reported once per workload
+inline void clamp_trace_sizes(std::vector<TraceEntry> &entries)
+{
+    size_t clamped = 0;
+    for (TraceEntry &entry : entries) {
+        if (entry.req_size < sizeof(FrameHeader) || entry.rsp_size < sizeof(FrameHeader)) clamped++;
+        entry.req_size = std::max<uint32_t>(entry.req_size, sizeof(FrameHeader));
+        entry.rsp_size = std::max<uint32_t>(entry.rsp_size, sizeof(FrameHeader));
+    }
+    if (clamped > 0)
+        error("WARNING: raised the sizes of " + std::to_string(clamped) + " replayed requests to the frame header size (" + std::to_string(sizeof(FrameHeader)) + " bytes)");
+}
+
+inline std::vector<TraceEntry> load_trace(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in) {
+        error("Cannot open trace file " + path);
+        throw std::runtime_error("Cannot open trace file");
+    }
+
+    std::vector<TraceEntry> entries;
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(in, line))
+    {
+        line_no++;
+        if (line.empty() || !std::isdigit(static_cast<unsigned char>(line[0]))) continue;
+
+        std::stringstream ss(line);
+        std::string req, rsp, gap;
+        if (!std::getline(ss, req, ',') || !std::getline(ss, rsp, ',') || !std::getline(ss, gap, ',')) {
+            error("Invalid trace line " + std::to_string(line_no) + ": " + line);
+            throw std::invalid_argument("Invalid trace file");
+        }
+        entries.push_back({ static_cast<uint32_t>(std::stoul(req)), static_cast<uint32_t>(std::stoul(rsp)), std::stod(gap) });
+    }
+    if (entries.empty()) {
+        error("Trace file " + path + " contains no requests");
+        throw std::invalid_argument("Empty trace file");
+    }
+
+    clamp_trace_sizes(entries);
+    return entries;
+}
+
+inline std::vector<TraceEntry> generate_trace(const std::string &mix, const double gap_us, const size_t num_requests, const uint64_t seed)
+{
+    std::vector<TraceEntry> classes;
+    std::vector<double> weights;
+    std::stringstream ss(mix);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.empty()) continue;
+        const size_t first = item.find(':');
+        const size_t second = item.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            error("Invalid size class " + item + ", expected req_size:rsp_size:weight");
+            throw std::invalid_argument("Invalid size mix");
+        }
+        classes.push_back({ static_cast<uint32_t>(std::stoul(item.substr(0, first))),
+                            static_cast<uint32_t>(std::stoul(item.substr(first + 1, second - first - 1))), 0 });
+        weights.push_back(std::stod(item.substr(second + 1)));
+    }
+    if (classes.empty()) {
+        error("Size mix " + mix + " contains no classes");
+        throw std::invalid_argument("Invalid size mix");
+    }
+
+    std::mt19937_64 rng(seed);
+    std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+    std::exponential_distribution<double> gap(gap_us > 0 ? 1.0 / gap_us : 1.0);
+    std::vector<TraceEntry> entries(num_requests);
+    for (TraceEntry &entry : entries) {
+        entry = classes[pick(rng)];
+        entry.gap_us = gap_us > 0 ? gap(rng) : 0;
+    }
+
+    clamp_trace_sizes(entries);
+    return entries;
+}
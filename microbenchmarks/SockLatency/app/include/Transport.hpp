@@ -0,0 +1,366 @@
+#pragma once
+
+// I/O backends used by the client and server measurement loops.
+//
+// All transports (including ShmTransport of the shm protocol, see ShmChannel.hpp) expose the same (non-virtual)
+// interface, the loops are templated on the transport type so the hot path is not paying for the abstraction:
+//   read(buf, len)                            single read of up to len bytes
+//   readall(buf, len)                         read exactly len bytes
+//   roundtrip(req, req_len, rsp, rsp_len)     send req, then a single read of up to rsp_len bytes
+//   roundtripAll(req, req_len, rsp, rsp_len)  send req, then read exactly rsp_len bytes
+//   write(buf, len)                           send exactly len bytes
+// All calls except write return the number of bytes received, 0 if the peer disconnected, or < 0 on error.
+// write returns the number of bytes sent or < 0 on error.
+// stats counts the reads and sends of readall/roundtripAll/write that did not complete the message at once.
+//
+// The blocking transport waits for incoming data according to its RecvStrategy, i.e. either sleeps in
+// read (one scheduler wakeup per message) or polls, trading cpu time for latency.
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Logger.hpp"
+#include "Utilities.hpp"
+#include "IoUring.hpp"
+#include "PerfCounters.hpp"
+
+enum IoBackend {
+    BLOCKING,
+    URING
+};
+
+inline std::string to_string(const IoBackend io)
+{
+    switch (io)
+    {
+    case BLOCKING:
+        return "blocking";
+    case URING:
+        return "uring";
+    default:
+        return "unknown";
+    }
+}
+
+inline std::ostream& operator<<(std::ostream& os, const IoBackend& io) {
+    os << to_string(io);
+    return os;
+}
+
+// how the blocking transport waits for incoming data
+enum class RecvStrategy {
+    BLOCKING,   // blocking read, the thread sleeps until data arrives
+    SPIN,       // non-blocking reads (MSG_DONTWAIT) in a loop, never sleeps
+    BUSY_POLL,  // blocking read on a socket with SO_BUSY_POLL, the kernel polls the device queue before sleeping
+    HYBRID      // spin for poll_us, then fall back to a blocking read
+};
+
+inline std::string to_string(const RecvStrategy strategy)
+{
+    switch (strategy)
+    {
+    case RecvStrategy::BLOCKING:
+        return "blocking";
+    case RecvStrategy::SPIN:
+        return "spin";
+    case RecvStrategy::BUSY_POLL:
+        return "busy_poll";
+    case RecvStrategy::HYBRID:
+        return "hybrid";
+    default:
+        return "unknown";
+    }
+}
+
+inline std::ostream& operator<<(std::ostream& os, const RecvStrategy& strategy) {
+    os << to_string(strategy);
+    return os;
+}
+
+struct RecvOptions {
+    RecvStrategy strategy = RecvStrategy::BLOCKING;
+    uint32_t poll_us = 0;  // hybrid: spin time before blocking, busy_poll: SO_BUSY_POLL value
+};
+
+struct UringOptions {
+    bool sqpoll;            // kernel-side submission polling thread, completions are polled from the ring
+    unsigned sqpoll_idle_ms;
+    bool register_fd;       // IOSQE_FIXED_FILE instead of a per-request fd lookup
+    bool register_buffers;  // READ_FIXED/WRITE_FIXED on pre-registered buffers
+};
+
+// one send/read syscall per direction (the baseline), reads wait according to the receive strategy
+class BlockingTransport
+{
+private:
+    const RecvOptions recv_opts;
+
+    inline int64_t spinRead(char *buf, const size_t len) {
+        while (true) {
+            const ssize_t n = ::recv(fd, buf, len, MSG_DONTWAIT);
+            if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) return n;
+            cpu_relax();
+        }
+    }
+
+    inline int64_t hybridRead(char *buf, const size_t len) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(recv_opts.poll_us);
+        do {
+            const ssize_t n = ::recv(fd, buf, len, MSG_DONTWAIT);
+            if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) return n;
+            cpu_relax();
+        } while (std::chrono::steady_clock::now() < deadline);
+        return ::read(fd, buf, len);
+    }
+
+public:
+    const int fd;
+    IoStats stats;
+
+    explicit BlockingTransport(const int fd, const RecvOptions &recv_opts = {}) : recv_opts(recv_opts), fd(fd)
+    {
+        if (recv_opts.strategy == RecvStrategy::BUSY_POLL) {
+            // values above net.core.busy_poll require CAP_NET_ADMIN
+            const int usecs = recv_opts.poll_us;
+            if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) < 0) {
+                error("Setsockopt SO_BUSY_POLL failed with ERROR: " + std::string(strerror(errno)));
+                throw std::runtime_error("Setsockopt SO_BUSY_POLL failed");
+            }
+        }
+    }
+
+    inline int64_t read(char *buf, const size_t len) {
+        switch (recv_opts.strategy) {
+        case RecvStrategy::SPIN:
+            return spinRead(buf, len);
+        case RecvStrategy::HYBRID:
+            return hybridRead(buf, len);
+        default:
+            return ::read(fd, buf, len);
+        }
+    }
+
+    inline int64_t readall(char *buf, const size_t len) {
+        size_t total = 0;
+        while (total < len) {
+            const int64_t n = read(buf + total, len - total);
+            if (n <= 0) [[unlikely]] { return n; }
+            total += n;
+            if (total < len) stats.partial_reads++;
+        }
+        return total;
+    }
+
+    inline int64_t roundtrip(const char *req, const size_t req_len, char *rsp, const size_t rsp_len) {
+        if (::send(fd, req, req_len, 0) != (ssize_t) req_len) [[unlikely]] {
+            error("Send failed. Error: " + std::string(strerror(errno)));
+            throw std::runtime_error("Send failed");
+        }
+        return read(rsp, rsp_len);
+    }
+
+    inline int64_t roundtripAll(const char *req, const size_t req_len, char *rsp, const size_t rsp_len) {
+        if (sendall(req, req_len) != (int64_t) req_len) [[unlikely]] {
+            error("Send failed. Error: " + std::string(strerror(errno)));
+            throw std::runtime_error("Send failed");
+        }
+        return readall(rsp, rsp_len);
+    }
+
+    inline int64_t write(const char *buf, const size_t len) {
+        return sendall(buf, len);
+    }
+
+private:
+    inline int64_t sendall(const char *buf, const size_t len) {
+        size_t total = 0;
+        while (total < len) {
+            const ssize_t n = ::send(fd, buf + total, len - total, 0);
+            if (n <= 0) [[unlikely]] { return n; }
+            total += n;
+            if (total < len) stats.partial_writes++;
+        }
+        return total;
+    }
+};
+
+#if HAVE_IO_URING
+
+// send and receive are submitted as one linked SQE pair, i.e. one io_uring_enter per roundtrip
+// (none with SQPOLL). Partial transfers are resubmitted until the requested amount is reached.
+class UringTransport
+{
+private:
+    static constexpr uint64_t TAG_SEND = 1;
+    static constexpr uint64_t TAG_RECV = 2;
+
+    IoUring ring;
+    const UringOptions opts;
+    int fd_ref;          // fd as seen by the sqe: registered index 0 or the raw fd
+    struct iovec bufs[2];  // 0: send buffer, 1: receive buffer (only with register_buffers)
+    bool send_failed = false;  // the last transfer returned -1 because its send failed
+
+    inline int bufIndex(const char *ptr, const size_t len) const {
+        if (!opts.register_buffers) return -1;
+        for (int i = 0; i < 2; i++) {
+            const char *base = static_cast<const char*>(bufs[i].iov_base);
+            if (ptr >= base && ptr + len <= base + bufs[i].iov_len) return i;
+        }
+        return -1;
+    }
+
+    inline void prepSend(const char *buf, const size_t len, const bool link) {
+        struct io_uring_sqe *sqe = ring.getSqe();
+        const int idx = bufIndex(buf, len);
+        if (idx >= 0) {
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            sqe->buf_index = idx;
+        } else {
+            sqe->opcode = IORING_OP_SEND;
+            sqe->msg_flags = MSG_WAITALL;
+        }
+        sqe->fd = fd_ref;
+        sqe->addr = (uint64_t) buf;
+        sqe->len = len;
+        sqe->user_data = TAG_SEND;
+        if (opts.register_fd) sqe->flags |= IOSQE_FIXED_FILE;
+        if (link) sqe->flags |= IOSQE_IO_LINK;
+    }
+
+    inline void prepRecv(char *buf, const size_t len, const bool exact) {
+        struct io_uring_sqe *sqe = ring.getSqe();
+        const int idx = bufIndex(buf, len);
+        if (idx >= 0) {
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->buf_index = idx;
+        } else {
+            sqe->opcode = IORING_OP_RECV;
+            sqe->msg_flags = exact ? MSG_WAITALL : 0;
+        }
+        sqe->fd = fd_ref;
+        sqe->addr = (uint64_t) buf;
+        sqe->len = len;
+        sqe->user_data = TAG_RECV;
+        if (opts.register_fd) sqe->flags |= IOSQE_FIXED_FILE;
+    }
+
+    // generic state machine: (re)submit whatever is missing until sent == req_len and rcvd >= need.
+    // A failed send returns -1 with errno set (see send_failed), like sendall of the blocking transport.
+    inline int64_t transfer(const char *req, const size_t req_len, char *rsp, const size_t rsp_len, const bool exact) {
+        const size_t need = exact ? rsp_len : 1;
+        size_t sent = 0, rcvd = 0;
+        unsigned inflight = 0;
+        send_failed = false;
+
+        while (sent < req_len || rcvd < need)
+        {
+            if (inflight == 0) {
+                const bool do_send = sent < req_len;
+                const bool do_recv = rcvd < need;
+                if (do_send) prepSend(req + sent, req_len - sent, do_recv);
+                if (do_recv) prepRecv(rsp + rcvd, exact ? rsp_len - rcvd : rsp_len, exact);
+                inflight = do_send + do_recv;
+                if (ring.submitAndWait(inflight, inflight) < 0) [[unlikely]] {
+                    error("io_uring_enter failed with ERROR: " + std::string(strerror(errno)));
+                    return -1;
+                }
+            }
+
+            struct io_uring_cqe *cqe = ring.waitCqe();
+            if (cqe == nullptr) [[unlikely]] return -1;
+            const uint64_t tag = cqe->user_data;
+            const int res = cqe->res;
+            ring.cqeSeen();
+            inflight--;
+
+            if (tag == TAG_SEND) {
+                if (res < 0) [[unlikely]] {
+                    // the linked recv completes with -ECANCELED, reap it so the next transfer starts clean
+                    for (; inflight > 0; inflight--) {
+                        if (ring.waitCqe() == nullptr) break;
+                        ring.cqeSeen();
+                    }
+                    errno = -res;
+                    send_failed = true;
+                    return -1;
+                }
+                sent += res;
+                if (sent < req_len) stats.partial_writes++;
+            } else {
+                if (res == -ECANCELED) continue;  // short send broke the link, resubmitted above
+                if (res <= 0) [[unlikely]] {
+                    errno = -res;
+                    return res;
+                }
+                rcvd += res;
+                if (rcvd < need) stats.partial_reads++;
+            }
+        }
+        return rcvd;
+    }
+
+public:
+    const int fd;
+    IoStats stats;
+
+    UringTransport(const int fd, const UringOptions &opts, char *send_buf, const size_t send_len, char *recv_buf, const size_t recv_len) :
+        ring(8, opts.sqpoll, opts.sqpoll_idle_ms), opts(opts), fd_ref(fd), bufs(), fd(fd)
+    {
+        if (opts.register_fd) {
+            if (ring.registerFiles(&fd, 1) < 0) {
+                error("io_uring register files failed with ERROR: " + std::string(strerror(errno)));
+                throw std::runtime_error("io_uring register files failed");
+            }
+            fd_ref = 0;
+        }
+
+        if (opts.register_buffers) {
+            bufs[0] = { send_buf, send_len };
+            bufs[1] = { recv_buf, recv_len };
+            if (ring.registerBuffers(bufs, 2) < 0) {
+                error("io_uring register buffers failed with ERROR: " + std::string(strerror(errno)));
+                throw std::runtime_error("io_uring register buffers failed");
+            }
+        }
+    }
+
+    inline int64_t read(char *buf, const size_t len) {
+        return transfer(nullptr, 0, buf, len, false);
+    }
+
+    inline int64_t readall(char *buf, const size_t len) {
+        return transfer(nullptr, 0, buf, len, true);
+    }
+
+    inline int64_t roundtrip(const char *req, const size_t req_len, char *rsp, const size_t rsp_len) {
+        const int64_t n = transfer(req, req_len, rsp, rsp_len, false);
+        if (send_failed) [[unlikely]] {
+            error("Send failed. Error: " + std::string(strerror(errno)));
+            throw std::runtime_error("Send failed");
+        }
+        return n;
+    }
+
+    inline int64_t roundtripAll(const char *req, const size_t req_len, char *rsp, const size_t rsp_len) {
+        const int64_t n = transfer(req, req_len, rsp, rsp_len, true);
+        if (send_failed) [[unlikely]] {
+            error("Send failed. Error: " + std::string(strerror(errno)));
+            throw std::runtime_error("Send failed");
+        }
+        return n;
+    }
+
+    inline int64_t write(const char *buf, const size_t len) {
+        return transfer(buf, len, nullptr, 0, true) < 0 ? -1 : (int64_t) len;
+    }
+};
+
+#endif  // HAVE_IO_URING
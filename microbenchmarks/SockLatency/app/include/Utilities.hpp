@@ -9,6 +9,9 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <ctime>
 
 namespace csv {
 
@@ -41,27 +44,36 @@ void write_csv(output &out, First first, Args... args) {
 
 }  // csv
 
-namespace tyme {
+// spin-wait hint for busy loops
+static __inline__ void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+   __builtin_ia32_pause();
+#elif defined(__aarch64__)
+   asm volatile("yield");
+#endif
+}
 
-   // CPU frequency on sgx06. 2.2 GHz. Pls change this value if you are running on a different machine!
-   const float CPU_FREQUENCY = 2.9e9;
-   const float CPU_FREQUENCY_kHZ = CPU_FREQUENCY / 1e3;
-   const float CPU_FREQUENCY_MHZ = CPU_FREQUENCY / 1e6;
-   const float CPU_FREQUENCY_GHZ = CPU_FREQUENCY / 1e9;
+// cpu time [s] of a cpu-time clock, by default the one of the calling thread (CLOCK_PROCESS_CPUTIME_ID: all threads)
+inline double cpu_clock_sec(const clockid_t clock = CLOCK_THREAD_CPUTIME_ID) {
+   struct timespec ts;
+   clock_gettime(clock, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
-   static __inline__ float cycles_to_nanoseconds(uint64_t cycles) {
-      return cycles / CPU_FREQUENCY_GHZ;
-   }
-   static __inline__ float cycles_to_microseconds(uint64_t cycles) {
-      return cycles / CPU_FREQUENCY_MHZ;
-   }
-   static __inline__ float cycles_to_milliseconds(uint64_t cycles) {
-      return cycles / CPU_FREQUENCY_kHZ;
-   }
-   static __inline__ float cycles_to_seconds(uint64_t cycles) {
-      return cycles / CPU_FREQUENCY;
-   }
-}  // tyme
+// CLOCK_MONOTONIC [ns], the timebase shared by client and server timestamps
+inline uint64_t monotonic_ns() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// pin the calling thread to a single core, returns 0 on success
+inline int pin_to_cpu(const int cpu) {
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
 
 inline
 int64_t sendall(int sock, std::string &msg) {
@@ -1,13 +1,31 @@
 #pragma once
 
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <stdexcept>
 
+// raw protocol: messages above this size are read completely (readall) instead of with a single read
 constexpr size_t THRESH_LARGE_MSG = 1024;
 
+// reply to the handshake, read completely by the client before the measurement starts
+constexpr char SERVER_HELLO[] = "Hello from server";
+constexpr size_t SERVER_HELLO_LEN = sizeof(SERVER_HELLO) - 1;
+
+// Config update over an established connection (sweeps): the marker followed by a ServerDynamicConfig,
+// sent by the client while no request is outstanding and acknowledged with SERVER_HELLO.
+// Requests (raw payloads and frames) never start with the marker.
+constexpr char CONFIG_UPDATE_MARKER = '\0';
+
 enum SocketProtocol {
     INET,
-    VSOCK
+    VSOCK,
+    UNIX,           // local IPC baseline: unix domain stream socket
+    UNIX_SEQPACKET, // unix domain socket that keeps message boundaries
+    SHM             // shared-memory rings, set up over a unix stream control socket
 };
 
 // adress family conversion
@@ -19,11 +37,36 @@ int af_from_enum(const SocketProtocol protocol)
         return AF_INET;
     case VSOCK:
         return AF_VSOCK;
+    case UNIX:
+    case UNIX_SEQPACKET:
+    case SHM:
+        return AF_UNIX;
     default:
         return -1;
     }
 }
 
+// socket type conversion
+int socktype_from_enum(const SocketProtocol protocol)
+{
+    return protocol == UNIX_SEQPACKET ? SOCK_SEQPACKET : SOCK_STREAM;
+}
+
+// unix socket address of a path, a leading '@' names a socket in the abstract namespace (no file)
+socklen_t unix_sockaddr(const std::string &path, struct sockaddr_un &addr)
+{
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        throw std::invalid_argument("Invalid unix socket path: " + path);
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    if (path[0] == '@') {
+        addr.sun_path[0] = '\0';
+        return offsetof(struct sockaddr_un, sun_path) + path.size();
+    }
+    return offsetof(struct sockaddr_un, sun_path) + path.size() + 1;
+}
+
 std::string to_string(const SocketProtocol protocol)
 {
     switch (protocol)
@@ -32,23 +75,205 @@ std::string to_string(const SocketProtocol protocol)
         return "inet";
     case VSOCK:
         return "vsock";
+    case UNIX:
+        return "unix";
+    case UNIX_SEQPACKET:
+        return "unix_seqpacket";
+    case SHM:
+        return "shm";
     default:
         return "unknown";
     }
 }
 
+SocketProtocol protocol_from_string(const std::string &str)
+{
+    if (str == "inet") {
+        return SocketProtocol::INET;
+    } else if (str == "vsock") {
+        return SocketProtocol::VSOCK;
+    } else if (str == "unix") {
+        return SocketProtocol::UNIX;
+    } else if (str == "unix_seqpacket") {
+        return SocketProtocol::UNIX_SEQPACKET;
+    } else if (str == "shm") {
+        return SocketProtocol::SHM;
+    } else {
+        throw std::runtime_error("Invalid protocol");
+    }
+}
+
 std::ostream& operator<<(std::ostream& os, const SocketProtocol& protocol) {
     os << to_string(protocol);
     return os;
 }
 
+// traffic pattern of a connection, negotiated in the handshake
+enum Workload {
+    LATENCY,  // request/response roundtrips
+    SEND,     // bandwidth: client streams req_size messages to the server
+    RECV,     // bandwidth: server streams rsp_size messages to the client
+    BIDIR,    // bandwidth: both directions at once (full duplex)
+    SCAN      // client streams columnar batches, the server filters and aggregates them and returns the aggregates (Columnar.hpp)
+};
+
+std::string to_string(const Workload workload)
+{
+    switch (workload)
+    {
+    case LATENCY:
+        return "latency";
+    case SEND:
+        return "send";
+    case RECV:
+        return "recv";
+    case BIDIR:
+        return "bidir";
+    case SCAN:
+        return "scan";
+    default:
+        return "unknown";
+    }
+}
+
+Workload workload_from_string(const std::string &str)
+{
+    if (str == "latency") {
+        return Workload::LATENCY;
+    } else if (str == "send") {
+        return Workload::SEND;
+    } else if (str == "recv") {
+        return Workload::RECV;
+    } else if (str == "bidir") {
+        return Workload::BIDIR;
+    } else if (str == "scan") {
+        return Workload::SCAN;
+    } else {
+        throw std::runtime_error("Invalid workload");
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const Workload& workload) {
+    os << to_string(workload);
+    return os;
+}
+
+// authenticated encryption of requests and responses (Sealing.hpp), negotiated in the handshake
+enum SealCipher {
+    PLAINTEXT,    // no record layer
+    AES_128_GCM,
+    AES_256_GCM
+};
+
+std::string to_string(const SealCipher seal)
+{
+    switch (seal)
+    {
+    case PLAINTEXT:
+        return "none";
+    case AES_128_GCM:
+        return "aes-128-gcm";
+    case AES_256_GCM:
+        return "aes-256-gcm";
+    default:
+        return "unknown";
+    }
+}
+
+SealCipher seal_cipher_from_string(const std::string &str)
+{
+    if (str == "none") {
+        return SealCipher::PLAINTEXT;
+    } else if (str == "aes-128-gcm") {
+        return SealCipher::AES_128_GCM;
+    } else if (str == "aes-256-gcm") {
+        return SealCipher::AES_256_GCM;
+    } else {
+        throw std::runtime_error("Invalid seal cipher");
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const SealCipher& seal) {
+    os << to_string(seal);
+    return os;
+}
+
+// compression of the bulk streams of the bandwidth workloads (Compression.hpp), negotiated in the handshake
+enum CompressionCodec {
+    UNCOMPRESSED,
+    LZ4,   // lz4 fast (levels <= 2, negative levels raise the acceleration) or lz4hc (levels 3-12)
+    ZSTD
+};
+
+std::string to_string(const CompressionCodec codec)
+{
+    switch (codec)
+    {
+    case UNCOMPRESSED:
+        return "none";
+    case LZ4:
+        return "lz4";
+    case ZSTD:
+        return "zstd";
+    default:
+        return "unknown";
+    }
+}
+
+CompressionCodec compression_codec_from_string(const std::string &str)
+{
+    if (str == "none") {
+        return CompressionCodec::UNCOMPRESSED;
+    } else if (str == "lz4") {
+        return CompressionCodec::LZ4;
+    } else if (str == "zstd") {
+        return CompressionCodec::ZSTD;
+    } else {
+        throw std::runtime_error("Invalid compression codec");
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const CompressionCodec& codec) {
+    os << to_string(codec);
+    return os;
+}
+
 struct ServerDynamicConfig {
     size_t buf_size;
     size_t rsp_size;
     size_t req_size;
+    Workload workload;
+    bool timestamps;  // stamp ServerTimestamps into the head of every response (rsp_size >= sizeof(ServerTimestamps))
+    bool framed;      // requests and responses are frames (Framing.hpp), otherwise raw req_size/rsp_size messages
+    SealCipher seal;            // sealed: req_size/rsp_size plaintext bytes travel as AES-GCM records (Sealing.hpp)
+    uint32_t seal_record_size;  // sealed: plaintext bytes per record, larger messages are split, 0: one record per message
+    uint8_t seal_key[32];       // sealed: session key, sent in the clear (key establishment is not part of the benchmark)
+    CompressionCodec compression;  // bandwidth workloads: the streams travel as compressed chunks (Compression.hpp)
+    int32_t compression_level;
+    uint32_t compression_chunk;    // compressed: raw bytes per chunk
+    uint32_t compression_depth;    // compressed: chunks compressed ahead of the sender (2: double buffering)
+    uint32_t compressibility;      // compressed: percentage of zeros in every 4 KiB block of the sent data
+    uint32_t scan_batch_rows;      // scan: rows per batch
+    uint32_t scan_buffers;         // scan: receive buffers of the server (2: double buffering)
+    uint32_t scan_groups;          // scan: groups of the generated rows
+    uint32_t scan_threshold;       // scan: filter key < scan_threshold
+    uint32_t scan_simd;            // scan: SimdLevel of the filter on the server
 
     std::string to_string() const {
         return "ServerDynamicConfig{ buf_size: " + std::to_string(buf_size) + 
-               ", rsp_size: " + std::to_string(rsp_size) + ", req_size: " + std::to_string(req_size) + " }";
+               ", rsp_size: " + std::to_string(rsp_size) + ", req_size: " + std::to_string(req_size) +
+               ", workload: " + ::to_string(workload) + ", timestamps: " + std::to_string(timestamps) +
+               ", framed: " + std::to_string(framed) + ", seal: " + ::to_string(seal) +
+               ", seal_record_size: " + std::to_string(seal_record_size) + ", compression: " + ::to_string(compression) +
+               ", compression_level: " + std::to_string(compression_level) + ", compression_chunk: " + std::to_string(compression_chunk) +
+               ", compression_depth: " + std::to_string(compression_depth) + ", compressibility: " + std::to_string(compressibility) +
+               ", scan_batch_rows: " + std::to_string(scan_batch_rows) + ", scan_buffers: " + std::to_string(scan_buffers) +
+               ", scan_groups: " + std::to_string(scan_groups) + ", scan_threshold: " + std::to_string(scan_threshold) + " }";
     }
 };
+
+// server-side timestamps of a roundtrip [ns, CLOCK_MONOTONIC of the server]
+struct ServerTimestamps {
+    uint64_t request_rcvd;   // request read completely
+    uint64_t response_sent;  // response about to be sent
+};
@@ -7,20 +7,59 @@
 #include "gflags/gflags.h"
 
 #include "myTypes.h"
+#include "Transport.hpp"
 
 
-DEFINE_int32(port, 5005, "Port number to listen on or request to connect to");
-DEFINE_string(address, "127.0.0.1", "Address to listen on or request to connect to");
-DEFINE_string(protocol, "inet", "Socket protocol to use (inet or vsock)");
+DEFINE_int32(port, 5005, "Port number to listen on or request to connect to (ignored by unix sockets)");
+DEFINE_string(address, "127.0.0.1", "Address (inet), cid (vsock) or socket path (unix, shm control socket, '@' prefix: abstract namespace) to listen on or request to connect to");
+DEFINE_string(protocol, "inet", "Socket protocol to use (inet, vsock, unix, unix_seqpacket or shm)");
 DEFINE_uint32(buf_size, 1024, "Size of the read buffer");
 // DEFINE_uint32(msg_size, 64, "The message size to send");
+DEFINE_string(io, "blocking", "I/O backend of the measurement loops (blocking or uring)");
+DEFINE_bool(uring_sqpoll, false, "io_uring: use a kernel submission polling thread and poll completions (io=uring only)");
+DEFINE_uint32(uring_sqpoll_idle_ms, 1000, "io_uring: idle time before the submission polling thread sleeps");
+DEFINE_bool(uring_register_fd, true, "io_uring: register the socket as fixed file");
+DEFINE_bool(uring_register_buffers, true, "io_uring: register the send/receive buffers (READ_FIXED/WRITE_FIXED)");
+DEFINE_string(recv_strategy, "blocking", "How reads wait for data (io=blocking only): blocking, spin (non-blocking reads in a loop), busy_poll (SO_BUSY_POLL) or hybrid (spin, then block). shm: futex, spin on the ring or hybrid");
+DEFINE_uint32(recv_poll_us, 50, "hybrid: spin time before a read blocks, busy_poll: SO_BUSY_POLL time [us]");
+DEFINE_bool(perf_counters, false, "Count cycles, instructions, cache misses (perf_event_open), page faults and context switches of the measurement loops");
 
 SocketProtocol getProtocol() {
-    if (FLAGS_protocol == "inet") {
-        return SocketProtocol::INET;
-    } else if (FLAGS_protocol == "vsock") {
-        return SocketProtocol::VSOCK;
+    return protocol_from_string(FLAGS_protocol);
+}
+
+
+IoBackend getIoBackend() {
+    if (FLAGS_io == "blocking") {
+        return IoBackend::BLOCKING;
+    } else if (FLAGS_io == "uring") {
+        #if HAVE_IO_URING
+        return IoBackend::URING;
+        #else
+        throw std::runtime_error("io_uring backend not available in this build");
+        #endif
+    } else {
+        throw std::runtime_error("Invalid io backend");
+    }
+}
+
+UringOptions getUringOptions() {
+    return UringOptions{ FLAGS_uring_sqpoll, FLAGS_uring_sqpoll_idle_ms, FLAGS_uring_register_fd, FLAGS_uring_register_buffers };
+}
+
+RecvOptions getRecvOptions() {
+    RecvOptions opts;
+    if (FLAGS_recv_strategy == "blocking") {
+        opts.strategy = RecvStrategy::BLOCKING;
+    } else if (FLAGS_recv_strategy == "spin") {
+        opts.strategy = RecvStrategy::SPIN;
+    } else if (FLAGS_recv_strategy == "busy_poll") {
+        opts.strategy = RecvStrategy::BUSY_POLL;
+    } else if (FLAGS_recv_strategy == "hybrid") {
+        opts.strategy = RecvStrategy::HYBRID;
     } else {
-        throw std::runtime_error("Invalid protocol");
+        throw std::runtime_error("Invalid receive strategy");
     }
+    opts.poll_us = FLAGS_recv_poll_us;
+    return opts;
 }
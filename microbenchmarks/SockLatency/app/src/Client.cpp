@@ -7,6 +7,17 @@
 #include "algorithm"
 #include "fstream"
 #include "sstream"
+#include "thread"
+#include "atomic"
+#include "random"
+#include "filesystem"
+#include "latch"
+#include "array"
+#include <ctime>
+#include <limits>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
 #include <netinet/tcp.h> // For TCP_MAXSEG
 
 
@@ -26,17 +37,80 @@ DEFINE_double(timeout_sec, 0, "Timeout in seconds for the experiment to run. Che
 DEFINE_bool(output_outliers, false, "Output outliers in the results");
 DEFINE_string(outfile, "", "Output file for results");
 DEFINE_bool(print_header, true, "Print header in output file");
+DEFINE_string(arrival, "closed", "Request schedule: closed (ping-pong), or open loop with constant or poisson inter-arrival times");
+DEFINE_string(rates, "1000", "Open loop only: comma-separated target request rates [req/s], one output row per rate step");
+DEFINE_double(step_duration_sec, 5.0, "Open loop only: duration of each rate step (capped by num_samples)");
+DEFINE_uint64(arrival_seed, 42, "Seed of the poisson arrival process (open loop) and of generated replay workloads");
+DEFINE_string(recorder, "vector", "Latency recorder: vector (all samples, exact) or hdr (constant-memory HDR histogram)");
+DEFINE_int32(hdr_digits, 3, "Significant decimal digits of the HDR histogram (1-5)");
+DEFINE_string(pipeline_depths, "", "Closed loop only: comma-separated numbers of outstanding requests, one output row per depth. Empty: ping-pong");
+DEFINE_uint32(connections, 1, "Number of concurrent connections to the server (requires a concurrent server, e.g. --server_mode=epoll)");
+DEFINE_uint32(threads, 0, "Number of client threads driving the connections round-robin, 0: one thread per connection");
+DEFINE_string(cpus, "", "Comma-separated cores to pin the client threads to (thread i on cpus[i % n]), empty: no pinning");
+DEFINE_string(workload, "latency", "Traffic pattern: latency (roundtrips), or bandwidth streaming in direction send (client to server), recv (server to client) or bidir. Streams run for timeout_sec (default 10s)");
+DEFINE_string(timer, "auto", "Timer of the closed-loop measurement: tsc (calibrated time stamp counter), clock (steady_clock), or auto (tsc if invariant and stable, otherwise clock)");
+DEFINE_bool(timestamps, false, "Split each roundtrip into request path, server dwell and response path via server timestamps (single closed-loop connection, server_rsp_size >= 16)");
+DEFINE_uint32(sync_rounds, 1000, "Timestamps only: roundtrips to estimate the clock offset to the server after the handshake");
+DEFINE_bool(framed, false, "Framed wire protocol: requests carry a header with their size and the requested response size, msg_size and server_rsp_size are frame sizes incl. the 16-byte header. Closed loop, one connection per thread");
+DEFINE_string(sweep_sizes, "", "Closed loop only: comma-separated message sizes [B] or doubling ranges lo..hi, measured over one connection with a config update per step, one output row per size. Empty: no sweep");
+DEFINE_string(sweep_vary, "both", "Sweep only: size that varies per step: req (server_rsp_size fixed), rsp (msg_size fixed), or both");
+DEFINE_string(replay_trace, "", "Replay a trace file of req_size,rsp_size,gap_us lines, cycled up to num_samples requests. Framed protocol, one output row per size class");
+DEFINE_string(replay_mix, "", "Replay num_samples requests drawn from weighted size classes req_size:rsp_size:weight,... Framed protocol, one output row per size class");
+DEFINE_double(replay_gap_us, 0, "Replay mix only: mean of the exponentially distributed inter-arrival gaps [us], 0: back-to-back");
+DEFINE_string(histogram_outfile, "", "Output file for the latency histograms (one row per non-empty bucket), can be merged offline");
+DEFINE_uint64(shm_ring_size, 1 << 20, "shm: capacity of each ring (requests and responses) in bytes, rounded up to a power of two");
+DEFINE_bool(shm_hugepages, false, "shm: back the rings with huge pages (MFD_HUGETLB, requires reserved huge pages)");
+DEFINE_string(raw_outfile, "", "Binary output file for the raw samples (completion timestamp, latency, sizes and connection of every sample), appended per run. See plot/raw_samples.py");
+DEFINE_string(variant, "", "Label of the measured setup in the variant column, e.g. the proxy configuration in front of the server");
+DEFINE_string(seal, "none", "Record layer of requests and responses: none (plaintext), aes-128-gcm or aes-256-gcm. msg_size and server_rsp_size are plaintext sizes. Single closed-loop connection, raw protocol, serial server");
+DEFINE_uint32(seal_record_size, 0, "Sealed only: plaintext bytes per record, larger messages are sealed as a batch of records and opened record by record, 0: one record per message");
+DEFINE_string(compression, "none", "Bandwidth workloads only: stream compressed chunks of synthetic data, none, lz4 or zstd (if found at build time). The sender compresses on a worker thread, the receiver decompresses. Serial server");
+DEFINE_int32(compression_level, 1, "Compressed only: codec level, lz4: <= 2 fast (negative: higher acceleration), 3-12 lz4hc; zstd: negative (fast) to 22");
+DEFINE_uint32(compression_chunk, 64 << 10, "Compressed only: raw bytes per compressed chunk");
+DEFINE_uint32(compression_depth, 2, "Compressed only: chunks compressed ahead of the sending thread (2: double buffering)");
+DEFINE_uint32(compressibility, 50, "Compressed only: percentage of zeros in every 4 KiB block of the sent data (fio's buffer_compress_percentage), the rest is random");
+DEFINE_string(scan_batch_rows, "65536", "Scan workload only: comma-separated rows per columnar batch, one output row per batch size, each streamed over a fresh connection for timeout_sec (default 10s)");
+DEFINE_uint32(scan_buffers, 2, "Scan only: receive buffers of the server, 1: receive and compute alternate, 2: double, 3: triple buffering");
+DEFINE_double(scan_selectivity, 0.5, "Scan only: fraction of the rows passing the filter");
+DEFINE_uint32(scan_groups, 64, "Scan only: groups of the aggregation (uniformly distributed over the rows)");
+DEFINE_string(scan_simd, "auto", "Scan only: filter kernel of the server, auto (widest supported by the server cpu), scalar, avx2 or avx512");
 
 // argument parsing
 
 struct ExperimentConfig {
     SocketProtocol protocol;
+    IoBackend io;
+    RecvOptions recv;
+    TimerCalibration timer;
+    ArrivalProcess arrival;
+    std::vector<double> rates;  // open loop rate steps
+    double target_rate;         // rate of the current step, 0 in closed loop
+    double step_duration_sec;
     ServerDynamicConfig server_config;
     ClientConfig client_config;
     size_t num_samples;
     size_t num_warmup_rounds;
     double perc_warmup_rounds;
     double timeout_sec;
+    RecorderType recorder;
+    int hdr_digits;
+    size_t connections;
+    size_t threads;
+    std::vector<int> cpus;   // thread pinning, empty: no pinning
+    std::string connection;  // connection id of the result row, "all" for aggregated results
+    std::vector<size_t> pipeline_depths;  // pipelined steps, empty: ping-pong
+    std::vector<size_t> sweep_sizes;      // sweep steps, empty: no sweep
+    SweepVary sweep_vary;
+    std::shared_ptr<const std::vector<TraceEntry>> replay;  // replayed requests, null: fixed sizes
+    std::string size_class;  // replay: size class req:rsp (power-of-two bounds) of the result row, "all" for aggregated results
+    size_t pipeline_depth;                // outstanding requests of the current step
+    size_t sync_rounds;      // timestamps: clock offset estimation roundtrips
+    std::string component;   // latency component of the result row: rtt, or request/dwell/response (timestamps)
+    std::string variant;     // label of the setup between client and server, e.g. a proxy configuration
+    std::vector<double> scan_batch_rows;  // scan steps
+    double scan_selectivity;
+
+    WarmupPolicy warmup() const { return { num_warmup_rounds, perc_warmup_rounds }; }
 
     std::string to_string() const;
     static std::string csv_header();
@@ -45,17 +119,233 @@ struct ExperimentConfig {
     friend std::ostream& operator<<(std::ostream& os, const ExperimentConfig& config);
 };
 
+ArrivalProcess getArrivalProcess() {
+    if (FLAGS_arrival == "closed") {
+        return ArrivalProcess::CLOSED;
+    } else if (FLAGS_arrival == "constant") {
+        return ArrivalProcess::CONSTANT;
+    } else if (FLAGS_arrival == "poisson") {
+        return ArrivalProcess::POISSON;
+    } else {
+        throw std::runtime_error("Invalid arrival process");
+    }
+}
+
+RecorderType getRecorderType() {
+    if (FLAGS_recorder == "vector") {
+        return RecorderType::VECTOR;
+    } else if (FLAGS_recorder == "hdr") {
+        return RecorderType::HDR;
+    } else {
+        throw std::runtime_error("Invalid recorder");
+    }
+}
+
+SweepVary getSweepVary() {
+    if (FLAGS_sweep_vary == "req") {
+        return SweepVary::REQ;
+    } else if (FLAGS_sweep_vary == "rsp") {
+        return SweepVary::RSP;
+    } else if (FLAGS_sweep_vary == "both") {
+        return SweepVary::BOTH;
+    } else {
+        throw std::runtime_error("Invalid sweep vary");
+    }
+}
+
+// comma-separated sizes, lo..hi expands to lo, 2*lo, 4*lo, ... up to hi
+std::vector<size_t> parseSizes(const std::string &str) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.empty()) continue;
+        const size_t range = item.find("..");
+        if (range == std::string::npos) {
+            sizes.push_back(std::stoull(item));
+            continue;
+        }
+        const size_t lo = std::stoull(item.substr(0, range));
+        const size_t hi = std::stoull(item.substr(range + 2));
+        if (lo == 0 || hi < lo)
+            throw std::invalid_argument("Invalid size range " + item);
+        for (size_t size = lo; size <= hi; size *= 2)
+            sizes.push_back(size);
+    }
+    return sizes;
+}
+
+std::vector<double> parseList(const std::string &str) {
+    std::vector<double> values;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty()) values.push_back(std::stod(item));
+    return values;
+}
+
 void parseExperimentConfig(ExperimentConfig &config) {
     config.protocol = getProtocol();
+    config.io = getIoBackend();
+    config.recv = getRecvOptions();
+    config.timer = calibrate_timer(timer_source_from_string(FLAGS_timer));
+    logger("Timer: " + to_string(config.timer.source) + ", " + std::to_string(config.timer.ticks_per_us) + " ticks/us, overhead " + std::to_string(config.timer.overhead_ns) + " ns");
+    config.arrival = getArrivalProcess();
+    config.rates = parseList(FLAGS_rates);
+    config.target_rate = 0;
+    config.step_duration_sec = FLAGS_step_duration_sec;
     config.server_config.buf_size = FLAGS_server_buf_size;
     config.server_config.rsp_size = FLAGS_server_rsp_size;
     config.server_config.req_size = FLAGS_msg_size;
+    config.server_config.workload = workload_from_string(FLAGS_workload);
+    config.server_config.timestamps = FLAGS_timestamps;
+    config.server_config.framed = FLAGS_framed;
+    config.server_config.seal = seal_cipher_from_string(FLAGS_seal);
+    config.server_config.seal_record_size = FLAGS_seal_record_size;
+    config.server_config.compression = compression_codec_from_string(FLAGS_compression);
+    config.server_config.compression_level = FLAGS_compression_level;
+    config.server_config.compression_chunk = FLAGS_compression_chunk;
+    config.server_config.compression_depth = FLAGS_compression_depth;
+    config.server_config.compressibility = FLAGS_compressibility;
+    config.scan_batch_rows = parseList(FLAGS_scan_batch_rows);
+    config.scan_selectivity = FLAGS_scan_selectivity;
+    config.server_config.scan_batch_rows = 0;  // set per step
+    config.server_config.scan_buffers = FLAGS_scan_buffers;
+    config.server_config.scan_groups = FLAGS_scan_groups;
+    config.server_config.scan_threshold = scan_threshold(FLAGS_scan_selectivity);
+    config.server_config.scan_simd = static_cast<uint32_t>(simd_level_from_string(FLAGS_scan_simd));
     config.client_config.buf_size = FLAGS_buf_size;
     config.client_config.msg_size = FLAGS_msg_size;
     config.num_samples = FLAGS_num_samples;
     config.num_warmup_rounds = FLAGS_num_warmup_rounds;
     config.perc_warmup_rounds = FLAGS_perc_warmup_rounds;
     config.timeout_sec = FLAGS_timeout_sec;
+    config.recorder = getRecorderType();
+    config.hdr_digits = FLAGS_hdr_digits;
+    config.connections = FLAGS_connections;
+    config.threads = FLAGS_threads ? FLAGS_threads : FLAGS_connections;
+    for (const double cpu : parseList(FLAGS_cpus))
+        config.cpus.push_back(static_cast<int>(cpu));
+    config.connection = "all";
+    for (const double depth : parseList(FLAGS_pipeline_depths))
+        config.pipeline_depths.push_back(static_cast<size_t>(depth));
+    config.pipeline_depth = 1;
+    config.sync_rounds = FLAGS_sync_rounds;
+    config.component = "rtt";
+    config.sweep_sizes = parseSizes(FLAGS_sweep_sizes);
+    config.sweep_vary = getSweepVary();
+    config.size_class = "all";
+    config.variant = FLAGS_variant;
+    if (config.variant.find_first_of(",\n") != std::string::npos)
+        throw std::invalid_argument("The variant label must not contain commas or newlines");
+
+    if (!config.sweep_sizes.empty()) {
+        if (config.server_config.workload != Workload::LATENCY || config.connections > 1 || config.threads > 1 || !config.cpus.empty()
+            || config.arrival != ArrivalProcess::CLOSED || !config.pipeline_depths.empty() || config.server_config.timestamps)
+            throw std::invalid_argument("Sweeps only support a single closed-loop connection without timestamps");
+
+        // both buffers hold the largest message of the sweep, so they are not reallocated between steps
+        const size_t max_size = *std::max_element(config.sweep_sizes.begin(), config.sweep_sizes.end());
+        const size_t min_size = *std::min_element(config.sweep_sizes.begin(), config.sweep_sizes.end());
+        if (min_size == 0)
+            throw std::invalid_argument("Sweep sizes must be greater than 0");
+        if (config.sweep_vary != SweepVary::RSP)
+            config.server_config.buf_size = std::max(config.server_config.buf_size, max_size);
+        if (config.sweep_vary != SweepVary::REQ)
+            config.client_config.buf_size = std::max(config.client_config.buf_size, max_size);
+        if (config.server_config.framed && min_size < sizeof(FrameHeader))
+            throw std::invalid_argument("The framed protocol requires sweep sizes >= " + std::to_string(sizeof(FrameHeader)));
+    }
+
+    if (config.server_config.timestamps) {
+        if (config.server_config.rsp_size < sizeof(ServerTimestamps))
+            throw std::invalid_argument("Timestamps require server_rsp_size >= " + std::to_string(sizeof(ServerTimestamps)));
+        if (config.server_config.workload != Workload::LATENCY || config.connections > 1 || config.threads > 1 || !config.cpus.empty()
+            || config.arrival != ArrivalProcess::CLOSED || !config.pipeline_depths.empty())
+            throw std::invalid_argument("Timestamps only support a single closed-loop connection");
+        if (config.sync_rounds == 0)
+            throw std::invalid_argument("Timestamps require sync_rounds > 0");
+    }
+
+    if (!FLAGS_replay_trace.empty() || !FLAGS_replay_mix.empty()) {
+        if (!FLAGS_replay_trace.empty() && !FLAGS_replay_mix.empty())
+            throw std::invalid_argument("Replay either a trace or a size mix");
+        if (!config.sweep_sizes.empty())
+            throw std::invalid_argument("Replay does not support sweeps");
+        std::vector<TraceEntry> entries = FLAGS_replay_trace.empty()
+            ? generate_trace(FLAGS_replay_mix, FLAGS_replay_gap_us, config.num_samples, FLAGS_arrival_seed)
+            : load_trace(FLAGS_replay_trace);
+
+        // per-request sizes need the framed protocol, the handshake announces the largest messages
+        uint32_t max_req = 0, max_rsp = 0;
+        for (const TraceEntry &entry : entries) {
+            max_req = std::max(max_req, entry.req_size);
+            max_rsp = std::max(max_rsp, entry.rsp_size);
+        }
+        config.server_config.framed = true;
+        config.server_config.req_size = max_req;
+        config.server_config.rsp_size = max_rsp;
+        config.client_config.msg_size = max_req;
+        config.client_config.buf_size = std::max<size_t>(config.client_config.buf_size, max_rsp);
+        config.replay = std::make_shared<const std::vector<TraceEntry>>(std::move(entries));
+        logger("Replaying " + std::to_string(config.replay->size()) + " requests, up to " + std::to_string(max_req) + " / " + std::to_string(max_rsp) + " bytes");
+    }
+
+    if (config.server_config.framed) {
+        if (config.client_config.msg_size < sizeof(FrameHeader) || config.server_config.rsp_size < sizeof(FrameHeader))
+            throw std::invalid_argument("The framed protocol requires msg_size and server_rsp_size >= " + std::to_string(sizeof(FrameHeader)));
+        if (config.server_config.timestamps)
+            throw std::invalid_argument("Timestamps require the raw protocol");
+        if (config.server_config.workload != Workload::LATENCY || config.arrival != ArrivalProcess::CLOSED || !config.pipeline_depths.empty()
+            || config.connections > config.threads)
+            throw std::invalid_argument("The framed protocol only supports closed-loop roundtrips with one connection per thread");
+    }
+
+    if (config.server_config.seal != SealCipher::PLAINTEXT) {
+        // the record numbers of a session key restart with every connection, i.e. one connection per key
+        if (config.server_config.framed || config.server_config.timestamps
+            || (config.server_config.workload != Workload::LATENCY && config.server_config.workload != Workload::SCAN)
+            || config.connections > 1 || config.threads > 1 || !config.cpus.empty() || config.arrival != ArrivalProcess::CLOSED || !config.pipeline_depths.empty())
+            throw std::invalid_argument("Sealed records only support a single closed-loop connection with the raw protocol");
+        if (config.server_config.workload == Workload::SCAN && config.server_config.seal_record_size != 0)
+            throw std::invalid_argument("Sealed scan batches travel as one record per batch, seal_record_size has to be 0");
+        seal_session_key(config.server_config);
+    }
+
+    if (config.server_config.compression != CompressionCodec::UNCOMPRESSED) {
+        if (!compression_supported(config.server_config.compression))
+            throw std::invalid_argument("Compression codec " + to_string(config.server_config.compression) + " is not supported by this build");
+        if (config.server_config.workload == Workload::LATENCY || config.server_config.workload == Workload::SCAN
+            || config.server_config.seal != SealCipher::PLAINTEXT)
+            throw std::invalid_argument("Compression requires a bandwidth workload without sealed records");
+        if (config.server_config.compression_chunk == 0 || config.server_config.compression_chunk > MAX_COMPRESSION_CHUNK
+            || config.server_config.compression_depth == 0 || config.server_config.compressibility > 100)
+            throw std::invalid_argument("Compression requires 0 < compression_chunk <= " + std::to_string(MAX_COMPRESSION_CHUNK) +
+                                        ", compression_depth > 0 and compressibility <= 100");
+    }
+
+    if (config.server_config.workload == Workload::SCAN) {
+        for (const double rows : config.scan_batch_rows)
+            if (rows < 1 || rows > MAX_BATCH_ROWS)
+                throw std::invalid_argument("scan_batch_rows must be in [1, " + std::to_string(MAX_BATCH_ROWS) + "]");
+        if (config.scan_batch_rows.empty() || config.server_config.scan_buffers == 0 || config.server_config.scan_groups == 0
+            || config.scan_selectivity < 0 || config.scan_selectivity > 1)
+            throw std::invalid_argument("The scan workload requires batch sizes, scan_buffers > 0, scan_groups > 0 and a selectivity in [0, 1]");
+    }
+}
+
+// config of the sweep step measuring size
+ExperimentConfig sweep_step(const ExperimentConfig &config, const size_t size)
+{
+    ExperimentConfig step = config;
+    if (config.sweep_vary != SweepVary::RSP) {
+        step.client_config.msg_size = size;
+        step.server_config.req_size = size;
+    }
+    if (config.sweep_vary != SweepVary::REQ)
+        step.server_config.rsp_size = size;
+    return step;
 }
 
 std::string ExperimentConfig::to_string() const {
@@ -70,13 +360,36 @@ std::string ExperimentConfig::to_string() const {
             << "num_samples: " << num_samples << ", "
             << "num_warmup_rounds: " << num_warmup_rounds << ", "
             << "num_warmup_rounds: " << num_warmup_rounds << ", "
-            << "timeout_sec: " << timeout_sec
+            << "timeout_sec: " << timeout_sec << ", "
+            << "io: " << io << ", "
+            << "arrival: " << arrival << ", "
+            << "target_rate: " << target_rate << ", "
+            << "recorder: " << recorder << ", "
+            << "hdr_digits: " << hdr_digits << ", "
+            << "connections: " << connections << ", "
+            << "threads: " << threads << ", "
+            << "connection: " << connection << ", "
+            << "workload: " << server_config.workload << ", "
+            << "pipeline_depth: " << pipeline_depth << ", "
+            << "recv_strategy: " << recv.strategy << ", "
+            << "recv_poll_us: " << recv.poll_us << ", "
+            << "timer: " << timer.source << ", "
+            << "component: " << component << ", "
+            << "framed: " << server_config.framed << ", "
+            << "size_class: " << size_class << ", "
+            << "variant: " << variant << ", "
+            << "seal: " << server_config.seal << ", "
+            << "seal_record_size: " << server_config.seal_record_size << ", "
+            << "compression: " << server_config.compression << ", "
+            << "compression_level: " << server_config.compression_level << ", "
+            << "compression_chunk: " << server_config.compression_chunk << ", "
+            << "compressibility: " << server_config.compressibility
         << " }";
     return oss.str();
 }
 
 std::string ExperimentConfig::csv_header() {
-    return "protocol,server.buf_size,server.rsp_size,client.buf_size,client.msg_size,num_samples,num_warmup_rounds,timeout_sec";
+    return "protocol,server.buf_size,server.rsp_size,client.buf_size,client.msg_size,num_samples,num_warmup_rounds,timeout_sec,io,arrival,target_rate,recorder,connections,threads,connection,workload,pipeline_depth,recv_strategy,recv_poll_us,timer,component,framed,size_class,variant,seal,seal_record_size,compression,compression_level,compression_chunk,compressibility";
 }
 
 std::string ExperimentConfig::to_csv() const {
@@ -88,7 +401,29 @@ std::string ExperimentConfig::to_csv() const {
         << client_config.msg_size << ","
         << num_samples << ","
         << num_warmup_rounds << ","
-        << timeout_sec;
+        << timeout_sec << ","
+        << io << ","
+        << arrival << ","
+        << target_rate << ","
+        << recorder << ","
+        << connections << ","
+        << threads << ","
+        << connection << ","
+        << server_config.workload << ","
+        << pipeline_depth << ","
+        << recv.strategy << ","
+        << recv.poll_us << ","
+        << timer.source << ","
+        << component << ","
+        << server_config.framed << ","
+        << size_class << ","
+        << variant << ","
+        << server_config.seal << ","
+        << server_config.seal_record_size << ","
+        << server_config.compression << ","
+        << server_config.compression_level << ","
+        << server_config.compression_chunk << ","
+        << server_config.compressibility;
     return oss.str();
 }
 
@@ -97,94 +432,13 @@ std::ostream& operator<<(std::ostream& os, const ExperimentConfig& config) {
     return os;
 }
 
-size_t calc_warmup_rounds(const ExperimentConfig& config, const size_t num_samples)
+// throughput: achieved request rate [req/s], 0 derives it from the average latency (closed loop)
+// cpu_util: client cpu time per wall time of the measurement, 1 = one busy core
+// timer_overhead_ns: share of every closed-loop sample caused by the timer itself (not subtracted)
+// counters: of the whole measurement incl. warmup, empty if not measured (--perf_counters)
+void output_results_aggregated(const ExperimentConfig& config, const LatencySummary& results, const bool printHeader, const std::string outfile = "", double throughput = 0, const double cpu_util = 0, const LoopCounters& counters = LoopCounters())
 {
-    if (config.num_warmup_rounds > 0 && config.num_warmup_rounds < num_samples)
-        return config.num_warmup_rounds;
-    else
-        return static_cast<size_t>(num_samples * config.perc_warmup_rounds / 100.0);
-}
-
-void output_results_aggregated(const ExperimentConfig& config, const std::vector<double>& results, const bool printHeader, const bool output_outliers, const std::string outfile = "")
-{
-    // Ensure num_warmup_rounds is within valid range
-    const size_t num_warmup_rounds = calc_warmup_rounds(config, results.size());
-
-    // copy, convert, and sort results
-    std::vector<double> sorted_results(results.begin() + num_warmup_rounds, results.end());
-    std::sort(sorted_results.begin(), sorted_results.end());
-
-    // simple statistics
-    const uint64_t num_measurements = sorted_results.size();
-    const double min = sorted_results[0];
-    const double max = sorted_results.back();
-    const double p99 = sorted_results[num_measurements * 0.99];
-    const double p999 = sorted_results[num_measurements * 0.999];
-    const double avg = std::accumulate(sorted_results.begin(), sorted_results.end(), 0.0) / num_measurements;
-    const double median = sorted_results[num_measurements * 0.5];
-    const double q25 = sorted_results[num_measurements * 0.25];
-    const double q75 = sorted_results[num_measurements * 0.75];
-
-    // advanced - boxplot outlier calculation
-    const double iqr = q75 - q25;
-    double lower_bound = q25 - 1.5 * iqr;
-    double upper_bound = q75 + 1.5 * iqr;
-    std::stringstream outliers_lo;
-    std::stringstream outliers_hi;
-    std::string outliers_lo_str("");
-    std::string outliers_hi_str("");
-    uint64_t num_outliers_lo = 0;
-    uint64_t num_outliers_hi = 0;
-    if (lower_bound < min)
-    {
-        // no outliers
-        lower_bound = min;
-    }
-    else
-    {
-        // outliers exist
-        auto it_end = sorted_results.begin() + (num_measurements * 0.25);  // outliers are below q25
-        for (auto it = sorted_results.begin(); it != it_end ; it++)
-            if (*it < lower_bound)
-            {
-                num_outliers_lo++;
-                if (output_outliers) outliers_lo << *it << "|";
-            }
-            else
-                break;
-
-        if (output_outliers)
-        {
-            outliers_lo_str = outliers_lo.str();
-            outliers_lo_str.pop_back();  // remove trailing "|"
-            outliers_lo.clear();
-        }
-    }
-    if (upper_bound > max)
-    {
-        // no outliers
-        upper_bound = max;
-    }
-    else
-    {
-        // outliers exist
-        auto it_end = sorted_results.rbegin() + (num_measurements * 0.25) + 1;  // outliers are above q75, +1 because I'm too lazy to think about one-off errors here...
-        for (auto it = sorted_results.rbegin(); it != it_end; it++)
-            if (*it > upper_bound)
-            {
-                num_outliers_hi++;
-                if (output_outliers) outliers_hi << *it << "|";
-            }
-            else
-                break;
-
-        if (output_outliers)
-        {
-            outliers_hi_str = outliers_hi.str();
-            outliers_hi_str.pop_back();  // remove trailing "|"
-            outliers_hi.clear();
-        }
-    }
+    if (throughput == 0) throughput = 1e6 / results.avg;
 
     // setup out stream
     std::ostream& out = outfile.size() ? *(new std::ofstream(outfile, std::ios_base::app)) : std::cout;
@@ -204,31 +458,200 @@ void output_results_aggregated(const ExperimentConfig& config, const std::vector
         "num_outliers_lo",
         "num_outliers_hi",
         "outliers_lo",
-        "outliers_hi");
+        "outliers_hi",
+        "throughput",
+        "cpu_util",
+        "timer_overhead_ns",
+        LoopCounters::csv_header());
     // output results
-    csv::write_csv(out, config.to_csv(), num_measurements, num_warmup_rounds,
-        min,
-        max,
-        p99,
-        p999,
-        avg,
-        median,
-        q25,
-        q75,
-        lower_bound,
-        upper_bound,
-        num_outliers_lo,
-        num_outliers_hi,
-        outliers_lo_str,
-        outliers_hi_str);
+    csv::write_csv(out, config.to_csv(), results.num_measurements, results.num_warmup_rounds,
+        results.min,
+        results.max,
+        results.p99,
+        results.p999,
+        results.avg,
+        results.median,
+        results.q25,
+        results.q75,
+        results.lower_bound,
+        results.upper_bound,
+        results.num_outliers_lo,
+        results.num_outliers_hi,
+        results.outliers_lo,
+        results.outliers_hi,
+        throughput,
+        cpu_util,
+        config.timer.overhead_ns,
+        counters.to_csv());
+
+    // cleanup
+    if (outfile.size()) delete &out;
+}
+
+// one row per non-empty bucket: value_ns is the lowest value of the bucket,
+// histograms with equal hdr_digits can be merged by summing the counts per value_ns (see plot/merge_histograms.py)
+void output_histogram(const ExperimentConfig& config, const Histogram& hist, const std::string outfile)
+{
+    // header only for new files, histograms of several runs are appended
+    const bool printHeader = !std::filesystem::exists(outfile) || std::filesystem::file_size(outfile) == 0;
+    std::ofstream out(outfile, std::ios_base::app);
+    if (!out) {
+        error("Cannot open histogram output file " + outfile);
+        throw std::runtime_error("Cannot open histogram output file");
+    }
+
+    if (printHeader) csv::write_csv(out, config.csv_header(), "hdr_digits", "value_ns", "count");
+    const std::string config_csv = config.to_csv();
+    hist.forEachBucket([&](const uint64_t value, const uint64_t count) {
+        csv::write_csv(out, config_csv, hist.digits(), value, count);
+    });
+}
+
+// bandwidth results of one stream or aggregated over all streams
+struct BandwidthResult {
+    double elapsed_sec;
+    uint64_t bytes_sent;  // on the wire, compressed: chunk frames
+    uint64_t bytes_rcvd;
+    double cpu_sec;       // client cpu time, compressed: including the compression workers
+    uint64_t raw_bytes_sent;  // before compression, uncompressed: bytes_sent
+    uint64_t raw_bytes_rcvd;  // after decompression
+    uint64_t msgs_sent;       // compressed: chunks
+    uint64_t msgs_rcvd;
+};
+
+void output_bandwidth(const ExperimentConfig& config, const BandwidthResult& result, const bool printHeader, const std::string outfile = "")
+{
+    const double gbit_s_sent = result.bytes_sent * 8 / result.elapsed_sec / 1e9;
+    const double gbit_s_rcvd = result.bytes_rcvd * 8 / result.elapsed_sec / 1e9;
+    const double msgs_s = result.elapsed_sec > 0 ? (result.msgs_sent + result.msgs_rcvd) / result.elapsed_sec : 0;
+    const uint64_t bytes = result.bytes_sent + result.bytes_rcvd;
+    const double cpu_ns_per_byte = bytes ? result.cpu_sec * 1e9 / bytes : 0;
+    // compressed streams: throughput of the application data (effective) vs. the wire (gbit_s)
+    const uint64_t raw_bytes = result.raw_bytes_sent + result.raw_bytes_rcvd;
+    const double gbit_s_effective = raw_bytes * 8 / result.elapsed_sec / 1e9;
+    const double compression_ratio = bytes ? (double) raw_bytes / bytes : 0;
+    const double cpu_ns_per_raw_byte = raw_bytes ? result.cpu_sec * 1e9 / raw_bytes : 0;
+
+    // setup out stream
+    std::ostream& out = outfile.size() ? *(new std::ofstream(outfile, std::ios_base::app)) : std::cout;
+
+    if (printHeader) csv::write_csv(out, config.csv_header(), "duration_sec", "bytes_sent", "bytes_rcvd",
+        "gbit_s_sent",
+        "gbit_s_rcvd",
+        "gbit_s",
+        "msgs_s",
+        "cpu_sec",
+        "cpu_ns_per_byte",
+        "raw_bytes_sent",
+        "raw_bytes_rcvd",
+        "gbit_s_effective",
+        "compression_ratio",
+        "cpu_ns_per_raw_byte");
+    csv::write_csv(out, config.to_csv(), result.elapsed_sec, result.bytes_sent, result.bytes_rcvd,
+        gbit_s_sent,
+        gbit_s_rcvd,
+        gbit_s_sent + gbit_s_rcvd,
+        msgs_s,
+        result.cpu_sec,
+        cpu_ns_per_byte,
+        result.raw_bytes_sent,
+        result.raw_bytes_rcvd,
+        gbit_s_effective,
+        compression_ratio,
+        cpu_ns_per_raw_byte);
+
+    // cleanup
+    if (outfile.size()) delete &out;
+}
+
+// scan results of one batch size: server-side split of the stream into receive and compute time
+void output_scan(const ExperimentConfig& config, const ScanSummary& summary, const double elapsed_sec, const double cpu_sec, const bool printHeader, const std::string outfile = "")
+{
+    const size_t batch_rows = config.server_config.scan_batch_rows;
+    const uint64_t bytes = summary.batches * batch_bytes(batch_rows);
+    const double server_sec = summary.elapsed_ns / 1e9;
+    const double recv_sec = summary.recv_ns / 1e9;
+    const double compute_sec = summary.compute_ns / 1e9;
+    // both threads are busy unless stalled on the ring, the time they spend together is the overlap
+    const double overlap_sec = std::max(0.0, recv_sec + compute_sec - server_sec);
+
+    // setup out stream
+    std::ostream& out = outfile.size() ? *(new std::ofstream(outfile, std::ios_base::app)) : std::cout;
+
+    if (printHeader) csv::write_csv(out, config.csv_header(), "batch_rows", "batch_bytes", "scan_buffers", "selectivity", "groups", "simd",
+        "batches",
+        "rows",
+        "selected",
+        "duration_sec",
+        "rows_s",
+        "gbit_s",
+        "server_sec",
+        "recv_sec",
+        "compute_sec",
+        "crypto_sec",
+        "overlap_sec",
+        "recv_stall_sec",
+        "compute_stall_sec",
+        "cpu_sec");
+    csv::write_csv(out, config.to_csv(), batch_rows, batch_bytes(batch_rows), config.server_config.scan_buffers, config.scan_selectivity,
+        config.server_config.scan_groups, to_string(static_cast<SimdLevel>(summary.simd)),
+        summary.batches,
+        summary.rows,
+        summary.selected,
+        elapsed_sec,
+        summary.rows / elapsed_sec,
+        bytes * 8 / elapsed_sec / 1e9,
+        server_sec,
+        recv_sec,
+        compute_sec,
+        summary.crypto_ns / 1e9,
+        overlap_sec,
+        summary.recv_stall_ns / 1e9,
+        summary.compute_stall_ns / 1e9,
+        cpu_sec);
 
     // cleanup
     if (outfile.size()) delete &out;
 }
 
+// cpu time per wall time since construction, of the calling thread or the whole process (multi-threaded modes)
+class CpuMeter
+{
+private:
+    const clockid_t clock;
+    const double cpu_start;
+    const std::chrono::steady_clock::time_point start;
+
+public:
+    explicit CpuMeter(const clockid_t clock = CLOCK_THREAD_CPUTIME_ID) :
+        clock(clock), cpu_start(cpu_clock_sec(clock)), start(std::chrono::steady_clock::now()) {}
+
+    double cpuSec() const { return cpu_clock_sec(clock) - cpu_start; }
+    double utilization() const {
+        const double elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return elapsed_sec > 0 ? cpuSec() / elapsed_sec : 0;
+    }
+};
+
+template <typename Recorder>
+void output_results(const ExperimentConfig& config, const Recorder& recorder, const bool printHeader, const double throughput = 0, const double cpu_util = 0, const LoopCounters& counters = LoopCounters())
+{
+    output_results_aggregated(config, recorder.summary(FLAGS_output_outliers), printHeader, FLAGS_outfile, throughput, cpu_util, counters);
+    if (!FLAGS_histogram_outfile.empty())
+        output_histogram(config, recorder.histogram(), FLAGS_histogram_outfile);
+}
+
+// raw samples of one recorder of the result row config, nullptr without --raw_outfile
+std::unique_ptr<RawSampleWriter> open_raw_dump(const ExperimentConfig& config, const size_t capacity, const uint32_t conn = 0)
+{
+    if (FLAGS_raw_outfile.empty()) return nullptr;
+    static RawDumpFile file(FLAGS_raw_outfile);
+    return file.segment(config.csv_header() + "\n" + config.to_csv(), conn, capacity, config.client_config.msg_size, config.server_config.rsp_size);
+}
+
 Client::Client(const SocketProtocol protocol, const size_t buf_size) :
     protocol(protocol), buf_size(buf_size), buf(std::make_unique<char[]>(buf_size)) {
-        if ((sock = socket(af_from_enum(protocol), SOCK_STREAM, 0)) < 0) {
+        if ((sock = socket(af_from_enum(protocol), socktype_from_enum(protocol), 0)) < 0) {
             error("Socket creation error");
             throw std::runtime_error("Socket creation error");
         }
@@ -253,6 +676,10 @@ std::unique_ptr<Client> Client::make(const SocketProtocol protocol, const std::s
         return std::make_unique<InetClient>(adr, port, buf_size);
     } else if (protocol == SocketProtocol::VSOCK) {
         return std::make_unique<VsockClient>(adr, port, buf_size);
+    } else if (protocol == SocketProtocol::UNIX || protocol == SocketProtocol::UNIX_SEQPACKET) {
+        return std::make_unique<UnixClient>(protocol, adr, buf_size);
+    } else if (protocol == SocketProtocol::SHM) {
+        return std::make_unique<ShmClient>(adr, buf_size, FLAGS_shm_ring_size, FLAGS_shm_hugepages);
     } else {
         throw std::invalid_argument("Unsupported protocol");
     }    
@@ -280,6 +707,23 @@ VsockClient::VsockClient(const std::string& adr, const int port, const size_t bu
     connectToServer();
 }
 
+UnixClient::UnixClient(const SocketProtocol protocol, const std::string& path, const size_t buf_size) : Client(protocol, buf_size), serv_addr() {
+
+    addrlen = unix_sockaddr(path, serv_addr);
+
+    connectToServer();
+}
+
+ShmClient::ShmClient(const std::string& path, const size_t buf_size, const size_t ring_size, const bool hugepages) : UnixClient(SocketProtocol::SHM, path, buf_size) {
+
+    // the server maps the rings before it reads the handshake
+    shm = ShmChannel::create(ring_size, hugepages);
+    if (!send_fd(sock, shm->getFd())) {
+        error("Passing the shared memory channel to the server failed. Error: " + std::string(strerror(errno)));
+        throw std::runtime_error("Passing the shared memory channel failed");
+    }
+}
+
 int InetClient::checkBufferSizes(const ExperimentConfig& conf) const {
 
     int rc = 0;
@@ -292,7 +736,7 @@ int InetClient::checkBufferSizes(const ExperimentConfig& conf) const {
         error("ERROR: getsockopt (SOL_SOCKET,SO_SNDBUF) failed");
     } else {
         logger("Send buffer size: " + std::to_string(sock_buf_size));
-        if (conf.server_config.buf_size < conf.client_config.msg_size) {
+        if (conf.server_config.buf_size < conf.client_config.msg_size && !conf.server_config.framed) {
             rc--;
             error("ERROR: Client Message size exceeds server receive buffer size");
         }
@@ -353,7 +797,7 @@ int VsockClient::checkBufferSizes(const ExperimentConfig& conf) const {
         error("ERROR: getsockopt (SOL_SOCKET,SO_SNDBUF) failed");
     } else {
         logger("Send buffer size: " + std::to_string(sock_buf_size));
-        if (conf.server_config.buf_size < conf.client_config.msg_size) {
+        if (conf.server_config.buf_size < conf.client_config.msg_size && !conf.server_config.framed) {
             rc--;
             error("ERROR: Client Message size exceeds server receive buffer size");
         }
@@ -386,184 +830,1444 @@ int VsockClient::checkBufferSizes(const ExperimentConfig& conf) const {
     return rc;
 }
 
+int UnixClient::checkBufferSizes(const ExperimentConfig& conf) const {
+
+    int rc = 0;
+    int sock_buf_size;
+    socklen_t optlen = sizeof(sock_buf_size);
+    // seqpacket: a message is sent as one record and a read returns at most one record, the rest is discarded
+    const bool seqpacket = protocol == SocketProtocol::UNIX_SEQPACKET;
+
+    if (seqpacket && conf.server_config.framed) {
+        rc--;
+        error("ERROR: Framed protocol not supported by unix_seqpacket (the frame header read would truncate the record)");
+    }
+
+    // Check the current send buffer size
+    if (getsockopt(sock, SOL_SOCKET, SO_SNDBUF, &sock_buf_size, &optlen) == -1) {
+        rc--;
+        error("ERROR: getsockopt (SOL_SOCKET,SO_SNDBUF) failed");
+    } else {
+        logger("Send buffer size: " + std::to_string(sock_buf_size));
+        if (conf.server_config.buf_size < conf.client_config.msg_size && !conf.server_config.framed) {
+            rc--;
+            error("ERROR: Client Message size exceeds server receive buffer size");
+        }
+        if (sock_buf_size < conf.client_config.msg_size) {
+            if (seqpacket) rc--;  // a record must fit into the send buffer (EMSGSIZE)
+            error(std::string(seqpacket ? "ERROR" : "WARNING") + ": Client Message size exceeds send buffer size");
+        }
+    }
+
+    // Check the current receive buffer size, unix sockets account queued data to the sender's send buffer
+    if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &sock_buf_size, &optlen) == -1) {
+        rc--;
+        error("ERROR: getsockopt (SOL_SOCKET,SO_RCVBUF) failed");
+    } else {
+        logger("Receive buffer size: " + std::to_string(sock_buf_size));
+        if (conf.client_config.buf_size < conf.server_config.rsp_size) {
+            rc--;
+            error("ERROR: Server Response size exceeds client receive buffer size");
+        }
+    }
+
+    return rc;
+}
+
+int ShmClient::checkBufferSizes(const ExperimentConfig& conf) const {
+
+    // the rings take messages of any size (in chunks), only the application buffers matter
+    int rc = 0;
+    if (conf.server_config.buf_size < conf.client_config.msg_size && !conf.server_config.framed) {
+        rc--;
+        error("ERROR: Client Message size exceeds server receive buffer size");
+    }
+    if (conf.client_config.buf_size < conf.server_config.rsp_size) {
+        rc--;
+        error("ERROR: Server Response size exceeds client receive buffer size");
+    }
+    return rc;
+}
+
 void Client::handshake(const ExperimentConfig &config)
 {
     // prepare hello/config message
-    auto hello = std::make_unique<uint8_t[]>(sizeof(config.server_config));
-    std::memcpy(hello.get(), &config.server_config, sizeof(config.server_config));
+    std::string hello(reinterpret_cast<const char*>(&config.server_config), sizeof(config.server_config));
 
     // Send message to server
-    send(sock, hello.get(), sizeof(config.server_config), 0);
+    if (sendall(sock, hello) != (int64_t) hello.size()) {
+        error("Sending config to server failed. Error: " + std::string(strerror(errno)));
+        throw std::runtime_error("Handshake failed");
+    }
     logger("Hello message sent to server");
 
-    // Receive handshake message from the server
-    read(sock, buf.get(), buf_size);
-    logger("Message from server: " + std::string(buf.get()));
+    awaitHello();
 }
 
-void Client::run(const ExperimentConfig &config)
+void Client::awaitHello()
+{
+    // Receive handshake message from the server, completely - leftovers would be taken for the first response
+    char reply[SERVER_HELLO_LEN + 1] = {};
+    if (readall(sock, reply, SERVER_HELLO_LEN) != (int64_t) SERVER_HELLO_LEN || std::strcmp(reply, SERVER_HELLO) != 0) {
+        error("Handshake failed: unexpected reply from server (rejected config?)");
+        throw std::runtime_error("Handshake failed");
+    }
+    logger("Message from server: " + std::string(reply));
+}
+
+void Client::reconfigure(const ExperimentConfig &config)
 {
+    // the server tells the update from a request by the marker, it is acknowledged like the handshake
+    std::string update(1 + sizeof(config.server_config), CONFIG_UPDATE_MARKER);
+    std::memcpy(update.data() + 1, &config.server_config, sizeof(config.server_config));
+    if (shm) {
+        // in band, i.e. over the rings the server is serving
+        ShmTransport transport(*shm, false, sock, config.recv);
+        char reply[SERVER_HELLO_LEN + 1] = {};
+        if (transport.write(update.data(), update.size()) != (int64_t) update.size()
+            || transport.readall(reply, SERVER_HELLO_LEN) != (int64_t) SERVER_HELLO_LEN || std::strcmp(reply, SERVER_HELLO) != 0) {
+            error("Config update failed: unexpected reply from server (rejected config?)");
+            throw std::runtime_error("Config update failed");
+        }
+        logger("Server config updated: " + config.server_config.to_string());
+        return;
+    }
+    if (sendall(sock, update) != (int64_t) update.size()) {
+        error("Sending config update to server failed. Error: " + std::string(strerror(errno)));
+        throw std::runtime_error("Config update failed");
+    }
+    awaitHello();
+    logger("Server config updated: " + config.server_config.to_string());
+}
 
+void Client::prepare(const ExperimentConfig &config)
+{
     // check buffer sizes
     if (checkBufferSizes(config) < 0)
         throw std::runtime_error("Buffer size check failed");
 
     // handshake with server
     handshake(config);
+}
+
+void Client::run(const ExperimentConfig &config)
+{
+    // the shm transport replaces the io backend, the open loop and pipelined clients work on the socket
+    if (shm && config.io != IoBackend::BLOCKING)
+        throw std::invalid_argument("The shm protocol has its own transport, use the blocking io backend");
+    if (shm && (config.arrival != ArrivalProcess::CLOSED || !config.pipeline_depths.empty()))
+        throw std::invalid_argument("The shm protocol only supports closed-loop roundtrips without pipelining");
+
+    prepare(config);
 
     // run experiment
-    std::vector<double> rtt_samples;
-    if (config.client_config.msg_size > THRESH_LARGE_MSG || config.server_config.rsp_size > THRESH_LARGE_MSG)
-        rtt_samples = measureRTTLarge(config.num_samples, config.client_config.msg_size, config.server_config.rsp_size, config.timeout_sec ? config.timeout_sec : 10.0);
-    else
-        if (config.timeout_sec == 0)
-            rtt_samples = measureRTT(config.num_samples, config.client_config.msg_size);
-        else
-            rtt_samples = measureRTT(config.num_samples, config.client_config.msg_size, config.timeout_sec);
+    switch (config.recorder)
+    {
+    case RecorderType::VECTOR:
+        if (config.arrival != ArrivalProcess::CLOSED) runOpenLoop<VectorRecorder>(config);
+        else if (!config.pipeline_depths.empty()) runPipelined<VectorRecorder>(config);
+        else if (config.server_config.seal != SealCipher::PLAINTEXT) runSealed<VectorRecorder>(config);
+        else if (!config.sweep_sizes.empty()) runSweep<VectorRecorder>(config);
+        else if (config.replay) runReplay<VectorRecorder>(config);
+        else if (config.server_config.timestamps) runDecomposed<VectorRecorder>(config);
+        else runClosedLoop<VectorRecorder>(config);
+        break;
+    case RecorderType::HDR:
+        if (config.arrival != ArrivalProcess::CLOSED) runOpenLoop<HdrRecorder>(config);
+        else if (!config.pipeline_depths.empty()) runPipelined<HdrRecorder>(config);
+        else if (config.server_config.seal != SealCipher::PLAINTEXT) runSealed<HdrRecorder>(config);
+        else if (!config.sweep_sizes.empty()) runSweep<HdrRecorder>(config);
+        else if (config.replay) runReplay<HdrRecorder>(config);
+        else if (config.server_config.timestamps) runDecomposed<HdrRecorder>(config);
+        else runClosedLoop<HdrRecorder>(config);
+        break;
+    default:
+        throw std::invalid_argument("Unsupported recorder");
+    }
+}
+
+template <typename Recorder>
+void Client::runClosedLoop(const ExperimentConfig &config)
+{
+    Recorder recorder(config.warmup(), config.num_samples, config.hdr_digits);
+    const auto raw = open_raw_dump(config, config.num_samples);
+    recorder.dumpTo(raw.get());
+    const CpuMeter cpu;
+    const PerfMeter perf(FLAGS_perf_counters);
+    measureConnection(config, recorder);
+    const double cpu_util = cpu.utilization();
+    LoopCounters counters = perf.read();
+    counters.setIo(io_stats);
 
     // Close the connection
     close(sock);
 
     // output results
-    output_results_aggregated(config, rtt_samples, FLAGS_print_header, FLAGS_output_outliers, FLAGS_outfile);
+    output_results(config, recorder, FLAGS_print_header, 0, cpu_util, counters);
 }
 
-std::vector<double> Client::measureRTT(const size_t num_samples, const size_t msg_size)
+template <typename Recorder>
+void Client::measureConnection(const ExperimentConfig &config, Recorder &recorder)
 {
-    // vector to store RTT samples
-    std::vector<double> rtt_samples;
-    rtt_samples.reserve(num_samples);
-
-    // allocations for RTT measurement
-    std::chrono::duration<double, std::micro> rtt;
-    std::chrono::time_point<std::chrono::high_resolution_clock> start;
-    std::chrono::time_point<std::chrono::high_resolution_clock> end;
-
-    logger("Measuring RTT for " + std::to_string(num_samples) + " samples...");
-
-    std::string msg(msg_size, 'a');
-    int rsp_len;
-    int rc_send;
-
-    for (size_t i = 0; i < num_samples; i++)
+    std::string msg(config.client_config.msg_size, 'a');
+    switch (config.io)
     {
-
-        // capture start ts
-        start = std::chrono::high_resolution_clock::now();
-
-        // Send message to server
-        rc_send = send(sock, msg.c_str(), msg.length(), 0);
-        if (rc_send != msg_size) [[unlikely]] {
-            error("Send failed. Error: " + std::string(strerror(errno)));
-            throw std::runtime_error("Send failed");
+    case IoBackend::BLOCKING: {
+        if (shm) {
+            ShmTransport transport(*shm, false, sock, config.recv);
+            measure(transport, recorder, config, msg);
+            io_stats = transport.stats;
+            break;
         }
-        #ifdef DEBUG
-        logger("Message sent to server");
-        #endif
-
-        // Receive message from server
-        rsp_len = read(sock, buf.get(), buf_size);
-        #ifdef DEBUG
-        logger("Response from server: " + std::to_string(rsp_len) + " (" + std::string(buf.get()) + ")");
-        #endif
-
-        // measure RTT
-        end = std::chrono::high_resolution_clock::now();
-        rtt = end - start;
-        rtt_samples.push_back(rtt.count());
+        BlockingTransport transport(sock, config.recv);
+        measure(transport, recorder, config, msg);
+        io_stats = transport.stats;
+        break;
+    }
+    #if HAVE_IO_URING
+    case IoBackend::URING: {
+        if (config.recv.strategy != RecvStrategy::BLOCKING)
+            throw std::invalid_argument("Receive strategies other than blocking require the blocking io backend");
+        UringTransport transport(sock, getUringOptions(), msg.data(), msg.size(), buf.get(), buf_size);
+        measure(transport, recorder, config, msg);
+        io_stats = transport.stats;
+        break;
+    }
+    #endif
+    default:
+        throw std::invalid_argument("Unsupported io backend");
+    }
+}
 
-        #ifdef DEBUG
-        // modify msg
-        msg[i % msg_size] += ((msg[i % msg_size] - 'a' + 1) % 26 + 'a');  // rotate through alphabet
-        #endif
+void Client::runConcurrent(const ExperimentConfig &config, const std::string& adr, const int port)
+{
+    if (config.arrival != ArrivalProcess::CLOSED)
+        throw std::invalid_argument("Open loop mode only supports a single connection");
+    if (!config.pipeline_depths.empty())
+        throw std::invalid_argument("Pipelined mode only supports a single connection");
+    if (config.threads == 0 || config.threads > config.connections)
+        throw std::invalid_argument("Number of threads must be between 1 and the number of connections");
+    if (config.protocol == SocketProtocol::SHM && config.connections > 1)
+        throw std::invalid_argument("The shm protocol only supports a single connection (serial server)");
+
+    // all connections are set up before the measurement starts, i.e. the server has to serve them concurrently
+    std::vector<std::unique_ptr<Client>> clients;
+    for (size_t i = 0; i < config.connections; i++) {
+        clients.push_back(make(config.protocol, adr, port, config.client_config.buf_size));
+        clients.back()->prepare(config);
     }
+    logger("Opened " + std::to_string(clients.size()) + " connections");
 
-    return rtt_samples;
+    switch (config.recorder)
+    {
+    case RecorderType::VECTOR:
+        measureConcurrent<VectorRecorder>(config, clients);
+        break;
+    case RecorderType::HDR:
+        measureConcurrent<HdrRecorder>(config, clients);
+        break;
+    default:
+        throw std::invalid_argument("Unsupported recorder");
+    }
 }
 
-std::vector<double> Client::measureRTT(const size_t num_max_samples, const size_t msg_size, const double timeout_sec)
+void Client::runBandwidth(const ExperimentConfig &config, const std::string& adr, const int port)
 {
-    // vector to store RTT samples
-    std::vector<double> rtt_samples;
-    rtt_samples.reserve(num_max_samples);
-    constexpr size_t timeout_check_interval = 1000;
-    if (num_max_samples % timeout_check_interval != 0)
-    {
-        error("WARNING: num_max_samples should be a multiple of timeout_check_interval=" + std::to_string(timeout_check_interval));
+    const Workload workload = config.server_config.workload;
+    const bool do_send = workload == Workload::SEND || workload == Workload::BIDIR;
+    const bool do_recv = workload == Workload::RECV || workload == Workload::BIDIR;
+    const double duration_sec = config.timeout_sec ? config.timeout_sec : 10.0;
+    if (config.io != IoBackend::BLOCKING)
+        throw std::invalid_argument("Bandwidth workloads only support the blocking io backend");
+    if (config.protocol == SocketProtocol::SHM)
+        throw std::invalid_argument("Bandwidth workloads do not support the shm protocol");
+    if (config.recv.strategy != RecvStrategy::BLOCKING)
+        throw std::invalid_argument("Bandwidth workloads only support the blocking receive strategy");
+    if (config.arrival != ArrivalProcess::CLOSED)
+        throw std::invalid_argument("Bandwidth workloads do not support open loop arrivals");
+
+    std::vector<std::unique_ptr<Client>> clients;
+    for (size_t i = 0; i < config.connections; i++) {
+        clients.push_back(make(config.protocol, adr, port, config.client_config.buf_size));
+        clients.back()->prepare(config);
     }
 
-    // allocations for RTT measurement and timeout
-    std::chrono::duration<double, std::micro> rtt;
-    std::chrono::time_point<std::chrono::high_resolution_clock> start;
-    std::chrono::time_point<std::chrono::high_resolution_clock> last;
-    std::chrono::time_point<std::chrono::high_resolution_clock> end;
+    // one thread per stream and direction: [0] send, [1] receive
+    const size_t num_streams = clients.size();
+    const size_t num_threads = num_streams * (do_send + do_recv);
+    std::vector<std::array<StreamCounters, 2>> counters(num_streams);
+    std::vector<std::thread> threads;
+    std::latch ready(num_threads + 1);
+    std::atomic<bool> stop(false);
+    std::atomic<bool> failed(false);
+    const std::string msg(config.client_config.msg_size, 'a');
+    const bool compressed = config.server_config.compression != CompressionCodec::UNCOMPRESSED;
+
+    auto spawn = [&](const size_t stream, const int dir) {
+        const size_t t = threads.size();
+        threads.emplace_back([&, stream, dir, t]() {
+            if (!config.cpus.empty()) {
+                const int cpu = config.cpus[t % config.cpus.size()];
+                if (pin_to_cpu(cpu) != 0) {
+                    error("Failed to pin thread " + std::to_string(t) + " to cpu " + std::to_string(cpu));
+                    failed = true;
+                }
+            }
+            ready.arrive_and_wait();
+            if (failed) return;
 
-    logger("Measuring RTT for up to " + std::to_string(num_max_samples) + " samples or " + std::to_string(timeout_sec) + " seconds...");
+            bool ok;
+            if (compressed)
+                ok = dir == 0 ? clients[stream]->streamSendCompressed(stop, config, stream, counters[stream][0])
+                              : clients[stream]->streamRecvCompressed(stop, config, counters[stream][1]);
+            else
+                ok = dir == 0 ? clients[stream]->streamSend(stop, msg, counters[stream][0])
+                              : clients[stream]->streamRecv(stop, config.server_config.rsp_size, counters[stream][1]);
+            if (!ok) failed = true;
+        });
+    };
+    for (size_t i = 0; i < num_streams; i++) {
+        if (do_send) spawn(i, 0);
+        if (do_recv) spawn(i, 1);
+    }
 
-    std::string msg(msg_size, 'a');
-    int rsp_len;
-    int rc_send;
+    logger("Streaming (" + to_string(workload) + (compressed ? ", " + to_string(config.server_config.compression) : "") + ") over " +
+           std::to_string(num_streams) + " connections for " + std::to_string(duration_sec) + " seconds...");
+    ready.arrive_and_wait();
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration_sec));
+    stop = true;
+
+    // unblock threads waiting in send/read, then close the connections
+    for (auto &client : clients)
+        shutdown(client->sock, SHUT_RDWR);
+    for (auto &thread : threads)
+        thread.join();
+    for (auto &client : clients)
+        close(client->sock);
+    if (failed) throw std::runtime_error("Bandwidth measurement failed");
+
+    // per-stream results
+    bool print_header = FLAGS_print_header;
+    BandwidthResult total = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (size_t i = 0; i < num_streams; i++) {
+        const StreamCounters &snd = counters[i][0];
+        const StreamCounters &rcv = counters[i][1];
+        const BandwidthResult result = { std::max(snd.elapsed_sec, rcv.elapsed_sec), snd.bytes, rcv.bytes, snd.cpu_sec + rcv.cpu_sec, snd.raw_bytes, rcv.raw_bytes,
+                                          snd.msgs, rcv.msgs };
+        if (num_streams > 1) {
+            ExperimentConfig conn = config;
+            conn.connection = std::to_string(i);
+            output_bandwidth(conn, result, print_header, FLAGS_outfile);
+            print_header = false;
+        }
+        total.elapsed_sec = std::max(total.elapsed_sec, result.elapsed_sec);
+        total.bytes_sent += result.bytes_sent;
+        total.bytes_rcvd += result.bytes_rcvd;
+        total.cpu_sec += result.cpu_sec;
+        total.raw_bytes_sent += result.raw_bytes_sent;
+        total.raw_bytes_rcvd += result.raw_bytes_rcvd;
+        total.msgs_sent += result.msgs_sent;
+        total.msgs_rcvd += result.msgs_rcvd;
+    }
 
-    start = std::chrono::high_resolution_clock::now();
-    for (size_t i = 0; i < num_max_samples; i += timeout_check_interval)
-    {
-        for (size_t j = 0; j < timeout_check_interval; j++)
-        {
+    // aggregated results
+    output_bandwidth(config, total, print_header, FLAGS_outfile);
+}
 
-            // capture start ts
-            last = std::chrono::high_resolution_clock::now();
+bool Client::streamSend(const std::atomic<bool> &stop, const std::string &msg, StreamCounters &counters)
+{
+    const double cpu_start = cpu_clock_sec();
+    const auto start = std::chrono::steady_clock::now();
+    bool ok = true;
+    size_t partial = 0;  // bytes of the current message
 
-            // Send message to server
-            rc_send = send(sock, msg.c_str(), msg.length(), 0);
-            if (rc_send != msg_size) [[unlikely]] {
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        const ssize_t n = ::send(sock, msg.data(), msg.size(), MSG_NOSIGNAL);
+        if (n <= 0) [[unlikely]] {
+            if (!stop) {
                 error("Send failed. Error: " + std::string(strerror(errno)));
-                throw std::runtime_error("Send failed");
+                ok = false;
             }
-            #ifdef DEBUG
-            logger("Message sent to server");
-            #endif
-
-            // Receive message from server
-            rsp_len = read(sock, buf.get(), buf_size);
-            #ifdef DEBUG
-            logger("Response from server: " + std::to_string(rsp_len) + " (" + std::string(buf.get()) + ")");
-            #endif
+            break;
+        }
+        counters.bytes += n;
+        partial += n;
+        counters.msgs += partial / msg.size();  // n > 0, so msg is not empty
+        partial %= msg.size();
+    }
 
-            // measure RTT
-            end = std::chrono::high_resolution_clock::now();
-            rtt = end - last;
-            rtt_samples.push_back(rtt.count());
+    counters.raw_bytes = counters.bytes;
+    counters.elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    counters.cpu_sec = cpu_clock_sec() - cpu_start;
+    return ok;
+}
 
-            #ifdef DEBUG
-            // modify msg
-            msg[i % msg_size] += ((msg[i % msg_size] - 'a' + 1) % 26 + 'a');  // rotate through alphabet
-            #endif
-        }
+bool Client::streamRecv(const std::atomic<bool> &stop, const size_t rsp_size, StreamCounters &counters)
+{
+    const double cpu_start = cpu_clock_sec();
+    const auto start = std::chrono::steady_clock::now();
+    bool ok = true;
+    size_t partial = 0;  // bytes of the current response
 
-        // check timeout
-        if (std::chrono::duration<double>(end - start).count() >= timeout_sec) [[unlikely]]
-        {
-            logger("Timeout reached after " + std::to_string(i+timeout_check_interval) + " samples");
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        const ssize_t n = ::read(sock, buf.get(), buf_size);
+        if (n <= 0) [[unlikely]] {
+            if (!stop) {
+                if (n < 0)
+                    error("Read failed. Error: " + std::string(strerror(errno)));
+                else
+                    error("Read failed. Peer disconnected.");
+                ok = false;
+            }
             break;
         }
-
+        counters.bytes += n;
+        if (rsp_size > 0) {
+            partial += n;
+            counters.msgs += partial / rsp_size;
+            partial %= rsp_size;
+        }
     }
 
-    rtt_samples.shrink_to_fit();
-    return rtt_samples;
+    counters.raw_bytes = counters.bytes;
+    counters.elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    counters.cpu_sec = cpu_clock_sec() - cpu_start;
+    return ok;
 }
 
-std::vector<double> Client::measureRTTLarge(const size_t num_max_samples, const size_t msg_size, const size_t rsp_exp_size, const double timeout_sec)
+// compressed SEND/BIDIR: the chunks are compressed on a worker thread while the previous ones are sent,
+// the cpu time of the stream includes the worker
+bool Client::streamSendCompressed(const std::atomic<bool> &stop, const ExperimentConfig &config, const size_t stream, StreamCounters &counters)
 {
-    // sanity check
-    if (rsp_exp_size > buf_size) {
-        error("Internal buffer size is smaller than expected response size");
+    const std::vector<std::string> chunks = compressible_chunks(config.server_config, stream * COMPRESSION_SOURCE_CHUNKS);
+    const double cpu_start = cpu_clock_sec();
+    const auto start = std::chrono::steady_clock::now();
+    bool ok = true;
+
+    CompressPipeline pipeline(config.server_config, chunks);
+    size_t len, raw;
+    const char *frame;
+    while (!stop.load(std::memory_order_relaxed) && (frame = pipeline.next(len, raw)) != nullptr)
+    {
+        if (!send_frame(sock, frame, len)) [[unlikely]] {
+            if (!stop) {
+                error("Send failed. Error: " + std::string(strerror(errno)));
+                ok = false;
+            }
+            break;
+        }
+        pipeline.release();
+        counters.bytes += len;
+        counters.raw_bytes += raw;
+        counters.msgs++;
+    }
+    pipeline.stop();
+
+    counters.elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    counters.cpu_sec = cpu_clock_sec() - cpu_start + pipeline.workerCpuSec();
+    return ok;
+}
+
+// compressed RECV/BIDIR: the chunks are decompressed on the receiving thread
+bool Client::streamRecvCompressed(const std::atomic<bool> &stop, const ExperimentConfig &config, StreamCounters &counters)
+{
+    ChunkReader reader(config.server_config);
+    const double cpu_start = cpu_clock_sec();
+    const auto start = std::chrono::steady_clock::now();
+    bool ok = true;
+
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        if (!reader.next(sock)) [[unlikely]] {
+            if (!stop) {
+                error(reader.error().empty() ? "Read failed. Peer disconnected." : reader.error());
+                ok = false;
+            }
+            break;
+        }
+        counters.msgs++;
+    }
+
+    counters.bytes = reader.wire_bytes;
+    counters.raw_bytes = reader.raw_bytes;
+    counters.elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    counters.cpu_sec = cpu_clock_sec() - cpu_start;
+    return ok;
+}
+
+void Client::runScan(const ExperimentConfig &config, const std::string& adr, const int port)
+{
+    const double duration_sec = config.timeout_sec ? config.timeout_sec : 10.0;
+    const bool sealed = config.server_config.seal != SealCipher::PLAINTEXT;
+    if (config.io != IoBackend::BLOCKING || config.protocol == SocketProtocol::SHM || config.recv.strategy != RecvStrategy::BLOCKING)
+        throw std::invalid_argument("The scan workload only supports the blocking io backend and receive strategy");
+    if (config.arrival != ArrivalProcess::CLOSED || config.connections > 1 || config.threads > 1)
+        throw std::invalid_argument("The scan workload streams over a single connection");
+
+    bool print_header = FLAGS_print_header;
+    for (const double r : config.scan_batch_rows) {
+        ExperimentConfig step = config;
+        const size_t rows = static_cast<size_t>(r);
+        step.server_config.scan_batch_rows = static_cast<uint32_t>(rows);
+        if (sealed) seal_session_key(step.server_config);  // record numbers restart with the connection
+
+        // distinct generated batches sent round robin, and the query result of each
+        const size_t batch_len = batch_bytes(rows);
+        const size_t pool_size = std::clamp<size_t>(SCAN_POOL_BYTES / batch_len, 2, 64);
+        std::vector<std::string> pool;
+        std::vector<uint64_t> pool_selected(pool_size), pool_checksum(pool_size), sent(pool_size);
+        for (size_t i = 0; i < pool_size; i++) {
+            pool.push_back(make_batch(rows, step.server_config.scan_groups, FLAGS_arrival_seed + i));
+            BatchView batch;
+            decode_batch(pool[i].data(), pool[i].size(), rows, batch);
+            for (size_t j = 0; j < rows; j++)
+                if (batch.col[COL_KEY][j] < step.server_config.scan_threshold) {
+                    pool_selected[i]++;
+                    pool_checksum[i] += batch.col[COL_VALUE][j] + batch.col[COL_GROUP][j];
+                }
+        }
+        std::string end_marker = make_batch(0, 1, 0);
+
+        auto client = make(config.protocol, adr, port, config.client_config.buf_size);
+        client->prepare(step);
+        std::unique_ptr<RecordCipher> cipher = sealed ? std::make_unique<RecordCipher>(step.server_config, false) : nullptr;
+        std::string record(sealed ? sealed_size(batch_len, 0) : 0, '\0');
+        uint64_t seq = 0;
+        auto send_batch = [&](char *batch, size_t len) {
+            put_batch_seq(batch, seq++);
+            if (cipher) {
+                len = cipher->seal(batch, len, record.data());
+                batch = record.data();
+            }
+            return send_frame(client->sock, batch, len);
+        };
+
+        logger("Streaming " + std::to_string(rows) + "-row batches (" + std::to_string(batch_len) + " bytes" + (sealed ? ", " + to_string(config.server_config.seal) : "") +
+               ") for " + std::to_string(duration_sec) + " seconds...");
+        const double cpu_start = cpu_clock_sec();
+        const auto start = std::chrono::steady_clock::now();
+        const auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(duration_sec));
+        while (std::chrono::steady_clock::now() < deadline) {
+            const size_t i = seq % pool_size;
+            if (!send_batch(pool[i].data(), batch_len)) {
+                error("Send failed. Error: " + std::string(strerror(errno)));
+                throw std::runtime_error("Scan stream failed");
+            }
+            sent[i]++;
+        }
+        ScanSummary summary;
+        if (!send_batch(end_marker.data(), end_marker.size())
+            || readall(client->sock, reinterpret_cast<char*>(&summary), sizeof(summary)) != (int64_t) sizeof(summary)) {
+            error("Receiving the scan result failed");
+            throw std::runtime_error("Scan stream failed");
+        }
+        std::vector<AggEntry> groups(summary.groups);
+        const int64_t groups_len = groups.size() * sizeof(AggEntry);
+        if (groups_len && readall(client->sock, reinterpret_cast<char*>(groups.data()), groups_len) != groups_len) {
+            error("Receiving the scan result failed");
+            throw std::runtime_error("Scan stream failed");
+        }
+        const double elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const double cpu_sec = cpu_clock_sec() - cpu_start;
+
+        // the aggregates have to match the sent batches
+        uint64_t batches = 0, selected = 0, checksum = 0, result_checksum = 0;
+        for (size_t i = 0; i < pool_size; i++) {
+            batches += sent[i];
+            selected += sent[i] * pool_selected[i];
+            checksum += sent[i] * pool_checksum[i];
+        }
+        for (const AggEntry &e : groups)
+            result_checksum += scan_checksum(e);
+        if (summary.batches != batches || summary.rows != batches * rows || summary.selected != selected || result_checksum != checksum) {
+            error("Scan result mismatch: " + std::to_string(summary.batches) + " of " + std::to_string(batches) + " batches, " +
+                  std::to_string(summary.selected) + " of " + std::to_string(selected) + " selected rows");
+            throw std::runtime_error("Scan result mismatch");
+        }
+
+        output_scan(step, summary, elapsed_sec, cpu_sec, print_header, FLAGS_outfile);
+        print_header = false;
+    }
+}
+
+// Connection i is driven by thread i % threads. A thread with a single connection runs the regular
+// measurement loop of the configured io backend, otherwise it keeps one request in flight per connection (epoll).
+template <typename Recorder>
+void Client::measureConcurrent(const ExperimentConfig &config, std::vector<std::unique_ptr<Client>> &clients)
+{
+    using clock = std::chrono::steady_clock;
+    const size_t num_connections = clients.size();
+
+    std::vector<Recorder> recorders;
+    std::vector<std::unique_ptr<RawSampleWriter>> raws;
+    recorders.reserve(num_connections);
+    for (size_t i = 0; i < num_connections; i++) {
+        recorders.emplace_back(config.warmup(), config.num_samples, config.hdr_digits);
+        ExperimentConfig conn = config;
+        if (num_connections > 1) conn.connection = std::to_string(i);
+        raws.push_back(open_raw_dump(conn, config.num_samples, i));
+        recorders.back().dumpTo(raws.back().get());
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<clock::time_point> ends(config.threads);
+    std::vector<double> cpu_secs(config.threads, 0);  // thread cpu time of the measurement
+    std::vector<LoopCounters> thread_counters(config.threads);
+    std::latch ready(config.threads + 1);
+    std::atomic<bool> failed(false);
+
+    for (size_t t = 0; t < config.threads; t++)
+    {
+        threads.emplace_back([&, t]() {
+            if (!config.cpus.empty()) {
+                const int cpu = config.cpus[t % config.cpus.size()];
+                if (pin_to_cpu(cpu) != 0) {
+                    error("Failed to pin thread " + std::to_string(t) + " to cpu " + std::to_string(cpu));
+                    failed = true;
+                }
+            }
+
+            std::vector<Client*> own_clients;
+            std::vector<Recorder*> own_recorders;
+            for (size_t i = t; i < num_connections; i += config.threads) {
+                own_clients.push_back(clients[i].get());
+                own_recorders.push_back(&recorders[i]);
+            }
+
+            // start all threads at once
+            ready.arrive_and_wait();
+            if (failed) return;
+
+            const CpuMeter cpu;
+            const PerfMeter perf(FLAGS_perf_counters);
+            try {
+                if (own_clients.size() == 1)
+                    own_clients[0]->measureConnection(config, *own_recorders[0]);
+                else
+                    measureMultiplexed(config, own_clients, own_recorders);
+            } catch (const std::exception &e) {
+                error("Thread " + std::to_string(t) + " failed: " + e.what());
+                failed = true;
+            }
+            ends[t] = clock::now();
+            cpu_secs[t] = cpu.cpuSec();
+            thread_counters[t] = perf.read();
+        });
+    }
+
+    ready.arrive_and_wait();
+    const clock::time_point start = clock::now();
+    for (auto &thread : threads)
+        thread.join();
+    if (failed) throw std::runtime_error("Concurrent measurement failed");
+
+    // Close the connections
+    for (auto &client : clients)
+        close(client->sock);
+
+    // per-connection results, cpu_util and the counters are the ones of the thread driving the connection
+    bool print_header = FLAGS_print_header;
+    if (num_connections > 1) {
+        for (size_t i = 0; i < num_connections; i++) {
+            ExperimentConfig conn = config;
+            conn.connection = std::to_string(i);
+            const size_t t = i % config.threads;
+            const double thread_sec = std::chrono::duration<double>(ends[t] - start).count();
+            LoopCounters counters = thread_counters[t];
+            counters.setIo(clients[i]->io_stats);
+            output_results(conn, recorders[i], print_header, 0, cpu_secs[t] / thread_sec, counters);
+            print_header = false;
+        }
+    }
+
+    // aggregated results, throughput is the total request rate of all connections
+    size_t num_requests = 0;
+    for (const auto &recorder : recorders)
+        num_requests += recorder.count();
+    Recorder total(WarmupPolicy{0, 0}, num_requests, config.hdr_digits);
+    for (const auto &recorder : recorders)
+        total.merge(recorder);
+    const double elapsed_sec = std::chrono::duration<double>(*std::max_element(ends.begin(), ends.end()) - start).count();
+    const double cpu_sec = std::accumulate(cpu_secs.begin(), cpu_secs.end(), 0.0);
+    LoopCounters counters;
+    for (const LoopCounters &c : thread_counters)
+        counters += c;
+    IoStats io;
+    for (const auto &client : clients)
+        io += client->io_stats;
+    counters.setIo(io);
+    output_results(config, total, print_header, num_requests / elapsed_sec, cpu_sec / elapsed_sec, counters);
+}
+
+template <typename Recorder>
+void Client::measureMultiplexed(const ExperimentConfig &config, const std::vector<Client*> &clients, const std::vector<Recorder*> &recorders)
+{
+    using clock = std::chrono::steady_clock;
+    if (config.io != IoBackend::BLOCKING)
+        throw std::invalid_argument("Multiple connections per thread only support the blocking io backend");
+    if (config.recv.strategy != RecvStrategy::BLOCKING)
+        throw std::invalid_argument("Multiple connections per thread only support the blocking receive strategy");
+
+    const size_t num_connections = clients.size();
+    const size_t rsp_size = config.server_config.rsp_size;
+    std::string msg(config.client_config.msg_size, 'a');
+    for (const Client *client : clients)
+        if (rsp_size > client->buf_size)
+            throw std::runtime_error("Buffer size is smaller than response size");
+
+    // per connection: send time and progress of the outstanding request
+    struct Outstanding {
+        clock::time_point start;
+        size_t rcvd;
+        size_t samples;
+    };
+    std::vector<Outstanding> outstanding(num_connections, Outstanding{clock::time_point(), 0, 0});
+
+    const int epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0) {
+        error("epoll_create1 failed with ERROR: " + std::string(strerror(errno)));
+        throw std::runtime_error("epoll_create1 failed");
+    }
+
+    for (Client *client : clients)
+        client->io_stats = IoStats();
+
+    auto send_request = [&](const size_t i) {
+        outstanding[i].rcvd = 0;
+        outstanding[i].start = clock::now();
+        size_t iter;
+        const int64_t sent = sendall_dbg(clients[i]->sock, msg, iter);
+        clients[i]->io_stats.partial_writes += iter - 1;
+        if (sent != (int64_t) msg.size()) [[unlikely]] {
+            error("Send failed. Error: " + std::string(strerror(errno)));
+            close(epoll_fd);
+            throw std::runtime_error("Send failed");
+        }
+    };
+
+    for (size_t i = 0; i < num_connections; i++) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = i;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, clients[i]->sock, &ev) < 0) {
+            error("epoll_ctl failed with ERROR: " + std::string(strerror(errno)));
+            close(epoll_fd);
+            throw std::runtime_error("epoll_ctl failed");
+        }
+    }
+
+    logger("Measuring RTT over " + std::to_string(num_connections) + " connections for up to " + std::to_string(config.num_samples) + " samples each...");
+
+    const clock::time_point begin = clock::now();
+    std::vector<struct epoll_event> events(num_connections);
+    size_t active = num_connections;
+    size_t completed = 0;
+    bool timeout = false;
+    for (size_t i = 0; i < num_connections; i++)
+        send_request(i);
+
+    while (active > 0)
+    {
+        const int n = epoll_wait(epoll_fd, events.data(), events.size(), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            error("epoll_wait failed with ERROR: " + std::string(strerror(errno)));
+            close(epoll_fd);
+            throw std::runtime_error("epoll_wait failed");
+        }
+
+        for (int e = 0; e < n; e++)
+        {
+            const size_t i = events[e].data.u64;
+            Client &client = *clients[i];
+            Outstanding &req = outstanding[i];
+
+            const ssize_t len = ::read(client.sock, client.buf.get() + req.rcvd, rsp_size - req.rcvd);
+            if (len <= 0) [[unlikely]] {
+                if (len < 0)
+                    error("Read failed. Error: " + std::string(strerror(errno)));
+                else
+                    error("Read failed. Peer disconnected.");
+                close(epoll_fd);
+                throw std::runtime_error("Read failed");
+            }
+            req.rcvd += len;
+            if (req.rcvd < rsp_size) {
+                client.io_stats.partial_reads++;
+                continue;
+            }
+
+            recorders[i]->record(std::chrono::duration<double, std::micro>(clock::now() - req.start).count());
+            completed++;
+
+            if (++req.samples < config.num_samples && !timeout) {
+                send_request(i);
+            } else {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client.sock, nullptr);
+                active--;
+            }
+        }
+
+        // check timeout
+        if (config.timeout_sec > 0 && !timeout && completed >= 1000) {
+            completed = 0;
+            if (std::chrono::duration<double>(clock::now() - begin).count() >= config.timeout_sec) [[unlikely]] {
+                logger("Timeout reached");
+                timeout = true;
+            }
+        }
+    }
+
+    close(epoll_fd);
+}
+
+template <typename Recorder>
+void Client::runOpenLoop(const ExperimentConfig &config)
+{
+    if (config.io != IoBackend::BLOCKING)
+        throw std::invalid_argument("Open loop mode only supports the blocking io backend");
+    if (config.recv.strategy != RecvStrategy::BLOCKING)
+        throw std::invalid_argument("Open loop mode only supports the blocking receive strategy");
+    if (config.server_config.rsp_size > buf_size)
         throw std::runtime_error("Buffer size is smaller than response size");
+
+    // one output row per rate step over the same connection
+    std::string msg(config.client_config.msg_size, 'a');
+    bool print_header = FLAGS_print_header;
+    for (const double rate : config.rates)
+    {
+        ExperimentConfig step = config;
+        step.target_rate = rate;
+        const size_t num_requests = std::min(config.num_samples, static_cast<size_t>(rate * config.step_duration_sec));
+
+        double achieved_rate = 0;
+        Recorder recorder(step.warmup(), num_requests, step.hdr_digits);
+        const auto raw = open_raw_dump(step, num_requests);
+        recorder.dumpTo(raw.get());
+        const CpuMeter cpu(CLOCK_PROCESS_CPUTIME_ID);  // pacing and receiving thread
+        const PerfMeter perf(FLAGS_perf_counters, true);
+        measureOpenLoop(recorder, step, msg, achieved_rate);
+        const double cpu_util = cpu.utilization();
+        LoopCounters counters = perf.read();
+        counters.setIo(io_stats);
+        output_results(step, recorder, print_header, achieved_rate, cpu_util, counters);
+        print_header = false;
+    }
+
+    close(sock);
+}
+
+template <typename Recorder>
+void Client::runPipelined(const ExperimentConfig &config)
+{
+    if (config.io != IoBackend::BLOCKING)
+        throw std::invalid_argument("Pipelined mode only supports the blocking io backend");
+    if (config.recv.strategy != RecvStrategy::BLOCKING)
+        throw std::invalid_argument("Pipelined mode only supports the blocking receive strategy");
+
+    // one output row per depth over the same connection
+    std::string msg(config.client_config.msg_size, 'a');
+    bool print_header = FLAGS_print_header;
+    for (const size_t depth : config.pipeline_depths)
+    {
+        ExperimentConfig step = config;
+        step.pipeline_depth = depth;
+
+        double achieved_rate = 0;
+        Recorder recorder(step.warmup(), step.num_samples, step.hdr_digits);
+        const auto raw = open_raw_dump(step, step.num_samples);
+        recorder.dumpTo(raw.get());
+        const CpuMeter cpu;
+        const PerfMeter perf(FLAGS_perf_counters);
+        measurePipelined(recorder, step, msg, achieved_rate);
+        const double cpu_util = cpu.utilization();
+        LoopCounters counters = perf.read();
+        counters.setIo(io_stats);
+        output_results(step, recorder, print_header, achieved_rate, cpu_util, counters);
+        print_header = false;
     }
 
-    // vector to store RTT samples
-    std::vector<double> rtt_samples;
-    rtt_samples.reserve(num_max_samples);
+    close(sock);
+}
+
+template <typename Recorder>
+void Client::runSweep(const ExperimentConfig &config)
+{
+    // one output row per size over the same connection, i.e. without reconnecting and restarting the server
+    bool print_header = FLAGS_print_header;
+    for (const size_t size : config.sweep_sizes)
+    {
+        const ExperimentConfig step = sweep_step(config, size);
+        reconfigure(step);
+
+        Recorder recorder(step.warmup(), step.num_samples, step.hdr_digits);
+        const auto raw = open_raw_dump(step, step.num_samples);
+        recorder.dumpTo(raw.get());
+        const CpuMeter cpu;
+        const PerfMeter perf(FLAGS_perf_counters);
+        measureConnection(step, recorder);
+        const double cpu_util = cpu.utilization();
+        LoopCounters counters = perf.read();
+        counters.setIo(io_stats);
+        output_results(step, recorder, print_header, 0, cpu_util, counters);
+        print_header = false;
+    }
+
+    close(sock);
+}
+
+template <typename Recorder>
+void Client::runReplay(const ExperimentConfig &config)
+{
+    // power-of-two size classes and the class of each trace entry, recorders are sized before the measurement
+    const std::vector<TraceEntry> &trace = *config.replay;
+    std::vector<std::pair<uint32_t, uint32_t>> classes;
+    std::vector<size_t> class_of(trace.size());
+    for (size_t i = 0; i < trace.size(); i++) {
+        const std::pair<uint32_t, uint32_t> key = { size_class(trace[i].req_size), size_class(trace[i].rsp_size) };
+        const auto it = std::find(classes.begin(), classes.end(), key);
+        class_of[i] = it - classes.begin();
+        if (it == classes.end()) classes.push_back(key);
+    }
+    std::vector<size_t> expected(classes.size(), 0);
+    for (size_t i = 0; i < config.num_samples; i++)
+        expected[class_of[i % trace.size()]]++;
+
+    // one raw sample segment of all classes with the sizes of each request
+    std::vector<Recorder> recorders;
+    const auto raw = open_raw_dump(config, config.num_samples);
+    for (size_t c = 0; c < classes.size(); c++) {
+        recorders.emplace_back(WarmupPolicy{0, 0}, expected[c], config.hdr_digits);
+        recorders.back().dumpTo(raw.get());
+    }
+
+    std::string msg(config.client_config.msg_size, 'a');
+    double elapsed_sec = 0;
+    const CpuMeter cpu;
+    const PerfMeter perf(FLAGS_perf_counters);
+    switch (config.io)
+    {
+    case IoBackend::BLOCKING: {
+        if (shm) {
+            ShmTransport transport(*shm, false, sock, config.recv);
+            elapsed_sec = measureReplay(transport, recorders, class_of, config, msg);
+            io_stats = transport.stats;
+            break;
+        }
+        BlockingTransport transport(sock, config.recv);
+        elapsed_sec = measureReplay(transport, recorders, class_of, config, msg);
+        io_stats = transport.stats;
+        break;
+    }
+    #if HAVE_IO_URING
+    case IoBackend::URING: {
+        if (config.recv.strategy != RecvStrategy::BLOCKING)
+            throw std::invalid_argument("Receive strategies other than blocking require the blocking io backend");
+        UringTransport transport(sock, getUringOptions(), msg.data(), msg.size(), buf.get(), buf_size);
+        elapsed_sec = measureReplay(transport, recorders, class_of, config, msg);
+        io_stats = transport.stats;
+        break;
+    }
+    #endif
+    default:
+        throw std::invalid_argument("Unsupported io backend");
+    }
+    const double cpu_util = cpu.utilization();
+    LoopCounters counters = perf.read();
+    counters.setIo(io_stats);
+
+    close(sock);
+
+    // one output row per size class with its share of the throughput, then all requests, the counters cover all classes
+    bool print_header = FLAGS_print_header;
+    size_t num_requests = 0;
+    for (size_t c = 0; c < classes.size(); c++)
+    {
+        num_requests += recorders[c].count();
+        if (recorders[c].count() == 0) continue;
+        ExperimentConfig row = config;
+        row.size_class = std::to_string(classes[c].first) + ":" + std::to_string(classes[c].second);
+        row.client_config.msg_size = row.server_config.req_size = classes[c].first;
+        row.server_config.rsp_size = classes[c].second;
+        output_results(row, recorders[c], print_header, recorders[c].count() / elapsed_sec, cpu_util, counters);
+        print_header = false;
+    }
+
+    Recorder total(WarmupPolicy{0, 0}, num_requests, config.hdr_digits);
+    for (const auto &recorder : recorders)
+        total.merge(recorder);
+    output_results(config, total, print_header, num_requests / elapsed_sec, cpu_util, counters);
+}
+
+template <typename Recorder>
+void Client::runSealed(const ExperimentConfig &config)
+{
+    // the crypto time of both ends (server: reported in the response) and the rest of the roundtrip, one row per component,
+    // a sweep measures each size over the same connection with a fresh session key
+    const std::array<std::string, 4> components = { "rtt", "crypto", "crypto_server", "transport" };
+    const std::vector<size_t> sizes = config.sweep_sizes.empty() ? std::vector<size_t>{ config.client_config.msg_size } : config.sweep_sizes;
+    bool print_header = FLAGS_print_header;
+    for (const size_t size : sizes)
+    {
+        ExperimentConfig step = config;
+        if (!config.sweep_sizes.empty()) {
+            step = sweep_step(config, size);
+            seal_session_key(step.server_config);
+            reconfigure(step);
+        }
+
+        std::vector<Recorder> recorders;
+        for (size_t i = 0; i < components.size(); i++)
+            recorders.emplace_back(step.warmup(), step.num_samples, step.hdr_digits);
+        const auto raw = open_raw_dump(step, step.num_samples);
+        recorders[0].dumpTo(raw.get());
+
+        // the sealed request and the body of a response record, headers are read separately
+        RecordCipher cipher(step.server_config, false);
+        std::string sealed(sealed_size(step.client_config.msg_size, cipher.record_size), '\0');
+        const size_t record_len = cipher.maxRecord(step.server_config.rsp_size) + SEAL_TAG_LEN;
+        std::unique_ptr<char[]> record = std::make_unique<char[]>(record_len);
+
+        const CpuMeter cpu;
+        const PerfMeter perf(FLAGS_perf_counters);
+        switch (step.io)
+        {
+        case IoBackend::BLOCKING: {
+            if (shm) {
+                ShmTransport transport(*shm, false, sock, step.recv);
+                measureSealed(transport, recorders, cipher, step, sealed, record.get());
+                io_stats = transport.stats;
+                break;
+            }
+            BlockingTransport transport(sock, step.recv);
+            measureSealed(transport, recorders, cipher, step, sealed, record.get());
+            io_stats = transport.stats;
+            break;
+        }
+        #if HAVE_IO_URING
+        case IoBackend::URING: {
+            if (step.recv.strategy != RecvStrategy::BLOCKING)
+                throw std::invalid_argument("Receive strategies other than blocking require the blocking io backend");
+            UringTransport transport(sock, getUringOptions(), sealed.data(), sealed.size(), record.get(), record_len);
+            measureSealed(transport, recorders, cipher, step, sealed, record.get());
+            io_stats = transport.stats;
+            break;
+        }
+        #endif
+        default:
+            throw std::invalid_argument("Unsupported io backend");
+        }
+        const double cpu_util = cpu.utilization();
+        LoopCounters counters = perf.read();
+        counters.setIo(io_stats);
+
+        for (size_t i = 0; i < components.size(); i++)
+        {
+            ExperimentConfig row = step;
+            row.component = components[i];
+            output_results(row, recorders[i], print_header, 0, cpu_util, counters);
+            print_header = false;
+        }
+    }
+
+    close(sock);
+}
+
+template <typename Recorder>
+void Client::runDecomposed(const ExperimentConfig &config)
+{
+    // client and server timestamps share CLOCK_MONOTONIC as timebase, i.e. the clock timer
+    ExperimentConfig cfg = config;
+    cfg.timer = calibrate_timer(TimerSource::CLOCK);
+
+    // rtt, request path, server dwell, response path
+    const std::array<std::string, 4> components = { "rtt", "request", "dwell", "response" };
+    std::vector<Recorder> recorders;
+    for (size_t i = 0; i < components.size(); i++)
+        recorders.emplace_back(cfg.warmup(), cfg.num_samples, cfg.hdr_digits);
+
+    // raw samples of the roundtrips (component rtt)
+    const auto raw = open_raw_dump(cfg, cfg.num_samples);
+    recorders[0].dumpTo(raw.get());
+
+    std::string msg(cfg.client_config.msg_size, 'a');
+    const CpuMeter cpu;
+    const PerfMeter perf(FLAGS_perf_counters);
+    switch (cfg.io)
+    {
+    case IoBackend::BLOCKING: {
+        if (shm) {
+            ShmTransport transport(*shm, false, sock, cfg.recv);
+            const int64_t offset_ns = syncClock(transport, cfg, msg);
+            measureDecomposed(transport, recorders, cfg, msg, offset_ns);
+            io_stats = transport.stats;
+            break;
+        }
+        BlockingTransport transport(sock, cfg.recv);
+        const int64_t offset_ns = syncClock(transport, cfg, msg);
+        measureDecomposed(transport, recorders, cfg, msg, offset_ns);
+        io_stats = transport.stats;
+        break;
+    }
+    #if HAVE_IO_URING
+    case IoBackend::URING: {
+        if (cfg.recv.strategy != RecvStrategy::BLOCKING)
+            throw std::invalid_argument("Receive strategies other than blocking require the blocking io backend");
+        UringTransport transport(sock, getUringOptions(), msg.data(), msg.size(), buf.get(), buf_size);
+        const int64_t offset_ns = syncClock(transport, cfg, msg);
+        measureDecomposed(transport, recorders, cfg, msg, offset_ns);
+        io_stats = transport.stats;
+        break;
+    }
+    #endif
+    default:
+        throw std::invalid_argument("Unsupported io backend");
+    }
+    const double cpu_util = cpu.utilization();
+    LoopCounters counters = perf.read();
+    counters.setIo(io_stats);
+
+    close(sock);
+
+    // one output row per component
+    bool print_header = FLAGS_print_header;
+    for (size_t i = 0; i < components.size(); i++)
+    {
+        ExperimentConfig row = cfg;
+        row.component = components[i];
+        output_results(row, recorders[i], print_header, 0, cpu_util, counters);
+        print_header = false;
+    }
+}
+
+// NTP-style offset estimation: for each roundtrip (t0 send, t1 server receive, t2 server send, t3 receive)
+// offset = ((t1 - t0) + (t2 - t3)) / 2, taken from the roundtrip with the smallest network delay, as it
+// is the least distorted by queueing. The estimate assumes symmetric paths for that roundtrip.
+template <typename Transport>
+int64_t Client::syncClock(Transport &transport, const ExperimentConfig &config, std::string &msg)
+{
+    const size_t rsp_size = config.server_config.rsp_size;
+    if (rsp_size > buf_size)
+        throw std::runtime_error("Buffer size is smaller than response size");
+
+    int64_t best_delay = std::numeric_limits<int64_t>::max();
+    int64_t offset = 0;
+    for (size_t i = 0; i < config.sync_rounds; i++)
+    {
+        const int64_t t0 = monotonic_ns();
+        const int64_t rsp_len = transport.roundtripAll(msg.data(), msg.size(), buf.get(), rsp_size);
+        const int64_t t3 = monotonic_ns();
+        if (rsp_len != (int64_t) rsp_size) {
+            error("Clock sync failed, response incomplete");
+            throw std::runtime_error("Read failed");
+        }
+
+        ServerTimestamps ts;
+        std::memcpy(&ts, buf.get(), sizeof(ts));
+        const int64_t t1 = ts.request_rcvd, t2 = ts.response_sent;
+        const int64_t delay = (t3 - t0) - (t2 - t1);
+        if (delay < best_delay) {
+            best_delay = delay;
+            offset = ((t1 - t0) + (t2 - t3)) / 2;
+        }
+    }
+
+    logger("Clock offset to server: " + std::to_string(offset) + " ns (+/- " + std::to_string(best_delay / 2) + " ns, " +
+           std::to_string(config.sync_rounds) + " sync rounds)");
+    return offset;
+}
+
+// Each roundtrip is split with the server timestamps into request path (send until the server has read the request),
+// server dwell (read until response send) and response path (server send until the response is read completely).
+template <typename Transport, typename Recorder>
+void Client::measureDecomposed(Transport &transport, std::vector<Recorder> &recorders, const ExperimentConfig &config, std::string &msg, const int64_t offset_ns)
+{
+    constexpr size_t timeout_check_interval = 1000;
+    const size_t rsp_size = config.server_config.rsp_size;
+    const double timeout_ns = config.timeout_sec * 1e9;
+    logger("Measuring decomposed RTT for " + std::to_string(config.num_samples) + " samples...");
+
+    const int64_t start = monotonic_ns();
+    for (size_t i = 0; i < config.num_samples; i++)
+    {
+        const int64_t t0 = monotonic_ns();
+        const int64_t rsp_len = transport.roundtripAll(msg.data(), msg.size(), buf.get(), rsp_size);
+        const int64_t t3 = monotonic_ns();
+        if (rsp_len != (int64_t) rsp_size) [[unlikely]] {
+            if (rsp_len < 0)
+                error("Read failed. Error: " + std::string(strerror(errno)));
+            else
+                error("Read failed. Peer disconnected.");
+            throw std::runtime_error("Read failed");
+        }
+
+        // server timestamps in client time
+        ServerTimestamps ts;
+        std::memcpy(&ts, buf.get(), sizeof(ts));
+        const int64_t t1 = (int64_t) ts.request_rcvd - offset_ns;
+        const int64_t t2 = (int64_t) ts.response_sent - offset_ns;
+
+        recorders[0].record((t3 - t0) / 1000.0);
+        recorders[1].record((t1 - t0) / 1000.0);
+        recorders[2].record((t2 - t1) / 1000.0);
+        recorders[3].record((t3 - t2) / 1000.0);
+
+        // check timeout
+        if (timeout_ns > 0 && (i + 1) % timeout_check_interval == 0 && t3 - start >= timeout_ns) [[unlikely]]
+        {
+            logger("Timeout reached after " + std::to_string(i + 1) + " samples");
+            break;
+        }
+    }
+}
+
+// Keeps up to pipeline_depth requests in flight on a non-blocking socket: the window is refilled as
+// soon as responses arrive, and sending never blocks reading (no deadlock with large messages).
+// Latency of a request is measured from the start of its send until its response is complete.
+template <typename Recorder>
+void Client::measurePipelined(Recorder &recorder, const ExperimentConfig &config, std::string &msg, double &achieved_rate)
+{
+    using clock = std::chrono::steady_clock;
+    const size_t depth = config.pipeline_depth;
+    const size_t num_requests = config.num_samples;
+    const size_t msg_size = msg.size();
+    const size_t rsp_size = config.server_config.rsp_size;
+    if (depth == 0 || num_requests == 0) {
+        error("Invalid pipeline depth: " + std::to_string(depth));
+        throw std::runtime_error("Invalid pipeline depth");
+    }
+
+    const int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    io_stats = IoStats();
+
+    // send timestamps of the outstanding requests, indexed by sequence number % depth
+    std::vector<clock::time_point> send_ts(depth);
+    size_t sent = 0, send_off = 0;      // complete requests sent, bytes of the current one
+    size_t received = 0, rcvd_off = 0;  // complete responses received, bytes of the current one
+    constexpr size_t timeout_check_interval = 1000;
+    size_t next_timeout_check = timeout_check_interval;
+
+    logger("Measuring pipelined RTT with depth " + std::to_string(depth) + " for up to " + std::to_string(num_requests) + " requests...");
+
+    const clock::time_point start = clock::now();
+    clock::time_point end = start;
+    size_t limit = num_requests;  // lowered on timeout
+    while (received < limit)
+    {
+        // fill the window
+        bool can_send = true;
+        while (sent < limit && sent - received < depth)
+        {
+            if (send_off == 0) send_ts[sent % depth] = clock::now();
+            const ssize_t n = ::send(sock, msg.data() + send_off, msg_size - send_off, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) { can_send = false; break; }
+                if (errno == EINTR) continue;
+                error("Send failed. Error: " + std::string(strerror(errno)));
+                throw std::runtime_error("Send failed");
+            }
+            send_off += n;
+            if (send_off == msg_size) {
+                sent++;
+                send_off = 0;
+            } else {
+                io_stats.partial_writes++;
+            }
+        }
+
+        // collect responses, several may arrive with one read
+        const ssize_t n = ::read(sock, buf.get(), buf_size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                error("Read failed. Error: " + std::string(strerror(errno)));
+                throw std::runtime_error("Read failed");
+            }
+            // wait until there is something to read, or room to send the rest of the window
+            struct pollfd pfd = { sock, POLLIN, 0 };
+            if (!can_send) pfd.events |= POLLOUT;
+            poll(&pfd, 1, -1);
+            continue;
+        }
+        if (n == 0) {
+            error("Read failed. Peer disconnected.");
+            throw std::runtime_error("Read failed");
+        }
+
+        rcvd_off += n;
+        end = clock::now();
+        for (; rcvd_off >= rsp_size && received < sent; rcvd_off -= rsp_size, received++)
+            recorder.record(std::chrono::duration<double, std::micro>(end - send_ts[received % depth]).count());
+        if (rcvd_off > 0) io_stats.partial_reads++;  // the next response is incomplete
+
+        // check timeout: stop sending, drain what is in flight
+        if (config.timeout_sec > 0 && received >= next_timeout_check) {
+            next_timeout_check += timeout_check_interval;
+            if (std::chrono::duration<double>(end - start).count() >= config.timeout_sec) [[unlikely]] {
+                logger("Timeout reached after " + std::to_string(received) + " samples");
+                limit = sent + (send_off ? 1 : 0);  // a partially sent request is completed
+            }
+        }
+    }
+
+    fcntl(sock, F_SETFL, flags);
+    achieved_rate = received / std::chrono::duration<double>(end - start).count();
+}
+
+// Requests are sent by a pacing thread at their intended times, independent of the responses.
+// Latency is measured from the intended send time, so a stalled sender (coordinated omission)
+// is charged to the requests that were due during the stall.
+template <typename Recorder>
+void Client::measureOpenLoop(Recorder &recorder, const ExperimentConfig &config, std::string &msg, double &achieved_rate)
+{
+    using clock = std::chrono::steady_clock;
+    const double rate = config.target_rate;
+    const size_t rsp_size = config.server_config.rsp_size;
+    const size_t num_requests = std::min(config.num_samples, static_cast<size_t>(rate * config.step_duration_sec));
+    if (rate <= 0 || num_requests == 0) {
+        error("Invalid rate step: " + std::to_string(rate));
+        throw std::runtime_error("Invalid rate step");
+    }
+
+    // precompute the schedule (offsets from the step start)
+    std::vector<clock::duration> schedule(num_requests);
+    std::mt19937_64 rng(FLAGS_arrival_seed);
+    std::exponential_distribution<double> exp_dist(rate);
+    double t_sec = 0;
+    for (size_t i = 0; i < num_requests; i++) {
+        schedule[i] = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(t_sec));
+        t_sec += config.arrival == ArrivalProcess::POISSON ? exp_dist(rng) : 1.0 / rate;
+    }
+
+    logger("Measuring open loop latency at " + std::to_string(rate) + " req/s (" + to_string(config.arrival) + ") for " + std::to_string(num_requests) + " requests...");
+
+    const clock::time_point start = clock::now() + std::chrono::milliseconds(1);  // let the sender spin up
+    std::atomic<bool> failed(false);
+    io_stats = IoStats();
+
+    std::thread sender([&]() {
+        for (size_t i = 0; i < num_requests && !failed.load(std::memory_order_relaxed); i++)
+        {
+            // sleep while far ahead of schedule, spin for the last stretch
+            const clock::time_point due = start + schedule[i];
+            clock::time_point now;
+            while ((now = clock::now()) < due) {
+                if (due - now > std::chrono::microseconds(200))
+                    std::this_thread::sleep_for(due - now - std::chrono::microseconds(100));
+                else
+                    cpu_relax();
+            }
+
+            size_t iter;
+            if (sendall_dbg(sock, msg, iter) != (int64_t) msg.size()) [[unlikely]] {
+                error("Send failed. Error: " + std::string(strerror(errno)));
+                failed = true;
+                return;
+            }
+            io_stats.partial_writes += iter - 1;
+        }
+    });
+
+    // responses arrive in request order
+    clock::time_point end = start;
+    size_t received = 0;
+    for (; received < num_requests; received++)
+    {
+        size_t iter;
+        const int64_t rsp_len = readall_dbg(sock, buf.get(), rsp_size, iter);
+        if (rsp_len != (int64_t) rsp_size) [[unlikely]] {
+            if (rsp_len < 0)
+                error("Read failed. Error: " + std::string(strerror(errno)));
+            else
+                error("Read failed. Peer disconnected.");
+            failed = true;
+            break;
+        }
+        end = clock::now();
+        io_stats.partial_reads += iter - 1;
+        recorder.record(std::chrono::duration<double, std::micro>(end - (start + schedule[received])).count());
+    }
+
+    if (failed) shutdown(sock, SHUT_RDWR);  // unblock the sender
+    sender.join();
+    if (failed) throw std::runtime_error("Open loop measurement failed");
+
+    achieved_rate = num_requests / std::chrono::duration<double>(end - start).count();
+}
+
+template <typename Transport, typename Recorder>
+void Client::measure(Transport &transport, Recorder &recorder, const ExperimentConfig &config, std::string &msg)
+{
+    switch (config.timer.source)
+    {
+    #if HAVE_TSC_TIMER
+    case TimerSource::TSC:
+        measure(transport, recorder, TscTimer(config.timer.ticks_per_us), config, msg);
+        break;
+    #endif
+    case TimerSource::CLOCK:
+        measure(transport, recorder, ClockTimer(), config, msg);
+        break;
+    default:
+        throw std::invalid_argument("Unsupported timer");
+    }
+}
+
+template <typename Transport, typename Recorder, typename Timer>
+void Client::measure(Transport &transport, Recorder &recorder, const Timer &timer, const ExperimentConfig &config, std::string &msg)
+{
+    if (config.server_config.framed)
+        measureFramed(transport, recorder, timer, config, msg);
+    else if (config.client_config.msg_size > THRESH_LARGE_MSG || config.server_config.rsp_size > THRESH_LARGE_MSG)
+        measureRTTLarge(transport, recorder, timer, config.num_samples, msg, config.server_config.rsp_size, config.timeout_sec ? config.timeout_sec : 10.0);
+    else
+        if (config.timeout_sec == 0)
+            measureRTT(transport, recorder, timer, config.num_samples, msg);
+        else
+            measureRTT(transport, recorder, timer, config.num_samples, msg, config.timeout_sec);
+}
+
+template <typename Transport, typename Recorder, typename Timer>
+void Client::measureRTT(Transport &transport, Recorder &recorder, const Timer &timer, const size_t num_samples, std::string &msg)
+{
+    // allocations for RTT measurement
+    uint64_t start;
+    uint64_t end;
+
+    logger("Measuring RTT for " + std::to_string(num_samples) + " samples...");
+
+    const size_t msg_size = msg.size();
+    int rsp_len;
+
+    for (size_t i = 0; i < num_samples; i++)
+    {
+
+        // capture start ts
+        start = timer.start();
+
+        // Send message to server and receive its response
+        rsp_len = transport.roundtrip(msg.data(), msg_size, buf.get(), buf_size);
+        #ifdef DEBUG
+        logger("Response from server: " + std::to_string(rsp_len) + " (" + std::string(buf.get()) + ")");
+        #endif
+
+        // measure RTT
+        end = timer.stop();
+        recorder.record(timer.toUs(end - start));
+
+        #ifdef DEBUG
+        // modify msg
+        msg[i % msg_size] += ((msg[i % msg_size] - 'a' + 1) % 26 + 'a');  // rotate through alphabet
+        #endif
+    }
+}
+
+template <typename Transport, typename Recorder, typename Timer>
+void Client::measureRTT(Transport &transport, Recorder &recorder, const Timer &timer, const size_t num_max_samples, std::string &msg, const double timeout_sec)
+{
     constexpr size_t timeout_check_interval = 1000;
     if (num_max_samples % timeout_check_interval != 0)
     {
@@ -571,46 +2275,86 @@ std::vector<double> Client::measureRTTLarge(const size_t num_max_samples, const
     }
 
     // allocations for RTT measurement and timeout
-    std::chrono::duration<double, std::micro> rtt;
-    std::chrono::time_point<std::chrono::high_resolution_clock> start;
-    std::chrono::time_point<std::chrono::high_resolution_clock> last;
-    std::chrono::time_point<std::chrono::high_resolution_clock> end;
+    uint64_t start;
+    uint64_t last;
+    uint64_t end;
 
     logger("Measuring RTT for up to " + std::to_string(num_max_samples) + " samples or " + std::to_string(timeout_sec) + " seconds...");
 
-    std::string msg(msg_size, 'a');
-    int64_t rsp_len;
-    int64_t rc_send;
+    const size_t msg_size = msg.size();
+    int rsp_len;
 
-    start = std::chrono::high_resolution_clock::now();
+    start = timer.start();
     for (size_t i = 0; i < num_max_samples; i += timeout_check_interval)
     {
         for (size_t j = 0; j < timeout_check_interval; j++)
         {
 
             // capture start ts
-            last = std::chrono::high_resolution_clock::now();
+            last = timer.start();
 
-            #ifdef DEGUG
-            size_t iter = 0;
-            rc_send = sendall_dbg(sock, msg, iter);
-            #else
-            rc_send = sendall(sock, msg);
-            #endif
-            if (rc_send != msg_size) [[unlikely]] {
-                error("Send failed. Error: " + std::string(strerror(errno)));
-                throw std::runtime_error("Send failed");
-            }
+            // Send message to server and receive its response
+            rsp_len = transport.roundtrip(msg.data(), msg_size, buf.get(), buf_size);
             #ifdef DEBUG
-            logger("Message sent to server in " + std::to_string(iter) + " iterations.");
+            logger("Response from server: " + std::to_string(rsp_len) + " (" + std::string(buf.get()) + ")");
             #endif
 
-            // Receive message from server
+            // measure RTT
+            end = timer.stop();
+            recorder.record(timer.toUs(end - last));
+
             #ifdef DEBUG
-            rsp_len = readall_dbg(sock, buf.get(), rsp_exp_size, iter);
-            #else
-            rsp_len = readall(sock, buf.get(), rsp_exp_size);
+            // modify msg
+            msg[i % msg_size] += ((msg[i % msg_size] - 'a' + 1) % 26 + 'a');  // rotate through alphabet
             #endif
+        }
+
+        // check timeout
+        if (timer.toUs(end - start) >= timeout_sec * 1e6) [[unlikely]]
+        {
+            logger("Timeout reached after " + std::to_string(i+timeout_check_interval) + " samples");
+            break;
+        }
+
+    }
+}
+
+template <typename Transport, typename Recorder, typename Timer>
+void Client::measureRTTLarge(Transport &transport, Recorder &recorder, const Timer &timer, const size_t num_max_samples, std::string &msg, const size_t rsp_exp_size, const double timeout_sec)
+{
+    // sanity check
+    if (rsp_exp_size > buf_size) {
+        error("Internal buffer size is smaller than expected response size");
+        throw std::runtime_error("Buffer size is smaller than response size");
+    }
+
+    constexpr size_t timeout_check_interval = 1000;
+    if (num_max_samples % timeout_check_interval != 0)
+    {
+        error("WARNING: num_max_samples should be a multiple of timeout_check_interval=" + std::to_string(timeout_check_interval));
+    }
+
+    // allocations for RTT measurement and timeout
+    uint64_t start;
+    uint64_t last;
+    uint64_t end;
+
+    logger("Measuring RTT for up to " + std::to_string(num_max_samples) + " samples or " + std::to_string(timeout_sec) + " seconds...");
+
+    const size_t msg_size = msg.size();
+    int64_t rsp_len;
+
+    start = timer.start();
+    for (size_t i = 0; i < num_max_samples; i += timeout_check_interval)
+    {
+        for (size_t j = 0; j < timeout_check_interval; j++)
+        {
+
+            // capture start ts
+            last = timer.start();
+
+            // Send message to server and receive the complete response
+            rsp_len = transport.roundtripAll(msg.data(), msg_size, buf.get(), rsp_exp_size);
             if (rsp_len != rsp_exp_size) [[unlikely]] {
                 if (rsp_len < 0)
                     error("Read failed. Error: " + std::string(strerror(errno)));
@@ -619,13 +2363,12 @@ std::vector<double> Client::measureRTTLarge(const size_t num_max_samples, const
                 throw std::runtime_error("Read failed");
             }
             #ifdef DEBUG
-            logger("Response from server in " + std::to_string(iter) + " iterations: " + std::to_string(rsp_len) + " (" + std::string(buf.get()) + ")");
+            logger("Response from server: " + std::to_string(rsp_len) + " (" + std::string(buf.get()) + ")");
             #endif
 
             // measure RTT
-            end = std::chrono::high_resolution_clock::now();
-            rtt = end - last;
-            rtt_samples.push_back(rtt.count());
+            end = timer.stop();
+            recorder.record(timer.toUs(end - last));
 
             #ifdef DEBUG
             // modify msg
@@ -634,16 +2377,239 @@ std::vector<double> Client::measureRTTLarge(const size_t num_max_samples, const
         }
 
         // check timeout
-        if (std::chrono::duration<double>(end - start).count() >= timeout_sec) [[unlikely]]
+        if (timer.toUs(end - start) >= timeout_sec * 1e6) [[unlikely]]
         {
             logger("Timeout reached after " + std::to_string(i+timeout_check_interval) + " samples");
             break;
         }
 
     }
+}
 
-    rtt_samples.shrink_to_fit();
-    return rtt_samples;
+// framed protocol: the response header is checked in place in the receive buffer
+static void check_response_frame(const char *buf, const int64_t rsp_len, const uint32_t rsp_size, const uint32_t seq)
+{
+    const FrameHeader &rsp = *reinterpret_cast<const FrameHeader*>(buf);
+    if (rsp_len != (int64_t) rsp_size || rsp.magic != FRAME_MAGIC || rsp.seq != seq || rsp.size != rsp_size) [[unlikely]] {
+        if (rsp_len < 0)
+            error("Read failed. Error: " + std::string(strerror(errno)));
+        else if (rsp_len != (int64_t) rsp_size)
+            error("Read failed. Peer disconnected.");
+        else
+            error("Unexpected response frame (seq " + std::to_string(rsp.seq) + ", size " + std::to_string(rsp.size) + ") to request " + std::to_string(seq));
+        throw std::runtime_error("Read failed");
+    }
+}
+
+template <typename Transport, typename Recorder, typename Timer>
+void Client::measureFramed(Transport &transport, Recorder &recorder, const Timer &timer, const ExperimentConfig &config, std::string &msg)
+{
+    // the response size is known from the request, i.e. every response is read completely at any size
+    const size_t rsp_size = config.server_config.rsp_size;
+    if (rsp_size > buf_size) {
+        error("Internal buffer size is smaller than expected response size");
+        throw std::runtime_error("Buffer size is smaller than response size");
+    }
+
+    constexpr size_t timeout_check_interval = 1000;
+    const double timeout_sec = config.timeout_sec ? config.timeout_sec : std::numeric_limits<double>::infinity();
+    logger("Measuring framed RTT for up to " + std::to_string(config.num_samples) + " samples or " + std::to_string(timeout_sec) + " seconds...");
+
+    uint64_t start = timer.start();
+    uint64_t last;
+    uint64_t end = start;
+    for (size_t i = 0; i < config.num_samples; i++)
+    {
+        const uint32_t seq = static_cast<uint32_t>(i);
+        put_frame_header(msg.data(), make_frame_header(seq, msg.size(), rsp_size));
+
+        // capture start ts
+        last = timer.start();
+
+        // Send the request frame and receive the complete response frame
+        const int64_t rsp_len = transport.roundtripAll(msg.data(), msg.size(), buf.get(), rsp_size);
+
+        // measure RTT
+        end = timer.stop();
+        check_response_frame(buf.get(), rsp_len, rsp_size, seq);
+        recorder.record(timer.toUs(end - last));
+
+        // check timeout
+        if ((i + 1) % timeout_check_interval == 0 && timer.toUs(end - start) >= timeout_sec * 1e6) [[unlikely]]
+        {
+            logger("Timeout reached after " + std::to_string(i + 1) + " samples");
+            break;
+        }
+    }
+}
+
+template <typename Transport, typename Recorder>
+double Client::measureReplay(Transport &transport, std::vector<Recorder> &recorders, const std::vector<size_t> &class_of, const ExperimentConfig &config, std::string &msg)
+{
+    switch (config.timer.source)
+    {
+    #if HAVE_TSC_TIMER
+    case TimerSource::TSC:
+        return measureReplay(transport, recorders, class_of, TscTimer(config.timer.ticks_per_us), config, msg);
+    #endif
+    case TimerSource::CLOCK:
+        return measureReplay(transport, recorders, class_of, ClockTimer(), config, msg);
+    default:
+        throw std::invalid_argument("Unsupported timer");
+    }
+}
+
+template <typename Transport, typename Recorder, typename Timer>
+double Client::measureReplay(Transport &transport, std::vector<Recorder> &recorders, const std::vector<size_t> &class_of, const Timer &timer, const ExperimentConfig &config, std::string &msg)
+{
+    using clock = std::chrono::steady_clock;
+    const std::vector<TraceEntry> &trace = *config.replay;
+    const size_t warmup = config.warmup().of(config.num_samples);
+    constexpr size_t timeout_check_interval = 1000;
+    const double timeout_sec = config.timeout_sec ? config.timeout_sec : std::numeric_limits<double>::infinity();
+    logger("Replaying up to " + std::to_string(config.num_samples) + " requests or " + std::to_string(timeout_sec) + " seconds...");
+
+    // requests are due gap_us after the previous one, or sent right after the previous response when behind
+    clock::time_point due = clock::now();
+    clock::time_point recorded_begin = due;  // throughput of the recorded requests
+    uint64_t start = timer.start();
+    uint64_t last;
+    uint64_t end = start;
+    size_t i = 0;
+    while (i < config.num_samples)
+    {
+        const TraceEntry &entry = trace[i % trace.size()];
+        if (entry.gap_us > 0) {
+            // sleep while far ahead of schedule, spin for the last stretch
+            due += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::micro>(entry.gap_us));
+            clock::time_point now;
+            while ((now = clock::now()) < due) {
+                if (due - now > std::chrono::microseconds(200))
+                    std::this_thread::sleep_for(due - now - std::chrono::microseconds(100));
+                else
+                    cpu_relax();
+            }
+        }
+
+        const uint32_t seq = static_cast<uint32_t>(i);
+        put_frame_header(msg.data(), make_frame_header(seq, entry.req_size, entry.rsp_size));
+        if (i == warmup) [[unlikely]] recorded_begin = clock::now();
+
+        // capture start ts
+        last = timer.start();
+
+        // Send the request frame and receive the complete response frame
+        const int64_t rsp_len = transport.roundtripAll(msg.data(), entry.req_size, buf.get(), entry.rsp_size);
+
+        // measure RTT, warmup requests are not recorded in any class
+        end = timer.stop();
+        check_response_frame(buf.get(), rsp_len, entry.rsp_size, seq);
+        if (i >= warmup) [[likely]]
+            recorders[class_of[i % trace.size()]].record(timer.toUs(end - last), entry.req_size, entry.rsp_size);
+        i++;
+
+        // check timeout
+        if (i % timeout_check_interval == 0 && timer.toUs(end - start) >= timeout_sec * 1e6) [[unlikely]]
+        {
+            logger("Timeout reached after " + std::to_string(i) + " requests");
+            break;
+        }
+    }
+
+    return std::chrono::duration<double>(clock::now() - recorded_begin).count();
+}
+
+template <typename Transport, typename Recorder>
+void Client::measureSealed(Transport &transport, std::vector<Recorder> &recorders, RecordCipher &cipher, const ExperimentConfig &config, std::string &sealed, char *record)
+{
+    switch (config.timer.source)
+    {
+    #if HAVE_TSC_TIMER
+    case TimerSource::TSC:
+        measureSealed(transport, recorders, cipher, TscTimer(config.timer.ticks_per_us), config, sealed, record);
+        break;
+    #endif
+    case TimerSource::CLOCK:
+        measureSealed(transport, recorders, cipher, ClockTimer(), config, sealed, record);
+        break;
+    default:
+        throw std::invalid_argument("Unsupported timer");
+    }
+}
+
+// Each roundtrip seals the request, sends it, and reads and opens the response record by record. The client crypto
+// time is taken around seal and open, the server crypto time comes with the response, transport is the rest of the rtt.
+template <typename Transport, typename Recorder, typename Timer>
+void Client::measureSealed(Transport &transport, std::vector<Recorder> &recorders, RecordCipher &cipher, const Timer &timer, const ExperimentConfig &config, std::string &sealed, char *record)
+{
+    const std::string msg(config.client_config.msg_size, 'a');
+    const size_t rsp_size = config.server_config.rsp_size;
+    const size_t max_record = cipher.maxRecord(rsp_size);
+    constexpr size_t timeout_check_interval = 1000;
+    const double timeout_sec = config.timeout_sec ? config.timeout_sec : std::numeric_limits<double>::infinity();
+    logger("Measuring sealed (" + to_string(config.server_config.seal) + ") RTT for up to " + std::to_string(config.num_samples) +
+           " samples or " + std::to_string(timeout_sec) + " seconds...");
+
+    auto fail = [](const int64_t len, const std::string &what) {
+        if (len < 0)
+            error("Read failed. Error: " + std::string(strerror(errno)));
+        else if (what.empty())
+            error("Read failed. Peer disconnected.");
+        else
+            error("Invalid response: " + what);
+        throw std::runtime_error("Read failed");
+    };
+
+    const uint64_t start = timer.start();
+    uint64_t end = start;
+    for (size_t i = 0; i < config.num_samples; i++)
+    {
+        // seal and send the request
+        const uint64_t t0 = timer.start();
+        const size_t req_len = cipher.seal(msg.data(), msg.size(), sealed.data());
+        const uint64_t t1 = timer.stop();
+        if (transport.write(sealed.data(), req_len) != (int64_t) req_len) [[unlikely]] {
+            error("Send failed. Error: " + std::string(strerror(errno)));
+            throw std::runtime_error("Send failed");
+        }
+
+        // read and open the response records
+        uint64_t open_ticks = 0;
+        uint32_t server_ns = 0;
+        size_t rcvd = 0;
+        SealHeader hdr;
+        do {
+            int64_t len = transport.readall(reinterpret_cast<char*>(&hdr), sizeof(hdr));
+            if (len != (int64_t) sizeof(hdr)) [[unlikely]] fail(len, "");
+            if (!cipher.check(hdr, std::min(max_record, rsp_size - rcvd))) [[unlikely]]
+                fail(len, "record seq " + std::to_string(hdr.seq) + ", " + std::to_string(hdr.len) + " bytes");
+            if (rcvd == 0) server_ns = hdr.crypto_ns;
+            if ((len = transport.readall(record, hdr.len + SEAL_TAG_LEN)) != (int64_t) (hdr.len + SEAL_TAG_LEN)) [[unlikely]] fail(len, "");
+
+            const uint64_t open_start = timer.stop();
+            if (!cipher.open(hdr, record)) [[unlikely]]
+                fail(len, "record seq " + std::to_string(hdr.seq) + " failed authentication");
+            open_ticks += timer.stop() - open_start;
+            rcvd += hdr.len;
+        } while (!(hdr.flags & SEAL_LAST));
+        end = timer.stop();
+        if (rcvd != rsp_size) [[unlikely]]
+            fail(rcvd, std::to_string(rcvd) + " of " + std::to_string(rsp_size) + " bytes");
+
+        const double rtt_us = timer.toUs(end - t0);
+        const double crypto_us = timer.toUs(t1 - t0 + open_ticks) + server_ns / 1000.0;
+        recorders[0].record(rtt_us);
+        recorders[1].record(crypto_us);
+        recorders[2].record(server_ns / 1000.0);
+        recorders[3].record(rtt_us - crypto_us);
+
+        // check timeout
+        if ((i + 1) % timeout_check_interval == 0 && timer.toUs(end - start) >= timeout_sec * 1e6) [[unlikely]]
+        {
+            logger("Timeout reached after " + std::to_string(i + 1) + " samples");
+            break;
+        }
+    }
 }
 
 // main
@@ -657,6 +2623,24 @@ int main(int argc, char *argv[]) {
     ExperimentConfig config;
     parseExperimentConfig(config);
 
+    if (config.server_config.workload == Workload::SCAN)
+    {
+        Client::runScan(config, FLAGS_address, FLAGS_port);
+        return rc;
+    }
+
+    if (config.server_config.workload != Workload::LATENCY)
+    {
+        Client::runBandwidth(config, FLAGS_address, FLAGS_port);
+        return rc;
+    }
+
+    if (config.connections > 1 || config.threads > 1 || !config.cpus.empty())
+    {
+        Client::runConcurrent(config, FLAGS_address, FLAGS_port);
+        return rc;
+    }
+
     auto client = Client::make(config.protocol, FLAGS_address, FLAGS_port, config.client_config.buf_size);
     // Client client(getProtocol(), FLAGS_address, FLAGS_port, FLAGS_buf_size);
     client->run(config);
@@ -0,0 +1,260 @@
+// app/Memory.cpp
+// Memory microbenchmark: STREAM bandwidth, pointer-chasing latency over a ladder of working sets and TLB pressure
+// with 4 KiB vs 2 MiB pages, for the same binary on the host and inside the enclave.
+#include "Memory.hpp"
+
+#include "chrono"
+#include "vector"
+#include "fstream"
+#include "sstream"
+#include "iostream"
+#include "memory"
+#include <ctime>
+
+#include "gflags/gflags.h"
+
+#include "Bench.hpp"
+#include "Logger.hpp"
+#include "Utilities.hpp"
+
+DEFINE_string(benchmarks, "stream,latency,tlb", "Comma-separated benchmarks to run: stream (bandwidth), latency (pointer chase, one node per cache line), tlb (pointer chase, one node per page)");
+DEFINE_string(threads, "1", "Comma-separated thread counts, one output row per count");
+DEFINE_string(cpus, "", "Comma-separated cores to pin the threads to (thread i on cpus[i % n]), empty: no pinning");
+DEFINE_string(simd, "auto", "Stream only: comma-separated kernels, scalar (plain loops), avx2, avx512 or auto (widest supported by the cpu), one output row per kernel");
+DEFINE_bool(nt_stores, false, "Stream only: non-temporal stores in the avx2/avx512 kernels (no read for ownership of the written lines)");
+DEFINE_string(page_sizes, "4k,2m", "Comma-separated page sizes: 4k (THP disabled) or 2m (reserved huge pages, otherwise transparent huge pages), one output row per page size");
+DEFINE_uint64(stream_size, 256ul << 20, "Stream only: bytes per array (a, b, c), split between the threads");
+DEFINE_string(working_sets, "4096..1073741824", "Latency and tlb only: comma-separated ring sizes per thread [B] or doubling ranges lo..hi, one output row per size");
+DEFINE_uint64(loads, 1 << 22, "Latency and tlb only: dependent loads per thread and repetition");
+DEFINE_uint32(repetitions, 5, "Measured repetitions of every run");
+DEFINE_uint32(warmup_repetitions, 1, "Repetitions before the measured ones");
+DEFINE_uint64(seed, 42, "Seed of the pointer rings");
+DEFINE_bool(output_outliers, false, "Output outliers in the results");
+DEFINE_string(outfile, "", "Output file for results");
+DEFINE_bool(print_header, true, "Print header in output file");
+DEFINE_string(line_prefix, "", "Prefix of every output line, e.g. to extract the results from the enclave console");
+DEFINE_string(variant, "", "Label of the measured setup in the variant column, e.g. host or enclave");
+DEFINE_bool(perf_counters, false, "Count cycles, instructions, cache misses (perf_event_open), page faults and context switches of all threads of the measured repetitions");
+
+struct MemoryConfig {
+    std::string benchmark;
+    std::string kernel;       // stream kernel or chase
+    std::string variant;
+    SimdLevel simd = SimdLevel::SCALAR;
+    bool nt_stores = false;
+    PageSize page;
+    std::string pages;        // actual backing of the region
+    double huge_pages_pct = 0;
+    size_t threads;
+    std::vector<int> cpus;
+    size_t working_set = 0;   // stream: all arrays, latency/tlb: ring per thread [B]
+    size_t bytes = 0;         // stream: bytes read and written per repetition
+    size_t loads = 0;         // latency/tlb: dependent loads per thread and repetition
+    size_t repetitions;
+    size_t warmup_repetitions;
+
+    static std::string csv_header();
+    std::string to_csv() const;
+};
+
+std::string MemoryConfig::csv_header() {
+    return "benchmark,kernel,variant,simd,nt_stores,page_size,pages,huge_pages_pct,threads,working_set,bytes,loads,repetitions,warmup_repetitions";
+}
+
+std::string MemoryConfig::to_csv() const {
+    std::ostringstream oss;
+    oss << benchmark << ","
+        << kernel << ","
+        << variant << ","
+        << to_string(simd) << ","
+        << nt_stores << ","
+        << to_string(page) << ","
+        << pages << ","
+        << huge_pages_pct << ","
+        << threads << ","
+        << working_set << ","
+        << bytes << ","
+        << loads << ","
+        << repetitions << ","
+        << warmup_repetitions;
+    return oss.str();
+}
+
+// comma-separated sizes, lo..hi expands to lo, 2*lo, 4*lo, ... up to hi
+std::vector<size_t> parseSizes(const std::string &str) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.empty()) continue;
+        const size_t range = item.find("..");
+        if (range == std::string::npos) {
+            sizes.push_back(std::stoull(item));
+            continue;
+        }
+        const size_t lo = std::stoull(item.substr(0, range));
+        const size_t hi = std::stoull(item.substr(range + 2));
+        if (lo == 0 || hi < lo)
+            throw std::invalid_argument("Invalid size range " + item);
+        for (size_t size = lo; size <= hi; size *= 2)
+            sizes.push_back(size);
+    }
+    return sizes;
+}
+
+// Times warmup + measured repetitions of run() and records each repetition divided by per_rep [us],
+// e.g. the loads of a pointer chase. throughput: work per second at the median repetition, stream: bytes,
+// latency/tlb: loads of all threads
+template <typename Run>
+void measure(const MemoryConfig &config, bool &print_header, const double per_rep, const double work, Run run)
+{
+    const BenchResult result = measure_repetitions(config.benchmark, config.warmup_repetitions, config.repetitions, per_rep,
+                                                   FLAGS_perf_counters, FLAGS_output_outliers, [&]() { run(); return uint64_t(0); });
+    output_bench_results(config, result, work, print_header, FLAGS_outfile, FLAGS_line_prefix);
+    print_header = false;
+}
+
+// first element of the part of thread t, a multiple of 8 elements (a cache line, aligned for the SIMD kernels)
+size_t stream_begin(const size_t n, const size_t t, const size_t threads)
+{
+    return t == threads ? n : n * t / threads / 8 * 8;
+}
+
+// copy, scale, add and triad per thread count and kernel, every thread works on its own part of the arrays
+void runStream(MemoryConfig base, const std::vector<size_t> &threads, const std::vector<SimdLevel> &levels, bool &print_header)
+{
+    const size_t n = FLAGS_stream_size / sizeof(double);
+    if (n < 8)
+        throw std::invalid_argument("stream_size must be at least 64 bytes");
+    const MappedRegion a_region(n * sizeof(double), base.page), b_region(n * sizeof(double), base.page), c_region(n * sizeof(double), base.page);
+    double *a = reinterpret_cast<double*>(a_region.data());
+    double *b = reinterpret_cast<double*>(b_region.data());
+    double *c = reinterpret_cast<double*>(c_region.data());
+
+    for (const size_t t : threads) {
+        for (const SimdLevel level : levels) {
+            // (re)initialized by the threads of the run, the first run places the pages (first touch)
+            run_parallel(t, base.cpus, [&](const size_t thread) {
+                for (size_t i = stream_begin(n, thread, t); i < stream_begin(n, thread + 1, t); i++) {
+                    a[i] = 1.0;
+                    b[i] = 2.0;
+                    c[i] = 0.0;
+                }
+            });
+
+            for (const StreamKernel kernel : { StreamKernel::COPY, StreamKernel::SCALE, StreamKernel::ADD, StreamKernel::TRIAD }) {
+                MemoryConfig config = base;
+                config.kernel = to_string(kernel);
+                config.simd = level;
+                config.nt_stores = FLAGS_nt_stores && level != SimdLevel::SCALAR;
+                config.pages = a_region.backing;
+                config.huge_pages_pct = (a_region.hugePct() + b_region.hugePct() + c_region.hugePct()) / 3;
+                config.threads = t;
+                config.working_set = 3 * n * sizeof(double);
+                config.bytes = stream_arrays(kernel) * n * sizeof(double);
+                measure(config, print_header, 1, config.bytes, [&]() {
+                    run_parallel(t, config.cpus, [&](const size_t thread) {
+                        stream(kernel, level, config.nt_stores, a, b, c, stream_begin(n, thread, t), stream_begin(n, thread + 1, t));
+                    });
+                });
+            }
+
+            // every kernel is idempotent: c = a = 1, b = s * c = 3, c = a + b = 4, a = b + s * c = 15
+            for (size_t i = 0; i < n; i++) {
+                if (a[i] != 15.0 || b[i] != 3.0 || c[i] != 4.0) {
+                    error("Stream arrays have unexpected values at element " + std::to_string(i));
+                    throw std::runtime_error("Wrong stream result");
+                }
+            }
+        }
+    }
+}
+
+// every thread chases its own ring of working_set bytes, nodes stride bytes apart
+void runChase(MemoryConfig base, const std::vector<size_t> &threads, const size_t stride, bool &print_header)
+{
+    const size_t loads = (FLAGS_loads + 7) / 8 * 8;
+    const size_t align = base.page == PageSize::PAGE_2M ? HUGE_PAGE_SIZE : SMALL_PAGE_SIZE;
+
+    for (const size_t t : threads) {
+        for (const size_t working_set : parseSizes(FLAGS_working_sets)) {
+            const size_t nodes = working_set / stride;
+            if (nodes == 0) {
+                error("WARNING: skipping working set " + std::to_string(working_set) + " below the node stride " + std::to_string(stride));
+                continue;
+            }
+            // rings of different threads never share a page
+            const size_t slice = (working_set + align - 1) / align * align;
+            const MappedRegion region(slice * t, base.page);
+            run_parallel(t, base.cpus, [&](const size_t thread) {
+                build_ring(region.data() + thread * slice, nodes, stride, FLAGS_seed + thread);
+            });
+
+            MemoryConfig config = base;
+            config.kernel = "chase";
+            config.pages = region.backing;
+            config.huge_pages_pct = region.hugePct();
+            config.threads = t;
+            config.working_set = working_set;
+            config.loads = loads;
+            std::vector<const void*> ends(t);
+            measure(config, print_header, loads, t, [&]() {
+                run_parallel(t, config.cpus, [&](const size_t thread) {
+                    ends[thread] = chase(region.data() + thread * slice, loads);
+                });
+            });
+            logger(config.benchmark + " working_set=" + std::to_string(working_set) + " pages=" + config.pages + " end=" + std::to_string(reinterpret_cast<uintptr_t>(ends[0])));
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    int rc = 0;
+
+    gflags::SetUsageMessage("Memory bandwidth and latency microbenchmark");
+    gflags::ParseCommandLineFlags(&argc, &argv, false);
+
+    std::vector<size_t> threads;
+    for (const double t : parseList(FLAGS_threads)) {
+        if (t < 1) throw std::invalid_argument("Thread counts must be >= 1");
+        threads.push_back(static_cast<size_t>(t));
+    }
+    if (threads.empty())
+        throw std::invalid_argument("No thread counts given");
+
+    std::vector<SimdLevel> levels;
+    for (const std::string &level : parseNames(FLAGS_simd))
+        levels.push_back(resolve_simd(simd_level_from_string(level)));
+
+    MemoryConfig base;
+    base.variant = FLAGS_variant;
+    for (const double cpu : parseList(FLAGS_cpus))
+        base.cpus.push_back(static_cast<int>(cpu));
+    base.repetitions = FLAGS_repetitions;
+    base.warmup_repetitions = FLAGS_warmup_repetitions;
+    if (base.repetitions == 0)
+        throw std::invalid_argument("repetitions must be > 0");
+
+    bool print_header = FLAGS_print_header;
+    for (const std::string &benchmark : parseNames(FLAGS_benchmarks)) {
+        for (const std::string &page : parseNames(FLAGS_page_sizes)) {
+            MemoryConfig config = base;
+            config.benchmark = benchmark;
+            config.page = page_size_from_string(page);
+            logger("Memory: " + benchmark + " on " + page + " pages");
+            if (benchmark == "stream") {
+                runStream(config, threads, levels, print_header);
+            } else if (benchmark == "latency") {
+                runChase(config, threads, CACHE_LINE_SIZE, print_header);
+            } else if (benchmark == "tlb") {
+                runChase(config, threads, SMALL_PAGE_SIZE, print_header);
+            } else {
+                throw std::invalid_argument("Unknown benchmark " + benchmark);
+            }
+        }
+    }
+
+    return rc;
+}
@@ -0,0 +1,303 @@
+// app/Operators.cpp
+// Database operator microbenchmark: selection scan, grouped aggregation, radix hash join and sort on generated
+// columns, for the same binary on the host and inside the enclave (no communication involved).
+#include "Operators.hpp"
+
+#include "chrono"
+#include "vector"
+#include "fstream"
+#include "sstream"
+#include "iostream"
+#include "memory"
+#include <ctime>
+#include <limits>
+
+#include "gflags/gflags.h"
+
+#include "Bench.hpp"
+#include "Logger.hpp"
+#include "Utilities.hpp"
+
+DEFINE_string(operators, "scan,aggregate,join,sort", "Comma-separated operators to run: scan, aggregate, join, sort");
+DEFINE_double(scale_factor, 1.0, "Input size: scale_factor * 10M rows (scan, aggregate, sort and the probe side of the join)");
+DEFINE_string(threads, "1", "Comma-separated thread counts, one output row per count");
+DEFINE_string(cpus, "", "Comma-separated cores to pin the threads to (thread i on cpus[i % n]), empty: no pinning");
+DEFINE_string(simd, "auto", "Scan kernel: scalar, avx2, avx512 or auto (widest supported by the cpu)");
+DEFINE_string(selectivities, "0.01,0.1,0.5,0.9", "Scan only: comma-separated fractions of selected rows, one output row per selectivity");
+DEFINE_string(groups, "1000,1000000", "Aggregate only: comma-separated numbers of groups, one output row per number");
+DEFINE_uint32(radix_bits, 10, "Join and sort: radix bits of the partitioning pass (2^bits partitions)");
+DEFINE_uint32(join_ratio, 16, "Join only: probe rows per build row (foreign key join, every probe row has one match)");
+DEFINE_uint32(repetitions, 10, "Measured repetitions of every operator run");
+DEFINE_uint32(warmup_repetitions, 2, "Repetitions before the measured ones");
+DEFINE_uint64(seed, 42, "Seed of the generated columns");
+DEFINE_bool(output_outliers, false, "Output outliers in the results");
+DEFINE_string(outfile, "", "Output file for results");
+DEFINE_bool(print_header, true, "Print header in output file");
+DEFINE_string(line_prefix, "", "Prefix of every output line, e.g. to extract the results from the enclave console");
+DEFINE_string(variant, "", "Label of the measured setup in the variant column, e.g. host or enclave");
+DEFINE_bool(perf_counters, false, "Count cycles, instructions, cache misses (perf_event_open), page faults and context switches of all threads of the measured repetitions");
+
+constexpr size_t ROWS_PER_SF = 10000000;
+
+struct OperatorConfig {
+    std::string op;
+    std::string variant;
+    SimdLevel simd;
+    double scale_factor;
+    size_t rows;         // input rows of the run (join: build and probe)
+    size_t threads;
+    std::vector<int> cpus;
+    double selectivity = 0;
+    size_t groups = 0;
+    unsigned radix_bits = 0;
+    unsigned join_ratio = 0;
+    size_t repetitions;
+    size_t warmup_repetitions;
+    uint64_t result = 0;  // checksum of the operator output, equal for every simd level and thread count
+
+    static std::string csv_header();
+    std::string to_csv() const;
+};
+
+std::string OperatorConfig::csv_header() {
+    return "operator,variant,simd,scale_factor,rows,threads,selectivity,groups,radix_bits,join_ratio,repetitions,warmup_repetitions,result";
+}
+
+std::string OperatorConfig::to_csv() const {
+    std::ostringstream oss;
+    oss << op << ","
+        << variant << ","
+        << to_string(simd) << ","
+        << scale_factor << ","
+        << rows << ","
+        << threads << ","
+        << selectivity << ","
+        << groups << ","
+        << radix_bits << ","
+        << join_ratio << ","
+        << repetitions << ","
+        << warmup_repetitions << ","
+        << result;
+    return oss.str();
+}
+
+// Times warmup + measured repetitions of run(), which returns the result checksum of a repetition.
+// The checksum has to be equal for all repetitions. throughput: input rows per second at the median repetition
+template <typename Run>
+void measure(OperatorConfig &config, bool &print_header, Run run)
+{
+    const BenchResult result = measure_repetitions(config.op, config.warmup_repetitions, config.repetitions, 1,
+                                                   FLAGS_perf_counters, FLAGS_output_outliers, run);
+    config.result = result.checksum;
+    output_bench_results(config, result, config.rows, print_header, FLAGS_outfile, FLAGS_line_prefix);
+    print_header = false;
+    logger(config.op + " threads=" + std::to_string(config.threads) + " result=" + std::to_string(config.result));
+}
+
+// col < selectivity * 2^32 over a uniform column, the selection vector of a morsel is reduced to a position checksum
+void runScan(OperatorConfig base, const std::vector<size_t> &threads, bool &print_header)
+{
+    std::vector<uint32_t> col;
+    generate(col, base.rows, FLAGS_seed, threads.back(), base.cpus, [](uint64_t &state, size_t) { return static_cast<uint32_t>(splitmix64(state)); });
+
+    for (const size_t t : threads) {
+        for (const double selectivity : parseList(FLAGS_selectivities)) {
+            if (selectivity < 0 || selectivity > 1)
+                throw std::invalid_argument("Selectivity must be in [0, 1]");
+            OperatorConfig config = base;
+            config.threads = t;
+            config.selectivity = selectivity;
+            const uint32_t bound = static_cast<uint32_t>(std::min(selectivity * 4294967296.0, 4294967295.0));
+
+            std::vector<std::vector<uint32_t>> sel(t, std::vector<uint32_t>(MORSEL_ROWS));
+            measure(config, print_header, [&]() {
+                Morsels morsels(col.size());
+                std::atomic<uint64_t> checksum{0};
+                run_parallel(t, config.cpus, [&](const size_t thread) {
+                    uint32_t *out = sel[thread].data();
+                    uint64_t local = 0;
+                    size_t begin, end;
+                    while (morsels.take(begin, end)) {
+                        const size_t k = select_lt(config.simd, col.data(), begin, end, bound, out);
+                        for (size_t i = 0; i < k; i++)
+                            local += out[i];
+                    }
+                    checksum += local;
+                });
+                return checksum.load();
+            });
+        }
+    }
+}
+
+// SELECT key, COUNT(*), SUM(value) GROUP BY key: thread-local pre-aggregation, then every thread merges one hash partition
+void runAggregate(OperatorConfig base, const std::vector<size_t> &threads, bool &print_header)
+{
+    std::vector<uint32_t> values;
+    generate(values, base.rows, FLAGS_seed + 1, threads.back(), base.cpus, [](uint64_t &state, size_t) { return static_cast<uint32_t>(splitmix64(state) & 0xffff); });
+    std::vector<uint64_t> draws;  // key of a row: draw % groups
+    generate(draws, base.rows, FLAGS_seed, threads.back(), base.cpus, [](uint64_t &state, size_t) { return splitmix64(state); });
+
+    for (const size_t t : threads) {
+        for (const double g : parseList(FLAGS_groups)) {
+            const size_t groups = static_cast<size_t>(g);
+            if (groups == 0 || groups > std::numeric_limits<uint32_t>::max())
+                throw std::invalid_argument("Number of groups must be in [1, 2^32 - 1]");
+            OperatorConfig config = base;
+            config.threads = t;
+            config.groups = groups;
+
+            std::vector<uint32_t> keys(base.rows);
+            for (size_t i = 0; i < keys.size(); i++)
+                keys[i] = static_cast<uint32_t>(draws[i] % groups);
+
+            // sized for all groups: the tables never fill up, independent of the key distribution
+            std::vector<AggTable> local(t, AggTable(groups));
+            std::vector<AggTable> merged(t, AggTable(groups));
+            measure(config, print_header, [&]() {
+                Morsels morsels(keys.size());
+                run_parallel(t, config.cpus, [&](const size_t thread) {
+                    AggTable &table = local[thread];
+                    table.clear();
+                    size_t begin, end;
+                    while (morsels.take(begin, end))
+                        for (size_t i = begin; i < end; i++)
+                            table.add(keys[i], 1, values[i]);
+                });
+
+                std::atomic<uint64_t> checksum{0};
+                run_parallel(t, config.cpus, [&](const size_t thread) {
+                    AggTable &table = merged[thread];
+                    table.clear();
+                    for (const AggTable &partial : local)
+                        partial.forEach([&](const AggEntry &e) {
+                            if (agg_partition(e.key, t) == thread) table.add(e.key, e.count, e.sum);
+                        });
+                    uint64_t local_checksum = 0;
+                    table.forEach([&](const AggEntry &e) { local_checksum += e.sum + static_cast<uint64_t>(e.count) * e.key; });
+                    checksum += local_checksum;
+                });
+                return checksum.load();
+            });
+        }
+    }
+}
+
+// R (unique keys) join S (foreign keys into R) on key, result: matches and the payload checksum
+void runJoin(OperatorConfig base, const std::vector<size_t> &threads, bool &print_header)
+{
+    if (base.join_ratio == 0)
+        throw std::invalid_argument("join_ratio must be > 0");
+    if (base.radix_bits == 0 || base.radix_bits > 16)
+        throw std::invalid_argument("radix_bits must be in [1, 16] for the join");
+    const size_t s_rows = base.rows;
+    const size_t r_rows = std::max<size_t>(1, s_rows / base.join_ratio);
+    if (r_rows > std::numeric_limits<uint32_t>::max())
+        throw std::invalid_argument("Build side exceeds 2^32 rows");
+
+    std::vector<JoinTuple> r, s;
+    generate(r, r_rows, FLAGS_seed, threads.back(), base.cpus, [](uint64_t &, size_t i) {
+        return JoinTuple{ scatter_key(static_cast<uint32_t>(i)), static_cast<uint32_t>(i) };
+    });
+    generate(s, s_rows, FLAGS_seed + 1, threads.back(), base.cpus, [r_rows](uint64_t &state, size_t) {
+        const uint64_t draw = splitmix64(state);
+        return JoinTuple{ scatter_key(static_cast<uint32_t>(draw % r_rows)), static_cast<uint32_t>(draw >> 32) };
+    });
+    std::vector<JoinTuple> r_part(r.size()), s_part(s.size());
+
+    for (const size_t t : threads) {
+        OperatorConfig config = base;
+        config.threads = t;
+        config.rows = r_rows + s_rows;
+        uint64_t matches = 0;
+        measure(config, print_header, [&]() {
+            const JoinResult result = radix_join(r, s, r_part, s_part, config.radix_bits, t, config.cpus);
+            matches = result.matches;
+            return result.checksum;
+        });
+        if (matches != s_rows) {
+            error("Join produced " + std::to_string(matches) + " matches, expected " + std::to_string(s_rows));
+            throw std::runtime_error("Wrong join result");
+        }
+    }
+}
+
+// uint64 keys, result: the median key
+void runSort(OperatorConfig base, const std::vector<size_t> &threads, bool &print_header)
+{
+    if (base.radix_bits == 0 || base.radix_bits > 24)
+        throw std::invalid_argument("radix_bits must be in [1, 24] for the sort");
+    std::vector<uint64_t> keys;
+    generate(keys, base.rows, FLAGS_seed, threads.back(), base.cpus, [](uint64_t &state, size_t) { return splitmix64(state); });
+    std::vector<uint64_t> out(keys.size());
+
+    for (const size_t t : threads) {
+        OperatorConfig config = base;
+        config.threads = t;
+        measure(config, print_header, [&]() {
+            radix_sort(keys, out, config.radix_bits, t, config.cpus);
+            return out.empty() ? 0 : out[out.size() / 2];
+        });
+        if (!std::is_sorted(out.begin(), out.end())) {
+            error("Sort output is not sorted");
+            throw std::runtime_error("Wrong sort result");
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    int rc = 0;
+
+    gflags::SetUsageMessage("Database operator microbenchmark");
+    gflags::ParseCommandLineFlags(&argc, &argv, false);
+
+    if (FLAGS_scale_factor <= 0)
+        throw std::invalid_argument("scale_factor must be > 0");
+
+    std::vector<size_t> threads;
+    for (const double t : parseList(FLAGS_threads)) {
+        if (t < 1) throw std::invalid_argument("Thread counts must be >= 1");
+        threads.push_back(static_cast<size_t>(t));
+    }
+    if (threads.empty())
+        throw std::invalid_argument("No thread counts given");
+    // data generation uses the largest thread count
+    std::sort(threads.begin(), threads.end());
+
+    OperatorConfig base;
+    base.variant = FLAGS_variant;
+    base.simd = resolve_simd(simd_level_from_string(FLAGS_simd));
+    base.scale_factor = FLAGS_scale_factor;
+    base.rows = static_cast<size_t>(FLAGS_scale_factor * ROWS_PER_SF);
+    base.threads = threads.front();
+    for (const double cpu : parseList(FLAGS_cpus))
+        base.cpus.push_back(static_cast<int>(cpu));
+    base.repetitions = FLAGS_repetitions;
+    base.warmup_repetitions = FLAGS_warmup_repetitions;
+    if (base.repetitions == 0)
+        throw std::invalid_argument("repetitions must be > 0");
+    logger("Operators: " + FLAGS_operators + ", " + std::to_string(base.rows) + " rows, simd " + to_string(base.simd));
+
+    bool print_header = FLAGS_print_header;
+    for (const std::string &op : parseNames(FLAGS_operators)) {
+        OperatorConfig config = base;
+        config.op = op;
+        if (op == "scan") {
+            runScan(config, threads, print_header);
+        } else if (op == "aggregate") {
+            runAggregate(config, threads, print_header);
+        } else if (op == "join") {
+            config.radix_bits = FLAGS_radix_bits;
+            config.join_ratio = FLAGS_join_ratio;
+            runJoin(config, threads, print_header);
+        } else if (op == "sort") {
+            config.radix_bits = FLAGS_radix_bits;
+            runSort(config, threads, print_header);
+        } else {
+            throw std::invalid_argument("Unknown operator " + op);
+        }
+    }
+
+    return rc;
+}
@@ -0,0 +1,1214 @@
+// app/Proxy.cpp
+#include "Proxy.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/vm_sockets.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include "gflags/gflags.h"
+
+#include "Logger.hpp"
+
+// proxy opts
+DEFINE_string(mode, "forward", "forward: one upstream connection per client, mux: carry all clients as framed streams over a pool of tunnel connections to a demux proxy, demux: accept tunnel connections and connect upstream per stream");
+DEFINE_string(listen_protocol, "inet", "Socket protocol to accept clients on (inet, vsock or unix)");
+DEFINE_string(listen_address, "0.0.0.0", "Address (inet), cid (vsock) or socket path (unix) to listen on");
+DEFINE_int32(listen_port, 5005, "Port to listen on");
+DEFINE_string(connect_protocol, "vsock", "Socket protocol to forward to (inet, vsock or unix)");
+DEFINE_string(connect_address, "16", "Address (inet), cid (vsock) or socket path (unix) to forward to");
+DEFINE_int32(connect_port, 5005, "Port to forward to");
+DEFINE_uint32(reuse_depth, 1, "Number of listener shards (SO_REUSEPORT), each served by its own epoll thread");
+DEFINE_int32(so_rcvbuf, 0, "SO_RCVBUF of all proxy sockets (0: system default)");
+DEFINE_int32(so_sndbuf, 0, "SO_SNDBUF of all proxy sockets (0: system default)");
+DEFINE_bool(no_delay, false, "Set TCP_NODELAY on inet sockets");
+DEFINE_bool(splice, true, "Forward via splice() through a pipe where the kernel supports it, copy otherwise");
+DEFINE_uint64(pipe_size, 0, "Pipe capacity per direction in splice mode (0: system default)");
+DEFINE_uint64(copy_buf_size, 65536, "Buffer size per direction in copy mode");
+DEFINE_uint32(coalesce_bytes, 16384, "mux: send the staged tunnel frames once this many bytes are pending (0: at the end of each event batch)");
+DEFINE_uint32(coalesce_us, 0, "mux: latency budget, staged tunnel frames are sent at the latest after this time [us] (0: at the end of each event batch). The demux adopts both for the responses");
+DEFINE_uint64(tunnel_buf_size, 1 << 20, "mux/demux: unsent bytes per tunnel connection before reading its streams pauses");
+DEFINE_uint32(tunnel_connections, 1, "mux: persistent tunnel connections to the demux proxy, each new stream goes to the one with the fewest open streams");
+DEFINE_uint32(stream_window, 256 << 10, "mux: flow control window per stream and direction [B], a stream is not read while this many bytes wait for the peer's socket. The demux adopts it");
+
+constexpr int MAX_EVENTS = 256;
+constexpr int TUNNEL_CONNECT_RETRIES = 50;  // 100ms apart, the demux end may still be starting
+
+std::string to_string(const ProxyMode mode)
+{
+    switch (mode)
+    {
+    case FORWARD:
+        return "forward";
+    case MUX:
+        return "mux";
+    case DEMUX:
+        return "demux";
+    default:
+        return "unknown";
+    }
+}
+
+ProxyMode proxy_mode_from_string(const std::string &str)
+{
+    if (str == "forward") {
+        return ProxyMode::FORWARD;
+    } else if (str == "mux") {
+        return ProxyMode::MUX;
+    } else if (str == "demux") {
+        return ProxyMode::DEMUX;
+    } else {
+        throw std::runtime_error("Invalid proxy mode");
+    }
+}
+
+std::string ProxyConfig::to_string() const {
+    std::ostringstream oss;
+    oss << "ProxyConfig{ "
+        << "mode: " << ::to_string(mode) << ", "
+        << "listen: " << listen_protocol << ":" << listen_address << ":" << listen_port << ", "
+        << "connect: " << connect_protocol << ":" << connect_address << ":" << connect_port << ", "
+        << "num_workers: " << num_workers << ", "
+        << "so_rcvbuf: " << so_rcvbuf << ", "
+        << "so_sndbuf: " << so_sndbuf << ", "
+        << "no_delay: " << no_delay << ", "
+        << "splice: " << splice << ", "
+        << "pipe_size: " << pipe_size << ", "
+        << "buf_size: " << buf_size << ", "
+        << "coalesce_bytes: " << coalesce_bytes << ", "
+        << "coalesce_us: " << coalesce_us << ", "
+        << "tunnel_buf_size: " << tunnel_buf_size << ", "
+        << "tunnel_connections: " << tunnel_connections << ", "
+        << "stream_window: " << stream_window
+        << " }";
+    return oss.str();
+}
+
+void parseProxyConfig(ProxyConfig &config) {
+    config.mode = proxy_mode_from_string(FLAGS_mode);
+    config.listen_protocol = protocol_from_string(FLAGS_listen_protocol);
+    config.listen_address = FLAGS_listen_address;
+    config.listen_port = FLAGS_listen_port;
+    config.connect_protocol = protocol_from_string(FLAGS_connect_protocol);
+    config.connect_address = FLAGS_connect_address;
+    config.connect_port = FLAGS_connect_port;
+    config.num_workers = std::max(1u, FLAGS_reuse_depth);
+    config.so_rcvbuf = FLAGS_so_rcvbuf;
+    config.so_sndbuf = FLAGS_so_sndbuf;
+    config.no_delay = FLAGS_no_delay;
+    config.splice = FLAGS_splice;
+    config.pipe_size = FLAGS_pipe_size;
+    config.buf_size = FLAGS_copy_buf_size;
+    config.coalesce_bytes = FLAGS_coalesce_bytes;
+    config.coalesce_us = FLAGS_coalesce_us;
+    config.tunnel_buf_size = std::max<size_t>(FLAGS_tunnel_buf_size, sizeof(TunnelFrame) + TUNNEL_MAX_PAYLOAD);
+    config.tunnel_connections = std::max(1u, FLAGS_tunnel_connections);
+    config.stream_window = std::max(1u, FLAGS_stream_window);
+
+    // byte streams only: seqpacket would cut messages at the proxy buffer size, shm is not a socket
+    for (const SocketProtocol protocol : { config.listen_protocol, config.connect_protocol }) {
+        if (protocol == SocketProtocol::UNIX_SEQPACKET || protocol == SocketProtocol::SHM) {
+            error("The proxy supports inet, vsock and unix sockets only");
+            throw std::invalid_argument("Unsupported protocol");
+        }
+    }
+}
+
+socklen_t make_sockaddr(const SocketProtocol protocol, const std::string &adr, const int port, struct sockaddr_storage &addr)
+{
+    std::memset(&addr, 0, sizeof(addr));
+    if (protocol == SocketProtocol::INET) {
+        auto *in = reinterpret_cast<struct sockaddr_in*>(&addr);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        if (inet_pton(AF_INET, adr.c_str(), &in->sin_addr) <= 0) {
+            error("Invalid address / Address not supported");
+            throw std::runtime_error("Invalid address / Address not supported");
+        }
+        return sizeof(struct sockaddr_in);
+    } else if (protocol == SocketProtocol::VSOCK) {
+        auto *vm = reinterpret_cast<struct sockaddr_vm*>(&addr);
+        vm->svm_family = AF_VSOCK;
+        vm->svm_port = port;
+        vm->svm_cid = (uint32_t) std::stoul(adr);  // typically VMADDR_CID_ANY = -1U for listeners
+        return sizeof(struct sockaddr_vm);
+    } else if (protocol == SocketProtocol::UNIX) {
+        return unix_sockaddr(adr, *reinterpret_cast<struct sockaddr_un*>(&addr));  // no port
+    } else {
+        throw std::invalid_argument("Unsupported protocol");
+    }
+}
+
+static void apply_socket_options(const ProxyConfig &config, const int fd, const SocketProtocol protocol)
+{
+    const int opt = 1;
+    if (config.so_rcvbuf > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &config.so_rcvbuf, sizeof(config.so_rcvbuf)))
+        error("WARNING: Setsockopt SO_RCVBUF failed");
+    if (config.so_sndbuf > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &config.so_sndbuf, sizeof(config.so_sndbuf)))
+        error("WARNING: Setsockopt SO_SNDBUF failed");
+    if (config.no_delay && protocol == SocketProtocol::INET && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)))
+        error("WARNING: Setsockopt TCP_NODELAY failed");
+}
+
+// PROXY
+
+Proxy::Proxy(const ProxyConfig &config) : config(config)
+{
+    // lift the soft fd limit - every proxied connection costs two sockets and up to four pipe ends
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    // a tunnel end is a single event loop: coalescing needs all streams of a tunnel connection in one thread
+    if (config.mode != ProxyMode::FORWARD) {
+        listen_fds.push_back(createListener(false));
+        tunnel = std::make_unique<TunnelWorker>(config, listen_fds.back());
+        logger("Proxy (" + ::to_string(config.mode) + ") listening");
+        return;
+    }
+
+    // one listener per worker, so the kernel spreads connections across threads.
+    // vsock has no SO_REUSEPORT load balancing, there all workers share one listener (EPOLLEXCLUSIVE).
+    const bool shard = config.listen_protocol == SocketProtocol::INET;
+    for (unsigned i = 0; i < config.num_workers; i++) {
+        if (shard || i == 0)
+            listen_fds.push_back(createListener(shard && config.num_workers > 1));
+        workers.push_back(std::make_unique<ProxyWorker>(config, i, listen_fds.back()));
+    }
+    logger("Proxy listening with " + std::to_string(listen_fds.size()) + " listener(s) and " + std::to_string(workers.size()) + " worker(s)");
+}
+
+Proxy::~Proxy()
+{
+    for (auto &t : threads)
+        if (t.joinable()) t.join();
+    workers.clear();
+    tunnel.reset();
+    for (const int fd : listen_fds)
+        close(fd);
+}
+
+int Proxy::createListener(const bool reuseport) const
+{
+    int fd;
+    const int opt = 1;
+    if ((fd = socket(af_from_enum(config.listen_protocol), SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0) {
+        error("Socket failed with ERROR: " + std::string(strerror(errno)));
+        throw std::runtime_error("Socket failed");
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+        error("Setsockopt SO_REUSEADDR failed");
+        close(fd);
+        throw std::runtime_error("Setsockopt SO_REUSEADDR failed");
+    }
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+        error("Setsockopt SO_REUSEPORT failed");
+        close(fd);
+        throw std::runtime_error("Setsockopt SO_REUSEPORT failed");
+    }
+    // buffer sizes are inherited by accepted sockets
+    if (config.so_rcvbuf > 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &config.so_rcvbuf, sizeof(config.so_rcvbuf));
+    if (config.so_sndbuf > 0)
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &config.so_sndbuf, sizeof(config.so_sndbuf));
+
+    struct sockaddr_storage addr;
+    const socklen_t addrlen = make_sockaddr(config.listen_protocol, config.listen_address, config.listen_port, addr);
+    if (config.listen_protocol == SocketProtocol::UNIX && config.listen_address[0] != '@')
+        unlink(config.listen_address.c_str());  // stale socket file of a previous run
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), addrlen) < 0) {
+        error("Bind failed with " + std::string(strerror(errno)));
+        close(fd);
+        throw std::runtime_error("Bind failed");
+    }
+    if (listen(fd, SOMAXCONN) < 0) {
+        error("Listen failed");
+        close(fd);
+        throw std::runtime_error("Listen failed");
+    }
+    return fd;
+}
+
+void Proxy::run()
+{
+    if (tunnel) {
+        tunnel->run();
+        return;
+    }
+    for (auto &w : workers)
+        threads.emplace_back([&w]() { w->run(); });
+    for (auto &t : threads)
+        t.join();
+}
+
+// WORKER
+
+ProxyWorker::ProxyWorker(const ProxyConfig &config, const unsigned id, const int listen_fd) :
+    config(config), id(id), listen_fd(listen_fd)
+{
+    connect_addrlen = make_sockaddr(config.connect_protocol, config.connect_address, config.connect_port, connect_addr);
+
+    if ((epoll_fd = epoll_create1(0)) < 0) {
+        error("epoll_create1 failed with ERROR: " + std::string(strerror(errno)));
+        throw std::runtime_error("epoll_create1 failed");
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = nullptr;  // nullptr marks the listening socket
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+        error("epoll_ctl (listen socket) failed with ERROR: " + std::string(strerror(errno)));
+        throw std::runtime_error("epoll_ctl failed");
+    }
+}
+
+ProxyWorker::~ProxyWorker()
+{
+    for (auto &[ptr, s] : sessions)
+        if (!s->closed) closeSession(*s);
+    if (epoll_fd >= 0) close(epoll_fd);
+}
+
+void ProxyWorker::run()
+{
+    struct epoll_event events[MAX_EVENTS];
+    logger("Proxy worker " + std::to_string(id) + " started.");
+
+    while (true)
+    {
+        const int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) [[unlikely]] {
+            if (errno == EINTR) continue;
+            error("epoll_wait failed with ERROR: " + std::string(strerror(errno)));
+            throw std::runtime_error("epoll_wait failed");
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (events[i].data.ptr == nullptr) {
+                acceptConnections();
+                continue;
+            }
+            auto *ep = static_cast<ProxyEndpoint*>(events[i].data.ptr);
+            ProxySession &s = *ep->session;
+            if (s.closed) continue;  // both sockets of a session may be reported in one batch
+            if (!onEvent(s, ep->side, events[i].events))
+                closeSession(s);
+        }
+
+        for (ProxySession *s : closed_sessions)
+            sessions.erase(s);
+        closed_sessions.clear();
+    }
+}
+
+void ProxyWorker::acceptConnections()
+{
+    while (true)
+    {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            error("Accept failed with ERROR: " + std::string(strerror(errno)));
+            return;
+        }
+        apply_socket_options(config, fd, config.listen_protocol);
+
+        auto s = std::make_unique<ProxySession>();
+        s->fd[0] = fd;
+
+        // upstream connect does not block the worker, completion is signaled via EPOLLOUT
+        s->fd[1] = socket(af_from_enum(config.connect_protocol), SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (s->fd[1] < 0) {
+            error("Socket failed with ERROR: " + std::string(strerror(errno)));
+            close(fd);
+            continue;
+        }
+        apply_socket_options(config, s->fd[1], config.connect_protocol);
+        if (connect(s->fd[1], reinterpret_cast<struct sockaddr*>(&connect_addr), connect_addrlen) < 0 && errno != EINPROGRESS) {
+            error("Connection to upstream failed with ERROR: " + std::string(strerror(errno)));
+            close(s->fd[1]);
+            close(fd);
+            continue;
+        }
+
+        // forwarding state per direction
+        for (int side = 0; side < 2; side++) {
+            ProxyFlow &f = s->flow[side];
+            f.use_splice = config.splice && pipe2(f.pipe_fds, O_NONBLOCK) == 0;
+            if (f.use_splice) {
+                if (config.pipe_size)
+                    fcntl(f.pipe_fds[1], F_SETPIPE_SZ, config.pipe_size);
+                f.capacity = fcntl(f.pipe_fds[1], F_GETPIPE_SZ);
+            } else {
+                f.buf = std::make_unique<char[]>(config.buf_size);
+                f.capacity = config.buf_size;
+            }
+        }
+
+        // wait for the upstream connection before reading from the client
+        ProxySession *ptr = s.get();
+        struct epoll_event ev = {};
+        bool ok = true;
+        for (int side = 0; side < 2; side++) {
+            ev.events = side == 1 ? static_cast<uint32_t>(EPOLLOUT) : 0u;
+            ev.data.ptr = &ptr->ep[side];
+            ok &= epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ptr->fd[side], &ev) == 0;
+            ptr->interest[side] = ev.events;
+        }
+        sessions.emplace(ptr, std::move(s));
+        if (!ok) {
+            error("epoll_ctl (session) failed with ERROR: " + std::string(strerror(errno)));
+            closeSession(*ptr);  // released with the current event batch
+            continue;
+        }
+        logger("Worker " + std::to_string(id) + ": client connected. Open sessions: " + std::to_string(sessions.size()));
+    }
+}
+
+void ProxyWorker::closeSession(ProxySession &s)
+{
+    for (int side = 0; side < 2; side++) {
+        if (s.fd[side] >= 0) close(s.fd[side]);
+        for (const int pfd : s.flow[side].pipe_fds)
+            if (pfd >= 0) close(pfd);
+    }
+    s.closed = true;
+    closed_sessions.push_back(&s);
+    logger("Worker " + std::to_string(id) + ": session closed. Open sessions: " + std::to_string(sessions.size() - closed_sessions.size()));
+}
+
+bool ProxyWorker::onEvent(ProxySession &s, const int side, const uint32_t events)
+{
+    if (s.connecting)
+    {
+        if (side != 1) return !(events & (EPOLLERR | EPOLLHUP));
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(s.fd[1], SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            error("Connection to upstream failed with ERROR: " + std::string(strerror(err ? err : errno)));
+            return false;
+        }
+        s.connecting = false;
+        return updateInterest(s);
+    }
+
+    if (events & EPOLLERR)
+        return false;
+
+    // peer is gone in both directions: forward what is left of it and end the session
+    if (events & EPOLLHUP) {
+        fill(s, side);
+        drain(s, side);
+        return false;
+    }
+
+    // pull from this side, push what the other side sent towards this side
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP))
+        if (!fill(s, side) || !drain(s, side)) return false;
+    if (events & EPOLLOUT)
+        if (!drain(s, 1 - side)) return false;
+
+    // both directions finished
+    if (s.flow[0].shut && s.flow[1].shut)
+        return false;
+
+    return updateInterest(s);
+}
+
+// read from fd[side] into the flow buffer/pipe
+bool ProxyWorker::fill(ProxySession &s, const int side)
+{
+    ProxyFlow &f = s.flow[side];
+    while (!f.eof && f.pending < f.capacity)
+    {
+        ssize_t n;
+        if (f.use_splice) {
+            n = splice(s.fd[side], nullptr, f.pipe_fds[1], nullptr, f.capacity - f.pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n < 0 && errno == EINVAL && f.pending == 0) {
+                // the socket family does not implement splice_read (e.g. vsock on older kernels)
+                logger("splice not supported for this socket, falling back to copying");
+                close(f.pipe_fds[0]);
+                close(f.pipe_fds[1]);
+                f.pipe_fds[0] = f.pipe_fds[1] = -1;
+                f.use_splice = false;
+                f.buf = std::make_unique<char[]>(config.buf_size);
+                f.capacity = config.buf_size;
+                continue;
+            }
+        } else {
+            const size_t off = (f.buf_off + f.pending);
+            if (off >= f.capacity) break;  // wait until the buffer is drained and rewound
+            n = read(s.fd[side], f.buf.get() + off, f.capacity - off);
+        }
+
+        if (n == 0) {
+            f.eof = true;
+        } else if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            if (errno == ECONNRESET) return false;
+            error("Proxy read failed with ERROR: " + std::string(strerror(errno)));
+            return false;
+        } else {
+            f.pending += n;
+        }
+    }
+    return true;
+}
+
+// write the pending data of flow[side] to the opposite socket
+bool ProxyWorker::drain(ProxySession &s, const int side)
+{
+    ProxyFlow &f = s.flow[side];
+    const int dst = s.fd[1 - side];
+    while (f.pending > 0)
+    {
+        ssize_t n;
+        if (f.use_splice)
+            n = splice(f.pipe_fds[0], nullptr, dst, nullptr, f.pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        else
+            n = send(dst, f.buf.get() + f.buf_off, f.pending, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            if (errno == EPIPE || errno == ECONNRESET) return false;
+            error("Proxy write failed with ERROR: " + std::string(strerror(errno)));
+            return false;
+        }
+        f.pending -= n;
+        f.buf_off = f.pending ? f.buf_off + n : 0;
+    }
+
+    // forward the half-close once everything was delivered
+    if (f.eof && f.pending == 0 && !f.shut) {
+        shutdown(dst, SHUT_WR);
+        f.shut = true;
+    }
+    return true;
+}
+
+// read from a socket while its flow has room, write to it while the opposite flow has data
+bool ProxyWorker::updateInterest(ProxySession &s)
+{
+    for (int side = 0; side < 2; side++)
+    {
+        const ProxyFlow &in = s.flow[side];
+        const ProxyFlow &out = s.flow[1 - side];
+        uint32_t events = 0;
+        if (!in.eof && in.pending < in.capacity && (in.use_splice || in.buf_off + in.pending < in.capacity))
+            events |= EPOLLIN | EPOLLRDHUP;
+        if (out.pending > 0)
+            events |= EPOLLOUT;
+
+        if (events == s.interest[side]) continue;
+        struct epoll_event ev = {};
+        ev.events = events;
+        ev.data.ptr = &s.ep[side];
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, s.fd[side], &ev) < 0) {
+            error("epoll_ctl (modify) failed with ERROR: " + std::string(strerror(errno)));
+            return false;
+        }
+        s.interest[side] = events;
+    }
+    return true;
+}
+
+
+// TUNNEL
+
+constexpr uint64_t TAG_LISTEN = 1ull << 63;
+constexpr uint64_t TAG_TIMER = (1ull << 63) | 1;
+constexpr uint64_t TAG_TUNNEL = 1ull << 62;  // | index of the tunnel connection, streams are tagged with their key
+
+static uint64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+char *TunnelBuffer::reserve(const size_t n)
+{
+    if (capacity - len >= n) return data.get() + len;
+    const size_t pending = size();
+    if (capacity - pending >= n) {
+        std::memmove(data.get(), begin(), pending);
+    } else {
+        const size_t grown_capacity = std::max({ 2 * capacity, pending + n, size_t(4096) });
+        std::unique_ptr<char[]> grown(new char[grown_capacity]);
+        if (pending) std::memcpy(grown.get(), begin(), pending);
+        data = std::move(grown);
+        capacity = grown_capacity;
+    }
+    off = 0;
+    len = pending;
+    return data.get() + len;
+}
+
+TunnelWorker::TunnelWorker(const ProxyConfig &config, const int listen_fd) :
+    config(config), listen_fd(listen_fd)
+{
+    connect_addrlen = make_sockaddr(config.connect_protocol, config.connect_address, config.connect_port, connect_addr);
+
+    if ((epoll_fd = epoll_create1(0)) < 0) {
+        error("epoll_create1 failed with ERROR: " + std::string(strerror(errno)));
+        throw std::runtime_error("epoll_create1 failed");
+    }
+    if ((timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) < 0) {
+        error("timerfd_create failed with ERROR: " + std::string(strerror(errno)));
+        throw std::runtime_error("timerfd_create failed");
+    }
+
+    uint32_t interest = 0;
+    if (!setInterest(listen_fd, TAG_LISTEN, interest, EPOLLIN, true) || !setInterest(timer_fd, TAG_TIMER, interest, EPOLLIN, true))
+        throw std::runtime_error("epoll_ctl failed");
+}
+
+TunnelWorker::~TunnelWorker()
+{
+    for (auto &[key, s] : streams)
+        if (!s->closed) close(s->fd);
+    for (auto &c : tunnels)
+        if (c && !c->closed) close(c->fd);
+    if (timer_fd >= 0) close(timer_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+}
+
+void TunnelWorker::run()
+{
+    struct epoll_event events[MAX_EVENTS];
+    logger("Tunnel worker (" + ::to_string(config.mode) + ") started.");
+
+    if (config.mode == ProxyMode::MUX && !connectTunnels())
+        throw std::runtime_error("Tunnel connection failed");
+
+    while (true)
+    {
+        const int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) [[unlikely]] {
+            if (errno == EINTR) continue;
+            error("epoll_wait failed with ERROR: " + std::string(strerror(errno)));
+            throw std::runtime_error("epoll_wait failed");
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            const uint64_t tag = events[i].data.u64;
+            if (tag == TAG_LISTEN) {
+                if (config.mode == ProxyMode::MUX) acceptClients();
+                else acceptTunnels();
+            } else if (tag == TAG_TIMER) {
+                onTimer();
+            } else if (tag & TAG_TUNNEL) {
+                const size_t t = tag & ~TAG_TUNNEL;
+                if (tunnels[t] && !tunnels[t]->closed) onTunnel(t, events[i].events);
+            } else {
+                auto it = streams.find(tag);
+                if (it != streams.end() && !it->second->closed) onStream(*it->second, events[i].events);
+            }
+        }
+        endBatch();
+    }
+}
+
+// the frames released during a batch leave together: one send per tunnel connection and batch
+void TunnelWorker::endBatch()
+{
+    for (const size_t t : dirty) {
+        tunnels[t]->dirty = false;
+        if (!tunnels[t]->closed && !flush(t))
+            closeTunnel(t);
+    }
+    dirty.clear();
+
+    for (TunnelStream *s : closed_streams)
+        streams.erase(s->key());
+    closed_streams.clear();
+
+    for (size_t t = 0; t < tunnels.size(); t++) {
+        if (!tunnels[t]) continue;
+        if (tunnels[t]->closed) tunnels[t].reset();
+        else if (!updateTunnel(t)) closeTunnel(t);  // released with the next batch
+    }
+}
+
+void TunnelWorker::acceptClients()
+{
+    // the live tunnel connection with the fewest open streams
+    auto least_loaded = [this]() {
+        size_t best = tunnels.size();
+        for (size_t t = 0; t < tunnels.size(); t++)
+            if (tunnels[t] && !tunnels[t]->closed && (best == tunnels.size() || tunnels[t]->open_streams < tunnels[best]->open_streams))
+                best = t;
+        return best;
+    };
+
+    while (true)
+    {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            error("Accept failed with ERROR: " + std::string(strerror(errno)));
+            return;
+        }
+        apply_socket_options(config, fd, config.listen_protocol);
+
+        // the pool is re-established on demand after the demux end went away
+        size_t t = least_loaded();
+        if (t == tunnels.size() && (!connectTunnels() || (t = least_loaded()) == tunnels.size())) {
+            close(fd);
+            continue;
+        }
+
+        auto s = std::make_unique<TunnelStream>(next_stream++, t, fd, config.stream_window);
+        TunnelStream &ref = *s;
+        streams.emplace(ref.key(), std::move(s));
+        tunnels[t]->open_streams++;
+        pushFrame(t, ref.id, OPEN);
+        if (!setInterest(fd, ref.key(), ref.interest, EPOLLIN | EPOLLRDHUP, true)) {
+            closeStream(ref, true);
+            continue;
+        }
+        logger("Stream " + std::to_string(ref.id) + " opened. Open streams: " + std::to_string(streams.size() - closed_streams.size()));
+    }
+}
+
+void TunnelWorker::acceptTunnels()
+{
+    while (true)
+    {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            error("Accept failed with ERROR: " + std::string(strerror(errno)));
+            return;
+        }
+        const size_t t = addTunnel(fd);
+        if (t < tunnels.size())
+            logger("Tunnel connection " + std::to_string(t) + " accepted.");
+    }
+}
+
+// mux: open the missing connections of the pool, true if at least one is up
+bool TunnelWorker::connectTunnels()
+{
+    size_t live = 0;
+    for (const auto &c : tunnels)
+        if (c && !c->closed) live++;
+
+    int err = 0;
+    for (int attempt = 0; live < config.tunnel_connections && attempt < TUNNEL_CONNECT_RETRIES; attempt++)
+    {
+        if (attempt > 0) usleep(100000);
+        const int fd = socket(af_from_enum(config.connect_protocol), SOCK_STREAM, 0);
+        if (fd < 0) {
+            error("Socket failed with ERROR: " + std::string(strerror(errno)));
+            return false;
+        }
+        if (connect(fd, reinterpret_cast<struct sockaddr*>(&connect_addr), connect_addrlen) < 0) {
+            err = errno;
+            close(fd);
+            continue;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        const size_t t = addTunnel(fd);
+        if (t == tunnels.size()) return false;
+
+        // the demux adopts the coalescing policy for the opposite direction
+        TunnelConn &c = *tunnels[t];
+        c.policy = { config.coalesce_bytes, config.coalesce_us, config.stream_window };
+        pushFrame(t, 0, HELLO, reinterpret_cast<const char*>(&c.policy), sizeof(c.policy));
+        release(t);
+        logger("Tunnel connection " + std::to_string(t) + " established.");
+        live++;
+        attempt = -1;  // retries per connection
+    }
+    if (live < config.tunnel_connections)
+        error("Tunnel connection failed with ERROR: " + std::string(strerror(err)) + ". Tunnel connections: " + std::to_string(live));
+    return live > 0;
+}
+
+// index of the registered tunnel connection, tunnels.size() on failure
+size_t TunnelWorker::addTunnel(const int fd)
+{
+    apply_socket_options(config, fd, config.mode == ProxyMode::MUX ? config.connect_protocol : config.listen_protocol);
+    // frames are coalesced here already, Nagle would only delay the flushes
+    const int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    size_t t = 0;
+    while (t < tunnels.size() && tunnels[t]) t++;
+    if (t == tunnels.size()) tunnels.emplace_back();
+    tunnels[t] = std::make_unique<TunnelConn>(fd);
+
+    if (!setInterest(fd, TAG_TUNNEL | t, tunnels[t]->interest, EPOLLIN | EPOLLRDHUP, true)) {
+        close(fd);
+        tunnels[t].reset();
+        return tunnels.size();
+    }
+    return t;
+}
+
+void TunnelWorker::closeTunnel(const size_t t)
+{
+    TunnelConn &c = *tunnels[t];
+    if (c.closed) return;
+    c.closed = true;
+    for (auto &[key, s] : streams)
+        if (s->tunnel == t && !s->closed) closeStream(*s, false);
+    close(c.fd);
+    logger("Tunnel connection " + std::to_string(t) + " closed.");
+}
+
+void TunnelWorker::onTunnel(const size_t t, const uint32_t events)
+{
+    TunnelConn &c = *tunnels[t];
+    if (events & EPOLLERR) {
+        closeTunnel(t);
+        return;
+    }
+    if (events & EPOLLOUT) {
+        c.want_out = false;
+        if (!flush(t)) {
+            closeTunnel(t);
+            return;
+        }
+    }
+    if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !readTunnel(t))
+        closeTunnel(t);
+}
+
+bool TunnelWorker::readTunnel(const size_t t)
+{
+    TunnelConn &c = *tunnels[t];
+    char *dst = c.in.reserve(sizeof(TunnelFrame) + TUNNEL_MAX_PAYLOAD);
+    const ssize_t n = read(c.fd, dst, c.in.capacity - c.in.len);
+    if (n == 0) return false;
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return true;
+        if (errno != ECONNRESET) error("Tunnel read failed with ERROR: " + std::string(strerror(errno)));
+        return false;
+    }
+    c.in.commit(n);
+
+    // handle the complete frames, the rest waits for the next read
+    while (c.in.size() >= sizeof(TunnelFrame))
+    {
+        TunnelFrame hdr;
+        std::memcpy(&hdr, c.in.begin(), sizeof(hdr));
+        if (c.in.size() < sizeof(hdr) + hdr.len) break;
+        if (!handleFrame(t, hdr, c.in.begin() + sizeof(hdr))) return false;
+        c.in.consume(sizeof(hdr) + hdr.len);
+    }
+    return true;
+}
+
+bool TunnelWorker::handleFrame(const size_t t, const TunnelFrame &hdr, const char *payload)
+{
+    TunnelConn &c = *tunnels[t];
+    if (hdr.type == HELLO || hdr.type == OPEN) {
+        if (config.mode != ProxyMode::DEMUX || (hdr.type == HELLO && hdr.len != sizeof(TunnelHello))) {
+            error("Unexpected tunnel frame " + std::to_string(hdr.type));
+            return false;
+        }
+        if (hdr.type == OPEN) {
+            openUpstream(t, hdr.stream);
+            return true;
+        }
+        std::memcpy(&c.policy, payload, sizeof(c.policy));
+        c.policy.stream_window = std::max(1u, c.policy.stream_window);
+        logger("Tunnel connection " + std::to_string(t) + ": coalesce_bytes=" + std::to_string(c.policy.coalesce_bytes)
+            + " coalesce_us=" + std::to_string(c.policy.coalesce_us) + " stream_window=" + std::to_string(c.policy.stream_window));
+        return true;
+    }
+
+    // frames of streams closed locally are dropped, the peer learns about it from the RESET
+    auto it = streams.find(TunnelStream::key(t, hdr.stream));
+    if (it == streams.end() || it->second->closed) return true;
+    TunnelStream &s = *it->second;
+
+    switch (hdr.type)
+    {
+    case DATA:
+        if (!writeStream(s, payload, hdr.len)) closeStream(s, true);
+        return true;
+    case CLOSE:
+        s.eof_out = true;
+        if (!writeStream(s, nullptr, 0)) closeStream(s, true);
+        return true;
+    case RESET:
+        closeStream(s, false);
+        return true;
+    case CREDIT: {
+        if (hdr.len != sizeof(uint32_t)) break;
+        uint32_t n;
+        std::memcpy(&n, payload, sizeof(n));
+        if (!creditStream(s, n)) closeStream(s, true);
+        return true;
+    }
+    default:
+        break;
+    }
+    error("Unexpected tunnel frame " + std::to_string(hdr.type));
+    return false;
+}
+
+// demux: the upstream connect does not block the tunnel, data is buffered until it completes
+void TunnelWorker::openUpstream(const size_t t, const uint32_t id)
+{
+    const int fd = socket(af_from_enum(config.connect_protocol), SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        error("Socket failed with ERROR: " + std::string(strerror(errno)));
+        pushFrame(t, id, RESET);
+        return;
+    }
+    apply_socket_options(config, fd, config.connect_protocol);
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&connect_addr), connect_addrlen) < 0 && errno != EINPROGRESS) {
+        error("Connection to upstream failed with ERROR: " + std::string(strerror(errno)));
+        close(fd);
+        pushFrame(t, id, RESET);
+        return;
+    }
+
+    auto s = std::make_unique<TunnelStream>(id, t, fd, tunnels[t]->policy.stream_window);
+    TunnelStream &ref = *s;
+    ref.connecting = true;
+    streams[ref.key()] = std::move(s);
+    tunnels[t]->open_streams++;
+    if (!setInterest(fd, ref.key(), ref.interest, EPOLLOUT, true))
+        closeStream(ref, true);
+}
+
+void TunnelWorker::onStream(TunnelStream &s, const uint32_t events)
+{
+    if (s.connecting)
+    {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            error("Connection to upstream failed with ERROR: " + std::string(strerror(err ? err : errno)));
+            closeStream(s, true);
+            return;
+        }
+        s.connecting = false;
+        if (!writeStream(s, nullptr, 0)) closeStream(s, true);
+        return;
+    }
+
+    if (events & EPOLLERR) {
+        closeStream(s, true);
+        return;
+    }
+    if ((events & EPOLLOUT) && !writeStream(s, nullptr, 0)) {
+        closeStream(s, true);
+        return;
+    }
+    if (s.closed) return;
+
+    if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !s.eof_in && !s.blocked)
+        readStream(s);
+
+    // peer is gone in both directions: nothing can be delivered anymore
+    if ((events & EPOLLHUP) && !s.closed && (s.eof_in || s.blocked))
+        closeStream(s, true);
+}
+
+// read straight into the tunnel buffer behind a frame header
+void TunnelWorker::readStream(TunnelStream &s)
+{
+    TunnelConn &c = *tunnels[s.tunnel];
+    if (c.out.size() >= config.tunnel_buf_size) {
+        s.blocked = true;  // until the tunnel connection drained
+        c.blocked.push_back(s.id);
+        if (!updateStream(s)) closeStream(s, true);
+        return;
+    }
+
+    const size_t max = std::min<size_t>(s.credit, TUNNEL_MAX_PAYLOAD);
+    char *dst = c.out.reserve(sizeof(TunnelFrame) + max);
+    const ssize_t n = read(s.fd, dst + sizeof(TunnelFrame), max);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return;
+        if (errno != ECONNRESET) error("Proxy read failed with ERROR: " + std::string(strerror(errno)));
+        closeStream(s, true);
+        return;
+    }
+    if (n == 0) {
+        s.eof_in = true;
+        pushFrame(s.tunnel, s.id, CLOSE);
+        if (s.shut) closeStream(s, false);
+        else if (!updateStream(s)) closeStream(s, true);
+        return;
+    }
+
+    const TunnelFrame hdr = { s.id, DATA, static_cast<uint16_t>(n) };
+    std::memcpy(dst, &hdr, sizeof(hdr));
+    c.out.commit(sizeof(hdr) + n);
+    stage(s.tunnel, sizeof(hdr) + n);
+
+    // window used up: wait for the peer's credit
+    s.credit -= n;
+    if (s.credit == 0 && !updateStream(s))
+        closeStream(s, true);
+}
+
+bool TunnelWorker::creditStream(TunnelStream &s, const size_t n)
+{
+    const bool paused = s.credit == 0;
+    s.credit += n;
+    if (s.credit > tunnels[s.tunnel]->policy.stream_window) {
+        error("Stream " + std::to_string(s.id) + " credited beyond its window");
+        return false;
+    }
+    return !paused || updateStream(s);
+}
+
+// forward data received for s to its socket, queue what the socket does not take
+bool TunnelWorker::writeStream(TunnelStream &s, const char *data, size_t len)
+{
+    auto failed = [](const ssize_t n) {
+        if (n >= 0 || errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return false;
+        if (errno != EPIPE && errno != ECONNRESET) error("Proxy write failed with ERROR: " + std::string(strerror(errno)));
+        return true;
+    };
+
+    TunnelConn &c = *tunnels[s.tunnel];
+    const size_t written = s.written;
+
+    // nothing queued: send directly, without the copy into out
+    bool full = s.connecting;
+    if (len > 0 && s.out.size() == 0 && !full) {
+        const ssize_t n = send(s.fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (failed(n)) return false;
+        const size_t sent = n > 0 ? n : 0;
+        full = sent < len;
+        data += sent;
+        len -= sent;
+        s.written += sent;
+    }
+    if (len > 0) {
+        if (s.out.size() + len > c.policy.stream_window) {
+            error("Stream " + std::to_string(s.id) + " exceeded its window");
+            return false;
+        }
+        std::memcpy(s.out.reserve(len), data, len);
+        s.out.commit(len);
+    }
+    while (!full && s.out.size() > 0) {
+        const ssize_t n = send(s.fd, s.out.begin(), s.out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (failed(n)) return false;
+        if (n < 0) {
+            full = errno != EINTR;
+            continue;
+        }
+        s.out.consume(n);
+        s.written += n;
+    }
+
+    // return the credit in chunks of half a window, not per write: the peer still has the other half
+    if (s.written > written && s.written >= c.policy.stream_window / 2) {
+        pushFrame(s.tunnel, s.id, CREDIT, reinterpret_cast<const char*>(&s.written), sizeof(s.written));
+        s.written = 0;
+    }
+
+    // forward the half-close once everything was delivered
+    if (s.eof_out && !s.shut && !s.connecting && s.out.size() == 0) {
+        shutdown(s.fd, SHUT_WR);
+        s.shut = true;
+    }
+
+    if (s.eof_in && s.shut) {
+        closeStream(s, false);
+        return true;
+    }
+    return updateStream(s);
+}
+
+void TunnelWorker::closeStream(TunnelStream &s, const bool reset)
+{
+    if (s.closed) return;
+    TunnelConn &c = *tunnels[s.tunnel];
+    if (reset) pushFrame(s.tunnel, s.id, RESET);
+    close(s.fd);
+    s.closed = true;
+    closed_streams.push_back(&s);
+
+    // counters of the busy period that just ended, e.g. one benchmark run
+    if (--c.open_streams == 0 && c.frames > 0) {
+        std::cout << "tunnel=" << s.tunnel << " frames=" << c.frames << " bytes=" << c.bytes << " sends=" << c.sends
+            << " frames_per_send=" << (c.sends ? static_cast<double>(c.frames) / c.sends : 0.0) << std::endl;
+        c.frames = c.bytes = c.sends = 0;
+    }
+    logger("Stream " + std::to_string(s.id) + " closed. Open streams: " + std::to_string(streams.size() - closed_streams.size()));
+}
+
+void TunnelWorker::pushFrame(const size_t t, const uint32_t stream, const TunnelFrameType type, const char *payload, const uint16_t len)
+{
+    TunnelConn &c = *tunnels[t];
+    if (c.closed) return;
+    const TunnelFrame hdr = { stream, type, len };
+    char *dst = c.out.reserve(sizeof(hdr) + len);
+    std::memcpy(dst, &hdr, sizeof(hdr));
+    if (len) std::memcpy(dst + sizeof(hdr), payload, len);
+    c.out.commit(sizeof(hdr) + len);
+    stage(t, sizeof(hdr) + len);
+}
+
+// coalescing: hold the new frame back until enough bytes are pending or the latency budget is used up
+void TunnelWorker::stage(const size_t t, const size_t n)
+{
+    TunnelConn &c = *tunnels[t];
+    c.frames++;
+    c.staged += n;
+    if (c.policy.coalesce_bytes == 0 || c.policy.coalesce_us == 0 || c.staged >= c.policy.coalesce_bytes) {
+        release(t);
+    } else if (c.deadline_ns == 0) {
+        c.deadline_ns = monotonic_ns() + c.policy.coalesce_us * 1000ull;
+        if (timer_ns == 0 || c.deadline_ns < timer_ns) armTimer();
+    }
+}
+
+// all frames of the tunnel connection may be sent, at the end of the current event batch
+void TunnelWorker::release(const size_t t)
+{
+    TunnelConn &c = *tunnels[t];
+    c.staged = 0;
+    c.deadline_ns = 0;
+    if (!c.dirty) {
+        c.dirty = true;
+        dirty.push_back(t);
+    }
+}
+
+bool TunnelWorker::flush(const size_t t)
+{
+    TunnelConn &c = *tunnels[t];
+    while (c.out.size() > c.staged)
+    {
+        const ssize_t n = send(c.fd, c.out.begin(), c.out.size() - c.staged, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                c.want_out = true;
+                break;
+            }
+            if (errno == EINTR) continue;
+            if (errno != EPIPE && errno != ECONNRESET) error("Tunnel write failed with ERROR: " + std::string(strerror(errno)));
+            return false;
+        }
+        c.sends++;
+        c.bytes += n;
+        c.out.consume(n);
+    }
+
+    // resume the streams paused on the full tunnel connection
+    if (!c.blocked.empty() && c.out.size() < config.tunnel_buf_size) {
+        std::vector<uint32_t> blocked;
+        blocked.swap(c.blocked);
+        for (const uint32_t id : blocked) {
+            auto it = streams.find(TunnelStream::key(t, id));
+            if (it == streams.end() || it->second->closed) continue;
+            it->second->blocked = false;
+            if (!updateStream(*it->second)) closeStream(*it->second, true);
+        }
+    }
+    return true;
+}
+
+void TunnelWorker::onTimer()
+{
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        error("Timer read failed with ERROR: " + std::string(strerror(errno)));
+    timer_ns = 0;
+
+    const uint64_t now = monotonic_ns();
+    for (size_t t = 0; t < tunnels.size(); t++)
+        if (tunnels[t] && !tunnels[t]->closed && tunnels[t]->deadline_ns && tunnels[t]->deadline_ns <= now)
+            release(t);
+    armTimer();
+}
+
+// one timer for all tunnel connections, armed for the earliest deadline
+void TunnelWorker::armTimer()
+{
+    uint64_t next = 0;
+    for (const auto &c : tunnels)
+        if (c && !c->closed && c->deadline_ns && (next == 0 || c->deadline_ns < next))
+            next = c->deadline_ns;
+    if (next == timer_ns) return;
+
+    struct itimerspec its = {};  // zero disarms
+    its.it_value.tv_sec = next / 1000000000ull;
+    its.it_value.tv_nsec = next % 1000000000ull;
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, nullptr) < 0)
+        error("timerfd_settime failed with ERROR: " + std::string(strerror(errno)));
+    timer_ns = next;
+}
+
+// read from a stream while its tunnel connection has room, write to it while data is queued
+bool TunnelWorker::updateStream(TunnelStream &s)
+{
+    uint32_t events = 0;
+    if (!s.connecting && !s.eof_in && !s.blocked && s.credit > 0)
+        events |= EPOLLIN | EPOLLRDHUP;
+    if (s.connecting || s.out.size() > 0)
+        events |= EPOLLOUT;
+    return setInterest(s.fd, s.key(), s.interest, events);
+}
+
+// always read from a tunnel connection (flow control is per stream), write to it while its send buffer was full
+bool TunnelWorker::updateTunnel(const size_t t)
+{
+    TunnelConn &c = *tunnels[t];
+    uint32_t events = EPOLLIN | EPOLLRDHUP;
+    if (c.want_out)
+        events |= EPOLLOUT;
+    return setInterest(c.fd, TAG_TUNNEL | t, c.interest, events);
+}
+
+bool TunnelWorker::setInterest(const int fd, const uint64_t tag, uint32_t &interest, const uint32_t events, const bool add)
+{
+    if (!add && events == interest) return true;
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.u64 = tag;
+    if (epoll_ctl(epoll_fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev) < 0) {
+        error("epoll_ctl failed with ERROR: " + std::string(strerror(errno)));
+        return false;
+    }
+    interest = events;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+
+    int rc = 0;
+
+    gflags::SetUsageMessage("Socket latency microbenchmark - PROXY");
+    gflags::ParseCommandLineFlags(&argc, &argv, false);
+
+    ProxyConfig config;
+    parseProxyConfig(config);
+    logger(config.to_string());
+
+    Proxy proxy(config);
+    proxy.run();
+
+    return rc;
+}
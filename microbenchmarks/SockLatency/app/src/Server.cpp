@@ -1,8 +1,127 @@
 // app/Server.cpp
 #include "Server.hpp"
 
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <limits>
+#include <chrono>
+
 #include "Logger.hpp"
 #include "options.hpp"
+// server opts
+DEFINE_string(server_mode, "serial", "Connection handling mode (serial or epoll)");
+DEFINE_uint32(max_events, 1024, "Maximum number of events handled per epoll_wait call (epoll mode only)");
+
+// upper bound of responses sent at once to back-to-back (pipelined) small requests
+constexpr size_t MAX_RSP_BATCH = 64;
+
+// timestamps mode: stamp the head of the first count responses in rsp
+static inline void stampResponses(std::string &rsp, const size_t rsp_size, const size_t count, const uint64_t request_rcvd)
+{
+    const ServerTimestamps ts = { request_rcvd, monotonic_ns() };
+    for (size_t i = 0; i < count; i++)
+        std::memcpy(rsp.data() + i * rsp_size, &ts, sizeof(ts));
+}
+
+// framed protocol: put the header of the response to req into the head of rsp,
+// returns the response frame size or 0 if the requested size is invalid or exceeds rsp (the session's rsp_size)
+static inline size_t frameResponse(std::string &rsp, const FrameHeader &req)
+{
+    if (req.rsp_size < sizeof(FrameHeader) || req.rsp_size > rsp.size()) [[unlikely]] {
+        error("Invalid frame: seq " + std::to_string(req.seq) + " requests a response of " + std::to_string(req.rsp_size) +
+              " bytes, supported are " + std::to_string(sizeof(FrameHeader)) + " to " + std::to_string(rsp.size()));
+        return 0;
+    }
+    put_frame_header(rsp.data(), make_frame_header(req.seq, req.rsp_size));
+    return req.rsp_size;
+}
+
+// framed protocol: rsp_size is the largest response of the session, the receive buffer has to hold a header
+static bool validFramedConfig(const ServerDynamicConfig &cfg)
+{
+    if (!cfg.framed) return true;
+    if (cfg.rsp_size < sizeof(FrameHeader) || cfg.buf_size < sizeof(FrameHeader)) {
+        error("Invalid config: the framed protocol requires rsp_size and buf_size >= " + std::to_string(sizeof(FrameHeader)));
+        return false;
+    }
+    if (cfg.timestamps) {
+        error("Invalid config: timestamps require the raw protocol");
+        return false;
+    }
+    return true;
+}
+
+// sealed records: raw request/response sizes on a serial connection, the receive buffer has to hold a record header
+static bool validSealedConfig(const ServerDynamicConfig &cfg)
+{
+    if (cfg.seal == SealCipher::PLAINTEXT) return true;
+    if (cfg.seal != SealCipher::AES_128_GCM && cfg.seal != SealCipher::AES_256_GCM) {
+        error("Invalid config: unknown seal cipher");
+        return false;
+    }
+    if (cfg.framed || cfg.timestamps || (cfg.workload != Workload::LATENCY && cfg.workload != Workload::SCAN)) {
+        error("Invalid config: sealed records require the raw protocol without timestamps and the latency or scan workload");
+        return false;
+    }
+    if (cfg.workload == Workload::SCAN && cfg.seal_record_size != 0) {
+        error("Invalid config: sealed scan batches travel as one record per batch (seal_record_size 0)");
+        return false;
+    }
+    if (cfg.buf_size < sizeof(SealHeader)) {
+        error("Invalid config: sealed records require buf_size >= " + std::to_string(sizeof(SealHeader)));
+        return false;
+    }
+    return true;
+}
+
+// compressed streams: bandwidth workloads on a serial connection with a codec of this build
+static bool validCompressedConfig(const ServerDynamicConfig &cfg)
+{
+    if (cfg.compression == CompressionCodec::UNCOMPRESSED) return true;
+    if (!compression_supported(cfg.compression)) {
+        error("Invalid config: compression codec " + to_string(cfg.compression) + " is not supported by this build");
+        return false;
+    }
+    if (cfg.workload == Workload::LATENCY || cfg.workload == Workload::SCAN || cfg.seal != SealCipher::PLAINTEXT) {
+        error("Invalid config: compression requires a bandwidth workload without sealed records");
+        return false;
+    }
+    if (cfg.compression_chunk == 0 || cfg.compression_chunk > MAX_COMPRESSION_CHUNK) {
+        error("Invalid config: compression_chunk must be between 1 and " + std::to_string(MAX_COMPRESSION_CHUNK));
+        return false;
+    }
+    return true;
+}
+
+// scan workload: batches of at most MAX_BATCH_ROWS rows, a filter kernel of this cpu
+static bool validScanConfig(const ServerDynamicConfig &cfg)
+{
+    if (cfg.workload != Workload::SCAN) return true;
+    if (cfg.scan_batch_rows == 0 || cfg.scan_batch_rows > MAX_BATCH_ROWS || cfg.scan_buffers == 0 || cfg.scan_groups == 0) {
+        error("Invalid config: the scan workload requires 0 < scan_batch_rows <= " + std::to_string(MAX_BATCH_ROWS) + ", scan_buffers > 0 and scan_groups > 0");
+        return false;
+    }
+    const SimdLevel level = static_cast<SimdLevel>(cfg.scan_simd);
+    if (level != SimdLevel::AUTO && !simd_supported(level)) {
+        error("Invalid config: SIMD level " + to_string(level) + " is not supported by this cpu");
+        return false;
+    }
+    return true;
+}
+
+ServerMode getServerMode() {
+    if (FLAGS_server_mode == "serial") {
+        return ServerMode::SERIAL;
+    } else if (FLAGS_server_mode == "epoll") {
+        return ServerMode::EPOLL;
+    } else {
+        throw std::runtime_error("Invalid server mode");
+    }
+}
 
 Server::Server(const SocketProtocol protocol, const size_t buf_size) : 
     protocol(protocol), buf(std::make_unique<char[]>(buf_size)), config(), server_fd(-1), client_con_fd(-1)
@@ -11,7 +130,7 @@ Server::Server(const SocketProtocol protocol, const size_t buf_size) :
     int opt = 1;
 
     // Creating socket file descriptor
-    if ((server_fd = socket(af_from_enum(protocol), SOCK_STREAM, 0)) <= 0) {
+    if ((server_fd = socket(af_from_enum(protocol), socktype_from_enum(protocol), 0)) <= 0) {
         error("Socket failed with ERROR: " + std::string(strerror(errno)));
         throw std::runtime_error("Socket failed");
     }
@@ -23,8 +142,8 @@ Server::Server(const SocketProtocol protocol, const size_t buf_size) :
         throw std::runtime_error("Setsockopt SO_REUSEADDR failed");
     }
 
-    // Set SO_REUSEPORT option
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+    // Set SO_REUSEPORT option (inet and vsock only, recent kernels reject it on unix sockets)
+    if (af_from_enum(protocol) != AF_UNIX && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
         error("Setsockopt SO_REUSEPORT failed");
         close(server_fd);
         throw std::runtime_error("Setsockopt SO_REUSEPORT failed");
@@ -36,6 +155,10 @@ std::unique_ptr<Server> Server::make(const SocketProtocol protocol, const std::s
         return std::make_unique<InetServer>(adr, port, buf_size);
     } else if (protocol == SocketProtocol::VSOCK) {
         return std::make_unique<VsockServer>(adr, port, buf_size);
+    } else if (protocol == SocketProtocol::UNIX || protocol == SocketProtocol::UNIX_SEQPACKET) {
+        return std::make_unique<UnixServer>(protocol, adr, buf_size);
+    } else if (protocol == SocketProtocol::SHM) {
+        return std::make_unique<ShmServer>(adr, buf_size);
     } else {
         throw std::invalid_argument("Unsupported protocol");
     }
@@ -62,7 +185,40 @@ VsockServer::VsockServer(const std::string &adr, const int port, const size_t bu
     address.svm_cid = (uint32_t) std::stoul(adr);  // typically VMADDR_CID_ANY = -1U
 }
 
-void Server::startServer()
+UnixServer::UnixServer(const SocketProtocol protocol, const std::string &path, const size_t buf_size) : Server(protocol, buf_size), address(), client_addr()
+{
+    // Define the server address, a stale socket file of a previous run would fail the bind
+    addrlen = unix_sockaddr(path, address);
+    if (address.sun_path[0] != '\0' && unlink(address.sun_path) < 0 && errno != ENOENT) {
+        error("Removing stale socket " + path + " failed with " + std::string(strerror(errno)));
+        throw std::runtime_error("Removing stale socket failed");
+    }
+}
+
+UnixServer::~UnixServer()
+{
+    if (address.sun_path[0] != '\0')
+        unlink(address.sun_path);
+}
+
+bool ShmServer::attachChannel()
+{
+    // the client passes the rings right after connecting
+    const int fd = recv_fd(client_con_fd);
+    if (fd < 0) {
+        error("Receiving the shared memory channel failed");
+        return false;
+    }
+    try {
+        shm = ShmChannel::attach(fd);
+    } catch (const std::runtime_error &) {
+        return false;  // already reported
+    }
+    logger("Shared memory channel attached.");
+    return true;
+}
+
+void Server::startServer(const int backlog)
 {
     socklen_t addrlen;
     const sockaddr *addr = getSockAddrServer(&addrlen);
@@ -75,7 +231,7 @@ void Server::startServer()
     }
 
     // Start listening for connections
-    if (listen(server_fd, 3) < 0) {
+    if (listen(server_fd, backlog) < 0) {
         error("Listen failed");
         close(server_fd);
         throw std::runtime_error("Listen failed");
@@ -107,53 +263,281 @@ void Server::applyConfig(ServerDynamicConfig &cfg)
     }
     config = cfg;
 }
-void Server::handshake()
+bool Server::handshake()
 {
-    // Receive hello message from client
+    // Receive hello message from client, it may arrive in several segments
     ServerDynamicConfig cfg;
-    const int msg_len = read(client_con_fd, buf.get(), getBufSize());
-    cfg = *reinterpret_cast<ServerDynamicConfig*>(buf.get());
+    if (readall(client_con_fd, reinterpret_cast<char*>(&cfg), sizeof(cfg)) != sizeof(cfg)) {
+        error("Handshake failed: incomplete config from client");
+        return false;
+    }
     logger("Server Config updated from client: " + cfg.to_string());
 
     // apply config
     applyConfig(cfg);
 
     // Respond with hello message to client
-    char hello[] = "Hello from server";
-    send(client_con_fd, hello, strlen(hello), 0);
+    std::string hello(SERVER_HELLO, SERVER_HELLO_LEN);
+    if (sendall(client_con_fd, hello) != (int64_t) hello.size()) {
+        error("Sending hello failed");
+        return false;
+    }
     logger("Hello message sent to client");
+    return true;
 }
 
 void Server::handleClient()
 {
-    // Continuously read messages from the client and respond until the client closes the socket
+    // a sweep re-enters with the config updated by the client
+    bool serve = true;
+    while (serve)
+    {
+        serve = false;
+        if (config.req_size == 0 || config.rsp_size == 0)
+        {
+            error("Invalid config: req_size and rsp_size must be greater than 0");
+        }
+        else if (config.timestamps && config.rsp_size < sizeof(ServerTimestamps))
+        {
+            error("Invalid config: timestamps require rsp_size >= " + std::to_string(sizeof(ServerTimestamps)));
+        }
+        else if (!validFramedConfig(config) || !validSealedConfig(config) || !validCompressedConfig(config) || !validScanConfig(config))
+        {
+            // already reported
+        }
+        else if (config.workload == Workload::SCAN)
+        {
+            scanClient();
+        }
+        else if (config.compression != CompressionCodec::UNCOMPRESSED)
+        {
+            streamCompressed();
+        }
+        else if (config.workload != Workload::LATENCY)
+        {
+            streamClient(std::string(config.rsp_size, 'a'));
+        }
+        else
+        {
+            // the response buffer holds up to one response per request that fits into the read buffer,
+            // framed: a single response frame of up to rsp_size bytes, sealed: the plaintext of a response
+            const bool large = config.rsp_size > THRESH_LARGE_MSG || config.req_size > THRESH_LARGE_MSG;
+            const size_t batch = config.framed || config.seal != SealCipher::PLAINTEXT || large ? 1 : std::min(getBufSize() / config.req_size + 1, MAX_RSP_BATCH);
+            std::string rsp(config.rsp_size * batch, 'a');
+
+            switch (io)
+            {
+            case IoBackend::BLOCKING: {
+                if (shm) {
+                    ShmTransport transport(*shm, true, client_con_fd, recv_opts);
+                    serve = serveClient(transport, rsp);
+                    break;
+                }
+                BlockingTransport transport(client_con_fd, recv_opts);
+                serve = serveClient(transport, rsp);
+                break;
+            }
+            #if HAVE_IO_URING
+            case IoBackend::URING: {
+                if (recv_opts.strategy != RecvStrategy::BLOCKING)
+                    throw std::invalid_argument("Receive strategies other than blocking require the blocking io backend");
+                UringTransport transport(client_con_fd, getUringOptions(), rsp.data(), rsp.size(), buf.get(), getBufSize());
+                serve = serveClient(transport, rsp);
+                break;
+            }
+            #endif
+            default:
+                throw std::invalid_argument("Unsupported io backend");
+            }
+        }
+    }
+
+    // Close the client socket
+    shm.reset();
+    close(client_con_fd);
+    logger("Client connection closed. waiting for new connection...");
+}
+
+template <typename Transport>
+bool Server::reconfigure(Transport &transport, const size_t n)
+{
+    ServerDynamicConfig cfg;
+    char *dst = reinterpret_cast<char*>(&cfg);
+    const size_t have = std::min(n - 1, sizeof(cfg));
+    std::memcpy(dst, buf.get() + 1, have);
+    if (have < sizeof(cfg) && transport.readall(dst + have, sizeof(cfg) - have) != (int64_t) (sizeof(cfg) - have)) {
+        error("Config update failed: incomplete config from client");
+        return false;
+    }
+    logger("Server Config updated from client: " + cfg.to_string());
+    applyConfig(cfg);
+
+    if (transport.write(SERVER_HELLO, SERVER_HELLO_LEN) != (int64_t) SERVER_HELLO_LEN) {
+        error("Config update failed: sending hello failed");
+        return false;
+    }
+    return true;
+}
+
+template <typename Transport>
+bool Server::serveClient(Transport &transport, std::string &rsp)
+{
+    // Continuously read messages from the client and respond until the client closes the socket.
+    // Sending a response and reading the next request is one roundtrip on the transport.
+    // Returns true if the client updated the config instead (sweep), i.e. has to be served again.
+    const double cpu_start = cpu_clock_sec();
+    const auto start = std::chrono::steady_clock::now();
+    const PerfMeter perf(FLAGS_perf_counters);
+    bool updated = false;
     int64_t msg_len;
-    std::string rsp(config.rsp_size, 'a');
-    if (config.rsp_size > THRESH_LARGE_MSG || config.req_size > THRESH_LARGE_MSG)
+    uint64_t crypto_ns = 0;  // sealed: session total
+    if (config.seal != SealCipher::PLAINTEXT)
     {
-        while ((msg_len = readall(client_con_fd, buf.get(), config.req_size)) > 0) [[likely]] {
+        // record headers are read into buf (a config update is longer than a header), the bodies are opened in place in record
+        RecordCipher cipher(config, true);
+        const size_t max_record = cipher.maxRecord(config.req_size);
+        std::unique_ptr<char[]> record = std::make_unique<char[]>(max_record + SEAL_TAG_LEN);
+        std::string sealed(sealed_size(rsp.size(), config.seal_record_size), '\0');
+        uint64_t roundtrip_ns = 0;  // crypto time of the current roundtrip
+        size_t rcvd = 0;            // plaintext bytes of the current request
+        msg_len = transport.readall(buf.get(), sizeof(SealHeader));
+        while (msg_len == (int64_t) sizeof(SealHeader)) [[likely]] {
+            if (rcvd == 0 && buf[0] == CONFIG_UPDATE_MARKER) [[unlikely]] {
+                updated = reconfigure(transport, msg_len);
+                break;
+            }
+
+            const SealHeader hdr = get_seal_header(buf.get());
+            if (!cipher.check(hdr, std::min(max_record, config.req_size - rcvd))) [[unlikely]] {
+                error("Invalid record: seq " + std::to_string(hdr.seq) + ", " + std::to_string(hdr.len) + " bytes");
+                msg_len = -1;
+                break;
+            }
+            if ((msg_len = transport.readall(record.get(), hdr.len + SEAL_TAG_LEN)) != (int64_t) (hdr.len + SEAL_TAG_LEN)) [[unlikely]]
+                break;
+            const uint64_t open_start = monotonic_ns();
+            if (!cipher.open(hdr, record.get())) [[unlikely]] {
+                error("Invalid record: seq " + std::to_string(hdr.seq) + " failed authentication");
+                msg_len = -1;
+                break;
+            }
+            roundtrip_ns += monotonic_ns() - open_start;
+            rcvd += hdr.len;
+
+            // respond once the request is complete and wait for the next one
+            if (hdr.flags & SEAL_LAST) {
+                if (rcvd != config.req_size) [[unlikely]] {
+                    error("Invalid request: " + std::to_string(rcvd) + " of " + std::to_string(config.req_size) + " bytes");
+                    msg_len = -1;
+                    break;
+                }
+                const uint64_t seal_start = monotonic_ns();
+                const size_t sealed_len = cipher.seal(rsp.data(), rsp.size(), sealed.data());
+                roundtrip_ns += monotonic_ns() - seal_start;
+                put_seal_crypto_ns(sealed.data(), static_cast<uint32_t>(std::min<uint64_t>(roundtrip_ns, std::numeric_limits<uint32_t>::max())));
+                crypto_ns += roundtrip_ns;
+                roundtrip_ns = 0;
+                rcvd = 0;
+                if (transport.write(sealed.data(), sealed_len) != (int64_t) sealed_len) [[unlikely]] {
+                    msg_len = -1;
+                    break;
+                }
+            }
+            msg_len = transport.readall(buf.get(), sizeof(SealHeader));
+        }
+    }
+
+    else if (config.framed)
+    {
+        // frames are parsed in place in buf and may be larger than buf, one response frame per request frame
+        FrameReader reader(buf.get(), getBufSize());
+        std::vector<FrameHeader> frames;
+        msg_len = transport.read(reader.readPtr(), reader.readLen());
+        while (msg_len > 0) [[likely]] {
+            if (reader.idle() && buf[0] == CONFIG_UPDATE_MARKER) [[unlikely]] {
+                updated = reconfigure(transport, msg_len);
+                break;
+            }
+
+            frames.clear();
+            if (!reader.consume(msg_len, [&](const FrameHeader &hdr) { frames.push_back(hdr); })) [[unlikely]] {
+                error("Invalid frame: " + reader.error());
+                break;
+            }
+
+            // respond to the client and wait for the next request, back-to-back frames are answered one by one
+            size_t rsp_len = 0;
+            for (const FrameHeader &hdr : frames) {
+                if (rsp_len > 0) transport.write(rsp.data(), rsp_len);
+                if ((rsp_len = frameResponse(rsp, hdr)) == 0) break;
+            }
+            if (rsp_len == 0 && !frames.empty()) [[unlikely]] break;
+            msg_len = rsp_len > 0 ? transport.roundtrip(rsp.data(), rsp_len, reader.readPtr(), reader.readLen())
+                                  : transport.read(reader.readPtr(), reader.readLen());
+        }
+    }
+
+    else if (config.rsp_size > THRESH_LARGE_MSG || config.req_size > THRESH_LARGE_MSG)
+    {
+        // the first read tells requests from config updates, which may be shorter than a request
+        msg_len = transport.read(buf.get(), config.req_size);
+        while (msg_len > 0) [[likely]] {
+            if (buf[0] == CONFIG_UPDATE_MARKER) [[unlikely]] {
+                updated = reconfigure(transport, msg_len);
+                break;
+            }
+            if (msg_len < (int64_t) config.req_size) {
+                const int64_t rest = transport.readall(buf.get() + msg_len, config.req_size - msg_len);
+                if (rest <= 0) [[unlikely]] {
+                    msg_len = rest;
+                    break;
+                }
+            }
+            if (config.timestamps) stampResponses(rsp, config.rsp_size, 1, monotonic_ns());
 
             #ifdef DEBUG
             logger("Message from client: " + std::to_string(msg_len) + "(" + std::string(buf.get()) + ")");
             memset(buf.get(), 0, getBufSize()); // Clear the buffer after each read
             #endif
 
-            // respond to the client
-            sendall(client_con_fd, rsp);
+            // respond to the client and wait for the next request
+            msg_len = transport.roundtrip(rsp.data(), rsp.size(), buf.get(), config.req_size);
         }
     }
 
     else
     {
-        while ((msg_len = read(client_con_fd, buf.get(), getBufSize())) > 0) [[likely]] {
+        // requests may arrive back-to-back (pipelining) or split across reads: one response per complete request
+        const size_t batch = rsp.size() / config.rsp_size;
+        size_t partial = 0;
+        msg_len = transport.read(buf.get(), getBufSize());
+        while (msg_len > 0) [[likely]] {
+            const uint64_t rcvd_ns = config.timestamps ? monotonic_ns() : 0;
+            if (partial == 0 && buf[0] == CONFIG_UPDATE_MARKER) [[unlikely]] {
+                updated = reconfigure(transport, msg_len);
+                break;
+            }
 
             #ifdef DEBUG
             logger("Message from client: " + std::to_string(msg_len) + "(" + std::string(buf.get()) + ")");
             memset(buf.get(), 0, getBufSize()); // Clear the buffer after each read
             #endif
 
-            // respond to the client
-            send(client_con_fd, rsp.c_str(), rsp.length(), 0);
+            partial += msg_len;
+            size_t requests = partial / config.req_size;
+            partial %= config.req_size;
+            for (; requests > batch; requests -= batch) {
+                if (config.timestamps) stampResponses(rsp, config.rsp_size, batch, rcvd_ns);
+                transport.write(rsp.data(), rsp.size());
+            }
+
+            // respond to the client and wait for the next request
+            if (requests == 0) {
+                msg_len = transport.read(buf.get(), getBufSize());
+            } else {
+                if (config.timestamps) stampResponses(rsp, config.rsp_size, requests, rcvd_ns);
+                msg_len = transport.roundtrip(rsp.data(), requests * config.rsp_size, buf.get(), getBufSize());
+            }
         }
     }
 
@@ -163,13 +547,240 @@ void Server::handleClient()
         error("Read error occurred.");
     }
 
-    // Close the client socket
-    close(client_con_fd);
-    logger("Client connection closed. waiting for new connection...");
+    // cpu time per wall time of the session, i.e. the cost of the receive strategy on the server side
+    const double elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double cpu_sec = cpu_clock_sec() - cpu_start;
+    std::cout << "recv_strategy=" << recv_opts.strategy << " recv_poll_us=" << recv_opts.poll_us
+              << " session_sec=" << elapsed_sec << " cpu_sec=" << cpu_sec
+              << " cpu_util=" << (elapsed_sec > 0 ? cpu_sec / elapsed_sec : 0);
+    if (config.seal != SealCipher::PLAINTEXT)
+        std::cout << " seal=" << config.seal << " crypto_sec=" << crypto_ns / 1e9;
+    if (FLAGS_perf_counters) {
+        LoopCounters counters = perf.read();
+        counters.setIo(transport.stats);
+        std::cout << " " << counters.to_kv();
+    }
+    std::cout << std::endl;
+    return updated;
+}
+
+void Server::streamClient(const std::string &rsp)
+{
+    // bandwidth workloads: discard everything the client sends until it closes the connection,
+    // for RECV and BIDIR a second thread streams rsp_size messages to the client meanwhile
+    std::thread sender;
+    if (config.workload == Workload::RECV || config.workload == Workload::BIDIR)
+        sender = std::thread([&]() {
+            while (send(client_con_fd, rsp.data(), rsp.size(), MSG_NOSIGNAL) > 0);
+        });
+
+    uint64_t bytes = 0;
+    ssize_t n;
+    while ((n = read(client_con_fd, buf.get(), getBufSize())) > 0)
+        bytes += n;
+    if (n < 0 && errno != ECONNRESET)
+        error("Read error occurred: " + std::string(strerror(errno)));
+    logger("Client disconnected. Received " + std::to_string(bytes) + " bytes.");
+
+    // unblock the sender
+    shutdown(client_con_fd, SHUT_RDWR);
+    if (sender.joinable())
+        sender.join();
+}
+
+void Server::streamCompressed()
+{
+    // compressed bandwidth workloads: decompress the chunks the client sends until it closes the connection,
+    // for RECV and BIDIR a second thread streams compressed chunks of synthetic data meanwhile
+    const double cpu_start = cpu_clock_sec();
+    const auto start = std::chrono::steady_clock::now();
+    const bool do_send = config.workload == Workload::RECV || config.workload == Workload::BIDIR;
+    const std::vector<std::string> chunks = do_send ? compressible_chunks(config, 0x5eed) : std::vector<std::string>();
+    uint64_t raw_sent = 0, wire_sent = 0;
+    double sender_cpu_sec = 0;  // sending thread and its compression worker
+    std::thread sender;
+    if (do_send)
+        sender = std::thread([&]() {
+            const double sender_start = cpu_clock_sec();
+            CompressPipeline pipeline(config, chunks);
+            size_t len, raw;
+            const char *frame;
+            while ((frame = pipeline.next(len, raw)) != nullptr && send_frame(client_con_fd, frame, len)) {
+                pipeline.release();
+                raw_sent += raw;
+                wire_sent += len;
+            }
+            pipeline.stop();
+            sender_cpu_sec = cpu_clock_sec() - sender_start + pipeline.workerCpuSec();
+        });
+
+    ChunkReader reader(config);
+    while (reader.next(client_con_fd));
+    if (!reader.error().empty())
+        error(reader.error());
+    logger("Client disconnected. Received " + std::to_string(reader.wire_bytes) + " bytes.");
+
+    // unblock the sender
+    shutdown(client_con_fd, SHUT_RDWR);
+    if (sender.joinable())
+        sender.join();
+
+    const double elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double cpu_sec = cpu_clock_sec() - cpu_start + sender_cpu_sec;
+    const uint64_t raw_bytes = reader.raw_bytes + raw_sent;
+    std::cout << "compression=" << config.compression << " compression_level=" << config.compression_level
+              << " raw_bytes_rcvd=" << reader.raw_bytes << " wire_bytes_rcvd=" << reader.wire_bytes
+              << " raw_bytes_sent=" << raw_sent << " wire_bytes_sent=" << wire_sent
+              << " session_sec=" << elapsed_sec << " cpu_sec=" << cpu_sec
+              << " cpu_ns_per_raw_byte=" << (raw_bytes ? cpu_sec * 1e9 / raw_bytes : 0) << std::endl;
 }
 
-void Server::run()
+void Server::scanClient()
 {
+    // scan workload: a receiving thread reads the batches into the ring (the batch at BATCH_ALIGN, a record header
+    // right before it), the calling thread opens, filters and aggregates them meanwhile. After the end of the stream
+    // the aggregates go back to the client.
+    const bool sealed = config.seal != SealCipher::PLAINTEXT;
+    const size_t max_batch = batch_bytes(config.scan_batch_rows);
+    const SimdLevel level = resolve_simd(static_cast<SimdLevel>(config.scan_simd));
+    BatchRing ring(config.scan_buffers, BATCH_ALIGN + max_batch + SEAL_TAG_LEN);
+    std::unique_ptr<RecordCipher> cipher = sealed ? std::make_unique<RecordCipher>(config, true) : nullptr;
+    std::vector<uint32_t> sel(config.scan_batch_rows);
+    AggTable table(config.scan_groups);
+    ScanSummary summary = {};
+    summary.simd = static_cast<uint32_t>(level);
+
+    const uint64_t start_ns = monotonic_ns();
+    bool recv_ok = true;
+    std::thread receiver([&]() {
+        // sealed: the record header announces the batch size, otherwise the batch header
+        const size_t head_len = sealed ? sizeof(SealHeader) : sizeof(BatchHeader);
+        const size_t head_off = sealed ? BATCH_ALIGN - sizeof(SealHeader) : BATCH_ALIGN;
+        while (true) {
+            const uint64_t acquire_ns = monotonic_ns();
+            char *buf = ring.acquire();
+            if (buf == nullptr) break;
+            const uint64_t read_ns = monotonic_ns();
+            summary.recv_stall_ns += read_ns - acquire_ns;
+
+            if (readall(client_con_fd, buf + head_off, head_len) != (int64_t) head_len) {
+                recv_ok = false;
+                break;
+            }
+            size_t rest;
+            bool last;  // end of the stream, a batch without rows
+            if (sealed) {
+                const SealHeader hdr = get_seal_header(buf + head_off);
+                rest = hdr.len + SEAL_TAG_LEN;
+                last = hdr.len == sizeof(BatchHeader);
+                if (hdr.len > max_batch) {
+                    error("Invalid record: " + std::to_string(hdr.len) + " bytes exceed the batch size");
+                    recv_ok = false;
+                    break;
+                }
+            } else {
+                BatchHeader hdr;
+                std::memcpy(&hdr, buf + BATCH_ALIGN, sizeof(hdr));
+                if (hdr.magic != BATCH_MAGIC || hdr.rows > config.scan_batch_rows) {
+                    error("Invalid batch header: " + std::to_string(hdr.rows) + " rows");
+                    recv_ok = false;
+                    break;
+                }
+                rest = hdr.rows ? batch_bytes(hdr.rows) - sizeof(BatchHeader) : 0;
+                last = hdr.rows == 0;
+            }
+            if (rest && readall(client_con_fd, buf + head_off + head_len, rest) != (int64_t) rest) {
+                recv_ok = false;
+                break;
+            }
+            summary.recv_ns += monotonic_ns() - read_ns;
+            ring.publish(head_len + rest);
+            if (last) break;
+        }
+        ring.close();
+    });
+
+    // compute until the end of the stream
+    bool done = false;
+    while (!done) {
+        const uint64_t take_ns = monotonic_ns();
+        size_t len;
+        char *buf = ring.take(len);
+        if (buf == nullptr) break;
+        const uint64_t compute_ns = monotonic_ns();
+        summary.compute_stall_ns += compute_ns - take_ns;
+
+        bool valid = true;
+        if (sealed) {
+            const SealHeader hdr = get_seal_header(buf + BATCH_ALIGN - sizeof(SealHeader));
+            valid = cipher->check(hdr, max_batch) && cipher->open(hdr, buf + BATCH_ALIGN);
+            len = hdr.len;
+            summary.crypto_ns += monotonic_ns() - compute_ns;
+        }
+        BatchView batch;
+        if (!valid || !decode_batch(buf + BATCH_ALIGN, len, config.scan_batch_rows, batch)) {
+            error(sealed && !valid ? "Invalid record: opening batch " + std::to_string(summary.batches) + " failed" :
+                                     "Invalid batch " + std::to_string(summary.batches));
+            ring.close();
+            break;
+        }
+        if (batch.rows == 0) {
+            done = true;
+        } else {
+            summary.selected += scan_aggregate(level, batch, config.scan_threshold, sel.data(), table);
+            summary.rows += batch.rows;
+            summary.batches++;
+        }
+        summary.compute_ns += monotonic_ns() - compute_ns;
+        ring.release();
+    }
+    summary.elapsed_ns = monotonic_ns() - start_ns;
+
+    // the receiving thread ends with the end of the stream, otherwise unblock it
+    if (!done) {
+        ring.close();
+        shutdown(client_con_fd, SHUT_RDWR);
+    }
+    receiver.join();
+
+    // the client is waiting for the result
+    if (done) {
+        std::string result(sizeof(ScanSummary), '\0');
+        table.forEach([&](const AggEntry &e) {
+            result.append(reinterpret_cast<const char*>(&e), sizeof(e));
+            summary.groups++;
+        });
+        std::memcpy(result.data(), &summary, sizeof(summary));
+        if (sendall(client_con_fd, result) != (int64_t) result.size())
+            error("Sending the scan result failed");
+    } else if (!recv_ok) {
+        error("Scan stream ended before its end marker");
+    }
+    logger("Client disconnected. Scanned " + std::to_string(summary.rows) + " rows in " + std::to_string(summary.batches) + " batches.");
+
+    std::cout << "scan_batch_rows=" << config.scan_batch_rows << " scan_buffers=" << config.scan_buffers << " simd=" << to_string(level)
+              << " session_sec=" << summary.elapsed_ns / 1e9 << " recv_sec=" << summary.recv_ns / 1e9
+              << " compute_sec=" << summary.compute_ns / 1e9 << " crypto_sec=" << summary.crypto_ns / 1e9
+              << " recv_stall_sec=" << summary.recv_stall_ns / 1e9 << " compute_stall_sec=" << summary.compute_stall_ns / 1e9
+              << " rows_s=" << (summary.elapsed_ns ? summary.rows * 1e9 / summary.elapsed_ns : 0) << std::endl;
+}
+
+void Server::run(const ServerMode mode)
+{
+    if (mode == ServerMode::EPOLL)
+    {
+        if (io != IoBackend::BLOCKING)
+            throw std::invalid_argument("epoll mode only supports the blocking io backend");
+        if (protocol == SocketProtocol::SHM)
+            throw std::invalid_argument("epoll mode does not support the shm protocol");
+        if (recv_opts.strategy != RecvStrategy::BLOCKING)
+            throw std::invalid_argument("epoll mode only supports the blocking receive strategy");
+        runEpoll();
+        return;
+    }
+
+    if (protocol == SocketProtocol::SHM && io != IoBackend::BLOCKING)
+        throw std::invalid_argument("The shm protocol has its own transport, use the blocking io backend");
 
     startServer();
 
@@ -177,15 +788,284 @@ void Server::run()
     {
         acceptConnection();
 
-        handshake();
+        if (!attachChannel() || !handshake())
+        {
+            shm.reset();
+            close(client_con_fd);
+            continue;
+        }
 
         handleClient();
     }
 
 }
+
+void Server::runEpoll()
+{
+    // lift the soft fd limit - every session costs one descriptor
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    startServer(SOMAXCONN);
+
+    if ((epoll_fd = epoll_create1(0)) < 0) {
+        error("epoll_create1 failed with ERROR: " + std::string(strerror(errno)));
+        throw std::runtime_error("epoll_create1 failed");
+    }
+
+    // the listening socket is non-blocking, so a burst of connects is drained in one go
+    fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL, 0) | O_NONBLOCK);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;  // nullptr marks the listening socket
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev) < 0) {
+        error("epoll_ctl (listen socket) failed with ERROR: " + std::string(strerror(errno)));
+        throw std::runtime_error("epoll_ctl failed");
+    }
+
+    std::vector<struct epoll_event> events(FLAGS_max_events);
+    logger("Server runs in epoll mode.");
+
+    while (true)
+    {
+        const int n = epoll_wait(epoll_fd, events.data(), events.size(), -1);
+        if (n < 0) [[unlikely]] {
+            if (errno == EINTR) continue;
+            error("epoll_wait failed with ERROR: " + std::string(strerror(errno)));
+            throw std::runtime_error("epoll_wait failed");
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (events[i].data.ptr == nullptr) {
+                acceptConnections();
+                continue;
+            }
+
+            Connection &con = *static_cast<Connection*>(events[i].data.ptr);
+            bool alive = true;
+            if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN))
+                alive = false;
+            if (alive && events[i].events & EPOLLIN)
+                alive = onReadable(con);
+            if (alive && events[i].events & EPOLLOUT)
+                alive = onWritable(con);
+            if (!alive)
+                closeConnection(con);
+        }
+    }
+}
+
+void Server::acceptConnections()
+{
+    while (true)
+    {
+        const int fd = accept4(server_fd, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            error("Accept failed with ERROR: " + std::string(strerror(errno)));
+            return;  // e.g. EMFILE - keep serving the existing sessions
+        }
+
+        auto con = std::make_unique<Connection>(fd, getBufSize());
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = con.get();
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            error("epoll_ctl (client socket) failed with ERROR: " + std::string(strerror(errno)));
+            close(fd);
+            continue;
+        }
+        connections.emplace(fd, std::move(con));
+        logger("Client connected. Open connections: " + std::to_string(connections.size()));
+        if (FLAGS_perf_counters && !busy_perf) busy_perf = std::make_unique<PerfMeter>(true);
+    }
+}
+
+void Server::closeConnection(Connection &con)
+{
+    const int fd = con.fd;
+    close(fd);  // also removes fd from the epoll set
+    connections.erase(fd);
+    logger("Client connection closed. Open connections: " + std::to_string(connections.size()));
+    if (connections.empty() && busy_perf) {
+        std::cout << "reactor " << busy_perf->read().to_kv() << std::endl;  // since the first connection
+        busy_perf.reset();
+    }
+}
+
+bool Server::updateInterest(Connection &con, const bool want_write)
+{
+    if (con.want_write == want_write) return true;
+
+    struct epoll_event ev = {};
+    ev.events = want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.ptr = &con;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, con.fd, &ev) < 0) {
+        error("epoll_ctl (modify) failed with ERROR: " + std::string(strerror(errno)));
+        return false;
+    }
+    con.want_write = want_write;
+    return true;
+}
+
+bool Server::onReadable(Connection &con)
+{
+    // bounded, so a connection that is streaming cannot starve the others (level-triggered, the rest is read next round)
+    constexpr int max_reads = 16;
+    for (int reads = 0; reads < max_reads; reads++)
+    {
+        // during the handshake read exactly the config, afterwards as much as the buffer holds (framed: behind a partial header)
+        size_t len = con.buf_size;
+        char *dst = con.buf.get();
+        if (con.state == Connection::State::HANDSHAKE) {
+            len = sizeof(ServerDynamicConfig) - con.rcvd;
+            dst = reinterpret_cast<char*>(&con.pending_config) + con.rcvd;
+        } else if (con.config.framed) {
+            len = con.reader.readLen();
+            dst = con.reader.readPtr();
+        }
+        ssize_t n = read(con.fd, dst, len);
+
+        if (n == 0) {
+            logger("Client disconnected.");
+            return false;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            if (errno != ECONNRESET)
+                error("Read error occurred: " + std::string(strerror(errno)));
+            return false;
+        }
+
+        // sweep: a config update while no request is outstanding, continue with it as handshake
+        if (con.state == Connection::State::ECHO && con.config.workload == Workload::LATENCY && con.rsp_pending == 0
+            && (con.config.framed ? con.reader.idle() : con.rcvd == 0) && dst[0] == CONFIG_UPDATE_MARKER)
+        {
+            n = std::min<ssize_t>(n - 1, sizeof(ServerDynamicConfig));
+            std::memcpy(&con.pending_config, dst + 1, n);
+            con.rcvd = 0;
+            con.state = Connection::State::HANDSHAKE;
+        }
+
+        if (con.state == Connection::State::HANDSHAKE)
+        {
+            con.rcvd += n;
+            if (con.rcvd < sizeof(ServerDynamicConfig)) continue;
+
+            // apply per-connection config
+            ServerDynamicConfig cfg = con.pending_config;
+            logger("Server Config updated from client: " + cfg.to_string());
+            if (cfg.req_size == 0 || cfg.rsp_size == 0) {
+                error("Invalid config: req_size and rsp_size must be greater than 0");
+                return false;
+            }
+            if (cfg.timestamps && cfg.rsp_size < sizeof(ServerTimestamps)) {
+                error("Invalid config: timestamps require rsp_size >= " + std::to_string(sizeof(ServerTimestamps)));
+                return false;
+            }
+            if (!validFramedConfig(cfg))
+                return false;
+            if (cfg.seal != SealCipher::PLAINTEXT) {
+                error("Invalid config: sealed records require --server_mode=serial");
+                return false;
+            }
+            if (cfg.compression != CompressionCodec::UNCOMPRESSED || cfg.workload == Workload::SCAN) {
+                error("Invalid config: compressed streams and the scan workload require --server_mode=serial");
+                return false;
+            }
+            if (cfg.buf_size != con.buf_size) {
+                con.buf = std::make_unique<char[]>(cfg.buf_size);
+                con.buf_size = cfg.buf_size;
+            }
+            con.config = cfg;
+            con.rsp = std::string(cfg.rsp_size, 'a');
+            con.reader = FrameReader(con.buf.get(), con.buf_size);
+            con.rcvd = 0;
+            con.state = Connection::State::ECHO;
+            if (cfg.workload == Workload::RECV || cfg.workload == Workload::BIDIR)
+                con.rsp_pending = std::numeric_limits<size_t>::max();  // stream until the client disconnects
+
+            // a fresh socket always has room for the short hello
+            if (send(con.fd, SERVER_HELLO, SERVER_HELLO_LEN, MSG_NOSIGNAL) != (ssize_t) SERVER_HELLO_LEN) {
+                error("Sending hello failed");
+                return false;
+            }
+            continue;
+        }
+
+        // bandwidth workloads discard the received data
+        if (con.config.workload != Workload::LATENCY) continue;
+
+        // one response is owed for each complete request (frame) in the stream
+        if (con.config.framed) {
+            bool valid = true;
+            if (!con.reader.consume(n, [&](const FrameHeader &hdr) {
+                    valid = valid && hdr.rsp_size >= sizeof(FrameHeader) && hdr.rsp_size <= con.rsp.size();
+                    con.frames.push_back(hdr);
+                    con.rsp_pending += hdr.rsp_size;
+                })) {
+                error("Invalid frame: " + con.reader.error());
+                return false;
+            }
+            if (!valid) {
+                error("Invalid frame: requested response size out of range");
+                return false;
+            }
+            continue;
+        }
+        con.rcvd += n;
+        const size_t requests = con.rcvd / con.config.req_size;
+        con.rsp_pending += requests * con.config.rsp_size;
+        con.rcvd %= con.config.req_size;
+        if (con.config.timestamps && requests > 0)
+            con.rcvd_ns.insert(con.rcvd_ns.end(), requests, monotonic_ns());
+    }
+
+    return con.rsp_pending ? onWritable(con) : true;
+}
+
+bool Server::onWritable(Connection &con)
+{
+    while (con.rsp_pending > 0)
+    {
+        // framed: the size of the current response is requested by its frame
+        const size_t rsp_size = con.config.framed ? con.frames.front().rsp_size : con.rsp.size();
+        if (con.config.framed && con.rsp_offset == 0)
+            frameResponse(con.rsp, con.frames.front());
+        if (con.config.timestamps && con.rsp_offset == 0)
+            stampResponses(con.rsp, rsp_size, 1, con.rcvd_ns.front());
+        const size_t len = std::min(rsp_size - con.rsp_offset, con.rsp_pending);
+        const ssize_t n = send(con.fd, con.rsp.data() + con.rsp_offset, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return updateInterest(con, true);
+            if (errno == EINTR) continue;
+            if (errno != ECONNRESET && errno != EPIPE)
+                error("Send error occurred: " + std::string(strerror(errno)));
+            return false;
+        }
+        con.rsp_pending -= n;
+        con.rsp_offset = (con.rsp_offset + n) % rsp_size;
+        if (con.rsp_offset == 0 && con.config.timestamps)
+            con.rcvd_ns.pop_front();
+        if (con.rsp_offset == 0 && con.config.framed)
+            con.frames.pop_front();
+    }
+    return updateInterest(con, false);
+}
+
 Server::~Server()
 {
-    // Close the server socket
+    // Close all sessions and the server socket
+    for (auto &[fd, con] : connections)
+        close(fd);
+    if (epoll_fd >= 0)
+        close(epoll_fd);
     close(server_fd);
 }
 
@@ -198,7 +1078,9 @@ int main(int argc, char *argv[]) {
     gflags::ParseCommandLineFlags(&argc, &argv, false);
 
     auto server = Server::make(getProtocol(), FLAGS_address, FLAGS_port, FLAGS_buf_size);
-    server->run();
+    server->setIoBackend(getIoBackend());
+    server->setRecvOptions(getRecvOptions());
+    server->run(getServerMode());
 
     return rc;
 }
@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+
+# Merge latency histograms exported by the client (--histogram_outfile) and derive percentiles
+# from the merged counts, instead of averaging the percentiles of individual runs.
+#
+# Usage: ./merge_histograms.py hist1.csv [hist2.csv ...] [--ignore COL ...] [--out summary.csv] [--out-hist merged.csv]
+#   Rows are grouped by all config columns except the ignored ones, e.g. --ignore protocol to merge inet and vsock runs.
+
+import argparse
+import math
+import sys
+
+import pandas as pd
+
+
+QUANTILES = {"p99": 0.99, "p999": 0.999, "median": 0.5, "q25": 0.25, "q75": 0.75}
+
+
+def bucket_size(value: int, digits: int) -> int:
+    # same bucket layout as app/include/Histogram.hpp
+    sub_bucket_count_magnitude = math.ceil(math.log2(2 * 10**digits))
+    sub_bucket_half_count_magnitude = max(sub_bucket_count_magnitude, 1) - 1
+    sub_bucket_mask = (1 << (sub_bucket_half_count_magnitude + 1)) - 1
+    bucket_index = (value | sub_bucket_mask).bit_length() - (sub_bucket_half_count_magnitude + 1)
+    return 1 << bucket_index
+
+
+def summarize(hist: pd.DataFrame) -> pd.Series:
+    # hist: value_ns (lowest value of the bucket), count, hdr_digits; same rank semantics as the client
+    hist = hist.sort_values("value_ns")
+    digits = int(hist["hdr_digits"].iloc[0])
+    values = hist["value_ns"].to_numpy()
+    counts = hist["count"].to_numpy()
+    highest = [v + bucket_size(int(v), digits) - 1 for v in values]
+    cumulative = counts.cumsum()
+    total = int(cumulative[-1])
+
+    def at_rank(rank: int) -> float:
+        i = int((cumulative > rank).argmax())
+        return min(max(highest[i], values[0]), highest[-1]) / 1000.0
+
+    stats = {"act_sample_count": total, "min": values[0] / 1000.0, "max": highest[-1] / 1000.0}
+    for name, q in QUANTILES.items():
+        stats[name] = at_rank(int(total * q))
+    mid = [v + bucket_size(int(v), digits) // 2 for v in values]
+    stats["avg"] = float((counts * mid).sum()) / total / 1000.0
+    return pd.Series(stats)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Merge exported latency histograms")
+    parser.add_argument("files", nargs="+", help="histogram csv files")
+    parser.add_argument("--ignore", nargs="*", default=[], help="config columns to merge across")
+    parser.add_argument("--out", default="", help="summary output file (default: stdout)")
+    parser.add_argument("--out-hist", default="", help="merged histogram output file")
+    args = parser.parse_args()
+
+    df = pd.concat([pd.read_csv(f) for f in args.files], ignore_index=True)
+    df = df.drop(columns=[c for c in args.ignore if c in df.columns])
+    # hdr_digits is part of the key, histograms of different precision are never merged
+    keys = [c for c in df.columns if c not in ["value_ns", "count"]]
+
+    merged = df.groupby(keys + ["value_ns"], as_index=False, dropna=False)["count"].sum()
+    if args.out_hist:
+        merged.to_csv(args.out_hist, index=False)
+
+    summary = merged.groupby(keys, dropna=False).apply(summarize).reset_index()
+    summary.to_csv(args.out if args.out else sys.stdout, index=False)
+
+
+if __name__ == "__main__":
+    main()
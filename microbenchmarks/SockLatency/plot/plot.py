@@ -124,8 +124,424 @@ def plot_verify():
     plt.close()
 
 
+def plot_open_loop():
+    df = pd.read_csv(f"{DATA_DIR}/results.csv")
+    if "arrival" not in df.columns:
+        return
+
+    # Filter to open loop rate steps
+    df = df[df["arrival"].isin(["constant", "poisson"])]
+    if df.empty:
+        return
+
+    # Project to required columns
+    x_axis = "Throughput [req/s]"
+    y_axis_1 = "Median Latency [µs]"
+    y_axis_2 = "p999 Latency"
+    hue = "Protocol"
+
+    data = DataFrame()
+    data[x_axis] = df["throughput"]
+    data[y_axis_1] = df["median"]
+    data[y_axis_2] = df["p999"]
+    data[hue] = df["protocol"] + " (" + df["arrival"] + ", " + df["client.msg_size"].astype(str) + " B)"
+
+    # Set figure stile
+    sns.set_style("ticks")
+    sns.set_palette("deep")
+    sns.set_context("notebook")
+
+    f, (ax1, ax2) = plt.subplots(figsize=(6,2.5), ncols=2, sharey=True)
+    sns.lineplot(data=data, y=y_axis_1, x=x_axis, hue=hue, style=hue, markers=True, ax=ax1, legend=False)
+    sns.lineplot(data=data, y=y_axis_2, x=x_axis, hue=hue, style=hue, markers=True, ax=ax2)
+
+    # Styling
+    sns.move_legend(ax2, "lower center", frameon=False, bbox_to_anchor=(-0.1, 0.95), ncols=2, title=None,
+                    columnspacing=0.8)
+    for ax in (ax1, ax2):
+        ax.set_yscale("log")
+        ax.grid(axis="y")
+
+    plt.tight_layout(pad=0.5)
+    plt.subplots_adjust(wspace=0.2)
+
+    # Save
+    plt.savefig(f"{IMG_DIR}/throughput_latency.pdf", dpi=300)
+    plt.close()
+
+
+def plot_decomposition():
+    df = pd.read_csv(f"{DATA_DIR}/results.csv")
+    if "component" not in df.columns:
+        return
+
+    # Filter to the one-way components of timestamped runs
+    df = df[df["component"].isin(["request", "dwell", "response"])]
+    if df.empty:
+        return
+
+    # Project to required columns
+    x_axis = "Response Size [B]"
+    y_axis_1 = "Median Latency [µs]"
+    y_axis_2 = "p99 Latency"
+    hue = "Component"
+
+    data = DataFrame()
+    data[x_axis] = df["protocol"] + " " + df["server.rsp_size"].astype(str)
+    data[y_axis_1] = df["median"]
+    data[y_axis_2] = df["p99"]
+    data[hue] = df["component"]
+
+    # Set figure stile
+    sns.set_style("ticks")
+    sns.set_palette("deep")
+    sns.set_context("notebook")
+
+    f, (ax1, ax2) = plt.subplots(figsize=(6,2.5), ncols=2, sharey=True)
+    sns.barplot(data=data, y=y_axis_1, x=x_axis, hue=hue, ax=ax1, legend=False)
+    sns.barplot(data=data, y=y_axis_2, x=x_axis, hue=hue, ax=ax2)
+
+    # Styling
+    sns.move_legend(ax2, "lower center", frameon=False, bbox_to_anchor=(-0.1, 0.95), ncols=3, title=None,
+                    columnspacing=0.8)
+    for ax in (ax1, ax2):
+        ax.tick_params(axis="x", rotation=45)
+        ax.grid(axis="y")
+
+    plt.tight_layout(pad=0.5)
+    plt.subplots_adjust(wspace=0.2)
+
+    # Save
+    plt.savefig(f"{IMG_DIR}/latency_decomposition.pdf", dpi=300)
+    plt.close()
+
+
+def plot_coalescing():
+    df = pd.read_csv(f"{DATA_DIR}/results.csv")
+    if "variant" not in df.columns:
+        return
+
+    # Filter to the aggregated rows of the proxy comparison
+    df = df[df["scenario"].str.startswith("coalescing") & (df["connection"].astype(str) == "all")]
+    if df.empty:
+        return
+    df = df.sort_values("connections")
+
+    # Project to required columns
+    x_axis = "Throughput [req/s]"
+    y_axis_1 = "Median Latency [µs]"
+    y_axis_2 = "p99 Latency"
+    hue = "Proxy"
+
+    data = DataFrame()
+    data[x_axis] = df["throughput"]
+    data[y_axis_1] = df["median"]
+    data[y_axis_2] = df["p99"]
+    data[hue] = df["variant"]
+
+    # Set figure stile
+    sns.set_style("ticks")
+    sns.set_palette("deep")
+    sns.set_context("notebook")
+
+    f, (ax1, ax2) = plt.subplots(figsize=(6,2.5), ncols=2, sharey=True)
+    sns.lineplot(data=data, y=y_axis_1, x=x_axis, hue=hue, style=hue, markers=True, sort=False, ax=ax1, legend=False)
+    sns.lineplot(data=data, y=y_axis_2, x=x_axis, hue=hue, style=hue, markers=True, sort=False, ax=ax2)
+
+    # Styling
+    sns.move_legend(ax2, "lower center", frameon=False, bbox_to_anchor=(-0.1, 0.95), ncols=4, title=None,
+                    columnspacing=0.8)
+    for ax in (ax1, ax2):
+        ax.set_yscale("log")
+        ax.grid(axis="y")
+
+    plt.tight_layout(pad=0.5)
+    plt.subplots_adjust(wspace=0.2)
+
+    # Save
+    plt.savefig(f"{IMG_DIR}/coalescing.pdf", dpi=300)
+    plt.close()
+
+
+def plot_sealing():
+    df = pd.read_csv(f"{DATA_DIR}/results.csv")
+    if "seal" not in df.columns:
+        return
+
+    # Filter to the crypto/transport split of the sealed runs and the rtt of the plaintext baseline
+    df = df[df["scenario"].str.startswith("sealing")]
+    sealed = df[(df["seal"] != "none") & df["component"].isin(["crypto", "transport"])]
+    plain = df[(df["seal"] == "none") & (df["component"] == "rtt")]
+    if sealed.empty:
+        return
+    df = pd.concat([sealed, plain]).sort_values("client.msg_size")
+
+    # Project to required columns
+    x_axis = "Message Size [B]"
+    y_axis_1 = "Median Latency [µs]"
+    y_axis_2 = "p99 Latency"
+    hue = "Component"
+    style = "Record Layer"
+
+    data = DataFrame()
+    data[x_axis] = df["client.msg_size"]
+    data[y_axis_1] = df["median"]
+    data[y_axis_2] = df["p99"]
+    data[hue] = df["component"].where(df["seal"] != "none", "plaintext rtt")
+    data[style] = df["seal"] + df["seal_record_size"].map(lambda r: f" {r // 1024}K records" if r > 0 else "")
+
+    # Set figure stile
+    sns.set_style("ticks")
+    sns.set_palette("deep")
+    sns.set_context("notebook")
+
+    f, (ax1, ax2) = plt.subplots(figsize=(6,2.5), ncols=2, sharey=True)
+    sns.lineplot(data=data, y=y_axis_1, x=x_axis, hue=hue, style=style, markers=True, ax=ax1, legend=False)
+    sns.lineplot(data=data, y=y_axis_2, x=x_axis, hue=hue, style=style, markers=True, ax=ax2)
+
+    # Styling
+    sns.move_legend(ax2, "lower center", frameon=False, bbox_to_anchor=(-0.1, 0.95), ncols=4, title=None,
+                    columnspacing=0.8)
+    for ax in (ax1, ax2):
+        ax.set_xscale("log", base=2)
+        ax.set_yscale("log")
+        ax.grid(axis="y")
+
+    plt.tight_layout(pad=0.5)
+    plt.subplots_adjust(wspace=0.2)
+
+    # Save
+    plt.savefig(f"{IMG_DIR}/sealing.pdf", dpi=300)
+    plt.close()
+
+
+def plot_compression():
+    df = pd.read_csv(f"{DATA_DIR}/results.csv")
+    if "compression" not in df.columns or "gbit_s_effective" not in df.columns:
+        return
+
+    # Filter to the aggregated rows of the compression runs
+    df = df[df["scenario"].str.startswith("compression") & (df["connection"] == "all")]
+    if df.empty:
+        return
+
+    # The uncompressed baseline does not depend on the data, draw it at every compressibility
+    plain = df[df["compression"] == "none"]
+    compressed = df[df["compression"] != "none"]
+    baseline = pd.concat([plain.assign(compressibility=c) for c in sorted(compressed["compressibility"].unique())])
+    df = pd.concat([compressed, baseline]).sort_values("compressibility")
+
+    # Project to required columns
+    x_axis = "Compressibility [%]"
+    y_axis_1 = "Effective Throughput [Gbit/s]"
+    y_axis_2 = "CPU per Byte [ns]"
+    hue = "Codec"
+
+    data = DataFrame()
+    data[x_axis] = df["compressibility"]
+    data[y_axis_1] = df["gbit_s_effective"]
+    data[y_axis_2] = df["cpu_ns_per_raw_byte"]
+    data[hue] = df["compression"].where(df["compression"] == "none", df["compression"] + " " + df["compression_level"].astype(str))
+
+    # Set figure stile
+    sns.set_style("ticks")
+    sns.set_palette("deep")
+    sns.set_context("notebook")
+
+    f, (ax1, ax2) = plt.subplots(figsize=(6,2.5), ncols=2)
+    sns.lineplot(data=data, y=y_axis_1, x=x_axis, hue=hue, style=hue, markers=True, ax=ax1, legend=False)
+    sns.lineplot(data=data, y=y_axis_2, x=x_axis, hue=hue, style=hue, markers=True, ax=ax2)
+
+    # Styling
+    sns.move_legend(ax2, "lower center", frameon=False, bbox_to_anchor=(-0.2, 0.95), ncols=5, title=None,
+                    columnspacing=0.8)
+    ax1.set_ylim(bottom=0)
+    ax2.set_yscale("log")
+    for ax in (ax1, ax2):
+        ax.grid(axis="y")
+
+    plt.tight_layout(pad=0.5)
+    plt.subplots_adjust(wspace=0.3)
+
+    # Save
+    plt.savefig(f"{IMG_DIR}/compression.pdf", dpi=300)
+    plt.close()
+
+
+def plot_scan():
+    df = pd.read_csv(f"{DATA_DIR}/results.csv")
+    if "batch_rows" not in df.columns or "overlap_sec" not in df.columns:
+        return
+
+    # Filter to the scan runs
+    df = df[df["scenario"].str.startswith("scan")].sort_values("batch_rows")
+    if df.empty:
+        return
+
+    # Project to required columns
+    x_axis = "Batch Size [Rows]"
+    y_axis_1 = "Throughput [Mrows/s]"
+    y_axis_2 = "Share of Server Time [%]"
+    hue = "Buffers"
+    style = "Record Layer"
+
+    data = DataFrame()
+    data[x_axis] = df["batch_rows"]
+    data[y_axis_1] = df["rows_s"] / 1e6
+    data[hue] = df["scan_buffers"].astype(str)
+    data[style] = df["seal"]
+
+    # Receive, compute and overlap time of the double-buffered runs
+    split = df[df["scan_buffers"] == 2]
+    parts = []
+    for component in ["recv", "compute", "overlap"]:
+        part = DataFrame()
+        part[x_axis] = split["batch_rows"]
+        part[y_axis_2] = split[f"{component}_sec"] / split["server_sec"] * 100
+        part["Component"] = component
+        part[style] = split["seal"]
+        parts.append(part)
+    split = pd.concat(parts)
+
+    # Set figure stile
+    sns.set_style("ticks")
+    sns.set_palette("deep")
+    sns.set_context("notebook")
+
+    f, (ax1, ax2) = plt.subplots(figsize=(6,2.5), ncols=2)
+    sns.lineplot(data=data, y=y_axis_1, x=x_axis, hue=hue, style=style, markers=True, ax=ax1)
+    sns.lineplot(data=split, y=y_axis_2, x=x_axis, hue="Component", style=style, markers=True, ax=ax2)
+
+    # Styling
+    sns.move_legend(ax1, "lower center", frameon=False, bbox_to_anchor=(0.5, 0.95), ncols=3, title=None,
+                    columnspacing=0.8, fontsize="small")
+    sns.move_legend(ax2, "lower center", frameon=False, bbox_to_anchor=(0.5, 0.95), ncols=3, title=None,
+                    columnspacing=0.8, fontsize="small")
+    for ax in (ax1, ax2):
+        ax.set_xscale("log", base=2)
+        ax.set_ylim(bottom=0)
+        ax.grid(axis="y")
+
+    plt.tight_layout(pad=0.5)
+    plt.subplots_adjust(wspace=0.3)
+
+    # Save
+    plt.savefig(f"{IMG_DIR}/scan.pdf", dpi=300)
+    plt.close()
+
+
+def plot_operators():
+    df = pd.read_csv(f"{DATA_DIR}/results.csv")
+    if "operator" not in df.columns:
+        return
+
+    # Filter to the operator runs
+    df = df[df["scenario"].str.startswith("operators")]
+    if df.empty:
+        return
+    operators = [op for op in ["scan", "aggregate", "join", "sort"] if op in df["operator"].values]
+
+    # Project to required columns
+    x_axis = "Threads"
+    y_axis = "Throughput [M rows/s]"
+    hue = "Setup"
+    style = "Parameter"
+
+    data = DataFrame()
+    data["operator"] = df["operator"]
+    data[x_axis] = df["threads"].astype(int)
+    data[y_axis] = df["throughput"] / 1e6
+    data[hue] = df["variant"]
+    data[style] = df.apply(lambda r: f"sel {r['selectivity']:g}" if r["operator"] == "scan"
+                           else f"{int(r['groups'])} groups" if r["operator"] == "aggregate" else "-", axis=1)
+
+    # Set figure stile
+    sns.set_style("ticks")
+    sns.set_palette("deep")
+    sns.set_context("notebook")
+
+    f, axes = plt.subplots(figsize=(3 * len(operators), 2.5), ncols=len(operators), squeeze=False)
+    for ax, op in zip(axes[0], operators):
+        sns.lineplot(data=data[data["operator"] == op], y=y_axis, x=x_axis, hue=hue, style=style, markers=True, ax=ax)
+        ax.set_title(op)
+        ax.set_xticks(sorted(data[x_axis].unique()))
+        ax.set_ylim(bottom=0)
+        ax.grid(axis="y")
+        sns.move_legend(ax, "upper left", frameon=False, fontsize="x-small", title=None)
+
+    plt.tight_layout(pad=0.5)
+
+    # Save
+    plt.savefig(f"{IMG_DIR}/operators.pdf", dpi=300)
+    plt.close()
+
+
+def plot_memory():
+    df = pd.read_csv(f"{DATA_DIR}/results.csv")
+    if "benchmark" not in df.columns:
+        return
+
+    # Filter to the memory runs
+    df = df[df["scenario"].str.startswith("memory")]
+    if df.empty:
+        return
+    stream = df[(df["benchmark"] == "stream") & (df["kernel"] == "triad")]
+    ladders = [b for b in ["latency", "tlb"] if b in df["benchmark"].values]
+
+    # Set figure stile
+    sns.set_style("ticks")
+    sns.set_palette("deep")
+    sns.set_context("notebook")
+
+    f, axes = plt.subplots(figsize=(3 * (1 + len(ladders)), 2.5), ncols=1 + len(ladders), squeeze=False)
+
+    # Triad bandwidth over the threads
+    data = DataFrame()
+    data["Threads"] = stream["threads"].astype(int)
+    data["Triad Bandwidth [GB/s]"] = stream["throughput"] / 1e9
+    data["Setup"] = stream["variant"]
+    data["Kernel"] = stream["simd"] + " " + stream["page_size"]
+    ax = axes[0][0]
+    if not data.empty:
+        sns.lineplot(data=data, y="Triad Bandwidth [GB/s]", x="Threads", hue="Setup", style="Kernel", markers=True, ax=ax)
+        ax.set_xticks(sorted(data["Threads"].unique()))
+        sns.move_legend(ax, "upper left", frameon=False, fontsize="x-small", title=None)
+    ax.set_title("stream")
+    ax.set_ylim(bottom=0)
+    ax.grid(axis="y")
+
+    # Load latency over the working set
+    for ax, benchmark in zip(axes[0][1:], ladders):
+        ladder = df[df["benchmark"] == benchmark]
+        data = DataFrame()
+        data["Working Set [B]"] = ladder["working_set"]
+        data["Load Latency [ns]"] = ladder["median"] * 1000
+        data["Setup"] = ladder["variant"]
+        data["Pages"] = ladder["pages"]
+        sns.lineplot(data=data, y="Load Latency [ns]", x="Working Set [B]", hue="Setup", style="Pages", markers=True, ax=ax)
+        ax.set_title(benchmark)
+        ax.set_xscale("log", base=2)
+        ax.set_yscale("log")
+        ax.grid(axis="y")
+        sns.move_legend(ax, "upper left", frameon=False, fontsize="x-small", title=None)
+
+    plt.tight_layout(pad=0.5)
+
+    # Save
+    plt.savefig(f"{IMG_DIR}/memory.pdf", dpi=300)
+    plt.close()
+
+
 def main():
     plot_paper()
+    plot_open_loop()
+    plot_decomposition()
+    plot_coalescing()
+    plot_sealing()
+    plot_compression()
+    plot_scan()
+    plot_operators()
+    plot_memory()
 
 
 if __name__ == '__main__':
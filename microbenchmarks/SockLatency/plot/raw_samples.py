@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+
+# Convert raw sample dumps of the client (--raw_outfile) into one row per sample: the config columns of the
+# result row the sample belongs to, then conn, seq, ts_ns (unix timestamp at completion), rtt_us, req_size, rsp_size.
+#
+# Usage: ./raw_samples.py raw1.bin [raw2.bin ...] [--out samples.csv|samples.parquet] [--no-config]
+#   seq counts the samples of a segment incl. warmup, i.e. seq < act_warmup_rounds of the result row are warmup
+#   (except for replayed workloads, which do not record warmup requests at all).
+#   Parquet output requires pyarrow or fastparquet.
+
+import argparse
+import io
+import struct
+import sys
+
+import numpy as np
+import pandas as pd
+
+
+MAGIC = b"SLRAW001"
+# same layout as RawSegmentHeader in app/include/RawDump.hpp
+HEADER = struct.Struct("<8sIIQQQQqII")
+SAMPLE = np.dtype([("ts_ns", "<u8"), ("rtt_ns", "<u8"), ("req_size", "<u4"), ("rsp_size", "<u4")])
+
+
+def read_segments(path: str, with_config: bool):
+    data = np.memmap(path, dtype=np.uint8, mode="r")
+    offset = 0
+    while offset + HEADER.size <= len(data):
+        (magic, header_size, sample_size, capacity, count, dropped, segment_size, realtime_offset_ns,
+         conn, config_len) = HEADER.unpack_from(data, offset)
+        if magic != MAGIC or sample_size != SAMPLE.itemsize:
+            sys.exit(f"{path}: no raw sample segment at offset {offset}")
+        if count == 0:
+            print(f"{path}: skipping empty or unfinished segment at offset {offset}", file=sys.stderr)
+        if dropped > 0:
+            print(f"{path}: segment at offset {offset} dropped {dropped} samples beyond its capacity of {capacity}", file=sys.stderr)
+
+        samples = np.frombuffer(data, dtype=SAMPLE, count=count, offset=offset + header_size)
+        df = pd.DataFrame({
+            "conn": np.full(count, conn, dtype=np.uint32),
+            "seq": np.arange(count, dtype=np.uint64),
+            "ts_ns": samples["ts_ns"].astype(np.int64) + realtime_offset_ns,
+            "rtt_us": samples["rtt_ns"] / 1000.0,
+            "req_size": samples["req_size"],
+            "rsp_size": samples["rsp_size"],
+        })
+        if with_config:
+            config_start = offset + HEADER.size
+            config = bytes(data[config_start:config_start + config_len]).decode()
+            row = pd.read_csv(io.StringIO(config), keep_default_na=False).iloc[0]
+            df = pd.concat([pd.DataFrame({col: [val] * count for col, val in row.items()}), df], axis=1)
+        yield df
+        offset += segment_size
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert raw sample dumps to columns")
+    parser.add_argument("files", nargs="+", help="raw sample files")
+    parser.add_argument("--out", default="", help="output file, .parquet or csv (default: csv to stdout)")
+    parser.add_argument("--no-config", action="store_true", help="omit the config columns")
+    args = parser.parse_args()
+
+    df = pd.concat([seg for f in args.files for seg in read_segments(f, not args.no_config)], ignore_index=True)
+    if args.out.endswith(".parquet"):
+        df.to_parquet(args.out, index=False)
+    else:
+        df.to_csv(args.out if args.out else sys.stdout, index=False)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+#!/bin/bash
+
+# Coalescing proxy vs. plain forwarding proxy: many clients with small messages reach the server through the native proxy.
+# forward: one upstream connection per client, mux: all clients over one tunnel connection that coalesces their messages
+# and is split up again by a demux proxy in front of the server. The mux variants sweep the flush thresholds.
+target=${1:-"enclave"}  # enclave: server in the enclave (vsock tunnel), host: server container on the host (inet tunnel)
+
+instance_type=$(ec2-metadata --instance-type | cut -d ' ' -f 2)
+file_name="coalescing_$target-$instance_type-$(date --utc +%FT%TZ | tr : _ | tr - _)-$(git rev-parse --short HEAD).csv"
+export RESULT_FILE=$file_name
+tunnel_log="results/data/${file_name%.csv}.tunnel.log"  # frames per send of every mux run
+
+coalesce_bytes=${coalesce_bytes:-"1024 4096 16384 65536"}
+coalesce_us=${coalesce_us:-"0 10 50 200"}  # 0: flush at the end of each event batch, the bytes threshold is not used
+connections=${connections:-"1 4 16 64"}
+msg_size=${msg_size:-64}
+
+n_runs=${n_runs:-3}
+export TIMEOUT_SEC=${timeout_sec:-10}
+export CLIENT_MSG_SIZE=$msg_size
+export SERVER_RSP_SIZE=$msg_size
+export SERVER_MODE=epoll
+export PROXY_TOOL=native
+export CLIENT_PORT=5006  # the proxy listens here and forwards to SERVER_PORT
+export PRINT_HEADER=yes
+
+# start_server <tunnel>: start the server, behind a demux proxy if tunnel is non-empty
+start_server() {
+    if [ "$target" = "enclave" ]; then
+        make TUNNEL="$1" build-server run-enclave-server
+        sleep 10
+    else
+        make TUNNEL="$1" run-host-server-background
+        sleep 2
+    fi
+}
+
+stop_server() {
+    if [ "$target" = "enclave" ]; then
+        make terminate-enclave-server
+    else
+        make terminate-host-server
+    fi
+}
+
+# run_variant <label> <make args...>: start the proxy, measure all connection counts, stop the proxy
+run_variant() {
+    local label=$1; shift
+    if [ "$target" = "enclave" ]; then
+        make "$@" run-proxy-background
+    else
+        make "$@" run-proxy-tcp-background
+    fi
+    sleep 2
+    for c in $connections; do
+        make VARIANT="$label" CLIENT_CONNECTIONS="$c" run-host-client2host
+        export PRINT_HEADER=""
+    done
+    docker logs socklatency-proxy 2>/dev/null | grep "^tunnel=" | sed "s/^/variant=$label /" >> "$tunnel_log"
+    make terminate-proxy
+}
+
+for i in $(seq 1 "$n_runs"); do
+
+    echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - forwarding proxy..."
+    start_server ""
+    run_variant forward PROXY_MODE=forward
+    stop_server
+
+    echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - coalescing proxy..."
+    start_server yes
+    for us in $coalesce_us; do
+        if [ "$us" = "0" ]; then
+            run_variant "mux-batch" PROXY_MODE=mux COALESCE_US=0
+            continue
+        fi
+        for bytes in $coalesce_bytes; do
+            run_variant "mux-${bytes}B-${us}us" PROXY_MODE=mux COALESCE_BYTES="$bytes" COALESCE_US="$us"
+        done
+    done
+    stop_server
+    make upload-results
+
+done
+
+echo "Done."
@@ -0,0 +1,57 @@
+#!/bin/bash
+
+# On-the-fly compression of bulk transfers into the enclave: host-to-enclave streams of synthetic data at several
+# compressibilities, uncompressed and compressed with lz4 and zstd at a fast and a stronger level. The client
+# compresses on a worker thread while it sends, the enclave server decompresses.
+target=${1:-"enclave"}  # enclave: server in the enclave (vsock), host: server container on the host (inet)
+
+instance_type=$(ec2-metadata --instance-type | cut -d ' ' -f 2)
+file_name="compression_$target-$instance_type-$(date --utc +%FT%TZ | tr : _ | tr - _)-$(git rev-parse --short HEAD).csv"
+export RESULT_FILE=$file_name
+
+codecs=${codecs:-"lz4:1 lz4:9 zstd:1 zstd:3"}  # codec:level
+compressibilities=${compressibilities:-"0 25 50 75 90"}
+workload=${workload:-"send"}
+
+n_runs=${n_runs:-3}
+export WORKLOAD=$workload
+export TIMEOUT_SEC=${timeout_sec:-10}
+export CLIENT_MSG_SIZE=65536
+export SERVER_RSP_SIZE=65536
+export COMPRESSION_CHUNK=${chunk:-65536}
+export SERVER_MODE=serial
+export PRINT_HEADER=yes
+
+if [ "$target" = "enclave" ]; then
+    make build-server run-enclave-server
+    sleep 10
+    client=run-host-client2enclave
+else
+    make run-host-server-background
+    sleep 2
+    client=run-host-client2host
+fi
+
+for i in $(seq 1 "$n_runs"); do
+
+    echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - uncompressed..."
+    make COMPRESSION=none $client
+    export PRINT_HEADER=""
+
+    for compressibility in $compressibilities; do
+        for codec in $codecs; do
+            echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - ${codec%%:*} level ${codec##*:}, compressibility $compressibility%..."
+            make COMPRESSION="${codec%%:*}" COMPRESSION_LEVEL="${codec##*:}" COMPRESSIBILITY="$compressibility" $client
+        done
+    done
+    make upload-results
+
+done
+
+if [ "$target" = "enclave" ]; then
+    make terminate-enclave-server
+else
+    make terminate-host-server
+fi
+
+echo "Done."
@@ -15,8 +15,32 @@ done
 # Find the maximum value in msg_sizes - at least 1024
 buf_size=$(echo "$msg_sizes 1024" | tr ' ' '\n' | sort -n | tail -1)
 
+sweep=${sweep:-}  # non-empty: one client per phase sweeps all sizes over a single connection
+sweep_sizes=$(echo $msg_sizes | tr ' ' ',')
+
+# measure_sizes <vary> <make args...>: measure all msg_sizes, vary is the varying size (req, rsp or both)
+measure_sizes() {
+    local vary=$1; shift
+    if [ -n "$sweep" ]; then
+        make SWEEP_SIZES="$sweep_sizes" SWEEP_VARY="$vary" "$@"
+        export PRINT_HEADER=""
+        return
+    fi
+    for msg_size in $msg_sizes; do
+        case $vary in
+            req)  make CLIENT_MSG_SIZE="$msg_size" "$@" ;;
+            rsp)  make SERVER_RSP_SIZE="$msg_size" "$@" ;;
+            both) make CLIENT_MSG_SIZE="$msg_size" SERVER_RSP_SIZE="$msg_size" "$@" ;;
+        esac
+        export PRINT_HEADER=""
+    done
+}
+
 n_runs=${n_runs:-10}
 export TIMEOUT_SEC=${timeout_sec:-10}
+export TIMESTAMPS=${timestamps:-}  # non-empty: decompose each roundtrip via server timestamps
+fixed_size=${TIMESTAMPS:+16}      # the timestamps need 16 byte responses
+fixed_size=${fixed_size:-8}
 export PRINT_HEADER=yes
 export CLIENT_TARGET_ADDR=$target_host
 
@@ -25,21 +49,15 @@ for i in $(seq 1 "$n_runs"); do
     if [[ "$variation" == *"s"* ]]; then
 
         echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - fix request size (8 byte)..."
-        for msg_size in $msg_sizes; do
-            make CLIENT_MSG_SIZE=8 CLIENT_BUF_SIZE=$buf_size SERVER_RSP_SIZE=$msg_size run-host-client2host
-            export PRINT_HEADER=""
-        done
+        measure_sizes rsp CLIENT_MSG_SIZE=8 CLIENT_BUF_SIZE=$buf_size run-host-client2host
         make upload-results
 
     fi
 
     if [[ "$variation" == *"c"* ]]; then
 
-        echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - fix response size (8 byte)..."
-        for msg_size in $msg_sizes; do
-            make CLIENT_MSG_SIZE=$msg_size SERVER_BUF_SIZE=$buf_size SERVER_RSP_SIZE=8 run-host-client2host
-            export PRINT_HEADER=""
-        done
+        echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - fix response size ($fixed_size byte)..."
+        measure_sizes req SERVER_BUF_SIZE=$buf_size SERVER_RSP_SIZE=$fixed_size run-host-client2host
         make upload-results
 
     fi
@@ -47,10 +65,7 @@ for i in $(seq 1 "$n_runs"); do
     if [[ "$variation" == *"b"* ]]; then
 
         echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - equal msg sizes 4 client & server..."
-        for msg_size in $msg_sizes; do
-            make CLIENT_MSG_SIZE=$msg_size SERVER_RSP_SIZE=$msg_size CLIENT_BUF_SIZE=$buf_size SERVER_BUF_SIZE=$buf_size run-host-client2host
-            export PRINT_HEADER=""
-        done
+        measure_sizes both CLIENT_BUF_SIZE=$buf_size SERVER_BUF_SIZE=$buf_size run-host-client2host
         make upload-results
 
     fi
@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Is the memory the nitro-enclaves-allocator carves out for the enclave as fast as host memory? STREAM bandwidth
+# over the thread counts, then the pointer chase and TLB ladders of a single thread up to several GiB, each on
+# 4 KiB and 2 MiB pages, first in the container on the host, then in the enclave.
+
+instance_type=$(ec2-metadata --instance-type | cut -d ' ' -f 2)
+file_name="memory-$instance_type-$(date --utc +%FT%TZ | tr : _ | tr - _)-$(git rev-parse --short HEAD).csv"
+export RESULT_FILE=$file_name
+
+stream_threads=${stream_threads:-"1,2,4"}  # at most ENCLAVE_VCPUS
+working_sets=${working_sets:-"4096..2147483648"}  # has to fit ENCLAVE_MEMORY with the image
+export SIMD=${simd:-"scalar,auto"}
+export PAGE_SIZES=${page_sizes:-"4k,2m"}
+
+n_runs=${n_runs:-3}
+export PRINT_HEADER=yes
+
+make build-server-container
+
+for phase in stream ladder; do
+
+    if [ "$phase" = "stream" ]; then
+        export MEMORY_BENCHMARKS=stream MEMORY_THREADS=$stream_threads
+    else
+        export MEMORY_BENCHMARKS=latency,tlb MEMORY_THREADS=1 WORKING_SETS=$working_sets
+    fi
+    make build-memory
+
+    for i in $(seq 1 "$n_runs"); do
+
+        echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - $phase, host..."
+        make run-host-memory
+        export PRINT_HEADER=""
+
+        echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - $phase, enclave..."
+        make run-enclave-memory
+        make terminate-enclave-server
+        make upload-results
+
+    done
+
+done
+
+echo "Done."
@@ -0,0 +1,78 @@
+#!/bin/bash
+
+# Connection per client vs. pooled multiplexing: 1 to 1000 clients reach the server through the native proxy.
+# forward: every client gets its own upstream (vsock) connection, like socat with fork,
+# mux: all clients are carried as framed streams over a small pool of tunnel connections to a demux proxy in front of the server.
+target=${1:-"enclave"}  # enclave: server in the enclave (vsock), host: server container on the host (inet)
+
+instance_type=$(ec2-metadata --instance-type | cut -d ' ' -f 2)
+file_name="multiplexing_$target-$instance_type-$(date --utc +%FT%TZ | tr : _ | tr - _)-$(git rev-parse --short HEAD).csv"
+export RESULT_FILE=$file_name
+
+clients=${clients:-"1 10 100 1000"}
+pools=${pools:-"1 2 4"}     # tunnel connections of the mux variants
+max_threads=${max_threads:-16}  # client threads driving the connections round-robin
+msg_size=${msg_size:-64}
+
+n_runs=${n_runs:-3}
+export TIMEOUT_SEC=${timeout_sec:-10}
+export CLIENT_MSG_SIZE=$msg_size
+export SERVER_RSP_SIZE=$msg_size
+export SERVER_MODE=epoll
+export PROXY_TOOL=native
+export CLIENT_PORT=5006  # the proxy listens here and forwards to SERVER_PORT
+export PRINT_HEADER=yes
+
+# start_server <tunnel>: start the server, behind a demux proxy if tunnel is non-empty
+start_server() {
+    if [ "$target" = "enclave" ]; then
+        make TUNNEL="$1" build-server run-enclave-server
+        sleep 10
+    else
+        make TUNNEL="$1" run-host-server-background
+        sleep 2
+    fi
+}
+
+stop_server() {
+    if [ "$target" = "enclave" ]; then
+        make terminate-enclave-server
+    else
+        make terminate-host-server
+    fi
+}
+
+# run_variant <label> <make args...>: start the proxy, measure all client counts, stop the proxy
+run_variant() {
+    local label=$1; shift
+    if [ "$target" = "enclave" ]; then
+        make "$@" run-proxy-background
+    else
+        make "$@" run-proxy-tcp-background
+    fi
+    sleep 2
+    for c in $clients; do
+        make VARIANT="$label" CLIENT_CONNECTIONS="$c" CLIENT_THREADS=$((c < max_threads ? c : max_threads)) run-host-client2host
+        export PRINT_HEADER=""
+    done
+    make terminate-proxy
+}
+
+for i in $(seq 1 "$n_runs"); do
+
+    echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - connection per client..."
+    start_server ""
+    run_variant forward PROXY_MODE=forward
+    stop_server
+
+    echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - pooled multiplexing..."
+    start_server yes
+    for pool in $pools; do
+        run_variant "mux-pool$pool" PROXY_MODE=mux TUNNEL_CONNECTIONS="$pool"
+    done
+    stop_server
+    make upload-results
+
+done
+
+echo "Done."
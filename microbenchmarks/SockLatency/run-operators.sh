@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# Query processing in the enclave vs. on the host: selection scan, grouped aggregation, radix join and sort of the
+# operator benchmark with the same inputs and thread counts, first in the container on the host, then in the enclave.
+# The checksums in the result column have to match between both.
+
+instance_type=$(ec2-metadata --instance-type | cut -d ' ' -f 2)
+file_name="operators-$instance_type-$(date --utc +%FT%TZ | tr : _ | tr - _)-$(git rev-parse --short HEAD).csv"
+export RESULT_FILE=$file_name
+
+export SCALE_FACTOR=${scale_factor:-1}
+export OPERATOR_THREADS=${threads:-"1,2,4"}  # at most ENCLAVE_VCPUS
+export SIMD=${simd:-auto}
+export REPETITIONS=${repetitions:-10}
+
+n_runs=${n_runs:-3}
+export PRINT_HEADER=yes
+
+make build-server-container build-operators
+
+for i in $(seq 1 "$n_runs"); do
+
+    echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - host..."
+    make run-host-operators
+    export PRINT_HEADER=""
+
+    echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - enclave..."
+    make run-enclave-operators
+    make terminate-enclave-server
+    make upload-results
+
+done
+
+echo "Done."
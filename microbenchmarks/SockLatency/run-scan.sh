@@ -0,0 +1,53 @@
+#!/bin/bash
+
+# Pipelined scan-and-aggregate into the enclave: the host streams columnar batches of several sizes, sealed and in the
+# clear, the enclave server filters and aggregates them with 1 (no overlap), 2 and 3 receive buffers and returns
+# only the aggregates. One result row per batch size with rows/s and the receive/compute/overlap split.
+target=${1:-"enclave"}  # enclave: server in the enclave (vsock), host: server container on the host (inet)
+
+instance_type=$(ec2-metadata --instance-type | cut -d ' ' -f 2)
+file_name="scan_$target-$instance_type-$(date --utc +%FT%TZ | tr : _ | tr - _)-$(git rev-parse --short HEAD).csv"
+export RESULT_FILE=$file_name
+
+buffers=${buffers:-"1 2 3"}
+seals=${seals:-"none aes-256-gcm"}
+
+n_runs=${n_runs:-3}
+export WORKLOAD=scan
+export TIMEOUT_SEC=${timeout_sec:-10}
+export SCAN_BATCH_ROWS=${batch_rows:-"1024,4096,16384,65536,262144,1048576"}
+export SCAN_SELECTIVITY=${selectivity:-0.5}
+export SCAN_GROUPS=${groups:-64}
+export SERVER_MODE=serial
+export PRINT_HEADER=yes
+
+if [ "$target" = "enclave" ]; then
+    make build-server run-enclave-server
+    sleep 10
+    client=run-host-client2enclave
+else
+    make run-host-server-background
+    sleep 2
+    client=run-host-client2host
+fi
+
+for i in $(seq 1 "$n_runs"); do
+
+    for seal in $seals; do
+        for n in $buffers; do
+            echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - $seal, $n buffers..."
+            make SEAL="$seal" SCAN_BUFFERS="$n" $client
+            export PRINT_HEADER=""
+        done
+    done
+    make upload-results
+
+done
+
+if [ "$target" = "enclave" ]; then
+    make terminate-enclave-server
+else
+    make terminate-host-server
+fi
+
+echo "Done."
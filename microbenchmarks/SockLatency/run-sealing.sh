@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# Crypto vs. transport cost of end-to-end encryption into the enclave: AES-GCM sealed requests and responses over a
+# size sweep, with one record per message and with 16 KiB records (batched sealing, opening overlapped with the transfer),
+# against the plaintext baseline of the same sizes.
+target=${1:-"enclave"}  # enclave: server in the enclave (vsock), host: server container on the host (inet)
+
+instance_type=$(ec2-metadata --instance-type | cut -d ' ' -f 2)
+file_name="sealing_$target-$instance_type-$(date --utc +%FT%TZ | tr : _ | tr - _)-$(git rev-parse --short HEAD).csv"
+export RESULT_FILE=$file_name
+
+ciphers=${ciphers:-"aes-128-gcm aes-256-gcm"}
+record_sizes=${record_sizes:-"0 16384"}  # 0: one record per message
+sweep_sizes=${sweep_sizes:-"64..1048576"}
+
+n_runs=${n_runs:-3}
+export NUM_SAMPLES=${num_samples:-10000}
+export SWEEP_SIZES=$sweep_sizes
+export SWEEP_VARY=both
+export SERVER_MODE=serial
+export PRINT_HEADER=yes
+
+if [ "$target" = "enclave" ]; then
+    make build-server run-enclave-server
+    sleep 10
+    client=run-host-client2enclave
+else
+    make run-host-server-background
+    sleep 2
+    client=run-host-client2host
+fi
+
+for i in $(seq 1 "$n_runs"); do
+
+    echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - plaintext..."
+    make SEAL=none $client
+    export PRINT_HEADER=""
+
+    for cipher in $ciphers; do
+        for record_size in $record_sizes; do
+            echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - $cipher, record size $record_size..."
+            make SEAL="$cipher" SEAL_RECORD_SIZE="$record_size" $client
+        done
+    done
+    make upload-results
+
+done
+
+if [ "$target" = "enclave" ]; then
+    make terminate-enclave-server
+else
+    make terminate-host-server
+fi
+
+echo "Done."
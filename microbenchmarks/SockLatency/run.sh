@@ -17,6 +17,27 @@ done
 # Find the maximum value in msg_sizes - at least 1024
 buf_size=$(echo $msg_sizes 1024 | tr ' ' '\n' | sort -n | tail -1)
 
+sweep=${sweep:-}  # non-empty: one client per phase sweeps all sizes over a single connection
+sweep_sizes=$(echo $msg_sizes | tr ' ' ',')
+
+# measure_sizes <vary> <make args...>: measure all msg_sizes, vary is the varying size (req, rsp or both)
+measure_sizes() {
+    local vary=$1; shift
+    if [ -n "$sweep" ]; then
+        make SWEEP_SIZES="$sweep_sizes" SWEEP_VARY="$vary" "$@"
+        export PRINT_HEADER=""
+        return
+    fi
+    for msg_size in $msg_sizes; do
+        case $vary in
+            req)  make CLIENT_MSG_SIZE="$msg_size" "$@" ;;
+            rsp)  make SERVER_RSP_SIZE="$msg_size" "$@" ;;
+            both) make CLIENT_MSG_SIZE="$msg_size" SERVER_RSP_SIZE="$msg_size" "$@" ;;
+        esac
+        export PRINT_HEADER=""
+    done
+}
+
 export TIMEOUT_SEC=${timeout_sec:-10}
 export PRINT_HEADER=yes
 
@@ -26,18 +47,13 @@ for i in $(seq 1 "$n_runs"); do
 
         echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - host->enclave (vsock) with fix response size (8 byte)..."
         make run-enclave-server
-        for msg_size in $msg_sizes; do
-            make CLIENT_MSG_SIZE=$msg_size SERVER_BUF_SIZE=$buf_size SERVER_RSP_SIZE=8 run-host-client2enclave
-            export PRINT_HEADER=""
-        done
+        measure_sizes req SERVER_BUF_SIZE=$buf_size SERVER_RSP_SIZE=8 run-host-client2enclave
         make terminate-enclave-server
         make upload-results
 
         echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - host->host (inet) with fix response size (8 byte)..."
         make run-host-server-background
-        for msg_size in $msg_sizes; do
-            make CLIENT_MSG_SIZE=$msg_size SERVER_BUF_SIZE=$buf_size SERVER_RSP_SIZE=8 run-host-client2host
-        done
+        measure_sizes req SERVER_BUF_SIZE=$buf_size SERVER_RSP_SIZE=8 run-host-client2host
         make terminate-host-server
         make upload-results
 
@@ -47,18 +63,13 @@ for i in $(seq 1 "$n_runs"); do
 
         echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - host->enclave (vsock) with fix request size (8 byte)..."
         make run-enclave-server
-        for msg_size in $msg_sizes; do
-            make CLIENT_MSG_SIZE=8 CLIENT_BUF_SIZE=$buf_size SERVER_RSP_SIZE=$msg_size run-host-client2enclave
-            export PRINT_HEADER=""
-        done
+        measure_sizes rsp CLIENT_MSG_SIZE=8 CLIENT_BUF_SIZE=$buf_size run-host-client2enclave
         make terminate-enclave-server
         make upload-results
 
         echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - host->host (inet) with fix request size (8 byte)..."
         make run-host-server-background
-        for msg_size in $msg_sizes; do
-            make CLIENT_MSG_SIZE=8 CLIENT_BUF_SIZE=$buf_size SERVER_RSP_SIZE=$msg_size run-host-client2host
-        done
+        measure_sizes rsp CLIENT_MSG_SIZE=8 CLIENT_BUF_SIZE=$buf_size run-host-client2host
         make terminate-host-server
         make upload-results
 
@@ -68,18 +79,13 @@ for i in $(seq 1 "$n_runs"); do
 
         echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - host->enclave (vsock) with equal msg sizes..."
         make run-enclave-server
-        for msg_size in $msg_sizes; do
-            make CLIENT_BUF_SIZE=$buf_size SERVER_BUF_SIZE=$buf_size CLIENT_MSG_SIZE=$msg_size SERVER_RSP_SIZE=$msg_size run-host-client2enclave
-            export PRINT_HEADER=""
-        done
+        measure_sizes both CLIENT_BUF_SIZE=$buf_size SERVER_BUF_SIZE=$buf_size run-host-client2enclave
         make terminate-enclave-server
         make upload-results
 
         echo "[$(date +"%y-%m-%d-%H:%M:%S")] Run $i - host->host (inet) with equal msg sizes..."
         make run-host-server-background
-        for msg_size in $msg_sizes; do
-            make CLIENT_BUF_SIZE=$buf_size SERVER_BUF_SIZE=$buf_size CLIENT_MSG_SIZE=$msg_size SERVER_RSP_SIZE=$msg_size run-host-client2host
-        done
+        measure_sizes both CLIENT_BUF_SIZE=$buf_size SERVER_BUF_SIZE=$buf_size run-host-client2host
         make terminate-host-server
         make upload-results
 
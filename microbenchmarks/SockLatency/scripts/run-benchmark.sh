@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# This script is used to run the compute benchmark BENCHMARK (operators or memory), on the host or inside the enclave.
+# With RESULT_NAME, results are appended to the result file, otherwise (enclave) they are printed to the console
+# with an "@csv " prefix per line, see run-enclave-operators/run-enclave-memory in the Makefile.
+RESULT_DIR=${RESULT_DIR:-/data}
+VARIANT=${VARIANT:-enclave}
+PRINT_HEADER=${PRINT_HEADER-yes}  # enclave: always, the console output is filtered
+
+cd /app || exit
+CMD="./$BENCHMARK $BENCHMARK_ARGS --variant=$VARIANT"
+
+# Conditionally append optional config flags and numactl
+if [ -n "$RESULT_NAME" ]; then
+    CMD="$CMD --outfile=$RESULT_DIR/$RESULT_NAME"
+else
+    CMD="$CMD --line_prefix='@csv '"
+fi
+test -n "$PRINT_HEADER"  || CMD="$CMD --print_header=false"  # default is true
+test -n "$PERF_COUNTERS" && CMD="$CMD --perf_counters"
+
+echo "Running $BENCHMARK with command: $CMD"
+
+# Execute the command
+eval "$CMD"
@@ -19,7 +19,46 @@ test -n "$SERVER_RSP_SIZE"   && CMD="$CMD --server_rsp_size=$SERVER_RSP_SIZE"
 test -n "$NUM_SAMPLES"       && CMD="$CMD --num_samples=$NUM_SAMPLES"
 test -n "$NUM_WARMUP_ROUNDS" && CMD="$CMD --num_warmup_rounds=$NUM_WARMUP_ROUNDS"
 test -n "$TIMEOUT_SEC"       && CMD="$CMD --timeout_sec=$TIMEOUT_SEC"
-test -n "$PIN_CPU"           && CMD="numactl -C $PIN_CPU $CMD"
+test -n "$IO"                && CMD="$CMD --io=$IO"
+test -n "$RECV_STRATEGY"     && CMD="$CMD --recv_strategy=$RECV_STRATEGY"
+test -n "$RECV_POLL_US"      && CMD="$CMD --recv_poll_us=$RECV_POLL_US"
+test -n "$SHM_RING_SIZE"     && CMD="$CMD --shm_ring_size=$SHM_RING_SIZE"
+test -n "$SHM_HUGEPAGES"     && CMD="$CMD --shm_hugepages"
+test -n "$ARRIVAL"           && CMD="$CMD --arrival=$ARRIVAL"
+test -n "$RATES"             && CMD="$CMD --rates=$RATES"
+test -n "$STEP_DURATION_SEC" && CMD="$CMD --step_duration_sec=$STEP_DURATION_SEC"
+test -n "$PIPELINE_DEPTHS"   && CMD="$CMD --pipeline_depths=$PIPELINE_DEPTHS"
+test -n "$RECORDER"          && CMD="$CMD --recorder=$RECORDER"
+test -n "$HDR_DIGITS"        && CMD="$CMD --hdr_digits=$HDR_DIGITS"
+test -n "$TIMER"             && CMD="$CMD --timer=$TIMER"
+test -n "$TIMESTAMPS"        && CMD="$CMD --timestamps"
+test -n "$PERF_COUNTERS"     && CMD="$CMD --perf_counters"
+test -n "$FRAMED"            && CMD="$CMD --framed"
+test -n "$SEAL"              && CMD="$CMD --seal=$SEAL"
+test -n "$SEAL_RECORD_SIZE"  && CMD="$CMD --seal_record_size=$SEAL_RECORD_SIZE"
+test -n "$COMPRESSION"       && CMD="$CMD --compression=$COMPRESSION"
+test -n "$COMPRESSION_LEVEL" && CMD="$CMD --compression_level=$COMPRESSION_LEVEL"
+test -n "$COMPRESSION_CHUNK" && CMD="$CMD --compression_chunk=$COMPRESSION_CHUNK"
+test -n "$COMPRESSION_DEPTH" && CMD="$CMD --compression_depth=$COMPRESSION_DEPTH"
+test -n "$COMPRESSIBILITY"   && CMD="$CMD --compressibility=$COMPRESSIBILITY"
+test -n "$SCAN_BATCH_ROWS"   && CMD="$CMD --scan_batch_rows=$SCAN_BATCH_ROWS"
+test -n "$SCAN_BUFFERS"      && CMD="$CMD --scan_buffers=$SCAN_BUFFERS"
+test -n "$SCAN_SELECTIVITY"  && CMD="$CMD --scan_selectivity=$SCAN_SELECTIVITY"
+test -n "$SCAN_GROUPS"       && CMD="$CMD --scan_groups=$SCAN_GROUPS"
+test -n "$SCAN_SIMD"         && CMD="$CMD --scan_simd=$SCAN_SIMD"
+test -n "$SWEEP_SIZES"       && CMD="$CMD --sweep_sizes=$SWEEP_SIZES"
+test -n "$SWEEP_VARY"        && CMD="$CMD --sweep_vary=$SWEEP_VARY"
+test -n "$REPLAY_TRACE"      && CMD="$CMD --replay_trace=$RESULT_DIR/$REPLAY_TRACE"
+test -n "$REPLAY_MIX"        && CMD="$CMD --replay_mix=$REPLAY_MIX"
+test -n "$REPLAY_GAP_US"     && CMD="$CMD --replay_gap_us=$REPLAY_GAP_US"
+test -n "$HISTOGRAM_NAME"    && CMD="$CMD --histogram_outfile=$RESULT_DIR/$HISTOGRAM_NAME"
+test -n "$RAW_NAME"          && CMD="$CMD --raw_outfile=$RESULT_DIR/$RAW_NAME"
+test -n "$VARIANT"           && CMD="$CMD --variant=$VARIANT"
+test -n "$CONNECTIONS"       && CMD="$CMD --connections=$CONNECTIONS"
+test -n "$WORKLOAD"          && CMD="$CMD --workload=$WORKLOAD"
+test -n "$THREADS"           && CMD="$CMD --threads=$THREADS"
+test -n "$CPUS"              && CMD="$CMD --cpus=$CPUS"                # the client pins its threads itself
+test -n "$PIN_CPU"           && test -z "$CPUS" && CMD="numactl -C $PIN_CPU $CMD"
 
 echo "Running client with command: $CMD"
 
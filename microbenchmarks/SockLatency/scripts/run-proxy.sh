@@ -1,9 +1,31 @@
 #!/bin/sh
 
 PROTOCOL=${PROTOCOL:-vsock}
+PROXY_TOOL=${PROXY_TOOL:-socat}
 SERVER_PORT=${SERVER_PORT:-5005}
 CLIENT_PORT=${CLIENT_PORT:-5005}
 
+# native splice/epoll proxy (requires the socklatency:app image)
+if [ "$PROXY_TOOL" = "native" ]; then
+    if [ "$PROTOCOL" = "vsock" ]; then
+        target="--connect_protocol=vsock --connect_address=$SERVER_CID"
+    elif [ "$PROTOCOL" = "tcp" ]; then
+        target="--connect_protocol=inet --connect_address=127.0.0.1"
+    else
+        echo "Unknown protocol $PROTOCOL"
+        exit 1
+    fi
+    # mux: all clients over a pool of coalescing tunnel connections to the demux proxy in front of the server (TUNNEL)
+    if [ "${PROXY_MODE:-forward}" = "mux" ]; then
+        target="$target --mode=mux"
+        test -n "$COALESCE_BYTES" && target="$target --coalesce_bytes=$COALESCE_BYTES"
+        test -n "$COALESCE_US"    && target="$target --coalesce_us=$COALESCE_US"
+        test -n "$TUNNEL_CONNECTIONS" && target="$target --tunnel_connections=$TUNNEL_CONNECTIONS"
+        test -n "$STREAM_WINDOW"      && target="$target --stream_window=$STREAM_WINDOW"
+    fi
+    exec /app/proxy --listen_port="$CLIENT_PORT" --connect_port="$SERVER_PORT" $target --no_delay
+fi
+
 # proxy tcp to vsock
 so_opts_tcp="reuseaddr,fork,nodelay,nonblock"
 so_opts_connect="nonblock"
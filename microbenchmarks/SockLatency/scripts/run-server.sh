@@ -2,11 +2,29 @@
 
 # This script is used to run the server side of the sock-latency microbenchmark.
 cd /app || exit
+
+# the images of the compute benchmarks run the benchmark instead of the server
+test -n "$BENCHMARK" && exec /scripts/run-benchmark.sh
+
+# tunnel end of a mux proxy: the demux proxy takes the tunnel connection and connects per stream to the server on a unix socket
+if [ -n "$TUNNEL" ]; then
+    echo "Running demux proxy on $PROTOCOL:$ADDRESS:${PORT:-5005}"
+    ./proxy --mode=demux --listen_protocol="$PROTOCOL" --listen_address="$ADDRESS" --listen_port="${PORT:-5005}" \
+        --connect_protocol=unix --connect_address=@socklatency-tunnel &
+    PROTOCOL=unix
+    ADDRESS=@socklatency-tunnel
+fi
+
 CMD="./server --protocol=$PROTOCOL --address=$ADDRESS"
 
 # Conditionally append optional config flags and numactl
 test -n "$PORT"      && CMD="$CMD --port=$PORT"
 test -n "$BUF_SIZE"  && CMD="$CMD --buf_size=$BUF_SIZE"
+test -n "$SERVER_MODE" && CMD="$CMD --server_mode=$SERVER_MODE"
+test -n "$IO"        && CMD="$CMD --io=$IO"
+test -n "$RECV_STRATEGY" && CMD="$CMD --recv_strategy=$RECV_STRATEGY"
+test -n "$RECV_POLL_US"  && CMD="$CMD --recv_poll_us=$RECV_POLL_US"
+test -n "$PERF_COUNTERS" && CMD="$CMD --perf_counters"
 test -n "$PIN_CPU"   && CMD="numactl -C $PIN_CPU $CMD"
 
 echo "Running server with command: $CMD"
@@ -3,6 +3,23 @@
 # starts as many proxies as given by the $NUM_SERVERS argument. Default 1. Ports are 5201 and following.
 # Copied into the proxy docker container to run there
 
+PROXY_TOOL=${PROXY_TOOL:-socat}
+
+# native splice/epoll proxy of the SockLatency app (built into the image at /app/proxy), one process per port
+if [ "$PROXY_TOOL" = "native" ]; then
+    PROXY_BIN=${PROXY_BIN:-/app/proxy}
+    echo "Starting $NUM_SERVERS native proxy processes!"
+    i=1
+    while [ "$i" -le "$NUM_SERVERS" ]; do
+        port=$((5201 + i - 1))
+        echo "Starting proxy $i on port $port"
+        $PROXY_BIN --listen_port=$port --connect_protocol=vsock --connect_address="$SERVER_CID" --connect_port=$port --no_delay &
+        i=$((i + 1))
+    done
+    wait
+    exit 0
+fi
+
 echo "Starting $NUM_SERVERS socat proxy processes!"
 
 so_opts_tcp="reuseaddr,fork,nodelay,nonblock"
@@ -38,6 +38,15 @@ if [ "$PROXY_TOOL" = "socat" ]; then
         socat tcp-listen:$TCP_LISTEN_PORT,$so_opts_listen tcp-connect:$TCP_CONNECT_HOST:$TCP_CONNECT_PORT$so_opts_connect &
     done
 
+# native splice/epoll proxy of the SockLatency app (built into the image at /app/proxy)
+elif [ "$PROXY_TOOL" = "native" ]; then
+    PROXY_BIN=${PROXY_BIN:-/app/proxy}
+    opts="--reuse_depth=$PROXY_REUSE_DEPTH"
+    test -n "$SO_RCVBUF_SIZE"       && opts="$opts --so_rcvbuf=$SO_RCVBUF_SIZE"
+    test -n "$SO_SNDBUF_SIZE"       && opts="$opts --so_sndbuf=$SO_SNDBUF_SIZE"
+    test -n "$SO_NO_DELAY"          && opts="$opts --no_delay"
+    $PROXY_BIN --listen_protocol=inet --listen_port=$TCP_LISTEN_PORT --connect_protocol=inet --connect_address=$TCP_CONNECT_HOST --connect_port=$TCP_CONNECT_PORT $opts &
+
 # ncat
 elif [ "$PROXY_TOOL" = "ncat" ]; then
     if [ "$PROXY_REUSE_DEPTH" -ne 1 ]; then
@@ -10,6 +10,7 @@ cat >> /data/config.yaml <<EOF
 proxy_on: true
 proxy_tool: $PROXY_TOOL
 proxy_reuse_depth: $PROXY_REUSE_DEPTH
+proxy_tunnels: $PROXY_TUNNELS
 proxy_so_rcvbuf_size: $SO_RCVBUF_SIZE
 proxy_so_sndbuf_size: $SO_SNDBUF_SIZE
 proxy_so_nonblocking: $SO_NONBLOCKING
@@ -35,6 +36,16 @@ if [ "$PROXY_TOOL" = "socat" ]; then
         socat tcp-listen:6379,$so_opts_tcp vsock-connect:$SERVER_CID:5000$so_opts_vsock &
     done
 
+# native splice/epoll proxy of the SockLatency app (built into the image at /app/proxy)
+elif [ "$PROXY_TOOL" = "native" ]; then
+    PROXY_BIN=${PROXY_BIN:-/app/proxy}
+    opts="--reuse_depth=$PROXY_REUSE_DEPTH"
+    test -n "$SO_RCVBUF_SIZE"       && opts="$opts --so_rcvbuf=$SO_RCVBUF_SIZE"
+    test -n "$SO_SNDBUF_SIZE"       && opts="$opts --so_sndbuf=$SO_SNDBUF_SIZE"
+    test -n "$SO_NO_DELAY"          && opts="$opts --no_delay"
+    test -n "$PROXY_TUNNELS"        && opts="$opts --mode=mux --tunnel_connections=$PROXY_TUNNELS"  # peer: demux proxy in the enclave
+    $PROXY_BIN --listen_protocol=inet --listen_port=6379 --connect_protocol=vsock --connect_address=$SERVER_CID --connect_port=5000 $opts &
+
 # ncat
 elif [ "$PROXY_TOOL" = "ncat" ]; then
     if [ "$PROXY_REUSE_DEPTH" -ne 1 ]; then
@@ -23,6 +23,16 @@ if [ "$PROXY_TOOL" = "socat" ]; then
         socat vsock-listen:5000,$so_opts_vsock tcp-connect:127.0.0.1:6379$so_opts_tcp &
     done
 
+# native splice/epoll proxy of the SockLatency app (built into the image at /app/proxy)
+elif [ "$PROXY_TOOL" = "native" ]; then
+    PROXY_BIN=${PROXY_BIN:-/app/proxy}
+    opts="--reuse_depth=$PROXY_REUSE_DEPTH"
+    test -n "$SO_RCVBUF_SIZE"       && opts="$opts --so_rcvbuf=$SO_RCVBUF_SIZE"
+    test -n "$SO_SNDBUF_SIZE"       && opts="$opts --so_sndbuf=$SO_SNDBUF_SIZE"
+    test -n "$SO_NO_DELAY"          && opts="$opts --no_delay"
+    test -n "$PROXY_TUNNELS"        && opts="$opts --mode=demux"  # peer: mux proxy on the host
+    $PROXY_BIN --listen_protocol=vsock --listen_address=-1 --listen_port=5000 --connect_protocol=inet --connect_address=127.0.0.1 --connect_port=6379 $opts &
+
 # ncat
 elif [ "$PROXY_TOOL" = "ncat" ]; then
     if [ "$PROXY_REUSE_DEPTH" -ne 1 ]; then